@@ -0,0 +1,71 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Starts a block big enough for size, twice the size of the previous one
+static ArenaBlock *addBlock(Arena *arena, size_t size) {
+  size_t capacity =
+      arena->current ? arena->current->size * 2 : ARENA_BLOCK_SIZE;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+  if (!block) {
+    return NULL;
+  }
+  block->prev = arena->current;
+  block->size = capacity;
+  block->used = 0;
+  arena->current = block;
+  return block;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  ArenaBlock *block = arena->current;
+  if (!block || block->size - block->used < size) {
+    block = addBlock(arena, size);
+    if (!block) {
+      return NULL;
+    }
+  }
+  void *ptr = block->data + block->used;
+  block->used += size;
+  return ptr;
+}
+
+char *arenaStrdup(Arena *arena, const char *str) {
+  size_t len = strlen(str) + 1;
+  char *copy = arenaAlloc(arena, len);
+  if (copy) {
+    memcpy(copy, str, len);
+  }
+  return copy;
+}
+
+static void freeBlocks(ArenaBlock *block) {
+  while (block) {
+    ArenaBlock *prev = block->prev;
+    free(block);
+    block = prev;
+  }
+}
+
+void arenaReset(Arena *arena) {
+  ArenaBlock *block = arena->current;
+  if (!block) {
+    return;
+  }
+  if (block->size > ARENA_RETAIN_MAX) {
+    arenaRelease(arena);
+    return;
+  }
+  freeBlocks(block->prev);
+  block->prev = NULL;
+  block->used = 0;
+}
+
+void arenaRelease(Arena *arena) {
+  freeBlocks(arena->current);
+  arena->current = NULL;
+}
@@ -0,0 +1,55 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 16
+#define ARENA_BLOCK_SIZE 4096        /* First block, later blocks double */
+#define ARENA_RETAIN_MAX (64 * 1024) /* Largest block kept across resets */
+
+typedef struct ArenaBlock {
+  struct ArenaBlock *prev;
+  size_t size; /* Capacity of data */
+  size_t used;
+  char data[] __attribute__((aligned(ARENA_ALIGN)));
+} ArenaBlock;
+
+/**
+ * Bump allocator for memory that lives until the next reset, such as the
+ * scratch copies one command makes while building its reply. A zeroed
+ * Arena is empty and ready to use; it takes no memory until first used.
+ */
+typedef struct Arena {
+  ArenaBlock *current; /* Block being carved, NULL until first use */
+} Arena;
+
+/**
+ * Allocates from the arena. The memory is not freed individually.
+ * @param arena Arena to allocate from
+ * @param size Bytes needed, may be 0
+ * @return Block aligned to ARENA_ALIGN, or NULL on failure
+ */
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+ * Copies a NUL-terminated string into the arena
+ * @param arena Arena to allocate from
+ * @param str String to copy
+ * @return Copy valid until the next reset, or NULL on failure
+ */
+char *arenaStrdup(Arena *arena, const char *str);
+
+/**
+ * Invalidates everything allocated so far. The newest block is kept for
+ * reuse unless it grew past ARENA_RETAIN_MAX, the rest are freed.
+ * @param arena Arena to reset
+ */
+void arenaReset(Arena *arena);
+
+/**
+ * Frees every block, leaving the arena empty
+ * @param arena Arena to release
+ */
+void arenaRelease(Arena *arena);
+
+#endif
@@ -1,4 +1,5 @@
 #include "client_handler.h"
+#include "clock.h"
 #include "command.h"
 #include "command_queue.h"
 #include "logger.h"
@@ -11,7 +12,7 @@
 ClientState *handleNewClient(RedisServer *server, int clientFd) {
   LOG_DEBUG("Attempting to create new client connection for fd %d", clientFd);
 
-  if (clientFd >= MAX_CLIENTS) {
+  if (server->clients_count >= MAX_CLIENTS) {
     LOG_WARN("Client connection rejected - exceeded MAX_CLIENTS limit (fd: %d, "
              "max: %d)",
              clientFd, MAX_CLIENTS);
@@ -28,6 +29,20 @@ ClientState *handleNewClient(RedisServer *server, int clientFd) {
   }
 
   client->fd = clientFd;
+  client->bstate = (BlockingState){.deadline = -1, .partition = -1};
+  client->events = 0;
+  client->registered = 0;
+  client->epfd = -1;
+  client->replica = 0;
+  client->propagate_as = NULL;
+  client->home = 0;
+  client->partition = -1;
+  client->forwarded_command = NULL;
+  client->forward_to = -1;
+  client->handoff = HANDOFF_EXECUTE;
+  client->handoff_status = CLIENT_OK;
+  client->handoff_next = NULL;
+  client->arena.current = NULL;
   client->buffer = createRespBuffer();
   if (!client->buffer) {
     LOG_ERROR("Failed to create RESP buffer for client (fd: %d)", clientFd);
@@ -35,10 +50,19 @@ ClientState *handleNewClient(RedisServer *server, int clientFd) {
     close(clientFd);
     return NULL;
   }
+  client->reply = createOutputBuffer();
+  if (!client->reply) {
+    LOG_ERROR("Failed to create output buffer for client (fd: %d)", clientFd);
+    freeRespBuffer(client->buffer);
+    free(client);
+    close(clientFd);
+    return NULL;
+  }
   client->in_transaction = 0;
   client->queue = createCommandQueue();
   if (!client->queue) {
     LOG_ERROR("Failed to create command queue for client (fd: %d)", clientFd);
+    freeOutputBuffer(client->reply);
     freeRespBuffer(client->buffer);
     free(client);
     close(clientFd);
@@ -50,60 +74,240 @@ ClientState *handleNewClient(RedisServer *server, int clientFd) {
   return client;
 }
 
-void handleClientCommand(RedisServer *server, int fd, RespValue *command,
-                         ClientState *clientState) {
+// Disconnects clients whose queued output grew past the hard limit
+static int checkClientOutputLimit(ClientState *client) {
+  if (client->reply->pending > OUTPUT_HARD_LIMIT) {
+    LOG_WARN("Client output buffer over hard limit, closing (fd: %d, "
+             "pending: %zu)",
+             client->fd, client->reply->pending);
+    return CLIENT_CLOSE;
+  }
+
+  return CLIENT_OK;
+}
+
+int queueClientReply(ClientState *client, const char *reply, size_t len) {
+  if (outputBufferAppend(client->reply, reply, len) != OUTPUT_OK) {
+    LOG_ERROR("Failed to queue reply for client (fd: %d)", client->fd);
+    return CLIENT_CLOSE;
+  }
+
+  return checkClientOutputLimit(client);
+}
+
+int flushClientOutput(ClientState *client) {
+  if (flushOutputBuffer(client->reply, client->fd) == OUTPUT_ERR) {
+    LOG_ERROR("Write error on client socket (fd: %d): %s", client->fd,
+              strerror(errno));
+    return CLIENT_CLOSE;
+  }
+  return CLIENT_OK;
+}
+
+int clientHasPendingOutput(const ClientState *client) {
+  return client->reply->pending > 0;
+}
+
+int clientOutputPaused(const ClientState *client) {
+  return client->reply->pending >= OUTPUT_SOFT_LIMIT;
+}
+
+int handleClientCommand(RedisServer *server, int fd, RespValue *command,
+                        ClientState *clientState) {
   if (command->type != RespTypeArray || command->data.array.len < 1) {
     LOG_DEBUG(
         "Received invalid command from client (fd: %d, type: %d, len: %d)", fd,
         command->type, command->data.array.len);
-    return;
+    return CLIENT_OK;
   }
 
   LOG_DEBUG("Processing command from client (fd: %d, in_transaction: %d)", fd,
             clientState->in_transaction);
 
-  const char *response =
-      executeCommand(server, server->db, command, clientState);
+  // In shared-nothing mode the client is always served by the thread that
+  // owns its current partition
+  RedisStore *store = clientState->partition >= 0
+                          ? server->partitions[clientState->partition]
+                          : server->db;
 
-  if (response) {
-    LOG_TRACE("Sending response to client (fd: %d, response: %s)", fd,
-              response);
-    sendReply(server, fd, response);
-  } else {
-    LOG_DEBUG("No response generated for client command (fd: %d)", fd);
+  // The reply is encoded straight into the client's output buffer
+  size_t pending = clientState->reply->pending;
+  if (executeCommandTo(server, store, command, clientState,
+                       clientState->reply) != OUTPUT_OK) {
+    LOG_ERROR("Failed to queue reply for client (fd: %d)", fd);
+    return CLIENT_CLOSE;
   }
+  // The reply holds its own copy of everything, scratch memory can go
+  arenaReset(&clientState->arena);
+
+  // A master does not answer its replicas, their socket only carries the
+  // replication stream (REPLCONF ACK has no reply anyway)
+  if (clientState->replica) {
+    resetOutputBuffer(clientState->reply);
+    return CLIENT_OK;
+  }
+
+  LOG_TRACE("Queued response for client (fd: %d, bytes: %zu)", fd,
+            clientState->reply->pending - pending);
+  return checkClientOutputLimit(clientState);
 }
 
-void handleClientData(RedisServer *server, ClientState *client) {
-  char readBuf[1024];
-  LOG_DEBUG("Starting client data handling loop (fd: %d)", client->fd);
+int blockClient(ClientState *client, int reason, long long timeoutMs) {
+  BlockingState *bstate = &client->bstate;
+  if (bstate->attempt != BLOCK_ALLOWED) {
+    return 0;
+  }
+  // Retries keep the deadline of the first attempt
+  if (bstate->reason == BLOCKED_NONE) {
+    bstate->deadline = timeoutMs > 0 ? clockMonotonicMs() + timeoutMs : -1;
+  }
+  bstate->reason = reason;
+  bstate->attempt = BLOCK_PARKED;
+  return 1;
+}
 
-  while (1) {
-    ssize_t n = recv(client->fd, readBuf, sizeof(readBuf), 0);
+// Runs one attempt of the blocked command, which stays in client->bstate
+// until an attempt answers
+static int runBlockedCommand(RedisServer *server, ClientState *client) {
+  BlockingState *bstate = &client->bstate;
+  bstate->attempt = bstate->timed_out ? BLOCK_TIMED_OUT : BLOCK_ALLOWED;
+  bstate->signals = __atomic_load_n(&server->block_signals, __ATOMIC_SEQ_CST);
 
-    if (n == 0) {
-      LOG_INFO("Client disconnected (fd: %d)", client->fd);
-      break;
-    }
+  int status = handleClientCommand(server, client->fd, bstate->command, client);
+  int parked = bstate->attempt == BLOCK_PARKED;
+  bstate->attempt = BLOCK_DENIED;
+  if (parked) {
+    LOG_DEBUG("Client parked by blocking command (fd: %d)", client->fd);
+    return status == CLIENT_OK ? CLIENT_BLOCKED : status;
+  }
+
+  freeRespValue(bstate->command);
+  bstate->command = NULL;
+  bstate->reason = BLOCKED_NONE;
+  bstate->timed_out = 0;
+  __atomic_sub_fetch(&server->blocked_clients, 1, __ATOMIC_RELAXED);
+  return status;
+}
 
-    if (n < 0) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        continue; // Non-blocking operation, try again
+// Executes one parsed command, or parks it when it must run elsewhere
+static int dispatchCommand(RedisServer *server, ClientState *client,
+                           RespValue *command) {
+  if (client->partition >= 0) {
+    int target = commandPartition(server, command, client);
+    if (target == PARTITION_CROSS) {
+      if (rejectCrossPartition(command, client, client->reply) != OUTPUT_OK) {
+        return CLIENT_CLOSE;
       }
-      LOG_ERROR("Read error on client socket (fd: %d): %s", client->fd,
-                strerror(errno));
-      break;
+      return checkClientOutputLimit(client);
+    }
+    if (target >= 0 && target != client->partition) {
+      // No parse happens until the owner runs it, so it can stay borrowed
+      client->forwarded_command = command;
+      client->forward_to = target;
+      return CLIENT_FORWARD;
+    }
+  }
+
+  if (commandMayBlock(command, client)) {
+    // The command outlives the read buffer contents while it is parked
+    client->bstate.command = cloneRespValue(command);
+    if (!client->bstate.command) {
+      return CLIENT_CLOSE;
+    }
+    // Counted before the first attempt looks for data, so a signal raised
+    // after that look is never skipped, see signalBlockedClients
+    __atomic_add_fetch(&server->blocked_clients, 1, __ATOMIC_SEQ_CST);
+    int status = runBlockedCommand(server, client);
+    if (status == CLIENT_BLOCKED) {
+      // Send what is batched so far before the client waits
+      return flushClientOutput(client) == CLIENT_OK ? CLIENT_BLOCKED
+                                                    : CLIENT_CLOSE;
     }
-    LOG_TRACE("Received data from client (fd: %d, bytes: %zd)", client->fd, n);
-    appendRespBuffer(client->buffer, readBuf, n);
-
-    RespValue *command;
-    while (parseResp(client->buffer, &command) == RESP_OK) {
-      LOG_TRACE("Successfully parsed RESP command (fd: %d)", client->fd);
-      handleClientCommand(server, client->fd, command, client);
-      freeRespValue(command);
+    return status;
+  }
+  return handleClientCommand(server, client->fd, command, client);
+}
+
+int processClientBuffer(RedisServer *server, ClientState *client) {
+  RespValue *command;
+  int result = RESP_OK;
+
+  // Replies of every command parsed from this read are batched and written
+  // with a single flush at the end instead of one syscall per reply.
+  // Stop executing commands while the client is not draining its replies,
+  // the rest of the input stays buffered until the socket becomes writable.
+  // Commands are parsed in place and borrowed from the read buffer, so they
+  // are only valid until the next parse.
+  while (!clientOutputPaused(client) &&
+         (result = parseRespInPlace(client->buffer, &command)) == RESP_OK) {
+    LOG_TRACE("Successfully parsed RESP command (fd: %d)", client->fd);
+    int status = dispatchCommand(server, client, command);
+    if (status != CLIENT_OK) {
+      return status;
+    }
+  }
+
+  if (result == RESP_ERR) {
+    LOG_WARN("Protocol error from client (fd: %d)", client->fd);
+    const char *error = "-ERR Protocol error\r\n";
+    queueClientReply(client, error, strlen(error));
+    flushClientOutput(client);
+    return CLIENT_CLOSE;
+  }
+
+  return flushClientOutput(client);
+}
+
+int resumeBlockedClient(RedisServer *server, ClientState *client) {
+  int status = runBlockedCommand(server, client);
+  if (status != CLIENT_OK) {
+    return status;
+  }
+  return processClientBuffer(server, client);
+}
+
+int runForwardedCommand(RedisServer *server, ClientState *client) {
+  RespValue *command = client->forwarded_command;
+  client->forwarded_command = NULL;
+
+  int status = dispatchCommand(server, client, command);
+  if (status != CLIENT_OK) {
+    return status;
+  }
+  return processClientBuffer(server, client);
+}
+
+int handleClientData(RedisServer *server, ClientState *client) {
+  RespBuffer *buffer = client->buffer;
+
+  // Read straight into the parse buffer, which may already have been sized
+  // for a large argument by the parser
+  if (reserveRespBuffer(buffer, CLIENT_READ_CHUNK) != RESP_OK) {
+    LOG_ERROR("Failed to buffer client data (fd: %d)", client->fd);
+    return CLIENT_CLOSE;
+  }
+
+  ssize_t n = recv(client->fd, buffer->buffer + buffer->used,
+                   buffer->size - buffer->used, 0);
+
+  if (n == 0) {
+    LOG_INFO("Client disconnected (fd: %d)", client->fd);
+    return CLIENT_CLOSE;
+  }
+
+  if (n < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return CLIENT_OK; // Spurious wakeup, wait for the next event
     }
+    LOG_ERROR("Read error on client socket (fd: %d): %s", client->fd,
+              strerror(errno));
+    return CLIENT_CLOSE;
   }
+
+  LOG_TRACE("Received data from client (fd: %d, bytes: %zd)", client->fd, n);
+  buffer->used += n;
+
+  return processClientBuffer(server, client);
 }
 
 void freeClientState(ClientState *client) {
@@ -116,28 +320,9 @@ void freeClientState(ClientState *client) {
   if (client->queue) {
     freeCommandQueue(client->queue);
   }
+  freeOutputBuffer(client->reply);
+  freeRespValue(client->bstate.command);
+  arenaRelease(&client->arena);
   close(client->fd);
   free(client);
 }
-
-void handleClientConnection(void *arg) {
-  ClientHandlerArg *client_arg = (ClientHandlerArg *)arg;
-  LOG_DEBUG("Initializing client handler thread (fd: %d, server_port: %d)",
-            client_arg->clientFd, client_arg->server->port);
-
-  ClientState *client =
-      handleNewClient(client_arg->server, client_arg->clientFd);
-
-  if (client) {
-    LOG_INFO("Starting client data handling (fd: %d)", client_arg->clientFd);
-    handleClientData(client_arg->server, client);
-    freeClientState(client);
-  } else {
-    LOG_WARN("Failed to initialize client state (fd: %d)",
-             client_arg->clientFd);
-  }
-
-  LOG_DEBUG("Cleaning up client handler thread (fd: %d)", client_arg->clientFd);
-  LOG_INFO("Client handler thread terminated (fd: %d)", client_arg->clientFd);
-  free(client_arg);
-}
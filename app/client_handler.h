@@ -1,29 +1,171 @@
 #ifndef CLIENT_HANDLER_H
 #define CLIENT_HANDLER_H
 
+#include "arena.h"
 #include "command_queue.h"
 
+#include "output_buffer.h"
 #include "resp.h"
 #include "server.h"
+#include "timer_wheel.h"
 
-#define MAX_CLIENTS 1024
+#define MAX_CLIENTS 65536
+#define CLIENT_READ_CHUNK 16384 /* Minimum free space offered to each read */
 
-typedef struct {
+/* Client processing status codes */
+#define CLIENT_OK 0       /* Keep serving the client */
+#define CLIENT_CLOSE -1   /* Connection closed or failed */
+#define CLIENT_BLOCKED 1  /* Parked until its blocking command can answer */
+#define CLIENT_FORWARD 2  /* Next command belongs to another partition */
+
+/* Why a client was handed to another reactor in shared-nothing mode */
+#define HANDOFF_EXECUTE 0 /* Run forwarded_command on the receiving partition */
+#define HANDOFF_RETURN 1  /* Back to the home reactor with handoff_status */
+#define HANDOFF_RETRY 2   /* Retry the blocked command on the receiving partition */
+
+/* What a blocked client waits for, bits when signalling reactors */
+#define BLOCKED_NONE 0
+#define BLOCKED_STREAM 1 /* XREAD BLOCK, retried after XADD */
+#define BLOCKED_WAIT 2   /* WAIT, retried after replica ACKs */
+
+/* Attempt of a blocked command, see blockClient */
+#define BLOCK_DENIED 0    /* Not running a blocked command, answer now */
+#define BLOCK_ALLOWED 1   /* The command may park the client */
+#define BLOCK_TIMED_OUT 2 /* Past the deadline, answer now */
+#define BLOCK_PARKED 3    /* The command parked the client */
+
+struct ClientState;
+
+/**
+ * A command that may block (XREAD BLOCK, WAIT) is kept here and attempted
+ * again whenever something it waits for is signalled or its deadline
+ * passes. In between the client is parked on its home reactor, which holds
+ * no thread for it.
+ */
+typedef struct BlockingState {
+  RespValue *command;        /* Owned copy, attempted until it answers */
+  int reason;                /* BLOCKED_* once an attempt parked the client */
+  int attempt;               /* BLOCK_* of the running attempt */
+  int timed_out;             /* Deadline passed, the next attempt answers */
+  long long deadline;        /* Monotonic ms to answer by, -1 for ever */
+  long long offset;          /* Replication offset WAIT waits for */
+  unsigned long signals;     /* server->block_signals at the last attempt */
+  int partition;             /* Partition the command runs against, or -1 */
+  TimerNode timer;           /* Deadline in the home reactor's wheel */
+  struct ClientState *prev;  /* Home reactor's parked clients */
+  struct ClientState *next;
+} BlockingState;
+
+typedef struct ClientState {
   int fd;
   RespBuffer *buffer;
+  OutputBuffer *reply; /* Replies waiting to be written to the socket */
+  Arena arena;         /* Scratch memory of the command being executed */
   int in_transaction;
   CommandQueue *queue;
-} ClientState;
+  BlockingState bstate;       /* Blocking command, if any */
+  unsigned int events;        /* epoll interest currently registered */
+  int registered;             /* Socket is in its home reactor's epoll set */
+  int epfd;                   /* Home reactor's epoll set, -1 until accepted */
+  int replica;                /* Synced replica, output is its replication
+                                 stream and replies are dropped */
+  RespValue *propagate_as;    /* Replicated instead of the command being
+                                 executed, lives in arena */
 
-typedef struct {
-  RedisServer *server;
-  int clientFd;
-} ClientHandlerArg;
+  // Shared-nothing mode. A client is served by one thread at a time: its
+  // home reactor or the reactor owning the partition of its current
+  // command.
+  int home;                     /* Reactor that accepted the connection */
+  int partition;                /* Partition commands run against, or -1 */
+  RespValue *forwarded_command; /* Borrowed from buffer, runs on forward_to */
+  int forward_to;               /* Partition owning forwarded_command */
+  int handoff;                  /* HANDOFF_EXECUTE or HANDOFF_RETURN */
+  int handoff_status;           /* Client status carried home */
+  struct ClientState *handoff_next; /* Overflow mailbox link */
+} ClientState;
 
 ClientState *handleNewClient(RedisServer *server, int clientFd);
-void handleClientCommand(RedisServer *server, int fd, RespValue *command,
-                         ClientState *clientState);
-void handleClientData(RedisServer *server, ClientState *client);
-void handleClientConnection(void *arg);
+
+/**
+ * Executes a command and queues its reply on the client's output buffer.
+ *
+ * @return CLIENT_OK or CLIENT_CLOSE
+ */
+int handleClientCommand(RedisServer *server, int fd, RespValue *command,
+                        ClientState *clientState);
+
+/**
+ * Queues raw reply bytes on the client's output buffer.
+ *
+ * @return CLIENT_OK or CLIENT_CLOSE if the output limit was exceeded
+ */
+int queueClientReply(ClientState *client, const char *reply, size_t len);
+
+/**
+ * Writes as much queued output as the socket accepts.
+ *
+ * @return CLIENT_OK or CLIENT_CLOSE
+ */
+int flushClientOutput(ClientState *client);
+
+/**
+ * Reports whether the client has queued output waiting for the socket to
+ * become writable.
+ */
+int clientHasPendingOutput(const ClientState *client);
+
+/**
+ * Reports whether reading from the client is paused because too much
+ * output is queued (backpressure).
+ */
+int clientOutputPaused(const ClientState *client);
+
+/**
+ * Reads available data from a readable client socket and executes every
+ * complete command in its buffer.
+ *
+ * @return CLIENT_OK, CLIENT_CLOSE, CLIENT_BLOCKED or CLIENT_FORWARD
+ */
+int handleClientData(RedisServer *server, ClientState *client);
+
+/**
+ * Executes every complete command buffered for the client. Stops after a
+ * command that parked the client, leaving it in client->bstate, and in
+ * shared-nothing mode before a command owned by another partition, leaving
+ * it in client->forwarded_command.
+ *
+ * @return CLIENT_OK, CLIENT_CLOSE, CLIENT_BLOCKED or CLIENT_FORWARD
+ */
+int processClientBuffer(RedisServer *server, ClientState *client);
+
+/**
+ * Called by a command handler that cannot answer yet. Parks the client if
+ * the handler runs as an attempt of its blocked command, in which case the
+ * handler must not reply.
+ *
+ * @param client Client running the command
+ * @param reason BLOCKED_* event that may let the command answer
+ * @param timeoutMs Time to wait from the first attempt, 0 for ever
+ * @return 1 if parked, 0 if the handler must answer now
+ */
+int blockClient(ClientState *client, int reason, long long timeoutMs);
+
+/**
+ * Attempts the client's blocked command again, then executes the rest of
+ * its buffer if the command answered.
+ *
+ * @return CLIENT_OK, CLIENT_CLOSE, CLIENT_BLOCKED or CLIENT_FORWARD
+ */
+int resumeBlockedClient(RedisServer *server, ClientState *client);
+
+/**
+ * Executes the command forwarded to the client's current partition, then
+ * the rest of its buffer.
+ *
+ * @return CLIENT_OK, CLIENT_CLOSE, CLIENT_BLOCKED or CLIENT_FORWARD
+ */
+int runForwardedCommand(RedisServer *server, ClientState *client);
+
+void freeClientState(ClientState *client);
 
 #endif
@@ -0,0 +1,33 @@
+#include "clock.h"
+#include <time.h>
+
+typedef struct ClockCache {
+  long long nowMs;
+  long long monotonicMs;
+  int cached; /* Set between clockUpdate and clockStopCaching */
+} ClockCache;
+
+static __thread ClockCache threadClock;
+
+static long long readMs(clockid_t id) {
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void clockUpdate(void) {
+  threadClock.nowMs = readMs(CLOCK_REALTIME);
+  threadClock.monotonicMs = readMs(CLOCK_MONOTONIC);
+  threadClock.cached = 1;
+}
+
+void clockStopCaching(void) { threadClock.cached = 0; }
+
+long long clockNowMs(void) {
+  return threadClock.cached ? threadClock.nowMs : readMs(CLOCK_REALTIME);
+}
+
+long long clockMonotonicMs(void) {
+  return threadClock.cached ? threadClock.monotonicMs
+                            : readMs(CLOCK_MONOTONIC);
+}
@@ -0,0 +1,30 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/**
+ * Caches the wall and monotonic clocks for the calling thread, so later
+ * reads on it cost a load instead of a clock_gettime call. Event loops call
+ * this once per iteration, right after epoll_wait returns, which makes every
+ * command of a batch see the same time. Threads that never call it, such as
+ * the thread pool, replication and tests, read the clocks directly.
+ */
+void clockUpdate(void);
+
+/**
+ * Stops caching on the calling thread, later reads hit the clocks again
+ */
+void clockStopCaching(void);
+
+/**
+ * Reads the wall clock, from the thread's cache when it has one
+ * @return Milliseconds since the Unix epoch
+ */
+long long clockNowMs(void);
+
+/**
+ * Reads the monotonic clock, from the thread's cache when it has one
+ * @return Milliseconds since an arbitrary fixed point
+ */
+long long clockMonotonicMs(void);
+
+#endif
@@ -1,67 +1,99 @@
 #include "command.h"
+#include "event_loop.h"
+#include "logger.h"
 #include "rdb.h"
 #include "redis_store.h"
 #include "replicas.h"
 #include "resp.h"
 #include "server.h"
+#include "slab.h"
 #include "stream.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
-static WaitState wait_state = {.remaining_count = 0,
-                               .mutex = PTHREAD_MUTEX_INITIALIZER,
-                               .condition = PTHREAD_COND_INITIALIZER,
-                               .acks_received = 0,
-                               .completed = false};
+#define WRONGTYPE_ERROR                                                        \
+  "WRONGTYPE Operation against a key holding the wrong kind of value"
 
-static const char *handleSet(RedisServer *server, RedisStore *store,
-                             RespValue *command, ClientState *clientState) {
+static int handleSet(RedisServer *server, RedisStore *store, RespValue *command,
+                     ClientState *clientState, OutputBuffer *reply) {
   RespValue *key = command->data.array.elements[1];
   RespValue *value = command->data.array.elements[2];
 
-  storeSet(store, key->data.string.str, value->data.string.str,
-           value->data.string.len);
+  // KEEPTTL is also how INCRBYFLOAT reaches replicas
+  if (command->data.array.len == 4 &&
+      strcasecmp(command->data.array.elements[3]->data.string.str,
+                 "KEEPTTL") == 0) {
+    storeSetKeepTtl(store, key->data.string.str, key->data.string.len,
+                    value->data.string.str, value->data.string.len);
+    return writeSimpleString(reply, "OK");
+  }
+
+  // Values cloned into a transaction are already shared, store that copy
+  if (value->data.string.shared) {
+    storeSetShared(store, key->data.string.str, key->data.string.len,
+                   value->data.string.shared);
+  } else {
+    storeSet(store, key->data.string.str, key->data.string.len,
+             value->data.string.str, value->data.string.len);
+  }
 
   if (command->data.array.len < 5) {
-    return createSimpleString("OK");
+    return writeSimpleString(reply, "OK");
   }
 
   RespValue *option = command->data.array.elements[3];
   if (strcasecmp(option->data.string.str, "px") != 0) {
-    return createSimpleString("OK");
+    return writeSimpleString(reply, "OK");
   }
 
   RespValue *pxValue = command->data.array.elements[4];
   long long milliseconds = atoll(pxValue->data.string.str);
   if (milliseconds <= 0) {
-    return createSimpleString("OK");
+    return writeSimpleString(reply, "OK");
   }
 
   time_t expiry = getCurrentTimeMs() + milliseconds;
-  setExpiry(store, key->data.string.str, expiry);
+  setExpiry(store, key->data.string.str, key->data.string.len, expiry);
 
-  return createSimpleString("OK");
+  return writeSimpleString(reply, "OK");
 }
 
-static const char *handleGet(RedisServer *server, RedisStore *store,
-                             RespValue *command, ClientState *clientState) {
+typedef struct BulkReply {
+  OutputBuffer *out;
+  int status;
+} BulkReply;
+
+// Serializes a value straight from the store entry into the reply. Large
+// values are referenced rather than copied, and stay valid if the key is
+// overwritten before the reply is written.
+static void writeBulkValue(const void *value, size_t valueLen,
+                           SharedValue *shared, void *ctx) {
+  BulkReply *bulk = (BulkReply *)ctx;
+  bulk->status = shared ? writeSharedBulkString(bulk->out, shared)
+                        : writeBulkString(bulk->out, value, valueLen);
+}
+
+static int handleGet(RedisServer *server, RedisStore *store, RespValue *command,
+                     ClientState *clientState, OutputBuffer *reply) {
   RespValue *key = command->data.array.elements[1];
 
   // Check in-memory store first
-  size_t memValueLen;
-  void *memValue = storeGet(store, key->data.string.str, &memValueLen);
-  if (memValue) {
-    char *response = createBulkString(memValue, memValueLen);
-    free(memValue);
-    return response;
+  BulkReply bulk = {reply, OUTPUT_OK};
+  if (storeVisitValue(store, key->data.string.str, key->data.string.len,
+                      writeBulkValue, &bulk) == STORE_OK) {
+    return bulk.status;
   }
 
   // Try reading from RDB file
   RdbReader *reader = createRdbReader(server->dir, server->filename);
   if (!reader) {
-    return createNullBulkString();
+    return writeNullBulkString(reply);
   }
 
   // Get value from RDB
@@ -70,99 +102,112 @@ static const char *handleGet(RedisServer *server, RedisStore *store,
   freeRdbReader(reader);
 
   if (rdbValue) {
-    char *response = createBulkString(rdbValue, rdbValueLen);
+    int status = writeBulkString(reply, rdbValue, rdbValueLen);
     free(rdbValue);
-    return response;
+    return status;
   }
 
-  return createNullBulkString();
+  return writeNullBulkString(reply);
 }
 
-static const char *handleType(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
+static int handleType(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
   RespValue *key = command->data.array.elements[1];
-  ValueType type = getValueType(store, key->data.string.str);
+  ValueType type =
+      getValueType(store, key->data.string.str, key->data.string.len);
 
   switch (type) {
   case TYPE_STRING:
-    return createSimpleString("string");
+    return writeSimpleString(reply, "string");
   case TYPE_STREAM:
-    return createSimpleString("stream");
+    return writeSimpleString(reply, "stream");
   case TYPE_NONE:
   default:
-    return createSimpleString("none");
+    return writeSimpleString(reply, "none");
   }
 }
 
-static const char *handleEcho(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
+static int handleEcho(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
   RespValue *message = command->data.array.elements[1];
-  return createBulkString(message->data.string.str, message->data.string.len);
+  return writeBulkString(reply, message->data.string.str,
+                         message->data.string.len);
 }
 
-static const char *handlePing(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
-  return createSimpleString("PONG");
+static int handlePing(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
+  return writeSimpleString(reply, "PONG");
 }
 
-static const char *handleXadd(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
+static int handleXadd(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
   RespValue *key = command->data.array.elements[1];
   RespValue *id = command->data.array.elements[2];
 
   size_t numFields = (command->data.array.len - 3) / 2;
-  char **fields = malloc(numFields * sizeof(char *));
-  char **values = malloc(numFields * sizeof(char *));
+  char **fields = arenaAlloc(&clientState->arena, numFields * sizeof(char *));
+  char **values = arenaAlloc(&clientState->arena, numFields * sizeof(char *));
+  if (!fields || !values) {
+    return writeError(reply, "ERR out of memory");
+  }
 
   for (size_t i = 0; i < numFields; i++) {
     fields[i] = command->data.array.elements[3 + i * 2]->data.string.str;
     values[i] = command->data.array.elements[4 + i * 2]->data.string.str;
   }
 
-  char *result = storeStreamAdd(store, key->data.string.str,
-                                id->data.string.str, fields, values, numFields);
-
-  free(fields);
-  free(values);
-
-  if (result[0] == '-') {
-    char *response = createError(result + 1);
-    free(result);
-    return response;
+  char *result;
+  int stored =
+      storeStreamAdd(store, key->data.string.str, key->data.string.len,
+                     id->data.string.str, fields, values, numFields, &result);
+  if (stored == STORE_WRONGTYPE) {
+    return writeError(reply, WRONGTYPE_ERROR);
+  } else if (stored != STORE_OK) {
+    return writeError(reply, "ERR out of memory");
   }
 
-  char *response = createBulkString(result, strlen(result));
+  int added = result[0] != '-';
+  int status = added ? writeBulkString(reply, result, strlen(result))
+                     : writeError(reply, result + 1);
   free(result);
+  if (added) {
+    signalBlockedClients(server, BLOCKED_STREAM);
+  }
+  return status;
+}
 
-  return response;
+typedef struct XrangeVisit {
+  const char *start;
+  const char *end;
+  Arena *arena;
+  StreamEntry *entries;
+  size_t count;
+} XrangeVisit;
+
+// Copies the entries of an XRANGE out while the stream is locked
+static void rangeStream(Stream *stream, void *ctx) {
+  XrangeVisit *range = (XrangeVisit *)ctx;
+  range->entries = streamRange(stream, range->start, range->end,
+                               &range->count, range->arena);
 }
 
-static const char *handleXrange(RedisServer *server, RedisStore *store,
-                                RespValue *command, ClientState *clientState) {
+static int handleXrange(RedisServer *server, RedisStore *store,
+                        RespValue *command, ClientState *clientState,
+                        OutputBuffer *reply) {
   RespValue *key = command->data.array.elements[1];
   RespValue *start = command->data.array.elements[2];
   RespValue *end = command->data.array.elements[3];
 
-  Stream *stream = storeGetStream(store, key->data.string.str);
-  if (!stream) {
-    return createXrangeResponse(NULL, 0);
-  }
-
-  size_t count;
-  StreamEntry *entries =
-      streamRange(stream, start->data.string.str, end->data.string.str, &count);
-
-  char *response = createXrangeResponse(entries, count);
-
-  // Clean up temporary entries
-  StreamEntry *current = entries;
-  while (current) {
-    StreamEntry *next = current->next;
-    freeStreamEntry(current);
-    current = next;
-  }
-
-  return response;
+  // The copies are scratch, dropped with the client's arena
+  XrangeVisit range = {start->data.string.str, end->data.string.str,
+                       &clientState->arena, NULL, 0};
+  storeVisitStream(store, key->data.string.str, key->data.string.len,
+                   rangeStream, &range);
+  return writeXrangeResponse(reply, range.entries, range.count);
 }
 
 typedef struct XreadArgs {
@@ -170,8 +215,7 @@ typedef struct XreadArgs {
   int blockMs;
   bool blocking;
   size_t numStreams;
-  Stream **streams;
-  const char **keys;
+  StreamInfo *reads;
   const char **ids;
 } XreadArgs;
 
@@ -203,253 +247,317 @@ static int parseXreadArgs(RespValue *command, XreadArgs *args) {
   return 0;
 }
 
-static int setupXreadStreams(RedisStore *store, RespValue *command, XreadArgs *args) {
-  args->streams = malloc(args->numStreams * sizeof(Stream *));
-  args->keys = malloc(args->numStreams * sizeof(char *));
-  args->ids = malloc(args->numStreams * sizeof(char *));
+// Replaces each $ of a blocked XREAD with the ID it stood for, so attempts
+// after the client parked wait for entries added since the first one
+static int pinXreadIds(RespValue *command, XreadArgs *args) {
+  RespValue **ids =
+      command->data.array.elements + args->streamsPos + 1 + args->numStreams;
+  for (size_t i = 0; i < args->numStreams; i++) {
+    if (strncmp(ids[i]->data.string.str, "$", 1) != 0) {
+      continue;
+    }
+    RespValue *pinned = createRespString(args->ids[i], strlen(args->ids[i]));
+    if (!pinned) {
+      return -1;
+    }
+    freeRespValue(ids[i]);
+    ids[i] = pinned;
+  }
+  return 0;
+}
+
+typedef struct XreadVisit {
+  const char *id; /* Requested ID, replaced by the last one if it was $ */
+  StreamInfo *read;
+  Arena *arena;
+} XreadVisit;
+
+// Copies the entries after the requested ID out while the stream is locked
+static void readStream(Stream *stream, void *ctx) {
+  XreadVisit *visit = (XreadVisit *)ctx;
+  if (strncmp(visit->id, "$", 1) == 0) {
+    visit->id =
+        arenaStrdup(visit->arena, stream->tail ? stream->tail->id : "0-0");
+    if (!visit->id) {
+      return;
+    }
+  }
+  visit->read->entries =
+      streamRead(stream, visit->id, &visit->read->count, visit->arena);
+}
+
+// Reads every stream of an XREAD. Everything set up here lives in the
+// client's arena until the reply is queued.
+static int readXreadStreams(RedisStore *store, RespValue *command,
+                            XreadArgs *args, Arena *arena, bool *hasData) {
+  args->reads = arenaAlloc(arena, args->numStreams * sizeof(StreamInfo));
+  args->ids = arenaAlloc(arena, args->numStreams * sizeof(char *));
 
-  if (!args->streams || !args->keys || !args->ids) {
-    free(args->streams);
-    free(args->keys);
-    free(args->ids);
+  if (!args->reads || !args->ids) {
     return -1;
   }
 
+  *hasData = false;
   for (size_t i = 0; i < args->numStreams; i++) {
-    args->keys[i] = command->data.array.elements[args->streamsPos + 1 + i]->data.string.str;
+    RespValue *key = command->data.array.elements[args->streamsPos + 1 + i];
     const char *rawId = command->data.array.elements[args->streamsPos + 1 + args->numStreams + i]->data.string.str;
-    args->streams[i] = storeGetStream(store, args->keys[i]);
-
-    // Replace $ with latest stream ID
-    if (strncmp(rawId, "$", 1) == 0) {
-      StreamEntry *lastEntry = args->streams[i] ? args->streams[i]->tail : NULL;
-      args->ids[i] = lastEntry ? strdup(lastEntry->id) : strdup("0-0");
-    } else {
-      args->ids[i] = strdup(rawId);
+    args->reads[i] = (StreamInfo){key->data.string.str, NULL, 0};
+
+    XreadVisit visit = {rawId, &args->reads[i], arena};
+    if (storeVisitStream(store, key->data.string.str, key->data.string.len,
+                         readStream, &visit) != STORE_OK &&
+        strncmp(rawId, "$", 1) == 0) {
+      // $ of a stream that does not exist yet
+      visit.id = "0-0";
     }
-    
+    args->ids[i] = visit.id;
+
     if (!args->ids[i]) {
-      // Cleanup on allocation failure
-      for (size_t j = 0; j < i; j++) {
-        free((void*)args->ids[j]);
-      }
-      free(args->streams);
-      free(args->keys);
-      free(args->ids);
       return -1;
     }
+    if (args->reads[i].count > 0) {
+      *hasData = true;
+    }
   }
 
   return 0;
 }
 
-static void freeXreadArgs(XreadArgs *args) {
-  if (args->streams) {
-    free(args->streams);
-  }
-  if (args->keys) {
-    free(args->keys);
-  }
-  if (args->ids) {
-    for (size_t i = 0; i < args->numStreams; i++) {
-      free((void*)args->ids[i]);
-    }
-    free(args->ids);
-  }
-}
-
-static const char *handleXread(RedisServer *server, RedisStore *store,
-                               RespValue *command, ClientState *clientState) {
+static int handleXread(RedisServer *server, RedisStore *store,
+                       RespValue *command, ClientState *clientState,
+                       OutputBuffer *reply) {
   XreadArgs args = {0};
   
   if (parseXreadArgs(command, &args) != 0) {
-    return createError("ERR syntax error");
-  }
-
-  if (setupXreadStreams(store, command, &args) != 0) {
-    return createError("ERR out of memory");
+    return writeError(reply, "ERR syntax error");
   }
 
-  // Process initial read
   bool hasData = false;
-  StreamInfo *streamInfos = processStreamReads(args.streams, args.keys, args.ids, args.numStreams, &hasData);
+  if (readXreadStreams(store, command, &args, &clientState->arena,
+                       &hasData) != 0) {
+    return writeError(reply, "ERR out of memory");
+  }
 
-  // Handle blocking if needed
+  // Nothing to read yet: park the client until an XADD or the deadline,
+  // then this runs again on the owned copy of the command
   if (args.blocking && !hasData) {
-    bool gotData;
-    if (args.blockMs == 0) {
-      gotData = waitForStreamDataInfinite(getStreamBlockState());
-    } else {
-      gotData = waitForStreamData(getStreamBlockState(), args.blockMs);
+    if (command == clientState->bstate.command &&
+        pinXreadIds(command, &args) != 0) {
+      return writeError(reply, "ERR out of memory");
     }
-
-    if (gotData) {
-      freeStreamInfo(streamInfos, args.numStreams);
-      streamInfos = recheckStreams(args.streams, args.keys, args.ids, args.numStreams);
-    } else {
-      freeStreamInfo(streamInfos, args.numStreams);
-      freeXreadArgs(&args);
-      return createNullBulkString();
+    if (blockClient(clientState, BLOCKED_STREAM, args.blockMs)) {
+      return OUTPUT_OK;
     }
+    return writeNullBulkString(reply);
   }
 
-  // Create response
-  char *response = createXreadResponse(streamInfos, args.numStreams);
+  return writeXreadResponse(reply, args.reads, args.numStreams);
+}
 
-  // Cleanup
-  freeStreamInfo(streamInfos, args.numStreams);
-  freeXreadArgs(&args);
+// Parses a whole argument as a signed 64-bit integer
+static int parseIntegerArg(RespValue *arg, long long *out) {
+  const char *str = arg->data.string.str;
+  if (arg->data.string.len == 0 || isspace((unsigned char)str[0])) {
+    return 0;
+  }
+  char *end;
+  errno = 0;
+  *out = strtoll(str, &end, 10);
+  return errno == 0 && end == str + arg->data.string.len;
+}
 
-  return response;
+static int writeIncrementResult(OutputBuffer *reply, int status,
+                                long long value) {
+  switch (status) {
+  case STORE_OK:
+    return writeInteger(reply, value);
+  case STORE_WRONGTYPE:
+    return writeError(reply, WRONGTYPE_ERROR);
+  case STORE_NOT_NUMBER:
+    return writeError(reply, "ERR value is not an integer or out of range");
+  case STORE_OVERFLOW:
+    return writeError(reply, "ERR increment or decrement would overflow");
+  default:
+    return writeError(reply, "ERR out of memory");
+  }
 }
 
-static const char *handleIncrement(RedisServer *server, RedisStore *store,
-                                   RespValue *command,
-                                   ClientState *clientState) {
+// INCR, INCRBY, DECR and DECRBY: the step is the argument, if any, and the
+// sign comes from the command name
+static int handleIncrement(RedisServer *server, RedisStore *store,
+                           RespValue *command, ClientState *clientState,
+                           OutputBuffer *reply) {
   RespValue *key = command->data.array.elements[1];
-  size_t valueLen;
-  void *value = storeGet(store, key->data.string.str, &valueLen);
-
-  if (value) {
-    // Convert string to number and ensure it's null-terminated
-    char *numStr = malloc(valueLen + 1);
-    memcpy(numStr, value, valueLen);
-    numStr[valueLen] = '\0';
-
-    // Check if the string is a valid number
-    char *endptr;
-    long long numValue = strtoll(numStr, &endptr, 10);
-
-    // If endptr points to anything other than '\0', the string contains
-    // non-numeric characters
-    if (*endptr != '\0') {
-      free(value);
-      free(numStr);
-      return createError("ERR value is not an integer or out of range");
-    }
+  const char *name = command->data.array.elements[0]->data.string.str;
 
-    free(value);
-    free(numStr);
+  long long delta = 1;
+  if (command->data.array.len > 2 &&
+      !parseIntegerArg(command->data.array.elements[2], &delta)) {
+    return writeError(reply, "ERR value is not an integer or out of range");
+  }
+  if (toupper((unsigned char)name[0]) == 'D') {
+    if (delta == LLONG_MIN) {
+      return writeError(reply, "ERR decrement would overflow");
+    }
+    delta = -delta;
+  }
 
-    numValue++;
+  long long value = 0;
+  int status = storeIncrBy(store, key->data.string.str, key->data.string.len,
+                           delta, &value);
+  return writeIncrementResult(reply, status, value);
+}
 
-    char newStr[32];
-    snprintf(newStr, sizeof(newStr), "%lld", numValue);
-    storeSet(store, key->data.string.str, newStr, strlen(newStr));
+// Builds SET key value KEEPTTL in the arena. Replicas store what the
+// master computed rather than redoing the float math and formatting.
+static RespValue *setKeepTtlCommand(Arena *arena, RespValue *key,
+                                    const char *value, size_t valueLen) {
+  RespValue *values = arenaAlloc(arena, 5 * sizeof(RespValue));
+  RespValue **elements = arenaAlloc(arena, 4 * sizeof(RespValue *));
+  char *copy = arenaAlloc(arena, valueLen + 1);
+  if (!values || !elements || !copy) {
+    return NULL;
+  }
+  memcpy(copy, value, valueLen);
+  copy[valueLen] = '\0';
+
+  const char *args[] = {"SET", key->data.string.str, copy, "KEEPTTL"};
+  size_t lens[] = {3, key->data.string.len, valueLen, 7};
+  for (int i = 0; i < 4; i++) {
+    values[i + 1] = (RespValue){.type = RespTypeBulk};
+    values[i + 1].data.string.str = (char *)args[i];
+    values[i + 1].data.string.len = lens[i];
+    elements[i] = &values[i + 1];
+  }
+  values[0] = (RespValue){.type = RespTypeArray};
+  values[0].data.array.elements = elements;
+  values[0].data.array.len = 4;
+  return &values[0];
+}
 
-    return createInteger(numValue);
+static int handleIncrementFloat(RedisServer *server, RedisStore *store,
+                                RespValue *command, ClientState *clientState,
+                                OutputBuffer *reply) {
+  RespValue *key = command->data.array.elements[1];
+  RespValue *arg = command->data.array.elements[2];
+
+  char *end;
+  long double delta = strtold(arg->data.string.str, &end);
+  if (arg->data.string.len == 0 ||
+      isspace((unsigned char)arg->data.string.str[0]) ||
+      end != arg->data.string.str + arg->data.string.len || isnan(delta) ||
+      isinf(delta)) {
+    return writeError(reply, "ERR value is not a valid float");
   }
 
-  storeSet(store, key->data.string.str, "1", 1);
-  return createInteger(1);
+  char result[STORE_FLOAT_BUF];
+  size_t resultLen;
+  int status =
+      storeIncrByFloat(store, key->data.string.str, key->data.string.len,
+                       delta, result, sizeof(result), &resultLen);
+  switch (status) {
+  case STORE_OK:
+    clientState->propagate_as =
+        setKeepTtlCommand(&clientState->arena, key, result, resultLen);
+    return writeBulkString(reply, result, resultLen);
+  case STORE_WRONGTYPE:
+    return writeError(reply, WRONGTYPE_ERROR);
+  case STORE_NOT_NUMBER:
+    return writeError(reply, "ERR value is not a valid float");
+  case STORE_OVERFLOW:
+    return writeError(reply, "ERR increment would produce NaN or Infinity");
+  default:
+    return writeError(reply, "ERR out of memory");
+  }
 }
 
-static const char *handleMulti(RedisServer *server, RedisStore *store,
-                               RespValue *command, ClientState *clientState) {
+static int handleMulti(RedisServer *server, RedisStore *store,
+                       RespValue *command, ClientState *clientState,
+                       OutputBuffer *reply) {
   clientState->in_transaction = 1;
-  return createSimpleString("OK");
+  return writeSimpleString(reply, "OK");
 }
 
-static const char *handleExec(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
+static int handleExec(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
   printf("[EXEC] Starting transaction execution\n");
 
   if (!clientState->in_transaction) {
     printf("[EXEC] Error: Not in transaction\n");
-    return createError("ERR EXEC without MULTI");
+    return writeError(reply, "ERR EXEC without MULTI");
   }
 
   printf("[EXEC] Executing %zu queued commands\n", clientState->queue->size);
 
-  // Create array of responses
-  RespValue **responses =
-      malloc(clientState->queue->size * sizeof(RespValue *));
-
   clientState->in_transaction = 0;
 
+  // Each queued command writes its reply straight after the array header
+  int status = writeArrayHeader(reply, clientState->queue->size);
+
   // Execute each queued command
-  for (size_t i = 0; i < clientState->queue->size; i++) {
+  for (size_t i = 0; i < clientState->queue->size && status == OUTPUT_OK;
+       i++) {
     RespValue *cmd = clientState->queue->commands[i];
     printf("[EXEC] Executing command %zu: %s\n", i + 1,
            cmd->data.array.elements[0]->data.string.str);
 
-    const char *response = executeCommand(server, store, cmd, clientState);
-    printf("[EXEC] Command response: %s\n", response);
-
-    responses[i] = parseResponseToRespValue(response);
-    free((void *)response);
-  }
-
-  printf("[EXEC] Creating final response array\n");
-  char *result =
-      createRespArrayFromElements(responses, clientState->queue->size);
-
-  // Cleanup
-  for (size_t i = 0; i < clientState->queue->size; i++) {
-    freeRespValue(responses[i]);
+    size_t pending = reply->pending;
+    status = executeCommandTo(server, store, cmd, clientState, reply);
+    // Keep the array well formed for commands that send no reply
+    if (status == OUTPUT_OK && reply->pending == pending) {
+      status = writeNullBulkString(reply);
+    }
   }
-  free(responses);
 
   // Reset transaction state
   clientState->in_transaction = 0;
   clearCommandQueue(clientState->queue);
 
   printf("[EXEC] Transaction completed successfully\n");
-  return result;
+  return status;
 }
 
-static const char *handleDiscard(RedisServer *server, RedisStore *store,
-                                 RespValue *command, ClientState *client) {
+static int handleDiscard(RedisServer *server, RedisStore *store,
+                         RespValue *command, ClientState *client,
+                         OutputBuffer *reply) {
   if (!client->in_transaction) {
-    const char *err = createError("ERR DISCARD without MULTI");
-    return err;
+    return writeError(reply, "ERR DISCARD without MULTI");
   }
 
   clearCommandQueue(client->queue);
   client->in_transaction = false;
-  const char *res = createSimpleString("OK");
-  return res;
+  return writeSimpleString(reply, "OK");
 }
 
-static const char *handleConfigGet(RedisServer *server, RedisStore *store,
-                                   RespValue *command,
-                                   ClientState *clientState) {
+static int handleConfigGet(RedisServer *server, RedisStore *store,
+                           RespValue *command, ClientState *clientState,
+                           OutputBuffer *reply) {
   // Get parameter name from command
   RespValue *param = command->data.array.elements[2]; // CONFIG GET param
 
-  // Create array elements for response
-  RespValue *elements[2];
-
   if (strcasecmp(param->data.string.str, "dir") == 0) {
-    // Create parameter name element
-    elements[0] = createRespString("dir", 3);
-    // Create parameter value element
-    elements[1] = createRespString(server->dir, strlen(server->dir));
-
-    // Create RESP array response
-    char *response = createRespArrayFromElements(elements, 2);
-
-    // Clean up
-    freeRespValue(elements[0]);
-    freeRespValue(elements[1]);
-
-    return response;
+    if (writeArrayHeader(reply, 2) != OUTPUT_OK ||
+        writeBulkString(reply, "dir", 3) != OUTPUT_OK)
+      return OUTPUT_ERR;
+    return writeBulkString(reply, server->dir, strlen(server->dir));
   }
 
   // For other parameters, return empty array
-  return createRespArray(NULL, 0);
+  return writeArrayHeader(reply, 0);
 }
 
-static const char *handleKeys(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
+static int handleKeys(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
   RespValue *pattern = command->data.array.elements[1];
   if (strcmp(pattern->data.string.str, "*") != 0) {
-    return createRespArray(NULL, 0);
+    return writeArrayHeader(reply, 0);
   }
 
   RdbReader *reader = createRdbReader(server->dir, server->filename);
   if (!reader) {
-    return createRespArray(NULL, 0);
+    return writeArrayHeader(reply, 0);
   }
 
   size_t keyCount;
@@ -457,10 +565,13 @@ static const char *handleKeys(RedisServer *server, RedisStore *store,
   freeRdbReader(reader);
 
   if (!keys) {
-    return createRespArray(NULL, 0);
+    return writeArrayHeader(reply, 0);
   }
 
-  char *result = createRespArrayFromElements(keys, keyCount);
+  int status = writeArrayHeader(reply, keyCount);
+  for (size_t i = 0; i < keyCount && status == OUTPUT_OK; i++) {
+    status = writeRespValue(reply, keys[i]);
+  }
 
   // Cleanup
   for (size_t i = 0; i < keyCount; i++) {
@@ -468,268 +579,486 @@ static const char *handleKeys(RedisServer *server, RedisStore *store,
   }
   free(keys);
 
-  return result;
+  return status;
 }
 
-static const char *handleInfo(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
-  const char *role = server->repl_info->master_info ? "slave" : "master";
+// Appends the allocator counters, one line per size class in use
+static int formatMemoryInfo(char *info, size_t size) {
+  SlabStats stats;
+  slabGetStats(&stats);
+
+  size_t slabBytes = 0;
+  for (int i = 0; i < SLAB_CLASSES; i++) {
+    slabBytes += stats.classes[i].objects * stats.classes[i].size;
+  }
+  int len = snprintf(info, size,
+                     "slab_region_bytes:%zu\r\n"
+                     "slab_span_bytes:%zu\r\n"
+                     "slab_allocated_bytes:%zu\r\n"
+                     "slab_lock_acquisitions:%zu\r\n"
+                     "slab_lock_contended:%zu\r\n"
+                     "slab_malloc_fallbacks:%zu",
+                     stats.regionBytes, stats.spanBytes, slabBytes,
+                     stats.lockAcquisitions, stats.lockContended,
+                     stats.mallocFallbacks);
+  for (int i = 0; i < SLAB_CLASSES && (size_t)len < size; i++) {
+    SlabClassStats *class = &stats.classes[i];
+    if (class->spans) {
+      len += snprintf(info + len, size - len,
+                      "\r\nslab_class_%zu:spans=%zu,objects=%zu,free=%zu",
+                      class->size, class->spans, class->objects, class->free);
+    }
+  }
+  return len;
+}
 
-  return createFormattedBulkString("role:%s\r\n"
-                                   "master_replid:%s\r\n"
-                                   "master_repl_offset:%lld",
-                                   role, server->repl_info->replication_id,
-                                   server->repl_info->repl_offset);
+// Appends the keyspace expiry counters
+static int formatStatsInfo(RedisServer *server, char *info, size_t size) {
+  return snprintf(
+      info, size,
+      "expired_keys:%zu\r\n"
+      "expired_time_cap_reached_count:%lld\r\n"
+      "expire_cycle_cpu_milliseconds:%lld\r\n"
+      "expire_cycle_budget_us:%lld",
+      serverExpiredKeys(server),
+      __atomic_load_n(&server->expire_time_cap_count, __ATOMIC_RELAXED),
+      __atomic_load_n(&server->expire_cycle_us, __ATOMIC_RELAXED) / 1000,
+      serverExpireBudget(server));
 }
 
-static const char *handleReplConf(RedisServer *server, RedisStore *store,
-                                  RespValue *command,
-                                  ClientState *clientState) {
+static int handleInfo(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
+  const char *section = command->data.array.len > 1
+                            ? command->data.array.elements[1]->data.string.str
+                            : "all";
+  int all = strcasecmp(section, "all") == 0 ||
+            strcasecmp(section, "default") == 0 ||
+            strcasecmp(section, "everything") == 0;
+
+  char info[4096];
+  int len = 0;
+  if (all || strcasecmp(section, "replication") == 0) {
+    const char *role = server->repl_info->master_info ? "slave" : "master";
+    len = snprintf(info, sizeof(info),
+                   "role:%s\r\n"
+                   "master_replid:%s\r\n"
+                   "master_repl_offset:%lld",
+                   role, server->repl_info->replication_id,
+                   replicationOffset(server));
+  }
+  if (all || strcasecmp(section, "memory") == 0) {
+    if (len) {
+      len += snprintf(info + len, sizeof(info) - len, "\r\n\r\n");
+    }
+    len += formatMemoryInfo(info + len, sizeof(info) - len);
+  }
+  if ((all || strcasecmp(section, "stats") == 0) &&
+      (size_t)len < sizeof(info)) {
+    if (len) {
+      len += snprintf(info + len, sizeof(info) - len, "\r\n\r\n");
+    }
+    len += formatStatsInfo(server, info + len, sizeof(info) - len);
+  }
+  if ((size_t)len >= sizeof(info)) {
+    len = sizeof(info) - 1;
+  }
+  return writeBulkString(reply, info, len);
+}
+
+static int handleReplConf(RedisServer *server, RedisStore *store,
+                          RespValue *command, ClientState *clientState,
+                          OutputBuffer *reply) {
   RespValue *subcommand = command->data.array.elements[1];
 
   printf("handleReplConf called with subcommand: %s\n",
          subcommand->data.string.str);
 
   if (strcasecmp(subcommand->data.string.str, "getack") == 0) {
-    printf("Processing GETACK command, current offset: %lld\n",
-           server->repl_info->repl_offset);
+    long long offset = replicationOffset(server);
+    printf("Processing GETACK command, current offset: %lld\n", offset);
 
     // Create response with current offset
     char offset_str[32];
-    snprintf(offset_str, sizeof(offset_str), "%lld",
-             server->repl_info->repl_offset);
-
-    RespValue *elements[3];
-    elements[0] = createRespString("REPLCONF", 8);
-    elements[1] = createRespString("ACK", 3);
-    elements[2] = createRespString(offset_str, strlen(offset_str));
+    int offset_len = snprintf(offset_str, sizeof(offset_str), "%lld", offset);
 
     printf("Creating GETACK response with offset: %s\n", offset_str);
 
-    char *response = createRespArrayFromElements(elements, 3);
-
-    freeRespValue(elements[0]);
-    freeRespValue(elements[1]);
-    freeRespValue(elements[2]);
-
-    return response;
+    if (writeArrayHeader(reply, 3) != OUTPUT_OK ||
+        writeBulkString(reply, "REPLCONF", 8) != OUTPUT_OK ||
+        writeBulkString(reply, "ACK", 3) != OUTPUT_OK)
+      return OUTPUT_ERR;
+    return writeBulkString(reply, offset_str, offset_len);
 
   } else if (strcasecmp(subcommand->data.string.str, "ack") == 0) {
-    printf("Processing ACK command\n");
-
-    pthread_mutex_lock(&wait_state.mutex);
-    printf("Current remaining count: %ld\n", wait_state.remaining_count);
-
-    printf("Wait State not completed\n");
-    wait_state.acks_received++;
-    wait_state.remaining_count--;
-    printf("Incremented acks received to: %zu\n", wait_state.acks_received);
-
-    if (wait_state.acks_received >= wait_state.remaining_count) {
-      printf("Required ACKs received, signaling condition\n");
-      pthread_cond_signal(&wait_state.condition);
+    // Only replicas acknowledge, and nothing is sent back
+    long long offset;
+    if (clientState->replica &&
+        parseIntegerArg(command->data.array.elements[2], &offset)) {
+      ackReplica(server, clientState->fd, offset);
+      signalBlockedClients(server, BLOCKED_WAIT);
     }
-    pthread_mutex_unlock(&wait_state.mutex);
-    return NULL;
+    return OUTPUT_OK;
   }
 
   printf("Returning OK response\n");
-  return createSimpleString("OK");
+  return writeSimpleString(reply, "OK");
 }
 
-static const char *handlePsync(RedisServer *server, RedisStore *store,
-                               RespValue *command, ClientState *clientState) {
+static int handlePsync(RedisServer *server, RedisStore *store,
+                       RespValue *command, ClientState *clientState,
+                       OutputBuffer *reply) {
 
   if (server->repl_info->master_info != NULL)
-    return NULL;
+    return OUTPUT_OK;
 
   static const unsigned char EMPTY_RDB[] = {0x52, 0x45, 0x44, 0x49, 0x53, 0x30,
                                             0x30, 0x30, 0x39, 0xFF, 0x09, 0x0A,
                                             0x40, 0x3F, 0x72, 0x6E, 0x64};
 
-  RespBuffer *buffer = createRespBuffer();
-
-  // Add FULLRESYNC response using helper
-  char *fullresync = createFormattedSimpleString(
-      "FULLRESYNC %s %lld", server->repl_info->replication_id,
-      server->repl_info->repl_offset);
-  appendRespBuffer(buffer, fullresync, strlen(fullresync));
-  free(fullresync);
+  char fullresync[128];
+  snprintf(fullresync, sizeof(fullresync), "FULLRESYNC %s %lld",
+           server->repl_info->replication_id, replicationOffset(server));
+  if (writeSimpleString(reply, fullresync) != OUTPUT_OK)
+    return OUTPUT_ERR;
 
   // Add RDB length prefix
   char prefix[32];
   int prefix_len =
       snprintf(prefix, sizeof(prefix), "$%zu\r\n", sizeof(EMPTY_RDB));
-  appendRespBuffer(buffer, prefix, prefix_len);
+  if (outputBufferAppend(reply, prefix, prefix_len) != OUTPUT_OK)
+    return OUTPUT_ERR;
 
   // Add raw RDB data without \r\n
-  appendRespBuffer(buffer, (char *)EMPTY_RDB, sizeof(EMPTY_RDB));
-
-  char *response = strndup(buffer->buffer, buffer->used);
-  freeRespBuffer(buffer);
+  if (outputBufferAppend(reply, (const char *)EMPTY_RDB, sizeof(EMPTY_RDB)) !=
+      OUTPUT_OK)
+    return OUTPUT_ERR;
 
-  addReplica(server, clientState->fd);
+  addReplica(server, clientState);
 
-  return response;
+  return OUTPUT_OK;
 }
 
-static const char *handleWait(RedisServer *server, RedisStore *store,
-                              RespValue *command, ClientState *clientState) {
-  printf("[WAIT] Starting WAIT command execution\n");
-
+static int handleWait(RedisServer *server, RedisStore *store,
+                      RespValue *command, ClientState *clientState,
+                      OutputBuffer *reply) {
   size_t numreplicas = atoll(command->data.array.elements[1]->data.string.str);
-  int timeout_ms = atoll(command->data.array.elements[2]->data.string.str);
+  long long timeout_ms = atoll(command->data.array.elements[2]->data.string.str);
 
-  printf("[WAIT] Requested wait for %zu replicas with timeout %d\n",
-         numreplicas, timeout_ms);
+  if (!server->repl_info->master_info && replicationOffset(server) == 0) {
+    return writeInteger(reply, replicaCount(server));
+  }
 
-  if (!server->repl_info->master_info && server->repl_info->repl_offset == 0) {
-    return createInteger(server->repl_info->replicas->replica_count);
+  // The first attempt asks every replica how far it got, later attempts
+  // only count the acknowledgements that came back
+  BlockingState *bstate = &clientState->bstate;
+  if (bstate->reason == BLOCKED_NONE) {
+    static const char getack_cmd[] =
+        "*3\r\n$8\r\nREPLCONF\r\n$6\r\nGETACK\r\n$1\r\n*\r\n";
+    bstate->offset = replicationOffset(server);
+    sendToReplicas(server, getack_cmd, sizeof(getack_cmd) - 1);
   }
 
-  // Send REPLCONF GETACK to all replicas
-  for (size_t i = 0; i < server->repl_info->replicas->replica_count; i++) {
-    RespValue *getack_elements[3];
-    getack_elements[0] = createRespString("REPLCONF", 8);
-    getack_elements[1] = createRespString("GETACK", 6);
-    getack_elements[2] = createRespString("*", 1);
+  size_t acked = replicasAcked(server, bstate->offset);
+  if (acked < numreplicas &&
+      blockClient(clientState, BLOCKED_WAIT, timeout_ms)) {
+    return OUTPUT_OK;
+  }
+  return writeInteger(reply, acked);
+}
+
+#define FIRST_KEY {1, 1, 1, NULL}
+#define NO_KEYS {0, 0, 0, NULL}
+
+static CommandHandler baseCommands[] = {
+    {"SET", handleSet, 3, 5, CMD_WRITE | CMD_FAST, FIRST_KEY},
+    {"GET", handleGet, 2, 2, CMD_READONLY | CMD_FAST, FIRST_KEY},
+    {"PING", handlePing, 1, 1, CMD_FAST, NO_KEYS},
+    {"ECHO", handleEcho, 2, 2, CMD_FAST, NO_KEYS},
+    {"TYPE", handleType, 2, 2, CMD_READONLY | CMD_FAST, FIRST_KEY},
+    {"XADD", handleXadd, 4, -1, CMD_WRITE, FIRST_KEY},
+    {"XRANGE", handleXrange, 4, 4, CMD_READONLY, FIRST_KEY},
+    {"XREAD", handleXread, 4, -1, CMD_READONLY | CMD_BLOCKING,
+     {0, 0, 1, "STREAMS"}},
+    {"INCR", handleIncrement, 2, 2, CMD_WRITE | CMD_FAST, FIRST_KEY},
+    {"INCRBY", handleIncrement, 3, 3, CMD_WRITE | CMD_FAST, FIRST_KEY},
+    {"DECR", handleIncrement, 2, 2, CMD_WRITE | CMD_FAST, FIRST_KEY},
+    {"DECRBY", handleIncrement, 3, 3, CMD_WRITE | CMD_FAST, FIRST_KEY},
+    {"INCRBYFLOAT", handleIncrementFloat, 3, 3, CMD_WRITE | CMD_FAST,
+     FIRST_KEY},
+    {"MULTI", handleMulti, 1, 1, CMD_TRANSACTION | CMD_FAST, NO_KEYS},
+    {"EXEC", handleExec, 1, 1, CMD_TRANSACTION, NO_KEYS},
+    {"DISCARD", handleDiscard, 0, -1, CMD_TRANSACTION | CMD_FAST, NO_KEYS},
+    {"CONFIG", handleConfigGet, 3, 3, CMD_ADMIN, NO_KEYS},
+    {"KEYS", handleKeys, 2, 2, CMD_READONLY, NO_KEYS},
+    {"INFO", handleInfo, 1, 2, 0, NO_KEYS},
+    {"REPLCONF", handleReplConf, 3, 3, CMD_ADMIN, NO_KEYS},
+    {"PSYNC", handlePsync, 3, 3, CMD_ADMIN, NO_KEYS},
+    {"WAIT", handleWait, 3, 3, CMD_BLOCKING, NO_KEYS},
+};
+
+static const size_t commandCount =
+    sizeof(baseCommands) / sizeof(CommandHandler);
+
+/* Open-addressed index over baseCommands, at most half full */
+#define COMMAND_INDEX_SIZE 64
+
+typedef struct CommandIndexSlot {
+  const CommandHandler *handler;
+  size_t nameLen; /* Compared before the name, so memcmp stays in bounds */
+} CommandIndexSlot;
 
-    char *getack_cmd = createRespArrayFromElements(getack_elements, 3);
-    int fd = server->repl_info->replicas->replicas[i].fd;
-    write(fd, getack_cmd, strlen(getack_cmd));
+static CommandIndexSlot commandIndex[COMMAND_INDEX_SIZE];
+static pthread_once_t commandIndexOnce = PTHREAD_ONCE_INIT;
 
-    for (int j = 0; j < 3; j++) {
-      freeRespValue(getack_elements[j]);
+// FNV-1a over the upper-cased name, which is also copied into folded
+static uint32_t commandHash(const char *name, size_t len, char *folded) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    char c = name[i];
+    if (c >= 'a' && c <= 'z') {
+      c -= 'a' - 'A';
     }
-    free(getack_cmd);
+    folded[i] = c;
+    hash = (hash ^ (unsigned char)c) * 16777619u;
   }
+  return hash;
+}
 
-  pthread_mutex_lock(&wait_state.mutex);
-  wait_state.remaining_count = numreplicas;
-  wait_state.completed = false;
-  wait_state.acks_received = 0;
+static void buildCommandIndex(void) {
+  char folded[COMMAND_NAME_MAX];
+  for (size_t i = 0; i < commandCount; i++) {
+    const char *name = baseCommands[i].name;
+    size_t nameLen = strlen(name);
+    size_t slot = commandHash(name, nameLen, folded);
+    while (commandIndex[slot &= COMMAND_INDEX_SIZE - 1].handler) {
+      slot++;
+    }
+    commandIndex[slot] = (CommandIndexSlot){&baseCommands[i], nameLen};
+  }
+}
 
-  // Get start time
-  struct timespec start_time;
-  clock_gettime(CLOCK_MONOTONIC, &start_time);
+const CommandHandler *lookupCommand(const char *name, size_t len) {
+  if (len == 0 || len > COMMAND_NAME_MAX) {
+    return NULL;
+  }
+  pthread_once(&commandIndexOnce, buildCommandIndex);
+
+  char folded[COMMAND_NAME_MAX];
+  size_t slot = commandHash(name, len, folded);
+  const CommandIndexSlot *entry;
+  while ((entry = &commandIndex[slot &= COMMAND_INDEX_SIZE - 1])->handler) {
+    if (entry->nameLen == len && memcmp(entry->handler->name, folded, len) == 0) {
+      return entry->handler;
+    }
+    slot++;
+  }
+  return NULL;
+}
 
-  struct timespec wait_until;
-  clock_gettime(CLOCK_REALTIME, &wait_until);
-  wait_until.tv_sec += timeout_ms / 1000;
-  wait_until.tv_nsec += (timeout_ms % 1000) * 1000000L;
+const CommandHandler *resolveCommand(RespValue *command) {
+  if (command->type != RespTypeArray || command->data.array.len < 1) {
+    return NULL;
+  }
+  if (!command->data.array.handler) {
+    RespValue *name = command->data.array.elements[0];
+    command->data.array.handler =
+        lookupCommand(name->data.string.str, name->data.string.len);
+  }
+  return command->data.array.handler;
+}
 
-  if (wait_until.tv_nsec >= 1000000000L) {
-    wait_until.tv_sec++;
-    wait_until.tv_nsec -= 1000000000L;
+size_t commandKeys(RespValue *command, KeyRange *range) {
+  range->first = range->last = 0;
+  range->step = 1;
+  const CommandHandler *handler = resolveCommand(command);
+  if (!handler) {
+    return 0;
   }
 
-  // Wait for the full timeout
-  pthread_cond_timedwait(&wait_state.condition, &wait_state.mutex, &wait_until);
+  const KeySpec *spec = &handler->keys;
+  size_t argc = command->data.array.len;
+  if (spec->keyword) {
+    for (size_t i = 1; i < argc; i++) {
+      RespValue *arg = command->data.array.elements[i];
+      if (strcasecmp(arg->data.string.str, spec->keyword) == 0) {
+        size_t count = (argc - i - 1) / 2;
+        if (count > 0) {
+          range->first = i + 1;
+          range->last = i + count;
+        }
+        return count;
+      }
+    }
+    return 0;
+  }
 
-  // Calculate remaining time if any
-  struct timespec current_time;
-  clock_gettime(CLOCK_MONOTONIC, &current_time);
-  long elapsed_ms = (current_time.tv_sec - start_time.tv_sec) * 1000 +
-                    (current_time.tv_nsec - start_time.tv_nsec) / 1000000;
+  if (spec->first == 0 || (size_t)spec->first >= argc) {
+    return 0;
+  }
+  size_t last = spec->last < 0 ? argc + spec->last : (size_t)spec->last;
+  if (last >= argc) {
+    last = argc - 1;
+  }
+  range->first = spec->first;
+  range->last = last;
+  range->step = spec->step;
+  return (last - range->first) / range->step + 1;
+}
 
-  if (elapsed_ms < timeout_ms) {
-    struct timespec remaining;
-    remaining.tv_sec = (timeout_ms - elapsed_ms) / 1000;
-    remaining.tv_nsec = ((timeout_ms - elapsed_ms) % 1000) * 1000000L;
-    nanosleep(&remaining, NULL);
+bool commandMayBlock(RespValue *command, ClientState *clientState) {
+  const CommandHandler *handler = resolveCommand(command);
+  if (!handler || !(handler->flags & CMD_BLOCKING) ||
+      clientState->in_transaction) {
+    return false;
   }
 
-  size_t acked = wait_state.acks_received;
-  wait_state.completed = true;
+  // XREAD only blocks when asked to
+  if (handler->handler == handleXread) {
+    XreadArgs args;
+    return parseXreadArgs(command, &args) == 0 && args.blocking;
+  }
+  return true;
+}
 
-  pthread_mutex_unlock(&wait_state.mutex);
+// Folds the partition of one more key into the running result
+static int mergePartition(int current, int next) {
+  if (current == PARTITION_ANY || current == next) {
+    return next;
+  }
+  return PARTITION_CROSS;
+}
 
-  printf("Acked %lu\n", acked);
-  return createInteger(acked);
+static int keysPartition(RedisServer *server, RespValue *command) {
+  KeyRange keys;
+  int partition = PARTITION_ANY;
+  if (commandKeys(command, &keys) == 0) {
+    return partition;
+  }
+  for (size_t i = keys.first; i <= keys.last; i += keys.step) {
+    RespValue *key = command->data.array.elements[i];
+    partition = mergePartition(
+        partition,
+        keyPartition(server, key->data.string.str, key->data.string.len));
+  }
+  return partition;
 }
 
-static CommandHandler baseCommands[] = {
-    {"SET", handleSet, 3, 5},
-    {"GET", handleGet, 2, 2},
-    {"PING", handlePing, 1, 1},
-    {"ECHO", handleEcho, 2, 2},
-    {"TYPE", handleType, 2, 2},
-    {"XADD", handleXadd, 4, -1},
-    {"XRANGE", handleXrange, 4, 4},
-    {"XREAD", handleXread, 4, -1},
-    {"INCR", handleIncrement, 2, 2},
-    {"MULTI", handleMulti, 1, 1},
-    {"EXEC", handleExec, 1, 1},
-    {"DISCARD", handleDiscard, 0, -1},
-    {"CONFIG", handleConfigGet, 3, 3},
-    {
-        "KEYS",
-        handleKeys,
-        2,
-        2,
-    },
-
-    {"INFO", handleInfo, 1, 2},
-    {"REPLCONF", handleReplConf, 3, 3},
-    {"PSYNC", handlePsync, 3, 3},
-    {"WAIT", handleWait, 3, 3},
-};
+int commandPartition(RedisServer *server, RespValue *command,
+                     ClientState *clientState) {
+  if (command->type != RespTypeArray || command->data.array.len < 1) {
+    return PARTITION_ANY;
+  }
 
-static const size_t commandCount =
-    sizeof(baseCommands) / sizeof(CommandHandler);
+  const CommandHandler *handler = resolveCommand(command);
+  if (handler && handler->handler == handleExec) {
+    int partition = PARTITION_ANY;
+    for (size_t i = 0; i < clientState->queue->size; i++) {
+      int next = keysPartition(server, clientState->queue->commands[i]);
+      if (next != PARTITION_ANY) {
+        partition = mergePartition(partition, next);
+      }
+    }
+    return partition;
+  }
 
-const char *executeCommand(RedisServer *server, RedisStore *store,
-                           RespValue *command, ClientState *clientState) {
-  // Validate command format
-  if (command->type != RespTypeArray || command->data.array.len < 1) {
-    return createError("wrong number of arguments");
+  // Queued commands only run at EXEC, on the partition EXEC is routed to
+  if (clientState->in_transaction) {
+    return PARTITION_ANY;
   }
+  return keysPartition(server, command);
+}
 
-  RespValue *cmdName = command->data.array.elements[0];
+int rejectCrossPartition(RespValue *command, ClientState *clientState,
+                         OutputBuffer *reply) {
+  const CommandHandler *handler = resolveCommand(command);
+  if (handler && handler->handler == handleExec) {
+    clearCommandQueue(clientState->queue);
+    clientState->in_transaction = 0;
+  }
+  return writeError(reply,
+                    "CROSSSLOT Keys in request don't hash to the same "
+                    "partition");
+}
 
-  // Find the command handler
-  CommandHandler *handler = NULL;
-  for (size_t i = 0; i < commandCount; i++) {
-    if (strcasecmp(cmdName->data.string.str, baseCommands[i].name) == 0) {
-      handler = &baseCommands[i];
-      break;
-    }
+int executeCommandTo(RedisServer *server, RedisStore *store,
+                     RespValue *command, ClientState *clientState,
+                     OutputBuffer *reply) {
+  // Validate command format
+  if (command->type != RespTypeArray || command->data.array.len < 1) {
+    return writeError(reply, "wrong number of arguments");
   }
 
   // Handle unknown commands
+  const CommandHandler *handler = resolveCommand(command);
   if (!handler) {
-    return createError("unknown command");
+    return writeError(reply, "unknown command");
   }
 
   // Validate argument count
-  if (command->data.array.len < handler->minArgs ||
-      (handler->maxArgs != -1 && command->data.array.len > handler->maxArgs)) {
-    return createError("wrong number of arguments");
+  if (command->data.array.len < (size_t)handler->minArgs ||
+      (handler->maxArgs != -1 &&
+       command->data.array.len > (size_t)handler->maxArgs)) {
+    return writeError(reply, "wrong number of arguments");
   }
 
-  if (strcasecmp(cmdName->data.string.str, "MULTI") == 0 ||
-      strcasecmp(cmdName->data.string.str, "EXEC") == 0 ||
-      strcasecmp(cmdName->data.string.str, "DISCARD") == 0) {
-    return handler->handler(server, store, command, clientState);
+  // MULTI, EXEC and DISCARD act on the transaction instead of joining it
+  if (handler->flags & CMD_TRANSACTION) {
+    return handler->handler(server, store, command, clientState, reply);
   }
 
   // Queue commands if in transaction
   if (clientState->in_transaction) {
     queueCommand(clientState->queue, command);
-    return createSimpleString("QUEUED");
+    return writeSimpleString(reply, "QUEUED");
+  }
+
+  // Writes go on to replicas. A replica only applies what its master
+  // streams, it never forwards it.
+  int propagate = (handler->flags & (CMD_WRITE | CMD_NO_PROPAGATE)) ==
+                      CMD_WRITE &&
+                  !server->repl_info->master_info;
+
+  // Every write command takes a single key. Its writes are applied and
+  // streamed under the key's write order, or two reactors writing the key
+  // could reach replicas in the opposite order to the store.
+  StoreShard *ordered = NULL;
+  if (propagate) {
+    RespValue *key = command->data.array.elements[1];
+    ordered = storeLockWrites(store, key->data.string.str, key->data.string.len);
   }
 
   // Execute command normally
-  const char *result = handler->handler(server, store, command, clientState);
+  int status = handler->handler(server, store, command, clientState, reply);
+
+  // A handler may stand in a deterministic command for replicas to apply
+  if (propagate) {
+    LOG_TRACE("Propagating command %s", handler->name);
+    propagateCommand(server, clientState->propagate_as
+                                 ? clientState->propagate_as
+                                 : command);
+  }
+  clientState->propagate_as = NULL;
+  storeUnlockWrites(ordered);
+
+  return status;
+}
+
+const char *executeCommand(RedisServer *server, RedisStore *store,
+                           RespValue *command, ClientState *clientState) {
+  OutputBuffer *reply = createOutputBuffer();
+  if (!reply) {
+    return NULL;
+  }
 
-  if (!server->repl_info->master_info &&
-          strcasecmp(cmdName->data.string.str, "SET") == 0 ||
-      strcasecmp(cmdName->data.string.str, "DEL") == 0 ||
-      strcasecmp(cmdName->data.string.str, "INCR") == 0 ||
-      strcasecmp(cmdName->data.string.str, "XADD") == 0) {
-    printf("Propagating Command %s\n", cmdName->data.string.str);
-    propagateCommand(server, command);
+  const char *response = NULL;
+  if (executeCommandTo(server, store, command, clientState, reply) ==
+          OUTPUT_OK &&
+      reply->pending > 0) {
+    response = flattenOutputBuffer(reply, NULL);
   }
 
-  return result;
+  freeOutputBuffer(reply);
+  arenaRelease(&clientState->arena);
+  return response;
 }
@@ -5,29 +5,131 @@
 #include "redis_store.h"
 #include "server.h"
 
-typedef struct {
-  const char *name;
-  const char *(*handler)(RedisServer *server, RedisStore *, RespValue *,
-                         ClientState *);
+/* Command flags */
+#define CMD_WRITE (1 << 0)          /* May modify the keyspace */
+#define CMD_READONLY (1 << 1)       /* Only reads the keyspace */
+#define CMD_ADMIN (1 << 2)          /* Configuration and replication */
+#define CMD_TRANSACTION (1 << 3)    /* MULTI, EXEC, DISCARD, never queued */
+#define CMD_FAST (1 << 4)           /* Constant time, never blocks */
+#define CMD_BLOCKING (1 << 5)       /* May block, see commandMayBlock */
+#define CMD_NO_PROPAGATE (1 << 6)   /* A write replicas must not receive */
+
+#define COMMAND_NAME_MAX 16 /* Longest command name */
+
+/**
+ * Where a command's keys sit among its arguments: every step-th argument
+ * from first to last, where a negative last counts from the end. With a
+ * keyword the keys instead start right after that argument and fill half
+ * of the arguments that follow it, the other half being per-key values
+ * (XREAD ... STREAMS key1 key2 id1 id2).
+ */
+typedef struct KeySpec {
+  int first; /* 0 when the command takes no keys */
+  int last;
+  int step;
+  const char *keyword;
+} KeySpec;
+
+typedef struct CommandHandler {
+  const char *name; /* Upper case */
+  int (*handler)(RedisServer *server, RedisStore *, RespValue *,
+                 ClientState *, OutputBuffer *reply);
   int minArgs;
   int maxArgs;
+  int flags; /* CMD_* */
+  KeySpec keys;
 } CommandHandler;
 
+/**
+ * Argument indexes of a command's keys: first, first + step, ... up to
+ * last. Empty when first is 0.
+ */
+typedef struct KeyRange {
+  size_t first;
+  size_t last;
+  size_t step;
+} KeyRange;
+
 typedef struct CommandTable {
   CommandHandler *commands;
   size_t count;
 } CommandTable;
 
-typedef struct {
-  size_t remaining_count;
-  pthread_mutex_t mutex;
-  pthread_cond_t condition;
-  size_t acks_received;
-  bool completed;
-  int timeout_ms;
-} WaitState;
+/**
+ * Finds a command table entry by name, ignoring case, with one probe of a
+ * hash index built on first use
+ * @param name Command name, not necessarily NUL-terminated
+ * @param len Length of name
+ * @return Table entry, or NULL for unknown commands
+ */
+const CommandHandler *lookupCommand(const char *name, size_t len);
+
+/**
+ * Returns the table entry of a parsed command. The entry is looked up once
+ * and cached in the command, so the stages of one request share it.
+ * @param command Parsed command array
+ * @return Table entry, or NULL for malformed or unknown commands
+ */
+const CommandHandler *resolveCommand(RespValue *command);
+
+/**
+ * Locates the keys of a command using its table entry's key spec
+ * @param command Parsed command array
+ * @param range Filled with the key positions, empty for keyless or unknown
+ *              commands
+ * @return Number of keys
+ */
+size_t commandKeys(RespValue *command, KeyRange *range);
 
+/**
+ * Executes a command and appends its RESP reply to the given output buffer.
+ * Commands that send no reply leave the buffer untouched. Scratch memory
+ * is taken from the client's arena, which the caller resets once the
+ * reply is queued.
+ *
+ * @return OUTPUT_OK or OUTPUT_ERR if the reply could not be buffered
+ */
+int executeCommandTo(RedisServer *server, RedisStore *store,
+                     RespValue *command, ClientState *client_state,
+                     OutputBuffer *reply);
+
+/**
+ * Executes a command and returns its reply as a newly allocated string, or
+ * NULL if the command sends no reply. Prefer executeCommandTo, this copy is
+ * not binary safe for callers that rely on strlen. The client's arena is
+ * released before returning.
+ */
 const char *executeCommand(RedisServer *server, RedisStore *store,
                            RespValue *command, ClientState *client_state);
 
+/**
+ * Reports whether executing the command may block the calling thread, for
+ * commands flagged CMD_BLOCKING (WAIT, XREAD BLOCK). Commands queued inside
+ * MULTI never block.
+ */
+bool commandMayBlock(RespValue *command, ClientState *client_state);
+
+/* commandPartition results besides a partition index */
+#define PARTITION_ANY -1   /* No keys, runs on whichever partition */
+#define PARTITION_CROSS -2 /* Keys live in more than one partition */
+
+/**
+ * Finds the partition that must execute a command in shared-nothing mode:
+ * the owner of its keys, or of the keys of every queued command for EXEC.
+ * Commands queued inside MULTI run wherever the client is.
+ *
+ * @return Partition index, PARTITION_ANY or PARTITION_CROSS
+ */
+int commandPartition(RedisServer *server, RespValue *command,
+                     ClientState *client_state);
+
+/**
+ * Replies to a command whose keys span partitions. A rejected EXEC also
+ * discards its transaction.
+ *
+ * @return OUTPUT_OK or OUTPUT_ERR if the reply could not be buffered
+ */
+int rejectCrossPartition(RespValue *command, ClientState *client_state,
+                         OutputBuffer *reply);
+
 #endif
@@ -1,7 +1,9 @@
 #include "config.h"
+#include "redis_store.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 ServerConfig *parseConfig(int argc, char *argv[]) {
   ServerConfig *config = calloc(1, sizeof(ServerConfig));
@@ -14,6 +16,12 @@ ServerConfig *parseConfig(int argc, char *argv[]) {
   config->is_replica = false;
   config->master_host = NULL;
   config->master_port = 0;
+  config->io_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (config->io_threads < 1) {
+    config->io_threads = 1;
+  }
+  config->store_shards = STORE_DEFAULT_SHARDS;
+  config->shared_nothing = false;
 
   // Parse command line arguments
   for (int i = 1; i < argc; i++) {
@@ -32,6 +40,20 @@ ServerConfig *parseConfig(int argc, char *argv[]) {
       free(config->bindaddr);
       config->bindaddr = strdup(argv[i + 1]);
       i++;
+    } else if (strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) {
+      int threads = atoi(argv[i + 1]);
+      if (threads > 0) {
+        config->io_threads = threads;
+      }
+      i++;
+    } else if (strcmp(argv[i], "--store-shards") == 0 && i + 1 < argc) {
+      int shards = atoi(argv[i + 1]);
+      if (shards > 0) {
+        config->store_shards = shards;
+      }
+      i++;
+    } else if (strcmp(argv[i], "--shared-nothing") == 0) {
+      config->shared_nothing = true;
     } else if (strcmp(argv[i], "--replicaof") == 0 && i + 1 < argc) {
       config->is_replica = true;
 
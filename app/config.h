@@ -11,7 +11,9 @@ typedef struct ServerConfig {
   char *master_host;
   int master_port;
   bool is_replica;
-
+  int io_threads;   // Number of event loop reactor threads
+  int store_shards; // Independently locked keyspace shards
+  bool shared_nothing; // Each reactor owns a keyspace partition
 } ServerConfig;
 
 ServerConfig *parseConfig(int argc, char *argv[]);
@@ -0,0 +1,669 @@
+#include "event_loop.h"
+#include "client_handler.h"
+#include "clock.h"
+#include "logger.h"
+#include "networking.h"
+#include "replicas.h"
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+
+#define EVENT_LOOP_TIMEOUT_MS 100 /* Upper bound on time between stop checks */
+
+static unsigned int clientInterest(ClientState *client) {
+  unsigned int events = 0;
+  // Backpressure: stop reading while the client is not draining replies
+  if (!clientOutputPaused(client)) {
+    events |= EPOLLIN;
+  }
+  if (clientHasPendingOutput(client)) {
+    events |= EPOLLOUT;
+  }
+  return events;
+}
+
+static int registerClient(EventLoop *loop, ClientState *client) {
+  struct epoll_event ev = {0};
+  ev.events = clientInterest(client);
+  // A replica's stream may have backed up while it was away, one
+  // EPOLLOUT resumes writing it or disarms itself
+  if (client->replica) {
+    ev.events |= EPOLLOUT;
+  }
+  ev.data.ptr = client;
+  client->events = ev.events;
+  // Back home, commands run against the home reactor's partition again
+  if (loop->server->partition_count > 0) {
+    client->partition = loop->id;
+  }
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, client->fd, &ev) != 0) {
+    return -1;
+  }
+  client->registered = 1;
+  return 0;
+}
+
+static EventLoop *homeLoop(EventLoop *loop, ClientState *client) {
+  return loop->group ? loop->group->loops[client->home] : loop;
+}
+
+// Stops watching the socket while another thread serves the client
+static void detachClient(EventLoop *loop, ClientState *client) {
+  if (client->registered) {
+    epoll_ctl(homeLoop(loop, client)->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    client->registered = 0;
+  }
+}
+
+// Parked clients are watched for hangup, and for room to send the replies
+// of commands pipelined before the blocking one
+static unsigned int parkedInterest(ClientState *client) {
+  return EPOLLRDHUP | (clientHasPendingOutput(client) ? EPOLLOUT : 0);
+}
+
+static int setClientInterest(EventLoop *loop, ClientState *client,
+                             unsigned int events) {
+  if (events == client->events) {
+    return 0;
+  }
+
+  struct epoll_event ev = {0};
+  ev.events = events;
+  ev.data.ptr = client;
+  client->events = events;
+  return epoll_ctl(loop->epfd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+static int updateClientInterest(EventLoop *loop, ClientState *client) {
+  return setClientInterest(loop, client, clientInterest(client));
+}
+
+static int clientParked(EventLoop *loop, ClientState *client) {
+  return client->bstate.prev || loop->blockedHead == client;
+}
+
+// Takes a client off the parked list and cancels its deadline
+static void unparkClient(EventLoop *loop, ClientState *client) {
+  BlockingState *bstate = &client->bstate;
+  if (!clientParked(loop, client)) {
+    return;
+  }
+  if (bstate->timer.pprev) {
+    timerWheelRemove(&loop->blockTimers, &bstate->timer);
+  }
+  if (bstate->prev) {
+    bstate->prev->bstate.next = bstate->next;
+  } else {
+    loop->blockedHead = bstate->next;
+  }
+  if (bstate->next) {
+    bstate->next->bstate.prev = bstate->prev;
+  }
+  bstate->prev = NULL;
+  bstate->next = NULL;
+}
+
+static void closeClient(EventLoop *loop, ClientState *client) {
+  // Before the socket closes, so no stream write can hit a reused fd
+  if (client->replica) {
+    removeReplica(loop->server, client->fd);
+  }
+  if (client->bstate.command) {
+    unparkClient(loop, client);
+    __atomic_sub_fetch(&loop->server->blocked_clients, 1, __ATOMIC_RELAXED);
+  }
+  detachClient(loop, client);
+  freeClientState(client);
+  __atomic_sub_fetch(&loop->server->clients_count, 1, __ATOMIC_RELAXED);
+}
+
+// Only the first wakeup the reactor has not noticed yet costs a syscall.
+// The fence orders what the wakeup announces before the flag check,
+// pairing with the one in handleWakeup.
+static void wakeLoop(EventLoop *loop) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (!__atomic_exchange_n(&loop->wakePending, 1, __ATOMIC_SEQ_CST)) {
+    eventfd_write(loop->wakefd, 1);
+  }
+}
+
+// Hands a client from one reactor to another
+static void postClient(EventLoop *from, EventLoop *to, ClientState *client) {
+  if (spscPush(to->inbox[from->id], client) != 0) {
+    client->handoff_next = NULL;
+    pthread_mutex_lock(&to->overflowLock);
+    if (to->overflowTail) {
+      to->overflowTail->handoff_next = client;
+    } else {
+      to->overflowHead = client;
+    }
+    to->overflowTail = client;
+    pthread_mutex_unlock(&to->overflowLock);
+  }
+  wakeLoop(to);
+}
+
+static void parkClient(EventLoop *loop, ClientState *client);
+
+// Acts on a client status once a command batch has run on this reactor
+static void dispatchClient(EventLoop *loop, ClientState *client,
+                           int status) {
+  if (status == CLIENT_FORWARD) {
+    detachClient(loop, client);
+    client->handoff = HANDOFF_EXECUTE;
+    postClient(loop, loop->group->loops[client->forward_to], client);
+    return;
+  }
+
+  // Only the home reactor registers, blocks or closes its clients
+  if (loop->id != client->home) {
+    client->handoff = HANDOFF_RETURN;
+    client->handoff_status = status;
+    postClient(loop, homeLoop(loop, client), client);
+    return;
+  }
+
+  if (status == CLIENT_CLOSE) {
+    closeClient(loop, client);
+  } else if (status == CLIENT_BLOCKED) {
+    parkClient(loop, client);
+  } else if (!client->registered) {
+    if (registerClient(loop, client) != 0) {
+      LOG_ERROR("Failed to re-register client (fd: %d): %s", client->fd,
+                strerror(errno));
+      closeClient(loop, client);
+    }
+  } else if (client->replica) {
+    // Interest follows the replication stream, which sets it under its lock
+  } else if (updateClientInterest(loop, client) != 0) {
+    LOG_ERROR("Failed to update client events (fd: %d): %s", client->fd,
+              strerror(errno));
+    closeClient(loop, client);
+  }
+}
+
+static void receiveClient(EventLoop *loop, ClientState *client) {
+  if (client->handoff == HANDOFF_RETURN) {
+    dispatchClient(loop, client, client->handoff_status);
+    return;
+  }
+  client->partition = loop->id;
+  if (client->handoff == HANDOFF_RETRY) {
+    dispatchClient(loop, client, resumeBlockedClient(loop->server, client));
+    return;
+  }
+  dispatchClient(loop, client, runForwardedCommand(loop->server, client));
+}
+
+static void drainInbox(EventLoop *loop) {
+  for (int i = 0; i < loop->group->count; i++) {
+    if (i == loop->id) {
+      continue;
+    }
+    ClientState *client;
+    while ((client = spscPop(loop->inbox[i]))) {
+      receiveClient(loop, client);
+    }
+  }
+
+  pthread_mutex_lock(&loop->overflowLock);
+  ClientState *client = loop->overflowHead;
+  loop->overflowHead = NULL;
+  loop->overflowTail = NULL;
+  pthread_mutex_unlock(&loop->overflowLock);
+
+  while (client) {
+    ClientState *next = client->handoff_next;
+    receiveClient(loop, client);
+    client = next;
+  }
+}
+
+// Attempts a parked client's command again, on the reactor owning the
+// partition it reads
+static void retryBlockedClient(EventLoop *loop, ClientState *client) {
+  unparkClient(loop, client);
+  int partition = client->bstate.partition;
+  if (loop->server->partition_count > 0 && partition != loop->id) {
+    detachClient(loop, client);
+    client->handoff = HANDOFF_RETRY;
+    postClient(loop, loop->group->loops[partition], client);
+    return;
+  }
+  dispatchClient(loop, client, resumeBlockedClient(loop->server, client));
+}
+
+// Keeps a client whose command is waiting on its home reactor. Its socket
+// stays registered for hangup and pending output only, so a client that
+// goes away while blocked is closed at once, earlier replies still drain
+// and the rest of its input stays unread.
+static void parkClient(EventLoop *loop, ClientState *client) {
+  BlockingState *bstate = &client->bstate;
+  struct epoll_event ev = {0};
+  ev.events = parkedInterest(client);
+  ev.data.ptr = client;
+  int op = client->registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (epoll_ctl(loop->epfd, op, client->fd, &ev) != 0) {
+    LOG_ERROR("Failed to park blocked client (fd: %d): %s", client->fd,
+              strerror(errno));
+    closeClient(loop, client);
+    return;
+  }
+  client->registered = 1;
+  client->events = ev.events;
+
+  bstate->partition = client->partition;
+  bstate->prev = NULL;
+  bstate->next = loop->blockedHead;
+  if (loop->blockedHead) {
+    loop->blockedHead->bstate.prev = client;
+  }
+  loop->blockedHead = client;
+  if (bstate->deadline >= 0) {
+    timerWheelAdd(&loop->blockTimers, &bstate->timer, bstate->deadline);
+  }
+
+  // A signal raised since the attempt began may have missed the client
+  // while it was on its way here, so it is attempted again
+  if (__atomic_load_n(&loop->server->block_signals, __ATOMIC_SEQ_CST) !=
+      bstate->signals) {
+    __atomic_fetch_or(&loop->blockedReady, bstate->reason, __ATOMIC_SEQ_CST);
+    wakeLoop(loop);
+  }
+}
+
+// Attempts again the commands of clients parked for a signalled reason
+static void serveSignalledClients(EventLoop *loop) {
+  int ready = __atomic_exchange_n(&loop->blockedReady, 0, __ATOMIC_SEQ_CST);
+  ClientState *client = ready ? loop->blockedHead : NULL;
+  while (client) {
+    // A client still waiting is parked again at the head, behind us
+    ClientState *next = client->bstate.next;
+    if (client->bstate.reason & ready) {
+      retryBlockedClient(loop, client);
+    }
+    client = next;
+  }
+}
+
+// Lets commands whose deadline passed answer
+static void expireBlockedClients(EventLoop *loop) {
+  TimerNode *timer;
+  while ((timer = timerWheelPop(&loop->blockTimers, clockMonotonicMs()))) {
+    ClientState *client =
+        (ClientState *)((char *)timer - offsetof(ClientState, bstate.timer));
+    client->bstate.timed_out = 1;
+    retryBlockedClient(loop, client);
+  }
+}
+
+// Sleeps no longer than until the next blocked command deadline
+static int pollTimeout(EventLoop *loop) {
+  long long next = timerWheelNextExpiry(&loop->blockTimers);
+  if (next < 0) {
+    return EVENT_LOOP_TIMEOUT_MS;
+  }
+  long long wait = next - clockMonotonicMs();
+  if (wait <= 0) {
+    return 0;
+  }
+  return wait < EVENT_LOOP_TIMEOUT_MS ? (int)wait : EVENT_LOOP_TIMEOUT_MS;
+}
+
+static void handleWakeup(EventLoop *loop) {
+  eventfd_t value;
+  eventfd_read(loop->wakefd, &value);
+  // Clear before draining so a wakeup racing with the drain is not lost
+  __atomic_store_n(&loop->wakePending, 0, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  if (loop->inbox) {
+    drainInbox(loop);
+  }
+  serveSignalledClients(loop);
+}
+
+void signalBlockedClients(RedisServer *server, int reason) {
+  // Pairs with the count taken before a blocking command first looks for
+  // data: either that look sees what the caller just wrote, or the count
+  // is seen here
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&server->blocked_clients, __ATOMIC_SEQ_CST) == 0) {
+    return;
+  }
+  __atomic_add_fetch(&server->block_signals, 1, __ATOMIC_SEQ_CST);
+  for (EventLoop *loop = server->reactors; loop; loop = loop->nextReactor) {
+    __atomic_fetch_or(&loop->blockedReady, reason, __ATOMIC_SEQ_CST);
+    wakeLoop(loop);
+  }
+}
+
+static void acceptClients(EventLoop *loop) {
+  while (1) {
+    int clientFd = acceptClientOn(loop->listen_fd);
+    if (clientFd < 0) {
+      return;
+    }
+    LOG_TRACE("Client FD %d ", clientFd);
+
+    ClientState *client = handleNewClient(loop->server, clientFd);
+    if (!client) {
+      continue;
+    }
+    client->home = loop->id;
+    client->epfd = loop->epfd;
+
+    if (registerClient(loop, client) != 0) {
+      LOG_ERROR("Failed to register client with epoll (fd: %d): %s", clientFd,
+                strerror(errno));
+      freeClientState(client);
+      continue;
+    }
+    __atomic_add_fetch(&loop->server->clients_count, 1, __ATOMIC_RELAXED);
+  }
+}
+
+static void handleClientEvent(EventLoop *loop, ClientState *client,
+                              uint32_t events) {
+  int status = CLIENT_OK;
+
+  // A parked client only writes out replies it already has
+  if (clientParked(loop, client)) {
+    if (!(events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) &&
+        flushClientOutput(client) == CLIENT_OK &&
+        setClientInterest(loop, client, parkedInterest(client)) == 0) {
+      return;
+    }
+    LOG_INFO("Blocked client disconnected (fd: %d)", client->fd);
+    closeClient(loop, client);
+    return;
+  }
+
+  if ((events & EPOLLOUT) && client->replica) {
+    status = flushReplica(loop->server, client->fd) == 0 ? CLIENT_OK
+                                                          : CLIENT_CLOSE;
+  } else if (events & EPOLLOUT) {
+    int wasPaused = clientOutputPaused(client);
+    status = flushClientOutput(client);
+    // Resume commands left buffered while output was over the soft limit
+    if (status == CLIENT_OK && wasPaused && !clientOutputPaused(client)) {
+      status = processClientBuffer(loop->server, client);
+    }
+  }
+
+  if (status == CLIENT_OK && (events & EPOLLIN)) {
+    status = handleClientData(loop->server, client);
+  } else if (status == CLIENT_OK && (events & (EPOLLERR | EPOLLHUP))) {
+    status = CLIENT_CLOSE;
+  }
+
+  dispatchClient(loop, client, status);
+}
+
+EventLoop *createEventLoop(RedisServer *server) {
+  return createEventLoopOn(server, server->fd);
+}
+
+EventLoop *createEventLoopOn(RedisServer *server, int listen_fd) {
+  EventLoop *loop = malloc(sizeof(EventLoop));
+  if (!loop) {
+    return NULL;
+  }
+
+  loop->id = 0;
+  loop->server = server;
+  loop->listen_fd = listen_fd;
+  loop->running = 1;
+  loop->nextReactor = NULL;
+  loop->blockedHead = NULL;
+  loop->blockedReady = 0;
+  timerWheelInit(&loop->blockTimers, clockMonotonicMs());
+  loop->group = NULL;
+  loop->inbox = NULL;
+  loop->wakefd = -1;
+  loop->wakePending = 0;
+  loop->overflowHead = NULL;
+  loop->overflowTail = NULL;
+  pthread_mutex_init(&loop->overflowLock, NULL);
+  loop->events = malloc(sizeof(struct epoll_event) * EVENT_LOOP_MAX_EVENTS);
+  if (!loop->events) {
+    free(loop);
+    return NULL;
+  }
+
+  loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epfd < 0) {
+    LOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+    free(loop->events);
+    free(loop);
+    return NULL;
+  }
+
+  // Accept in a loop until EAGAIN instead of blocking on an empty backlog
+  int flags = fcntl(loop->listen_fd, F_GETFL, 0);
+  if (flags == -1 ||
+      fcntl(loop->listen_fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    LOG_ERROR("Failed to make listening socket non-blocking: %s",
+              strerror(errno));
+    freeEventLoop(loop);
+    return NULL;
+  }
+
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL; // NULL marks the listening socket
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->listen_fd, &ev) != 0) {
+    LOG_ERROR("Failed to register listening socket: %s", strerror(errno));
+    freeEventLoop(loop);
+    return NULL;
+  }
+
+  loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  ev.data.ptr = &loop->wakefd; // Marks the wakeup from other threads
+  if (loop->wakefd < 0 ||
+      epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev) != 0) {
+    LOG_ERROR("Failed to register wakeup eventfd: %s", strerror(errno));
+    freeEventLoop(loop);
+    return NULL;
+  }
+
+  // Blocked clients are signalled through every loop of the server
+  loop->nextReactor = server->reactors;
+  server->reactors = loop;
+  return loop;
+}
+
+void runEventLoop(EventLoop *loop) {
+  clockUpdate();
+  long long nextCron = clockMonotonicMs() + SERVER_CRON_INTERVAL_MS;
+
+  while (loop->running) {
+    int n = epoll_wait(loop->epfd, loop->events, EVENT_LOOP_MAX_EVENTS,
+                       pollTimeout(loop));
+    // Commands, TTL checks and logging in this iteration share one reading
+    clockUpdate();
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG_ERROR("epoll_wait failed: %s", strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      struct epoll_event *ev = &loop->events[i];
+      if (ev->data.ptr == NULL) {
+        acceptClients(loop);
+      } else if (ev->data.ptr == &loop->wakefd) {
+        handleWakeup(loop);
+      } else {
+        handleClientEvent(loop, ev->data.ptr, ev->events);
+      }
+    }
+    expireBlockedClients(loop);
+
+    // Every reactor maintains the keyspace it owns
+    if (clockMonotonicMs() >= nextCron) {
+      serverCron(loop->server, loop->id);
+      nextCron = clockMonotonicMs() + SERVER_CRON_INTERVAL_MS;
+    }
+  }
+  clockStopCaching();
+}
+
+void stopEventLoop(EventLoop *loop) { loop->running = 0; }
+
+void freeEventLoop(EventLoop *loop) {
+  if (!loop) {
+    return;
+  }
+  for (EventLoop **link = &loop->server->reactors; *link;
+       link = &(*link)->nextReactor) {
+    if (*link == loop) {
+      *link = loop->nextReactor;
+      break;
+    }
+  }
+  if (loop->inbox) {
+    for (int i = 0; i < loop->group->count; i++) {
+      freeSpscQueue(loop->inbox[i]);
+    }
+    free(loop->inbox);
+  }
+  if (loop->wakefd >= 0) {
+    close(loop->wakefd);
+  }
+  pthread_mutex_destroy(&loop->overflowLock);
+  close(loop->epfd);
+  free(loop->events);
+  free(loop);
+}
+
+// Sets up the queues other threads use to hand clients to this reactor
+static int createMailbox(EventLoop *loop, int reactors) {
+  loop->inbox = calloc(reactors, sizeof(SpscQueue *));
+  if (!loop->inbox) {
+    return -1;
+  }
+  for (int i = 0; i < reactors; i++) {
+    if (i == loop->id) {
+      continue;
+    }
+    loop->inbox[i] = createSpscQueue(EVENT_LOOP_INBOX_SIZE);
+    if (!loop->inbox[i]) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+ReactorGroup *createReactorGroup(RedisServer *server, int count) {
+  if (count < 1) {
+    count = 1;
+  }
+
+  ReactorGroup *group = calloc(1, sizeof(ReactorGroup));
+  if (!group) {
+    return NULL;
+  }
+  group->loops = calloc(count, sizeof(EventLoop *));
+  group->threads = calloc(count, sizeof(pthread_t));
+  if (!group->loops || !group->threads) {
+    free(group->loops);
+    free(group->threads);
+    free(group);
+    return NULL;
+  }
+
+  for (int i = 0; i < count; i++) {
+    int listen_fd = server->fd;
+    if (i > 0) {
+      listen_fd = createListeningSocket(server->bindaddr, server->port,
+                                        server->tcp_backlog);
+      if (listen_fd < 0) {
+        LOG_ERROR("Failed to create listening socket for reactor %d", i);
+        freeReactorGroup(group);
+        return NULL;
+      }
+    }
+
+    group->loops[i] = createEventLoopOn(server, listen_fd);
+    if (!group->loops[i]) {
+      if (i > 0) {
+        close(listen_fd);
+      }
+      freeReactorGroup(group);
+      return NULL;
+    }
+    group->loops[i]->id = i;
+    group->loops[i]->group = group;
+    group->count = i + 1;
+  }
+
+  if (server->shared_nothing) {
+    if (createServerPartitions(server, count) != 0) {
+      LOG_ERROR("Failed to create keyspace partitions");
+      freeReactorGroup(group);
+      return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+      if (createMailbox(group->loops[i], count) != 0) {
+        LOG_ERROR("Failed to create mailbox for reactor %d: %s", i,
+                  strerror(errno));
+        freeReactorGroup(group);
+        return NULL;
+      }
+    }
+  }
+
+  return group;
+}
+
+static void *reactorThread(void *arg) {
+  runEventLoop((EventLoop *)arg);
+  return NULL;
+}
+
+void runReactorGroup(ReactorGroup *group) {
+  int started = 1;
+  for (int i = 1; i < group->count; i++) {
+    if (pthread_create(&group->threads[i], NULL, reactorThread,
+                       group->loops[i]) != 0) {
+      LOG_ERROR("Failed to start reactor thread %d", i);
+      break;
+    }
+    started++;
+  }
+
+  LOG_INFO("Started %d reactor(s)", started);
+  runEventLoop(group->loops[0]);
+
+  // Reactor 0 only returns once stopped, bring the others down with it
+  stopReactorGroup(group);
+  for (int i = 1; i < started; i++) {
+    pthread_join(group->threads[i], NULL);
+  }
+}
+
+void stopReactorGroup(ReactorGroup *group) {
+  for (int i = 0; i < group->count; i++) {
+    stopEventLoop(group->loops[i]);
+  }
+}
+
+void freeReactorGroup(ReactorGroup *group) {
+  if (!group) {
+    return;
+  }
+  for (int i = 0; i < group->count; i++) {
+    // Reactor 0 serves server->fd, which freeServer closes
+    if (i > 0) {
+      close(group->loops[i]->listen_fd);
+    }
+    freeEventLoop(group->loops[i]);
+  }
+  free(group->loops);
+  free(group->threads);
+  free(group);
+}
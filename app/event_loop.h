@@ -0,0 +1,151 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "client_handler.h"
+#include "server.h"
+#include "spsc_queue.h"
+#include "timer_wheel.h"
+#include <sys/epoll.h>
+
+#define EVENT_LOOP_MAX_EVENTS 1024 /* Events fetched per epoll_wait call */
+#define EVENT_LOOP_INBOX_SIZE 4096 /* Clients in flight between two reactors */
+
+struct ReactorGroup;
+
+/**
+ * Readiness-driven event loop multiplexing the listening socket and every
+ * client connection over a single epoll instance.
+ *
+ * Clients whose command blocks (XREAD BLOCK, WAIT) stay parked on their
+ * home reactor, watched only for hangup. Other threads signal the reactor
+ * through its eventfd when such commands may answer, and a timer wheel
+ * retries them once their deadline passes.
+ */
+typedef struct EventLoop {
+  int id;                     /* Reactor index within its group */
+  int epfd;                   /* epoll instance */
+  int listen_fd;              /* Listening socket registered with epoll */
+  RedisServer *server;        /* Server whose clients are served */
+  struct epoll_event *events; /* Ready events buffer */
+  volatile int running;       /* Cleared to stop the loop */
+  struct EventLoop *nextReactor; /* Next in server->reactors */
+
+  // Wakeups from other threads, for handed over clients or blocked ones
+  int wakefd;                    /* eventfd signalled by other threads */
+  int wakePending;               /* Set while a wakeup is unconsumed */
+
+  // Blocked clients parked on this reactor
+  ClientState *blockedHead;      /* Parked clients, linked through bstate */
+  int blockedReady;              /* BLOCKED_* reasons signalled, unserved */
+  TimerWheel blockTimers;        /* Deadlines in monotonic ms */
+
+  // Shared-nothing mailbox: clients handed over by other reactors
+  struct ReactorGroup *group;    /* Group this reactor belongs to, or NULL */
+  SpscQueue **inbox;             /* inbox[i] is fed by reactor i only */
+  pthread_mutex_t overflowLock;  /* Guards the overflow list */
+  ClientState *overflowHead;     /* When an inbox is full */
+  ClientState *overflowTail;
+} EventLoop;
+
+/**
+ * A set of reactors, each running its own event loop on its own thread with
+ * its own SO_REUSEPORT listening socket. The kernel shards incoming
+ * connections across the listeners, and a connection stays on the reactor
+ * that accepted it for its whole lifetime.
+ *
+ * In shared-nothing mode reactor i also owns keyspace partition i. A command
+ * for another partition detaches its client from the home reactor and hands
+ * the client itself to the owner through a lock-free SPSC queue per reactor
+ * pair, waking it with an eventfd. The owner runs the command and any that
+ * follow on its partition, then hands the client on or back home.
+ */
+typedef struct ReactorGroup {
+  EventLoop **loops;  /* One event loop per reactor */
+  pthread_t *threads; /* Threads running reactors 1..count-1 */
+  int count;          /* Number of reactors */
+} ReactorGroup;
+
+/**
+ * Creates an event loop serving the server's listening socket.
+ *
+ * @param server Initialized server instance
+ * @return Newly allocated EventLoop or NULL on failure
+ */
+EventLoop *createEventLoop(RedisServer *server);
+
+/**
+ * Creates an event loop serving the given listening socket.
+ *
+ * @param server Initialized server instance
+ * @param listen_fd Listening socket accepted from by this loop
+ * @return Newly allocated EventLoop or NULL on failure
+ */
+EventLoop *createEventLoopOn(RedisServer *server, int listen_fd);
+
+/**
+ * Runs the event loop until stopEventLoop is called.
+ *
+ * @param loop Event loop to run
+ */
+void runEventLoop(EventLoop *loop);
+
+/**
+ * Requests the event loop to stop after the current iteration.
+ *
+ * @param loop Event loop to stop
+ */
+void stopEventLoop(EventLoop *loop);
+
+/**
+ * Frees the event loop. Client connections still registered are not closed.
+ *
+ * @param loop Event loop to free
+ */
+void freeEventLoop(EventLoop *loop);
+
+/**
+ * Wakes the clients blocked for the given reason on every reactor, to
+ * attempt their commands again. Safe to call from any thread, and cheap
+ * while no client is blocked.
+ *
+ * @param server Server whose reactors are signalled
+ * @param reason BLOCKED_* event that happened, e.g. BLOCKED_STREAM after
+ *               an XADD
+ */
+void signalBlockedClients(RedisServer *server, int reason);
+
+/**
+ * Creates count reactors. Reactor 0 serves the server's listening socket,
+ * the others bind additional SO_REUSEPORT sockets on the same address. When
+ * the server asks for shared-nothing mode this also creates one keyspace
+ * partition per reactor.
+ *
+ * @param server Initialized server instance
+ * @param count Number of reactors, at least 1
+ * @return Newly allocated ReactorGroup or NULL on failure
+ */
+ReactorGroup *createReactorGroup(RedisServer *server, int count);
+
+/**
+ * Runs every reactor: reactors 1..count-1 on new threads and reactor 0 on
+ * the calling thread. Returns once all reactors have stopped.
+ *
+ * @param group Reactors to run
+ */
+void runReactorGroup(ReactorGroup *group);
+
+/**
+ * Requests every reactor in the group to stop.
+ *
+ * @param group Reactors to stop
+ */
+void stopReactorGroup(ReactorGroup *group);
+
+/**
+ * Frees the reactors and the extra listening sockets they own.
+ *
+ * @param group Reactors to free
+ */
+void freeReactorGroup(ReactorGroup *group);
+
+#endif
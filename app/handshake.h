@@ -3,6 +3,8 @@
 
 #define INITIAL_REPLICA_CAPACITY 16
 
+#include "output_buffer.h"
+#include <pthread.h>
 #include <stddef.h>
 
 typedef struct {
@@ -11,15 +13,26 @@ typedef struct {
   int fd;
 } MasterInfo;
 
+struct ClientState;
+
 typedef struct {
   int fd;
-  long long ack_offset;
+  long long ack_offset;        /* Master offset the replica confirmed */
+  long long sync_offset;       /* Master offset its stream starts at */
+  OutputBuffer *stream;       /* Replication stream the socket has not taken */
+  struct ClientState *client; /* Connection the replica synced on */
+  int epfd;                   /* epoll set serving the connection, or -1 */
+  int writable;               /* EPOLLOUT armed until stream drains */
+  int failed;                 /* Stream broken, waiting for its client to close */
 } Replica;
 
 typedef struct {
   Replica *replicas; // Array of Replica structs
   size_t replica_count;
   size_t replica_capacity;
+  // Write commands run on every reactor, this keeps the list, repl_offset
+  // and each replica's byte stream consistent between them
+  pthread_mutex_t lock;
 } Replicas;
 
 typedef struct {
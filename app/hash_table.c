@@ -0,0 +1,362 @@
+#include "hash_table.h"
+#include "redis_store.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* Control byte states, full slots hold a 7-bit fingerprint (0..127) */
+#define CTRL_EMPTY ((uint8_t)0x80)
+#define CTRL_DELETED ((uint8_t)0xFE)
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash) & 0x7F))
+
+typedef uint32_t GroupMask; /* One bit per control byte of a group */
+
+#ifdef __SSE2__
+
+static inline GroupMask matchByte(const uint8_t *group, uint8_t value) {
+  __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+  return (GroupMask)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)value)));
+}
+
+static inline GroupMask matchEmptyOrDeleted(const uint8_t *group) {
+  // Both special states have the high bit set, fingerprints never do
+  __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+  return (GroupMask)_mm_movemask_epi8(ctrl);
+}
+
+#else
+
+static inline GroupMask matchByte(const uint8_t *group, uint8_t value) {
+  GroupMask mask = 0;
+  for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+    mask |= (GroupMask)(group[i] == value) << i;
+  }
+  return mask;
+}
+
+static inline GroupMask matchEmptyOrDeleted(const uint8_t *group) {
+  GroupMask mask = 0;
+  for (int i = 0; i < HT_GROUP_WIDTH; i++) {
+    mask |= (GroupMask)(group[i] >> 7) << i;
+  }
+  return mask;
+}
+
+#endif
+
+static inline GroupMask matchEmpty(const uint8_t *group) {
+  return matchByte(group, CTRL_EMPTY);
+}
+
+static inline int lowestBit(GroupMask mask) { return __builtin_ctz(mask); }
+
+static inline int highestBit(GroupMask mask) { return 31 - __builtin_clz(mask); }
+
+// At most 7/8 of the slots may be full or deleted
+static size_t maxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+// Sets a control byte, keeping the copy of the first group that follows the
+// last slot in sync so a group load never has to wrap around
+static inline void setCtrl(HashSlots *ht, size_t index, uint8_t value) {
+  ht->ctrl[index] = value;
+  if (index < HT_GROUP_WIDTH) {
+    ht->ctrl[ht->capacity + index] = value;
+  }
+}
+
+static int initSlots(HashSlots *ht, size_t capacity) {
+  uint8_t *ctrl = malloc(capacity + HT_GROUP_WIDTH);
+  struct StoreEntry **slots = malloc(capacity * sizeof(struct StoreEntry *));
+  if (!ctrl || !slots) {
+    free(ctrl);
+    free(slots);
+    return -1;
+  }
+  memset(ctrl, CTRL_EMPTY, capacity + HT_GROUP_WIDTH);
+
+  ht->ctrl = ctrl;
+  ht->slots = slots;
+  ht->capacity = capacity;
+  ht->used = 0;
+  ht->deleted = 0;
+  ht->growthLeft = maxLoad(capacity);
+  return 0;
+}
+
+static void releaseSlots(HashSlots *ht) {
+  free(ht->ctrl);
+  free(ht->slots);
+  memset(ht, 0, sizeof(HashSlots));
+}
+
+HashTable *createHashTable(size_t capacity) {
+  size_t size = HT_MIN_CAPACITY;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  HashTable *table = malloc(sizeof(HashTable));
+  if (!table) {
+    return NULL;
+  }
+  memset(&table->ht[1], 0, sizeof(HashSlots));
+  table->rehashIdx = -1;
+  if (initSlots(&table->ht[0], size) != 0) {
+    free(table);
+    return NULL;
+  }
+  return table;
+}
+
+void freeHashTable(HashTable *table) {
+  if (!table) {
+    return;
+  }
+  releaseSlots(&table->ht[0]);
+  releaseSlots(&table->ht[1]);
+  free(table);
+}
+
+// Probes group by group, stepping 1, 2, 3... groups further each time. With
+// a power-of-two capacity this visits every group exactly once.
+#define FOR_EACH_PROBE(ht, hash, pos)                                          \
+  for (size_t pos = H1(hash) & ((ht)->capacity - 1), step = 0;                 \
+       step <= (ht)->capacity;                                                 \
+       step += HT_GROUP_WIDTH, pos = (pos + step) & ((ht)->capacity - 1))
+
+// Returns the slot index holding the key, or -1
+static long findIndex(HashSlots *ht, const char *key, size_t keyLen,
+                      uint64_t hash) {
+  uint8_t fingerprint = H2(hash);
+  size_t mask = ht->capacity - 1;
+
+  FOR_EACH_PROBE(ht, hash, pos) {
+    const uint8_t *group = ht->ctrl + pos;
+    // Start pulling in the slots while the control bytes are compared
+    __builtin_prefetch(&ht->slots[pos]);
+    for (GroupMask match = matchByte(group, fingerprint); match;
+         match &= match - 1) {
+      size_t index = (pos + lowestBit(match)) & mask;
+      struct StoreEntry *entry = ht->slots[index];
+      if (entry->hash == hash && entry->keyLen == keyLen &&
+          memcmp(entry->key, key, keyLen) == 0) {
+        return (long)index;
+      }
+    }
+    // An empty slot ends the probe sequence: the key would have gone there
+    if (matchEmpty(group)) {
+      return -1;
+    }
+  }
+  return -1;
+}
+
+// Returns the first empty or deleted slot on the key's probe sequence
+static size_t findInsertIndex(HashSlots *ht, uint64_t hash) {
+  size_t mask = ht->capacity - 1;
+  FOR_EACH_PROBE(ht, hash, pos) {
+    GroupMask available = matchEmptyOrDeleted(ht->ctrl + pos);
+    if (available) {
+      return (pos + lowestBit(available)) & mask;
+    }
+  }
+  // Unreachable, the load factor keeps free slots around
+  abort();
+}
+
+// Stores an entry in a free slot found by findInsertIndex
+static void placeAt(HashSlots *ht, size_t index, struct StoreEntry *entry) {
+  if (ht->ctrl[index] == CTRL_DELETED) {
+    ht->deleted--;
+  } else {
+    ht->growthLeft--;
+  }
+  setCtrl(ht, index, H2(entry->hash));
+  ht->slots[index] = entry;
+  ht->used++;
+}
+
+// Empties a full slot
+static void clearSlot(HashSlots *ht, size_t index) {
+  size_t mask = ht->capacity - 1;
+
+  // The slot can go straight back to empty if no probe sequence ever had to
+  // step over it, i.e. no window of a full group around it was ever full
+  GroupMask emptyAfter = matchEmpty(ht->ctrl + index);
+  GroupMask emptyBefore =
+      matchEmpty(ht->ctrl + ((index - HT_GROUP_WIDTH) & mask));
+  int neverFull = emptyAfter && emptyBefore &&
+                  lowestBit(emptyAfter) +
+                          (HT_GROUP_WIDTH - 1 - highestBit(emptyBefore)) <
+                      HT_GROUP_WIDTH;
+
+  if (neverFull) {
+    setCtrl(ht, index, CTRL_EMPTY);
+    ht->growthLeft++;
+  } else {
+    setCtrl(ht, index, CTRL_DELETED);
+    ht->deleted++;
+  }
+  ht->used--;
+}
+
+int hashTableIsRehashing(const HashTable *table) {
+  return table->rehashIdx >= 0;
+}
+
+size_t hashTableSize(const HashTable *table) {
+  return table->ht[0].used + table->ht[1].used;
+}
+
+// Allocates ht[1], entries then move over incrementally
+static int startRehash(HashTable *table) {
+  // Grow, or keep the size and just purge tombstones when they are the
+  // reason the table ran out of room
+  size_t capacity = table->ht[0].capacity;
+  if (table->ht[0].used >= maxLoad(capacity) / 2) {
+    capacity *= 2;
+  }
+  if (initSlots(&table->ht[1], capacity) != 0) {
+    return -1;
+  }
+  table->rehashIdx = 0;
+  return 0;
+}
+
+int hashTableRehash(HashTable *table, size_t slots) {
+  if (table->rehashIdx < 0) {
+    return 0;
+  }
+
+  HashSlots *from = &table->ht[0];
+  size_t index = (size_t)table->rehashIdx;
+  while (slots-- > 0 && index < from->capacity && from->used > 0) {
+    if (!(from->ctrl[index] & 0x80)) {
+      struct StoreEntry *entry = from->slots[index];
+      // A tombstone keeps the probe sequences running through this slot
+      // intact for the entries that have not moved yet
+      setCtrl(from, index, CTRL_DELETED);
+      from->used--;
+      HashSlots *to = &table->ht[1];
+      placeAt(to, findInsertIndex(to, entry->hash), entry);
+    }
+    index++;
+  }
+  table->rehashIdx = (long)index;
+
+  if (index < from->capacity && from->used > 0) {
+    return 1;
+  }
+  releaseSlots(from);
+  table->ht[0] = table->ht[1];
+  memset(&table->ht[1], 0, sizeof(HashSlots));
+  table->rehashIdx = -1;
+  return 0;
+}
+
+// Slot array a new entry goes into
+static HashSlots *insertTarget(HashTable *table) {
+  return table->rehashIdx >= 0 ? &table->ht[1] : &table->ht[0];
+}
+
+struct StoreEntry *hashTableFind(HashTable *table, const char *key,
+                                 size_t keyLen, uint64_t hash) {
+  // Recent and migrated entries live in ht[1], look there first
+  for (int i = table->rehashIdx >= 0 ? 1 : 0; i >= 0; i--) {
+    HashSlots *ht = &table->ht[i];
+    long index = findIndex(ht, key, keyLen, hash);
+    if (index >= 0) {
+      return ht->slots[index];
+    }
+  }
+  return NULL;
+}
+
+int hashTableInsert(HashTable *table, struct StoreEntry *entry) {
+  hashTableRehash(table, HT_REHASH_STEP);
+
+  HashSlots *ht = insertTarget(table);
+  size_t index = findInsertIndex(ht, entry->hash);
+
+  if (ht->ctrl[index] == CTRL_EMPTY && ht->growthLeft == 0) {
+    // ht[1] is sized so that a resize completes long before it fills up,
+    // finish one anyway rather than resizing twice at once
+    hashTableRehash(table, SIZE_MAX);
+    if (startRehash(table) != 0) {
+      return -1;
+    }
+    hashTableRehash(table, HT_REHASH_STEP);
+    ht = insertTarget(table);
+    index = findInsertIndex(ht, entry->hash);
+  }
+
+  placeAt(ht, index, entry);
+  return 0;
+}
+
+int hashTableReplace(HashTable *table, struct StoreEntry *old,
+                     struct StoreEntry *entry) {
+  for (int i = table->rehashIdx >= 0 ? 1 : 0; i >= 0; i--) {
+    HashSlots *ht = &table->ht[i];
+    long index = findIndex(ht, old->key, old->keyLen, old->hash);
+    if (index >= 0) {
+      ht->slots[index] = entry;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+struct StoreEntry *hashTableRemove(HashTable *table, const char *key,
+                                   size_t keyLen, uint64_t hash) {
+  for (int i = table->rehashIdx >= 0 ? 1 : 0; i >= 0; i--) {
+    HashSlots *ht = &table->ht[i];
+    long index = findIndex(ht, key, keyLen, hash);
+    if (index >= 0) {
+      struct StoreEntry *entry = ht->slots[index];
+      clearSlot(ht, (size_t)index);
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+struct StoreEntry *hashTableNext(HashTable *table, size_t *pos) {
+  // Positions run through ht[0] and then through ht[1]
+  while (1) {
+    HashSlots *ht = &table->ht[0];
+    size_t index = *pos;
+    if (index >= ht->capacity) {
+      index -= ht->capacity;
+      ht = &table->ht[1];
+      if (index >= ht->capacity) {
+        return NULL;
+      }
+    }
+    (*pos)++;
+    if (!(ht->ctrl[index] & 0x80)) {
+      return ht->slots[index];
+    }
+  }
+}
+
+void hashTableClear(HashTable *table) {
+  if (table->rehashIdx >= 0) {
+    releaseSlots(&table->ht[0]);
+    table->ht[0] = table->ht[1];
+    memset(&table->ht[1], 0, sizeof(HashSlots));
+    table->rehashIdx = -1;
+  }
+
+  HashSlots *ht = &table->ht[0];
+  memset(ht->ctrl, CTRL_EMPTY, ht->capacity + HT_GROUP_WIDTH);
+  ht->used = 0;
+  ht->deleted = 0;
+  ht->growthLeft = maxLoad(ht->capacity);
+}
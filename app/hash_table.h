@@ -0,0 +1,141 @@
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HT_GROUP_WIDTH 16   /* Control bytes probed together */
+#define HT_MIN_CAPACITY 16  /* Smallest table, at least one full group */
+#define HT_REHASH_STEP 16   /* Slots migrated by each insert while rehashing */
+
+struct StoreEntry;
+
+/**
+ * One open-addressing slot array in the style of a Swiss table.
+ *
+ * Every slot has a control byte that is either empty, deleted, or a 7-bit
+ * fingerprint of the hash of the entry it holds. Lookups compare a whole
+ * group of 16 control bytes against the fingerprint at once (SSE2 when
+ * available) and only touch the entries whose fingerprint matches, so a miss
+ * rarely dereferences an entry at all. The capacity is a power of two and
+ * slots are located by masking, never by division.
+ */
+typedef struct HashSlots {
+  uint8_t *ctrl;              /* capacity + HT_GROUP_WIDTH control bytes */
+  struct StoreEntry **slots;  /* Entry for each full control byte */
+  size_t capacity;            /* Number of slots, a power of two */
+  size_t used;                /* Live entries */
+  size_t deleted;             /* Tombstones left by removals */
+  size_t growthLeft;          /* Inserts into empty slots before resizing */
+} HashSlots;
+
+/**
+ * Keyspace index made of up to two slot arrays.
+ *
+ * Resizing never rebuilds the table in one go. A resize allocates ht[1] and
+ * entries then migrate from ht[0] a few slots at a time, on every insert and
+ * from hashTableRehash, while lookups and removals consult both arrays. Once
+ * ht[0] is drained ht[1] takes its place.
+ *
+ * The table indexes StoreEntry pointers using their cached hash and key, it
+ * does not own the entries.
+ */
+typedef struct HashTable {
+  HashSlots ht[2]; /* ht[1] is only allocated while rehashing */
+  long rehashIdx;  /* Next ht[0] slot to migrate, -1 when not rehashing */
+} HashTable;
+
+/**
+ * Creates an empty table
+ * @param capacity Minimum number of slots, rounded up to a power of two
+ * @return Newly allocated HashTable or NULL on failure
+ */
+HashTable *createHashTable(size_t capacity);
+
+/**
+ * Frees the table. The indexed entries are not freed.
+ * @param table Table to free
+ */
+void freeHashTable(HashTable *table);
+
+/**
+ * Looks up the entry for a key
+ * @param table Table to search
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param hash Hash of the key, as cached in StoreEntry.hash
+ * @return Matching entry or NULL
+ */
+struct StoreEntry *hashTableFind(HashTable *table, const char *key,
+                                 size_t keyLen, uint64_t hash);
+
+/**
+ * Adds an entry whose key is not in the table yet. Starts a resize when the
+ * table is full and advances a resize in progress by HT_REHASH_STEP slots.
+ * @param table Table to insert into
+ * @param entry Entry with its hash set
+ * @return 0 on success, -1 on allocation failure
+ */
+int hashTableInsert(HashTable *table, struct StoreEntry *entry);
+
+/**
+ * Swaps the entry indexed for a key for another one with the same key, in
+ * place, e.g. after the entry was reallocated
+ * @param table Table to update
+ * @param old Entry currently indexed
+ * @param entry Replacement with the same key and hash
+ * @return 0 on success, -1 if old is not in the table
+ */
+int hashTableReplace(HashTable *table, struct StoreEntry *old,
+                     struct StoreEntry *entry);
+
+/**
+ * Removes the entry for a key
+ * @param table Table to remove from
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param hash Hash of the key
+ * @return The removed entry, which the caller frees, or NULL if absent
+ */
+struct StoreEntry *hashTableRemove(HashTable *table, const char *key,
+                                   size_t keyLen, uint64_t hash);
+
+/**
+ * Iterates over the live entries. Start with *pos = 0 and call until NULL is
+ * returned. Removing the returned entry during iteration is allowed,
+ * inserting or rehashing is not.
+ * @param table Table to iterate
+ * @param pos Iteration cursor
+ * @return Next entry or NULL when done
+ */
+struct StoreEntry *hashTableNext(HashTable *table, size_t *pos);
+
+/**
+ * Removes every entry without freeing them, keeping the capacity
+ * @param table Table to clear
+ */
+void hashTableClear(HashTable *table);
+
+/**
+ * Migrates up to the given number of ht[0] slots into ht[1]
+ * @param table Table to rehash
+ * @param slots Number of slots to visit
+ * @return 1 if the resize is still in progress, 0 once it is complete
+ */
+int hashTableRehash(HashTable *table, size_t slots);
+
+/**
+ * Reports whether a resize is in progress
+ * @param table Table to check
+ * @return 1 while rehashing, 0 otherwise
+ */
+int hashTableIsRehashing(const HashTable *table);
+
+/**
+ * Counts the live entries across both slot arrays
+ * @param table Table to count
+ * @return Number of entries
+ */
+size_t hashTableSize(const HashTable *table);
+
+#endif
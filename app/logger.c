@@ -1,4 +1,5 @@
 #include "logger.h"
+#include "clock.h"
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -9,6 +10,11 @@ static FILE *log_file = NULL;
 static LogLevel current_level = LOG_INFO;
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// Formatted once per second and reused by every line logged within it,
+// guarded by log_mutex
+static time_t timestamp_second = -1;
+static char timestamp[20];
+
 static const char *level_strings[] = {"TRACE", "DEBUG", "INFO",
                                       "WARN",  "ERROR", "FATAL"};
 
@@ -35,10 +41,13 @@ void logger_log(LogLevel level, const char *file, int line, const char *fmt,
 
   pthread_mutex_lock(&log_mutex);
 
-  time_t t = time(NULL);
-  struct tm *lt = localtime(&t);
-  char timestamp[20];
-  strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", lt);
+  time_t t = (time_t)(clockNowMs() / 1000);
+  if (t != timestamp_second) {
+    struct tm lt;
+    localtime_r(&t, &lt);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &lt);
+    timestamp_second = t;
+  }
 
   // Write to stdout with colors
   printf("%s%s %-5s\x1b[0m \x1b[90m%s:%d:\x1b[0m ", level_colors[level],
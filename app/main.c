@@ -1,23 +1,21 @@
-#include "client_handler.h"
 #include "config.h"
+#include "event_loop.h"
 #include "logger.h"
 #include "networking.h"
 #include "server.h"
-#include "thread_pool.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
 
-static volatile int g_running = 1;
-static ThreadPool *g_pool = NULL;
+static ReactorGroup *g_reactors = NULL;
 static RedisServer *g_server = NULL;
 static ServerConfig *g_config = NULL;
 
 void cleanup_resources(void) {
-  if (g_pool) {
-    threadPoolDestroy(g_pool);
-    g_pool = NULL;
+  if (g_reactors) {
+    freeReactorGroup(g_reactors);
+    g_reactors = NULL;
   }
   if (g_server) {
     freeServer(g_server);
@@ -31,7 +29,6 @@ void cleanup_resources(void) {
 }
 
 void signal_handler(int sig) {
-  g_running = 0;
   cleanup_resources();
   exit(0);
 }
@@ -42,6 +39,8 @@ int main(int argc, char **argv) {
 
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
+  // Writes to a closed client surface as EPIPE instead of killing the server
+  signal(SIGPIPE, SIG_IGN);
 
   g_config = parseConfig(argc, argv);
   if (!g_config) {
@@ -66,35 +65,20 @@ int main(int argc, char **argv) {
   logger_init("app.log", LOG_TRACE);
 
   int num_cores = sysconf(_SC_NPROCESSORS_ONLN);
-  g_pool = createThreadPool(8);
-  if (!g_pool) {
-    fprintf(stderr, "Failed to create thread pool\n");
+
+  // Every client, blocked ones included, is served by the reactors
+  g_reactors = createReactorGroup(g_server, g_config->io_threads);
+  if (!g_reactors) {
+    fprintf(stderr, "Failed to create reactors\n");
     cleanup_resources();
     return 1;
   }
 
-  printf("Redis server listening on port %d with %d worker threads\n",
-         g_server->port, num_cores);
+  printf("Redis server listening on port %d with %d reactor threads (%d "
+         "cores)\n",
+         g_server->port, g_reactors->count, num_cores);
 
-  while (g_running) {
-    int clientFd = acceptClient(g_server);
-    LOG_TRACE("Client FD %d ", clientFd);
-    if (clientFd >= 0) {
-      ClientHandlerArg *arg = malloc(sizeof(ClientHandlerArg));
-      if (!arg) {
-        LOG_ERROR("Failed to allocate memory for client handler arg");
-        close(clientFd);
-        continue;
-      }
-      arg->server = g_server;
-      arg->clientFd = clientFd;
-      if (threadPoolAdd(g_pool, handleClientConnection, arg) != 0) {
-        LOG_ERROR("Failed to add client to thread pool");
-        free(arg);
-        close(clientFd);
-      }
-    }
-  }
+  runReactorGroup(g_reactors);
 
   cleanup_resources();
   return 0;
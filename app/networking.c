@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-int initServerSocket(RedisServer *server) {
+int createListeningSocket(const char *bindaddr, int port, int backlog) {
   int server_fd;
   struct sockaddr_in server_addr;
 
@@ -23,12 +23,21 @@ int initServerSocket(RedisServer *server) {
     return -1;
   }
 
+  // Set SO_REUSEPORT so every reactor can bind its own listening socket and
+  // let the kernel spread incoming connections across them
+  if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) <
+      0) {
+    fprintf(stderr, "setsockopt SO_REUSEPORT failed: %s\n", strerror(errno));
+    close(server_fd);
+    return -1;
+  }
+
   // Prepare server address structure
   memset(&server_addr, 0, sizeof(server_addr));
   server_addr.sin_family = AF_INET;
-  server_addr.sin_port = htons(server->port);
+  server_addr.sin_port = htons(port);
 
-  if (inet_pton(AF_INET, server->bindaddr, &server_addr.sin_addr) <= 0) {
+  if (inet_pton(AF_INET, bindaddr, &server_addr.sin_addr) <= 0) {
     fprintf(stderr, "Invalid address: %s\n", strerror(errno));
     close(server_fd);
     return -1;
@@ -43,22 +52,36 @@ int initServerSocket(RedisServer *server) {
   }
 
   // Listen for connections
-  if (listen(server_fd, server->tcp_backlog) < 0) {
+  if (listen(server_fd, backlog) < 0) {
     fprintf(stderr, "Listen failed: %s\n", strerror(errno));
     close(server_fd);
     return -1;
   }
 
+  return server_fd;
+}
+
+int initServerSocket(RedisServer *server) {
+  int server_fd =
+      createListeningSocket(server->bindaddr, server->port, server->tcp_backlog);
+  if (server_fd < 0) {
+    return -1;
+  }
+
   server->fd = server_fd;
   return 0;
 }
 
 int acceptClient(RedisServer *server) {
+  return acceptClientOn(server->fd);
+}
+
+int acceptClientOn(int listen_fd) {
   struct sockaddr_in client_addr;
   socklen_t client_len = sizeof(client_addr);
 
   int client_fd =
-      accept(server->fd, (struct sockaddr *)&client_addr, &client_len);
+      accept(listen_fd, (struct sockaddr *)&client_addr, &client_len);
   if (client_fd < 0) {
     if (errno != EAGAIN && errno != EWOULDBLOCK) {
       fprintf(stderr, "Accept failed: %s\n", strerror(errno));
@@ -12,8 +12,10 @@
 #define REGULAR_BUFFER_SIZE 1024
 
 // Networking setup
+int createListeningSocket(const char *bindaddr, int port, int backlog);
 int initServerSocket(RedisServer *server);
 int acceptClient(RedisServer *server);
+int acceptClientOn(int listen_fd);
 void closeClientConnection(RedisServer *server, int client_fd);
 
 // Protocol handling
@@ -0,0 +1,216 @@
+#include "output_buffer.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+static OutputChunk *createChunk(size_t minSize) {
+  size_t size = minSize > OUTPUT_CHUNK_SIZE ? minSize : OUTPUT_CHUNK_SIZE;
+  OutputChunk *chunk = malloc(sizeof(OutputChunk) + size);
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  chunk->sent = 0;
+  chunk->shared = NULL;
+  return chunk;
+}
+
+static void freeChunk(OutputChunk *chunk) {
+  releaseSharedValue(chunk->shared);
+  free(chunk);
+}
+
+static inline const char *chunkData(const OutputChunk *chunk) {
+  return chunk->shared ? chunk->shared->data : chunk->data;
+}
+
+OutputBuffer *createOutputBuffer(void) {
+  OutputBuffer *out = malloc(sizeof(OutputBuffer));
+  if (!out) {
+    return NULL;
+  }
+  out->head = NULL;
+  out->tail = NULL;
+  out->pending = 0;
+  return out;
+}
+
+void resetOutputBuffer(OutputBuffer *out) {
+  OutputChunk *chunk = out->head;
+  while (chunk) {
+    OutputChunk *next = chunk->next;
+    freeChunk(chunk);
+    chunk = next;
+  }
+  out->head = NULL;
+  out->tail = NULL;
+  out->pending = 0;
+}
+
+void freeOutputBuffer(OutputBuffer *out) {
+  if (!out) {
+    return;
+  }
+  resetOutputBuffer(out);
+  free(out);
+}
+
+int outputBufferAppend(OutputBuffer *out, const char *data, size_t len) {
+  if (len == 0) {
+    return OUTPUT_OK;
+  }
+
+  // A referenced chunk has no spare room, size == used
+  OutputChunk *tail = out->tail;
+  if (tail && tail->size - tail->used >= len) {
+    memcpy(tail->data + tail->used, data, len);
+    tail->used += len;
+    out->pending += len;
+    return OUTPUT_OK;
+  }
+
+  // Fill what is left of the tail before starting a new chunk
+  size_t copied = 0;
+  if (tail && !tail->shared) {
+    copied = tail->size - tail->used;
+    memcpy(tail->data + tail->used, data, copied);
+    tail->used += copied;
+  }
+
+  OutputChunk *chunk = createChunk(len - copied);
+  if (!chunk) {
+    if (tail) {
+      tail->used -= copied;
+    }
+    return OUTPUT_ERR;
+  }
+  memcpy(chunk->data, data + copied, len - copied);
+  chunk->used = len - copied;
+
+  if (tail) {
+    tail->next = chunk;
+  } else {
+    out->head = chunk;
+  }
+  out->tail = chunk;
+  out->pending += len;
+  return OUTPUT_OK;
+}
+
+int outputBufferAppendShared(OutputBuffer *out, SharedValue *value) {
+  if (value->len < SHARED_VALUE_MIN_REF) {
+    return outputBufferAppend(out, value->data, value->len);
+  }
+
+  OutputChunk *chunk = malloc(sizeof(OutputChunk));
+  if (!chunk) {
+    return OUTPUT_ERR;
+  }
+  chunk->next = NULL;
+  chunk->size = value->len;
+  chunk->used = value->len;
+  chunk->sent = 0;
+  chunk->shared = retainSharedValue(value);
+
+  if (out->tail) {
+    out->tail->next = chunk;
+  } else {
+    out->head = chunk;
+  }
+  out->tail = chunk;
+  out->pending += value->len;
+  return OUTPUT_OK;
+}
+
+int flushOutputBuffer(OutputBuffer *out, int fd) {
+  while (out->pending > 0) {
+    struct iovec iov[OUTPUT_MAX_IOV];
+    int iovcnt = 0;
+
+    for (OutputChunk *chunk = out->head; chunk && iovcnt < OUTPUT_MAX_IOV;
+         chunk = chunk->next) {
+      if (chunk->used == chunk->sent) {
+        continue;
+      }
+      iov[iovcnt].iov_base = (char *)chunkData(chunk) + chunk->sent;
+      iov[iovcnt].iov_len = chunk->used - chunk->sent;
+      iovcnt++;
+    }
+
+    ssize_t written = writev(fd, iov, iovcnt);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return OUTPUT_PENDING;
+      }
+      return OUTPUT_ERR;
+    }
+
+    out->pending -= written;
+
+    // Release fully written chunks, keep the tail around for reuse
+    size_t remaining = written;
+    while (out->head) {
+      OutputChunk *chunk = out->head;
+      size_t unsent = chunk->used - chunk->sent;
+      if (remaining < unsent) {
+        chunk->sent += remaining;
+        break;
+      }
+      remaining -= unsent;
+      if (chunk == out->tail && chunk->size == OUTPUT_CHUNK_SIZE &&
+          !chunk->shared) {
+        chunk->used = 0;
+        chunk->sent = 0;
+        break;
+      }
+      out->head = chunk->next;
+      if (chunk == out->tail) {
+        out->tail = NULL;
+      }
+      freeChunk(chunk);
+    }
+  }
+
+  return OUTPUT_OK;
+}
+
+ssize_t writeOutputBuffer(const OutputBuffer *out, int fd) {
+  struct iovec iov[OUTPUT_MAX_IOV];
+  int iovcnt = 0;
+  for (OutputChunk *chunk = out->head; chunk && iovcnt < OUTPUT_MAX_IOV;
+       chunk = chunk->next) {
+    if (chunk->used == chunk->sent) {
+      continue;
+    }
+    iov[iovcnt].iov_base = (char *)chunkData(chunk) + chunk->sent;
+    iov[iovcnt].iov_len = chunk->used - chunk->sent;
+    iovcnt++;
+  }
+  return iovcnt > 0 ? writev(fd, iov, iovcnt) : 0;
+}
+
+char *flattenOutputBuffer(const OutputBuffer *out, size_t *len) {
+  char *data = malloc(out->pending + 1);
+  if (!data) {
+    return NULL;
+  }
+
+  size_t offset = 0;
+  for (OutputChunk *chunk = out->head; chunk; chunk = chunk->next) {
+    size_t unsent = chunk->used - chunk->sent;
+    memcpy(data + offset, chunkData(chunk) + chunk->sent, unsent);
+    offset += unsent;
+  }
+  data[offset] = '\0';
+
+  if (len) {
+    *len = offset;
+  }
+  return data;
+}
@@ -0,0 +1,106 @@
+#ifndef OUTPUT_BUFFER_H
+#define OUTPUT_BUFFER_H
+
+#include "shared_value.h"
+#include <stddef.h>
+#include <sys/types.h>
+
+/* Output buffer status codes */
+#define OUTPUT_OK 0       /* Everything queued has been written */
+#define OUTPUT_ERR -1     /* Write failed, connection should be closed */
+#define OUTPUT_PENDING 1  /* Socket is full, data remains queued */
+
+#define OUTPUT_CHUNK_SIZE 16384 /* Minimum chunk allocation */
+#define OUTPUT_MAX_IOV 64       /* Chunks handed to a single writev */
+
+/* Above the soft limit the client stops being read until the buffer drains,
+ * above the hard limit the client is disconnected */
+#define OUTPUT_SOFT_LIMIT (8 * 1024 * 1024)
+#define OUTPUT_HARD_LIMIT (256 * 1024 * 1024)
+
+/**
+ * A contiguous block of queued reply bytes, either owned by the chunk or
+ * borrowed from a shared value
+ */
+typedef struct OutputChunk {
+  struct OutputChunk *next;
+  size_t size; /* Capacity of data */
+  size_t used; /* Bytes appended */
+  size_t sent; /* Bytes already written to the socket */
+  SharedValue *shared; /* Referenced bytes used instead of data, or NULL */
+  char data[];
+} OutputChunk;
+
+/**
+ * Per-client queue of reply bytes waiting to be written
+ */
+typedef struct OutputBuffer {
+  OutputChunk *head;
+  OutputChunk *tail;
+  size_t pending; /* Bytes queued but not yet written */
+} OutputBuffer;
+
+/**
+ * Creates an empty output buffer
+ * @return Newly allocated OutputBuffer or NULL on failure
+ */
+OutputBuffer *createOutputBuffer(void);
+
+/**
+ * Frees an output buffer and any unsent data
+ * @param out Buffer to free
+ */
+void freeOutputBuffer(OutputBuffer *out);
+
+/**
+ * Queues bytes at the end of the buffer
+ * @param out Buffer to append to
+ * @param data Data to append
+ * @param len Length of data
+ * @return OUTPUT_OK on success, OUTPUT_ERR on allocation failure
+ */
+int outputBufferAppend(OutputBuffer *out, const char *data, size_t len);
+
+/**
+ * Queues a shared value's bytes. Values of at least SHARED_VALUE_MIN_REF
+ * bytes are referenced rather than copied and written straight from the
+ * value; smaller ones are copied like outputBufferAppend.
+ * @param out Buffer to append to
+ * @param value Value to queue, the buffer takes its own reference
+ * @return OUTPUT_OK on success, OUTPUT_ERR on allocation failure
+ */
+int outputBufferAppendShared(OutputBuffer *out, SharedValue *value);
+
+/**
+ * Writes as much queued data as the socket accepts using writev
+ * @param out Buffer to flush
+ * @param fd Non-blocking socket to write to
+ * @return OUTPUT_OK when drained, OUTPUT_PENDING if the socket filled up,
+ * OUTPUT_ERR on write failure
+ */
+int flushOutputBuffer(OutputBuffer *out, int fd);
+
+/**
+ * Writes the unsent data with a single writev without consuming it, so one
+ * buffer can be sent to several sockets
+ * @param out Buffer to write
+ * @param fd Socket to write to
+ * @return Bytes written or -1 on failure
+ */
+ssize_t writeOutputBuffer(const OutputBuffer *out, int fd);
+
+/**
+ * Copies the unsent data into one contiguous NUL-terminated string
+ * @param out Buffer to copy from
+ * @param len Optional pointer to store the data length
+ * @return Newly allocated string or NULL on allocation failure
+ */
+char *flattenOutputBuffer(const OutputBuffer *out, size_t *len);
+
+/**
+ * Discards all queued data
+ * @param out Buffer to reset
+ */
+void resetOutputBuffer(OutputBuffer *out);
+
+#endif
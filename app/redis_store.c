@@ -1,287 +1,904 @@
 #include "redis_store.h"
+#include "clock.h"
+#include "slab.h"
 #include "stream.h"
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 
-#define LOAD_FACTOR_THRESHOLD 0.75
-
-static uint64_t hash(const char *key) {
+static uint64_t hash(const char *key, size_t keyLen) {
   uint64_t hash = 5381;
-  int c;
-  while ((c = *key++)) {
-    hash = ((hash << 5) + hash) + c;
+  for (size_t i = 0; i < keyLen; i++) {
+    hash = ((hash << 5) + hash) + (unsigned char)key[i];
   }
+  // Finalize so that both the low bits (fingerprint) and the high bits
+  // (slot) used by the hash table depend on every key byte
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
   return hash;
 }
 
+uint64_t storeKeyHash(const char *key, size_t keyLen) {
+  return hash(key, keyLen);
+}
+
 RedisStore *createStore(void) {
+  return createShardedStore(STORE_DEFAULT_SHARDS);
+}
+
+static RedisStore *allocStore(size_t shards, int locked) {
+  size_t count = 1;
+  while (count < shards && count < STORE_MAX_SHARDS) {
+    count *= 2;
+  }
+
   RedisStore *store = malloc(sizeof(RedisStore));
   if (!store) {
     return NULL;
   }
-  store->size = INITIAL_STORE_SIZE;
-  store->used = 0;
-  store->table = calloc(store->size, sizeof(StoreEntry *));
-  if (!store->table) {
+  if (posix_memalign((void **)&store->shards, STORE_SHARD_ALIGN,
+                     count * sizeof(StoreShard)) != 0) {
     free(store);
     return NULL;
   }
-  if (pthread_rwlock_init(&store->rwlock, NULL) != 0) {
-    free(store->table);
-    free(store);
-    return NULL;
+  store->shardCount = 0;
+  store->expireCursor = 0;
+  store->expiredKeys = 0;
+
+  for (size_t i = 0; i < count; i++) {
+    StoreShard *shard = &store->shards[i];
+    shard->table = createHashTable(INITIAL_STORE_SIZE);
+    if (!shard->table) {
+      freeStore(store);
+      return NULL;
+    }
+    timerWheelInit(&shard->expiring, getCurrentTimeMs());
+    if (pthread_rwlock_init(&shard->rwlock, NULL) != 0) {
+      freeHashTable(shard->table);
+      freeStore(store);
+      return NULL;
+    }
+    if (pthread_mutex_init(&shard->writeOrder, NULL) != 0) {
+      pthread_rwlock_destroy(&shard->rwlock);
+      freeHashTable(shard->table);
+      freeStore(store);
+      return NULL;
+    }
+    shard->locked = locked;
+    store->shardCount = i + 1;
   }
   return store;
 }
 
+RedisStore *createShardedStore(size_t shards) { return allocStore(shards, 1); }
+
+RedisStore *createOwnedStore(void) { return allocStore(1, 0); }
+
+// A store owned by a single thread has nothing to exclude, its shard skips
+// the lock calls altogether
+static inline void shardReadLock(StoreShard *shard) {
+  if (shard->locked) {
+    pthread_rwlock_rdlock(&shard->rwlock);
+  }
+}
+
+static inline void shardWriteLock(StoreShard *shard) {
+  if (shard->locked) {
+    pthread_rwlock_wrlock(&shard->rwlock);
+  }
+}
+
+static inline void shardUnlock(StoreShard *shard) {
+  if (shard->locked) {
+    pthread_rwlock_unlock(&shard->rwlock);
+  }
+}
+
+// The top hash bits pick the shard, the hash table probes with the low ones
+static inline StoreShard *shardFor(RedisStore *store, uint64_t hashVal) {
+  return &store->shards[(hashVal >> 54) & (store->shardCount - 1)];
+}
+
+StoreShard *storeLockWrites(RedisStore *store, const char *key,
+                            size_t keyLen) {
+  StoreShard *shard = shardFor(store, hash(key, keyLen));
+  if (!shard->locked) {
+    return NULL;
+  }
+  pthread_mutex_lock(&shard->writeOrder);
+  return shard;
+}
+
+void storeUnlockWrites(StoreShard *shard) {
+  if (shard) {
+    pthread_mutex_unlock(&shard->writeOrder);
+  }
+}
+
 static void freeEntry(StoreEntry *entry) {
-  free(entry->key);
-  if (entry->type == TYPE_STRING) {
-    free(entry->value.string.data);
+  if (entry->type == TYPE_STRING && entry->encoding == ENCODING_SHARED) {
+    releaseSharedValue(entry->value.string);
   } else if (entry->type == TYPE_STREAM) {
     freeStream(entry->value.stream);
   }
-  free(entry);
+  slabFree(entry);
 }
 
-static void resize(RedisStore *store) {
-  size_t newSize = store->size * 2;
-  StoreEntry **newTable = calloc(newSize, sizeof(StoreEntry *));
+// Embedded values live right after the key and its NUL
+static inline char *entryValue(StoreEntry *entry) {
+  return entry->key + entry->keyLen + 1;
+}
 
-  for (size_t i = 0; i < store->size; i++) {
-    StoreEntry *entry = store->table[i];
-    while (entry) {
-      StoreEntry *next = entry->next;
-      uint64_t hashVal = hash(entry->key) % newSize;
-      entry->next = newTable[hashVal];
-      newTable[hashVal] = entry;
-      entry = next;
-    }
+// Bytes available for an embedded value and its NUL, including class slack
+static size_t embedRoom(StoreEntry *entry) {
+  return slabUsableSize(entry) - sizeof(StoreEntry) - entry->keyLen - 1;
+}
+
+// Only reads the clock for keys that have a TTL
+static inline int isExpired(const StoreEntry *entry) {
+  return entry->timer.when && entry->timer.when <= getCurrentTimeMs();
+}
+
+// Removes an entry from the keyspace and the expiry index without freeing it
+static void unlinkEntry(StoreShard *shard, StoreEntry *entry) {
+  hashTableRemove(shard->table, entry->key, entry->keyLen, entry->hash);
+  if (entry->timer.pprev) {
+    timerWheelRemove(&shard->expiring, &entry->timer);
   }
+}
 
-  free(store->table);
-  store->table = newTable;
-  store->size = newSize;
+// Schedules, moves or cancels the TTL of an entry in a write locked shard
+static void setTimerLocked(StoreShard *shard, StoreEntry *entry,
+                           time_t expiry) {
+  if (entry->timer.pprev) {
+    timerWheelRemove(&shard->expiring, &entry->timer);
+  }
+  entry->timer.when = expiry;
+  if (expiry) {
+    timerWheelAdd(&shard->expiring, &entry->timer, expiry);
+  }
 }
 
-int storeSet(RedisStore *store, const char *key, void *value, size_t valueLen) {
-  if (!store || !key || !value) {
-    return STORE_ERR;
+// Unlinks and frees an entry whose TTL has passed, with the shard write
+// locked, so callers see the key as missing. Returns the entry if live.
+static StoreEntry *expireIfNeeded(RedisStore *store, StoreShard *shard,
+                                  StoreEntry *entry) {
+  if (entry && isExpired(entry)) {
+    unlinkEntry(shard, entry);
+    freeEntry(entry);
+    __atomic_add_fetch(&store->expiredKeys, 1, __ATOMIC_RELAXED);
+    return NULL;
   }
+  return entry;
+}
 
-  pthread_rwlock_wrlock(&store->rwlock);
+// Looks a key up with the shard read locked. An expired entry is deleted
+// on the spot by trading the read lock for the write lock and back, so a
+// hot expired key is not found, and paid for, again on every access.
+// Returns the live entry or NULL, with the shard read locked either way.
+static StoreEntry *findLiveLocked(RedisStore *store, StoreShard *shard,
+                                  const char *key, size_t keyLen,
+                                  uint64_t hashVal) {
+  StoreEntry *entry = hashTableFind(shard->table, key, keyLen, hashVal);
+  if (!entry || !isExpired(entry)) {
+    return entry;
+  }
+  shardUnlock(shard);
+  shardWriteLock(shard);
+  // Another thread may have replaced or deleted the key in between
+  expireIfNeeded(store, shard,
+                 hashTableFind(shard->table, key, keyLen, hashVal));
+  shardUnlock(shard);
+  shardReadLock(shard);
+  return NULL;
+}
 
-  if ((float)store->used / store->size > LOAD_FACTOR_THRESHOLD) {
-    resize(store);
+// Creates an unindexed entry with room for an embedded value of room bytes
+static StoreEntry *createEntry(const char *key, size_t keyLen,
+                               uint64_t hashVal, size_t room) {
+  if (keyLen > UINT32_MAX) {
+    return NULL;
   }
+  StoreEntry *entry = slabAlloc(sizeof(StoreEntry) + keyLen + 1 + room);
+  if (!entry) {
+    return NULL;
+  }
+  memcpy(entry->key, key, keyLen);
+  entry->key[keyLen] = '\0';
+  entry->keyLen = keyLen;
+  entry->hash = hashVal;
+  entry->type = TYPE_NONE;
+  entry->encoding = ENCODING_SHARED;
+  entry->timer = (TimerNode){NULL, NULL, 0};
+  return entry;
+}
 
-  uint64_t hashVal = hash(key) % store->size;
-  StoreEntry *entry = store->table[hashVal];
+// Creates an entry for a key known to be absent and indexes it
+static StoreEntry *addEntry(StoreShard *shard, const char *key, size_t keyLen,
+                            uint64_t hashVal, size_t room) {
+  StoreEntry *entry = createEntry(key, keyLen, hashVal, room);
+  if (!entry) {
+    return NULL;
+  }
+  if (hashTableInsert(shard->table, entry) != 0) {
+    slabFree(entry);
+    return NULL;
+  }
+  return entry;
+}
 
-  while (entry) {
-    if (strcmp(entry->key, key) == 0) {
-      if (entry->type == TYPE_STRING) {
-        free(entry->value.string.data);
-      } else if (entry->type == TYPE_STREAM) {
-        freeStream(entry->value.stream);
-      }
-      entry->type = TYPE_STRING;
-      entry->value.string.data = malloc(valueLen);
-      if (!entry->value.string.data) {
-        pthread_rwlock_unlock(&store->rwlock);
-        return STORE_ERR;
-      }
-      memcpy(entry->value.string.data, value, valueLen);
-      entry->value.string.len = valueLen;
-      pthread_rwlock_unlock(&store->rwlock);
-      return STORE_OK;
+// Recognizes values that round-trip through a long long, e.g. "42" or "-7"
+// but not "007", "+1" or " 1"
+static int parseCanonicalInteger(const char *value, size_t len,
+                                 long long *integer) {
+  char buf[STORE_INT_BUF];
+  if (len == 0 || len >= sizeof(buf)) {
+    return 0;
+  }
+  memcpy(buf, value, len);
+  buf[len] = '\0';
+
+  char *end;
+  errno = 0;
+  long long parsed = strtoll(buf, &end, 10);
+  if (errno != 0 || end != buf + len) {
+    return 0;
+  }
+  char canonical[STORE_INT_BUF];
+  if ((size_t)snprintf(canonical, sizeof(canonical), "%lld", parsed) != len ||
+      memcmp(canonical, value, len) != 0) {
+    return 0;
+  }
+  *integer = parsed;
+  return 1;
+}
+
+// Points at the bytes of a string entry, formatting integers into buf
+static const char *stringBytes(StoreEntry *entry, char *buf, size_t *len) {
+  switch (entry->encoding) {
+  case ENCODING_INT:
+    *len = snprintf(buf, STORE_INT_BUF, "%lld", entry->value.integer);
+    return buf;
+  case ENCODING_EMBED:
+    *len = entry->value.embeddedLen;
+    return entryValue(entry);
+  default:
+    *len = entry->value.string->len;
+    return entry->value.string->data;
+  }
+}
+
+static inline int isString(StoreEntry *entry) {
+  return entry && entry->type == TYPE_STRING;
+}
+
+// A string value prepared for storing in its most compact encoding
+typedef struct EncodedValue {
+  ValueEncoding encoding;
+  const char *bytes;   /* ENCODING_EMBED */
+  size_t len;          /* ENCODING_EMBED */
+  long long integer;   /* ENCODING_INT */
+  SharedValue *shared; /* ENCODING_SHARED, a reference the value owns */
+} EncodedValue;
+
+// Picks the encoding for value. shared, if given, holds the same bytes and
+// is referenced instead of copied when the value is too long to embed.
+static int encodeValue(const char *value, size_t len, SharedValue *shared,
+                       EncodedValue *out) {
+  out->bytes = value;
+  out->len = len;
+  out->shared = NULL;
+  if (parseCanonicalInteger(value, len, &out->integer)) {
+    out->encoding = ENCODING_INT;
+  } else if (len <= STORE_EMBED_MAX) {
+    out->encoding = ENCODING_EMBED;
+  } else {
+    out->encoding = ENCODING_SHARED;
+    out->shared = shared ? retainSharedValue(shared)
+                         : createSharedValue(value, len);
+    if (!out->shared) {
+      return STORE_ERR;
     }
-    entry = entry->next;
   }
+  return STORE_OK;
+}
+
+// Installs an encoded value for a key with the shard write locked, creating
+// the entry or growing it as needed. entry is the key's current entry or
+// NULL. The previous shared value, if any, is handed back in *old so it can
+// be released after unlocking.
+static int putValueLocked(StoreShard *shard, StoreEntry *entry,
+                          const char *key, size_t keyLen, uint64_t hashVal,
+                          EncodedValue *value, SharedValue **old) {
+  size_t room = value->encoding == ENCODING_EMBED ? value->len + 1 : 0;
+  *old = NULL;
 
-  entry = malloc(sizeof(StoreEntry));
   if (!entry) {
-    pthread_rwlock_unlock(&store->rwlock);
+    entry = addEntry(shard, key, keyLen, hashVal, room);
+    if (!entry) {
+      releaseSharedValue(value->shared);
+      return STORE_ERR;
+    }
+  } else if (room > embedRoom(entry)) {
+    // The value outgrew the entry, move the key into a bigger one
+    StoreEntry *grown = createEntry(key, keyLen, hashVal, room);
+    if (!grown) {
+      return STORE_ERR;
+    }
+    grown->type = entry->type;
+    grown->encoding = entry->encoding;
+    grown->value = entry->value;
+    hashTableReplace(shard->table, entry, grown);
+    if (entry->timer.pprev) {
+      timerWheelReplace(&entry->timer, &grown->timer);
+    }
+    slabFree(entry);
+    entry = grown;
+  }
+
+  // Readers holding the old value keep it, only the store's reference goes
+  if (entry->type == TYPE_STRING && entry->encoding == ENCODING_SHARED) {
+    *old = entry->value.string;
+  } else if (entry->type == TYPE_STREAM) {
+    freeStream(entry->value.stream);
+  }
+
+  entry->type = TYPE_STRING;
+  entry->encoding = value->encoding;
+  switch (value->encoding) {
+  case ENCODING_INT:
+    entry->value.integer = value->integer;
+    break;
+  case ENCODING_EMBED:
+    memcpy(entryValue(entry), value->bytes, value->len);
+    entryValue(entry)[value->len] = '\0';
+    entry->value.embeddedLen = value->len;
+    break;
+  case ENCODING_SHARED:
+    entry->value.string = value->shared;
+    break;
+  }
+  return STORE_OK;
+}
+
+static int setString(RedisStore *store, const char *key, size_t keyLen,
+                     const char *value, size_t valueLen, SharedValue *shared,
+                     int keepTtl) {
+  EncodedValue encoded;
+  if (encodeValue(value, valueLen, shared, &encoded) != STORE_OK) {
     return STORE_ERR;
   }
-  entry->key = strdup(key);
-  if (!entry->key) {
-    free(entry);
-    pthread_rwlock_unlock(&store->rwlock);
+
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardWriteLock(shard);
+
+  // Like SET, a new value discards the TTL of the old one unless asked not to
+  StoreEntry *entry = expireIfNeeded(
+      store, shard, hashTableFind(shard->table, key, keyLen, hashVal));
+  if (entry && entry->timer.when && !keepTtl) {
+    setTimerLocked(shard, entry, 0);
+  }
+  SharedValue *old;
+  int result =
+      putValueLocked(shard, entry, key, keyLen, hashVal, &encoded, &old);
+
+  shardUnlock(shard);
+  releaseSharedValue(old);
+  return result;
+}
+
+int storeSet(RedisStore *store, const char *key, size_t keyLen, void *value,
+             size_t valueLen) {
+  if (!store || !key || !value) {
     return STORE_ERR;
   }
-  entry->type = TYPE_STRING;
-  entry->value.string.data = malloc(valueLen);
-  if (!entry->value.string.data) {
-    free(entry->key);
-    free(entry);
-    pthread_rwlock_unlock(&store->rwlock);
+  return setString(store, key, keyLen, value, valueLen, NULL, 0);
+}
+
+int storeSetKeepTtl(RedisStore *store, const char *key, size_t keyLen,
+                    const void *value, size_t valueLen) {
+  if (!store || !key || !value) {
     return STORE_ERR;
   }
-  memcpy(entry->value.string.data, value, valueLen);
-  entry->value.string.len = valueLen;
-  entry->expiry = 0;
-  entry->next = store->table[hashVal];
-  store->table[hashVal] = entry;
-  store->used++;
+  return setString(store, key, keyLen, value, valueLen, NULL, 1);
+}
 
-  pthread_rwlock_unlock(&store->rwlock);
-  return STORE_OK;
+int storeSetShared(RedisStore *store, const char *key, size_t keyLen,
+                   SharedValue *value) {
+  if (!store || !key || !value) {
+    return STORE_ERR;
+  }
+  return setString(store, key, keyLen, value->data, value->len, value, 0);
 }
 
-void *storeGet(RedisStore *store, const char *key, size_t *valueLen) {
+void *storeGet(RedisStore *store, const char *key, size_t keyLen,
+               size_t *valueLen) {
   if (!store || !key || !valueLen) {
     return NULL;
   }
 
-  pthread_rwlock_rdlock(&store->rwlock);
-
-  uint64_t hashVal = hash(key) % store->size;
-  StoreEntry *entry = store->table[hashVal];
-
-  while (entry) {
-    if (strcmp(entry->key, key) == 0) {
-      if (entry->expiry && entry->expiry <= getCurrentTimeMs()) {
-        pthread_rwlock_unlock(&store->rwlock);
-        return NULL;
-      }
-      if (entry->type != TYPE_STRING) {
-        pthread_rwlock_unlock(&store->rwlock);
-        return NULL;
-      }
-      void *value = malloc(entry->value.string.len);
-      if (!value) {
-        pthread_rwlock_unlock(&store->rwlock);
-        return NULL;
-      }
-      memcpy(value, entry->value.string.data, entry->value.string.len);
-      *valueLen = entry->value.string.len;
-      pthread_rwlock_unlock(&store->rwlock);
-      return value;
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardReadLock(shard);
+
+  StoreEntry *entry = findLiveLocked(store, shard, key, keyLen, hashVal);
+  if (!isString(entry)) {
+    shardUnlock(shard);
+    return NULL;
+  }
+
+  // Copy the terminating NUL too, callers may treat the value as a string
+  char buf[STORE_INT_BUF];
+  size_t len;
+  const char *bytes = stringBytes(entry, buf, &len);
+  void *value = malloc(len + 1);
+  if (value) {
+    memcpy(value, bytes, len + 1);
+    *valueLen = len;
+  }
+  shardUnlock(shard);
+  return value;
+}
+
+SharedValue *storeGetShared(RedisStore *store, const char *key,
+                            size_t keyLen) {
+  if (!store || !key) {
+    return NULL;
+  }
+
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardReadLock(shard);
+
+  StoreEntry *entry = findLiveLocked(store, shard, key, keyLen, hashVal);
+  SharedValue *value = NULL;
+  if (isString(entry)) {
+    if (entry->encoding == ENCODING_SHARED) {
+      value = retainSharedValue(entry->value.string);
+    } else {
+      char buf[STORE_INT_BUF];
+      size_t len;
+      const char *bytes = stringBytes(entry, buf, &len);
+      value = createSharedValue(bytes, len);
     }
-    entry = entry->next;
   }
-  pthread_rwlock_unlock(&store->rwlock);
-  return NULL;
+
+  shardUnlock(shard);
+  return value;
 }
 
-ValueType getValueType(RedisStore *store, const char *key) {
-  uint64_t hashVal = hash(key) % store->size;
-  StoreEntry *entry = store->table[hashVal];
+int storeIncrBy(RedisStore *store, const char *key, size_t keyLen,
+                long long delta, long long *result) {
+  if (!store || !key || !result) {
+    return STORE_ERR;
+  }
 
-  while (entry) {
-    if (strcmp(entry->key, key) == 0) {
-      if (entry->expiry && entry->expiry < time(NULL)) {
-        return TYPE_NONE;
-      }
-      return entry->type;
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardWriteLock(shard);
+
+  StoreEntry *entry = expireIfNeeded(
+      store, shard, hashTableFind(shard->table, key, keyLen, hashVal));
+
+  // Canonical integers are always stored as ENCODING_INT, any other string
+  // encoding means the value is not an integer
+  int status = STORE_OK;
+  long long current = 0;
+  if (entry && entry->type != TYPE_STRING) {
+    status = STORE_WRONGTYPE;
+  } else if (entry && entry->encoding != ENCODING_INT) {
+    status = STORE_NOT_NUMBER;
+  } else if (entry) {
+    current = entry->value.integer;
+  }
+
+  long long updated;
+  if (status == STORE_OK && __builtin_add_overflow(current, delta, &updated)) {
+    status = STORE_OVERFLOW;
+  }
+
+  if (status == STORE_OK) {
+    if (!entry) {
+      entry = addEntry(shard, key, keyLen, hashVal, 0);
+    }
+    if (entry) {
+      // Updated in place, no allocation once the counter exists
+      entry->type = TYPE_STRING;
+      entry->encoding = ENCODING_INT;
+      entry->value.integer = updated;
+      *result = updated;
+    } else {
+      status = STORE_ERR;
     }
-    entry = entry->next;
   }
-  return TYPE_NONE;
+
+  shardUnlock(shard);
+  return status;
 }
 
-int setExpiry(RedisStore *store, const char *key, time_t expiry) {
-  uint64_t hashVal = hash(key) % store->size;
-  StoreEntry *entry = store->table[hashVal];
+// Parses a whole string as a finite floating point number
+static int parseFloat(const char *value, size_t len, long double *out) {
+  if (len == 0 || isspace((unsigned char)value[0])) {
+    return 0;
+  }
+  char *end;
+  errno = 0;
+  long double parsed = strtold(value, &end);
+  if (end != value + len || errno == ERANGE || isnan(parsed) ||
+      isinf(parsed)) {
+    return 0;
+  }
+  *out = parsed;
+  return 1;
+}
 
-  while (entry) {
-    if (strcmp(entry->key, key) == 0) {
-      entry->expiry = expiry;
-      return STORE_OK;
+// Formats like "%.17Lf" without trailing zeros, e.g. 10.5 or 3
+static int formatFloat(long double value, char *buf, size_t size,
+                       size_t *len) {
+  int written = snprintf(buf, size, "%.17Lf", value);
+  if (written < 0 || (size_t)written >= size) {
+    return 0;
+  }
+  if (strchr(buf, '.')) {
+    while (buf[written - 1] == '0') {
+      written--;
     }
-    entry = entry->next;
-  }
-  return STORE_ERR;
-}
-
-void clearExpired(RedisStore *store) {
-  time_t now = time(NULL);
-  for (size_t i = 0; i < store->size; i++) {
-    StoreEntry **entryPtr = &store->table[i];
-    while (*entryPtr) {
-      if ((*entryPtr)->expiry && (*entryPtr)->expiry < now) {
-        StoreEntry *expired = *entryPtr;
-        *entryPtr = expired->next;
-        freeEntry(expired);
-        store->used--;
-      } else {
-        entryPtr = &(*entryPtr)->next;
-      }
+    if (buf[written - 1] == '.') {
+      written--;
     }
+    buf[written] = '\0';
   }
+  *len = written;
+  return 1;
 }
 
-char *storeStreamAdd(RedisStore *store, const char *key, const char *id,
-                     char **fields, char **values, size_t numFields) {
-  uint64_t hashVal = hash(key) % store->size;
-  StoreEntry *entry = store->table[hashVal];
+int storeIncrByFloat(RedisStore *store, const char *key, size_t keyLen,
+                     long double delta, char *result, size_t resultSize,
+                     size_t *resultLen) {
+  if (!store || !key || !result || !resultLen) {
+    return STORE_ERR;
+  }
 
-  while (entry) {
-    if (strcmp(entry->key, key) == 0) {
-      break;
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardWriteLock(shard);
+
+  StoreEntry *entry = expireIfNeeded(
+      store, shard, hashTableFind(shard->table, key, keyLen, hashVal));
+
+  int status = STORE_OK;
+  long double current = 0;
+  if (entry && entry->type != TYPE_STRING) {
+    status = STORE_WRONGTYPE;
+  } else if (entry) {
+    char buf[STORE_INT_BUF];
+    size_t len;
+    const char *bytes = stringBytes(entry, buf, &len);
+    if (!parseFloat(bytes, len, &current)) {
+      status = STORE_NOT_NUMBER;
     }
-    entry = entry->next;
   }
 
+  long double updated = current + delta;
+  if (status == STORE_OK && (isnan(updated) || isinf(updated))) {
+    status = STORE_OVERFLOW;
+  }
+  if (status == STORE_OK &&
+      !formatFloat(updated, result, resultSize, resultLen)) {
+    status = STORE_ERR;
+  }
+
+  // Integral results land back in ENCODING_INT through the usual encoding
+  SharedValue *old = NULL;
+  EncodedValue encoded;
+  if (status == STORE_OK) {
+    status = encodeValue(result, *resultLen, NULL, &encoded);
+  }
+  if (status == STORE_OK) {
+    status =
+        putValueLocked(shard, entry, key, keyLen, hashVal, &encoded, &old);
+  }
+
+  shardUnlock(shard);
+  releaseSharedValue(old);
+  return status;
+}
+
+int storeVisitValue(RedisStore *store, const char *key, size_t keyLen,
+                    StoreValueVisitor visit, void *ctx) {
+  if (!store || !key || !visit) {
+    return STORE_ERR;
+  }
+
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardReadLock(shard);
+
+  StoreEntry *entry = findLiveLocked(store, shard, key, keyLen, hashVal);
+  if (!isString(entry)) {
+    shardUnlock(shard);
+    return STORE_ERR;
+  }
+
+  char buf[STORE_INT_BUF];
+  size_t len;
+  const char *bytes = stringBytes(entry, buf, &len);
+  visit(bytes, len,
+        entry->encoding == ENCODING_SHARED ? entry->value.string : NULL, ctx);
+  shardUnlock(shard);
+  return STORE_OK;
+}
+
+int storeDelete(RedisStore *store, const char *key, size_t keyLen) {
+  if (!store || !key) {
+    return STORE_ERR;
+  }
+
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardWriteLock(shard);
+
+  // An expired key counts as already gone
+  StoreEntry *entry = expireIfNeeded(
+      store, shard, hashTableFind(shard->table, key, keyLen, hashVal));
+  if (entry) {
+    unlinkEntry(shard, entry);
+  }
+  shardUnlock(shard);
+
   if (!entry) {
-    entry = malloc(sizeof(StoreEntry));
-    entry->key = strdup(key);
-    entry->type = TYPE_STREAM;
-    entry->value.stream = createStream();
-    entry->next = store->table[hashVal];
-    store->table[hashVal] = entry;
-    store->used++;
+    return STORE_ERR;
   }
+  // Unlinked, so the shard lock is no longer needed to free it
+  freeEntry(entry);
+  return STORE_OK;
+}
+
+ValueType getValueType(RedisStore *store, const char *key, size_t keyLen) {
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardReadLock(shard);
 
-  return streamAdd(entry->value.stream, id, fields, values, numFields);
+  StoreEntry *entry = findLiveLocked(store, shard, key, keyLen, hashVal);
+  ValueType type = entry ? entry->type : TYPE_NONE;
+
+  shardUnlock(shard);
+  return type;
 }
 
-Stream *storeGetStream(RedisStore *store, const char *key) {
-  uint64_t hashVal = hash(key) % store->size;
-  StoreEntry *entry = store->table[hashVal];
+int setExpiry(RedisStore *store, const char *key, size_t keyLen,
+              time_t expiry) {
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardWriteLock(shard);
 
-  while (entry) {
-    if (strcmp(entry->key, key) == 0) {
-      if (entry->type == TYPE_STREAM) {
-        return entry->value.stream;
-      }
-      return NULL;
+  StoreEntry *entry = expireIfNeeded(
+      store, shard, hashTableFind(shard->table, key, keyLen, hashVal));
+  if (entry) {
+    setTimerLocked(shard, entry, expiry);
+  }
+
+  shardUnlock(shard);
+  return entry ? STORE_OK : STORE_ERR;
+}
+
+int getExpiry(RedisStore *store, const char *key, size_t keyLen,
+              time_t *expiry) {
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardReadLock(shard);
+
+  StoreEntry *entry = findLiveLocked(store, shard, key, keyLen, hashVal);
+  if (entry) {
+    *expiry = entry->timer.when;
+  }
+
+  shardUnlock(shard);
+  return entry ? STORE_OK : STORE_ERR;
+}
+
+int storeStreamAdd(RedisStore *store, const char *key, size_t keyLen,
+                   const char *id, char **fields, char **values,
+                   size_t numFields, char **result) {
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardWriteLock(shard);
+
+  StoreEntry *entry = expireIfNeeded(
+      store, shard, hashTableFind(shard->table, key, keyLen, hashVal));
+
+  // The value union only holds a stream for TYPE_STREAM
+  if (entry && entry->type != TYPE_STREAM) {
+    shardUnlock(shard);
+    return STORE_WRONGTYPE;
+  }
+
+  if (!entry) {
+    Stream *stream = createStream();
+    entry = stream ? addEntry(shard, key, keyLen, hashVal, 0) : NULL;
+    if (!entry) {
+      freeStream(stream);
+      shardUnlock(shard);
+      return STORE_ERR;
     }
-    entry = entry->next;
+    entry->type = TYPE_STREAM;
+    entry->value.stream = stream;
   }
 
-  return NULL;
+  *result = streamAdd(entry->value.stream, id, fields, values, numFields);
+  shardUnlock(shard);
+  return *result ? STORE_OK : STORE_ERR;
 }
 
-time_t getCurrentTimeMs(void) {
-  struct timespec ts;
-  clock_gettime(CLOCK_REALTIME, &ts);
-  return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+int storeVisitStream(RedisStore *store, const char *key, size_t keyLen,
+                     StoreStreamVisitor visit, void *ctx) {
+  if (!store || !key || !visit) {
+    return STORE_ERR;
+  }
+
+  uint64_t hashVal = hash(key, keyLen);
+  StoreShard *shard = shardFor(store, hashVal);
+  shardReadLock(shard);
+
+  // XADD, or a SET or DEL replacing the key, waits until the walk is done
+  StoreEntry *entry = findLiveLocked(store, shard, key, keyLen, hashVal);
+  if (!entry || entry->type != TYPE_STREAM) {
+    shardUnlock(shard);
+    return STORE_ERR;
+  }
+
+  visit(entry->value.stream, ctx);
+  shardUnlock(shard);
+  return STORE_OK;
 }
 
+time_t getCurrentTimeMs(void) { return (time_t)clockNowMs(); }
+
 size_t storeSize(RedisStore *store) {
   if (!store) {
     return 0;
   }
-  return store->used;
+
+  size_t size = 0;
+  for (size_t i = 0; i < store->shardCount; i++) {
+    StoreShard *shard = &store->shards[i];
+    shardReadLock(shard);
+    size += hashTableSize(shard->table);
+    shardUnlock(shard);
+  }
+  return size;
+}
+
+static long long elapsedUs(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000000LL +
+         (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+void storeRehash(RedisStore *store, long long budgetUs) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // The budget is shared, each shard lock is only held for its own batches
+  for (size_t i = 0; i < store->shardCount; i++) {
+    StoreShard *shard = &store->shards[i];
+    shardWriteLock(shard);
+    int rehashing = 1;
+    while (rehashing && elapsedUs(&start) < budgetUs) {
+      rehashing = hashTableRehash(shard->table, STORE_REHASH_BATCH);
+    }
+    shardUnlock(shard);
+
+    if (elapsedUs(&start) >= budgetUs) {
+      return;
+    }
+  }
+}
+
+// Deletes up to STORE_EXPIRE_BATCH due keys of a locked shard. Returns the
+// number deleted, a full batch means more may be due.
+static size_t expireBatch(StoreShard *shard, time_t now) {
+  size_t expired = 0;
+  TimerNode *timer;
+  while (expired < STORE_EXPIRE_BATCH &&
+         (timer = timerWheelPop(&shard->expiring, now))) {
+    StoreEntry *entry =
+        (StoreEntry *)((char *)timer - offsetof(StoreEntry, timer));
+    unlinkEntry(shard, entry);
+    freeEntry(entry);
+    expired++;
+  }
+  return expired;
+}
+
+size_t storeActiveExpire(RedisStore *store, long long budgetUs,
+                         int *incomplete) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  time_t now = getCurrentTimeMs();
+  size_t expired = 0;
+  int stopped = 0;
+
+  // Resume where the last cycle ran out of time, so every shard gets turns
+  for (size_t visited = 0; visited < store->shardCount; visited++) {
+    StoreShard *shard = &store->shards[store->expireCursor];
+    shardWriteLock(shard);
+    size_t batch;
+    do {
+      batch = expireBatch(shard, now);
+      expired += batch;
+    } while (batch == STORE_EXPIRE_BATCH && elapsedUs(&start) < budgetUs);
+    shardUnlock(shard);
+
+    if (batch == STORE_EXPIRE_BATCH) {
+      // Out of time with keys still due here, start from this shard next
+      stopped = 1;
+      break;
+    }
+    store->expireCursor = (store->expireCursor + 1) & (store->shardCount - 1);
+    // Shards with nothing due cost little, stop only once work was done
+    if (expired > 0 && elapsedUs(&start) >= budgetUs) {
+      stopped = visited + 1 < store->shardCount;
+      break;
+    }
+  }
+
+  __atomic_add_fetch(&store->expiredKeys, expired, __ATOMIC_RELAXED);
+  if (incomplete) {
+    *incomplete = stopped;
+  }
+  return expired;
+}
+
+size_t storeExpiredKeys(RedisStore *store) {
+  return __atomic_load_n(&store->expiredKeys, __ATOMIC_RELAXED);
+}
+
+static void freeShardEntries(StoreShard *shard) {
+  size_t pos = 0;
+  StoreEntry *entry;
+  while ((entry = hashTableNext(shard->table, &pos))) {
+    freeEntry(entry);
+  }
+}
+
+void storeClear(RedisStore *store) {
+  if (!store) {
+    return;
+  }
+
+  for (size_t i = 0; i < store->shardCount; i++) {
+    StoreShard *shard = &store->shards[i];
+    shardWriteLock(shard);
+    freeShardEntries(shard);
+    hashTableClear(shard->table);
+    timerWheelInit(&shard->expiring, getCurrentTimeMs());
+    shardUnlock(shard);
+  }
 }
 
 void freeStore(RedisStore *store) {
   if (!store) {
     return;
   }
-  
-  for (size_t i = 0; i < store->size; i++) {
-    StoreEntry *entry = store->table[i];
-    while (entry) {
-      StoreEntry *next = entry->next;
-      freeEntry(entry);
-      entry = next;
-    }
+
+  for (size_t i = 0; i < store->shardCount; i++) {
+    StoreShard *shard = &store->shards[i];
+    freeShardEntries(shard);
+    freeHashTable(shard->table);
+    pthread_rwlock_destroy(&shard->rwlock);
+    pthread_mutex_destroy(&shard->writeOrder);
   }
-  free(store->table);
-  pthread_rwlock_destroy(&store->rwlock);
+  free(store->shards);
   free(store);
 }
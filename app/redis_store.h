@@ -1,63 +1,315 @@
 #ifndef REDIS_STORE_H
 #define REDIS_STORE_H
 
+#include "hash_table.h"
+#include "shared_value.h"
 #include "stream.h"
+#include "timer_wheel.h"
 #include <pthread.h>
 #include <stdint.h>
 #include <time.h>
 
 #define STORE_OK 0
 #define STORE_ERR -1
-#define INITIAL_STORE_SIZE 16
+#define STORE_WRONGTYPE -2  /* Key holds a value of another type */
+#define STORE_NOT_NUMBER -3 /* String value is not a number of the needed kind */
+#define STORE_OVERFLOW -4   /* Result is out of range */
+#define INITIAL_STORE_SIZE 16 /* Initial keyspace capacity in slots */
+#define STORE_REHASH_BATCH 1024 /* Slots migrated between budget checks */
+#define STORE_EXPIRE_BATCH 64   /* Keys expired between budget checks */
+#define STORE_DEFAULT_SHARDS 16 /* Keyspace shards when not configured */
+#define STORE_MAX_SHARDS 1024   /* Shards are picked by the top 10 hash bits */
+#define STORE_SHARD_ALIGN 64    /* Keeps each shard lock on its own line */
+#define STORE_EMBED_MAX 64      /* Longest value stored inside its entry */
+#define STORE_INT_BUF 32        /* Fits any long long in decimal and a NUL */
+#define STORE_FLOAT_BUF 5120    /* Fits any long double printed by INCRBYFLOAT */
 
 typedef enum ValueType { TYPE_NONE, TYPE_STRING, TYPE_STREAM } ValueType;
 
+/* How a TYPE_STRING value is held */
+typedef enum ValueEncoding {
+  ENCODING_SHARED, /* value.string, for values over STORE_EMBED_MAX bytes */
+  ENCODING_EMBED,  /* value.embeddedLen bytes and a NUL after the key */
+  ENCODING_INT     /* value.integer, for values in canonical integer form */
+} ValueEncoding;
+
+/**
+ * A key and its value in a single allocation. The key is stored inline
+ * after the header, and short string values follow the key in the same
+ * block, so a small key costs one malloc instead of three.
+ */
 typedef struct StoreEntry {
-  char *key;
-  ValueType type;
+  uint64_t hash;   /* Cached hash of the key */
+  TimerNode timer; /* timer.when is the expiry in ms, 0 if none */
   union {
-    struct {
-      void *data;
-      size_t len;
-    } string;
+    SharedValue *string; /* Replaced, never modified, on overwrite */
+    long long integer;
+    size_t embeddedLen;
     Stream *stream;
   } value;
-  struct StoreEntry *next;
-  time_t expiry;
+  uint32_t keyLen;  /* Key length in bytes */
+  uint8_t type;     /* ValueType */
+  uint8_t encoding; /* ValueEncoding when type is TYPE_STRING */
+  char key[];       /* Binary-safe key and NUL, then any embedded value */
 } StoreEntry;
 
+/**
+ * One independently locked slice of the keyspace
+ */
+typedef struct StoreShard {
+  HashTable *table;           /* Keys whose hash selects this shard */
+  TimerWheel expiring;        /* Timers of the keys in table with a TTL */
+  pthread_rwlock_t rwlock;    /* Guards table, expiring and the entries */
+  int locked;                 /* Takes locks, 0 in a store owned by one thread */
+  pthread_mutex_t writeOrder; /* Held across a write and its propagation */
+} __attribute__((aligned(STORE_SHARD_ALIGN))) StoreShard;
+
+/**
+ * Keyspace split into a power-of-two number of shards selected by the top
+ * bits of the key hash. Single-key operations lock only their shard, whole
+ * store operations visit the shards one at a time.
+ */
 typedef struct RedisStore {
-  StoreEntry **table;
-  size_t size;
-  size_t used;
-  pthread_rwlock_t rwlock;
+  StoreShard *shards;
+  size_t shardCount;   /* Power of two, at most STORE_MAX_SHARDS */
+  size_t expireCursor; /* Shard the next active expiry cycle starts at */
+  size_t expiredKeys;  /* Keys deleted for a passed TTL, updated atomically */
 } RedisStore;
 
+// Keys are binary safe: every operation takes the key as pointer + length
+
 // Core operations
 RedisStore *createStore(void);
+
+/**
+ * Creates a store split into the given number of shards
+ * @param shards Shard count, rounded up to a power of two and capped at
+ * STORE_MAX_SHARDS
+ * @return Newly allocated RedisStore or NULL on failure
+ */
+RedisStore *createShardedStore(size_t shards);
+
+/**
+ * Creates a single shard store for one thread, which takes no locks. Every
+ * operation on it, including rehash and active expiry, must come from the
+ * owning thread; only storeExpiredKeys may be read from others.
+ * @return Newly allocated RedisStore or NULL on failure
+ */
+RedisStore *createOwnedStore(void);
 void freeStore(RedisStore *store);
-int storeSet(RedisStore *store, const char *key, void *value, size_t valueLen);
-void *storeGet(RedisStore *store, const char *key, size_t *valueLen);
-int storeDelete(RedisStore *store, const char *key);
-
-// Expiry operations
-int setExpiry(RedisStore *store, const char *key, time_t expiry);
-int getExpiry(RedisStore *store, const char *key, time_t *expiry);
-void clearExpired(RedisStore *store);
+int storeSet(RedisStore *store, const char *key, size_t keyLen, void *value,
+             size_t valueLen);
+void *storeGet(RedisStore *store, const char *key, size_t keyLen,
+               size_t *valueLen);
+int storeDelete(RedisStore *store, const char *key, size_t keyLen);
+
+/**
+ * Stores a string value like SET KEEPTTL, leaving any TTL of the key as is
+ * @param store Store to write to
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param value Value bytes, copied
+ * @param valueLen Value length
+ * @return STORE_OK or STORE_ERR
+ */
+int storeSetKeepTtl(RedisStore *store, const char *key, size_t keyLen,
+                    const void *value, size_t valueLen);
+
+/**
+ * Stores a string value by reference, without copying it
+ * @param store Store to write to
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param value Value to share, the store takes its own reference
+ * @return STORE_OK or STORE_ERR
+ */
+int storeSetShared(RedisStore *store, const char *key, size_t keyLen,
+                   SharedValue *value);
+
+/**
+ * Takes a reference to a string value. Values over STORE_EMBED_MAX bytes
+ * are not copied, smaller ones are copied into a new buffer. Either way the
+ * value stays valid after the key is overwritten or deleted.
+ * @param store Store to read from
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @return Retained value the caller must release, or NULL if the key does
+ * not hold a live string
+ */
+SharedValue *storeGetShared(RedisStore *store, const char *key,
+                            size_t keyLen);
+
+/**
+ * Receives a string value in place. Runs with the shard read locked, so it
+ * must not call back into the store or keep the pointer after returning.
+ * shared is the buffer holding the value when it has one, or NULL for
+ * embedded and integer values, and may be retained.
+ */
+typedef void (*StoreValueVisitor)(const void *value, size_t valueLen,
+                                  SharedValue *shared, void *ctx);
+
+/**
+ * Hands a string value to a visitor without copying it out of the store
+ * @param store Store to read from
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param visit Called once with the value if the key holds a live string
+ * @param ctx Passed through to visit
+ * @return STORE_OK if visit was called, STORE_ERR if there is no such value
+ */
+int storeVisitValue(RedisStore *store, const char *key, size_t keyLen,
+                    StoreValueVisitor visit, void *ctx);
+
+/**
+ * Adds to an integer value in place under a single lock acquisition, so
+ * concurrent increments are never lost. A missing or expired key counts
+ * as 0. An existing TTL is kept.
+ * @param store Store to update
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param delta Amount to add, negative to decrement
+ * @param result Receives the new value
+ * @return STORE_OK, STORE_WRONGTYPE, STORE_NOT_NUMBER if the value is not a
+ * 64-bit integer, STORE_OVERFLOW or STORE_ERR
+ */
+int storeIncrBy(RedisStore *store, const char *key, size_t keyLen,
+                long long delta, long long *result);
+
+/**
+ * Adds to a value parsed as a long double and stores the result as a
+ * string, under a single lock acquisition
+ * @param store Store to update
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param delta Amount to add
+ * @param result Receives the new value as stored, NUL terminated
+ * @param resultSize Size of result, STORE_FLOAT_BUF always suffices
+ * @param resultLen Receives the length of result
+ * @return STORE_OK, STORE_WRONGTYPE, STORE_NOT_NUMBER if the value is not a
+ * number, STORE_OVERFLOW if the result is NaN or infinite, or STORE_ERR
+ */
+int storeIncrByFloat(RedisStore *store, const char *key, size_t keyLen,
+                     long double delta, char *result, size_t resultSize,
+                     size_t *resultLen);
+
+// Expiry operations, expiries are absolute Unix times in milliseconds
+
+/**
+ * Sets or clears the TTL of a key
+ * @param store Store to update
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param expiry Time the key expires, or 0 to keep it forever
+ * @return STORE_OK, or STORE_ERR if the key does not exist
+ */
+int setExpiry(RedisStore *store, const char *key, size_t keyLen,
+              time_t expiry);
+int getExpiry(RedisStore *store, const char *key, size_t keyLen,
+              time_t *expiry);
+
+/**
+ * Deletes keys whose TTL has passed, in expiry order to the millisecond,
+ * for at most the given time. Shards are visited round robin across
+ * calls, so a budget too small for the whole store still reaches every
+ * shard in turn. At least one batch is expired per call whatever the
+ * budget.
+ * @param store Store to expire keys from
+ * @param budgetUs Time budget in microseconds
+ * @param incomplete If not NULL, set to 1 when the budget ran out before
+ * every shard was cleared of due keys, 0 otherwise
+ * @return Number of keys deleted
+ */
+size_t storeActiveExpire(RedisStore *store, long long budgetUs,
+                         int *incomplete);
+
+/**
+ * Counts the keys deleted because their TTL passed, whether found by
+ * storeActiveExpire or on access
+ * @param store Store to read
+ * @return Keys expired since the store was created
+ */
+size_t storeExpiredKeys(RedisStore *store);
 time_t getCurrentTimeMs(void);
 
 // Type Operations
 
-ValueType getValueType(RedisStore *store, const char *key);
+ValueType getValueType(RedisStore *store, const char *key, size_t keyLen);
 
 // Stream Operations
 
-char *storeStreamAdd(RedisStore *store, const char *key, const char *id,
-                     char **fields, char **values, size_t numFields);
-Stream *storeGetStream(RedisStore *store, const char *key);
+/**
+ * Appends an entry to the stream at a key, creating the stream if needed
+ * @param store Store to write to
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param id Requested entry ID, may contain *
+ * @param fields Field names
+ * @param values Values of the fields
+ * @param numFields Number of fields
+ * @param result Set on STORE_OK to the ID added, or to an error message
+ * after a leading '-' if the ID was rejected; the caller frees it
+ * @return STORE_OK, STORE_WRONGTYPE if the key holds another type, or
+ * STORE_ERR if out of memory
+ */
+int storeStreamAdd(RedisStore *store, const char *key, size_t keyLen,
+                   const char *id, char **fields, char **values,
+                   size_t numFields, char **result);
+
+/**
+ * Receives a stream in place. Runs with the shard read locked, so it must
+ * not call back into the store or keep the stream or its entries after
+ * returning; what it needs later is copied out, e.g. by streamRange.
+ */
+typedef void (*StoreStreamVisitor)(Stream *stream, void *ctx);
+
+/**
+ * Hands a stream to a visitor while writers are kept out of it
+ * @param store Store to read from
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @param visit Called once with the stream if the key holds a live one
+ * @param ctx Passed through to visit
+ * @return STORE_OK if visit was called, STORE_ERR if there is no such stream
+ */
+int storeVisitStream(RedisStore *store, const char *key, size_t keyLen,
+                     StoreStreamVisitor visit, void *ctx);
 
 // Utility functions
 size_t storeSize(RedisStore *store);
+
+/**
+ * Orders the writes to a key's shard with what the caller does after them.
+ * Held around a write command and its propagation, it makes replicas see
+ * the writes to a key in the order they were applied. Stores owned by one
+ * thread are ordered already and skip it.
+ * @param store Store about to be written
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @return Shard to pass to storeUnlockWrites, NULL if nothing was locked
+ */
+StoreShard *storeLockWrites(RedisStore *store, const char *key, size_t keyLen);
+
+/**
+ * Releases the write order taken by storeLockWrites
+ * @param shard Shard it returned, may be NULL
+ */
+void storeUnlockWrites(StoreShard *shard);
+
+/**
+ * Hashes a key the way the store does
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @return 64-bit hash
+ */
+uint64_t storeKeyHash(const char *key, size_t keyLen);
 void storeClear(RedisStore *store);
 
+/**
+ * Advances a keyspace resize in progress for at most the given time, so a
+ * resize also completes while few keys are being written
+ * @param store Store to rehash
+ * @param budgetUs Time budget in microseconds
+ */
+void storeRehash(RedisStore *store, long long budgetUs);
+
 #endif
@@ -2,6 +2,8 @@
 #include "handshake.h"
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 void initReplicaList(RedisServer *server) {
@@ -10,61 +12,224 @@ void initReplicaList(RedisServer *server) {
   server->repl_info->replicas->replicas =
       malloc(sizeof(Replica) * server->repl_info->replicas->replica_capacity);
   server->repl_info->replicas->replica_count = 0;
+  pthread_mutex_init(&server->repl_info->replicas->lock, NULL);
 }
 
-void addReplica(RedisServer *server, int fd) {
-  if (server->repl_info->replicas->replica_count >=
-      server->repl_info->replicas->replica_capacity) {
-    server->repl_info->replicas->replica_capacity *= 2;
-    server->repl_info->replicas->replicas = realloc(
-        server->repl_info->replicas->replicas,
-        sizeof(Replica) * server->repl_info->replicas->replica_capacity);
+static Replica *findReplicaLocked(Replicas *list, int fd) {
+  for (size_t i = 0; i < list->replica_count; i++) {
+    if (list->replicas[i].fd == fd) {
+      return &list->replicas[i];
+    }
+  }
+  return NULL;
+}
+
+// Asks the serving reactor to report when the socket can take more of the
+// stream, or to stop once it is drained. The caller holds the lock.
+static void watchReplicaOutput(Replica *replica, int writable) {
+  replica->writable = writable;
+  if (replica->epfd < 0) {
+    return;
+  }
+  struct epoll_event ev = {0};
+  ev.events = EPOLLIN | (writable ? EPOLLOUT : 0);
+  ev.data.ptr = replica->client;
+  // Fails harmlessly while the connection is detached, registering it
+  // again watches for output as well
+  epoll_ctl(replica->epfd, EPOLL_CTL_MOD, replica->fd, &ev);
+}
+
+// Gives up on a replica whose stream can no longer be delivered whole. The
+// shutdown makes its reactor see the connection close and remove it.
+static void failReplica(Replica *replica) {
+  replica->failed = 1;
+  resetOutputBuffer(replica->stream);
+  shutdown(replica->fd, SHUT_RDWR);
+}
+
+// Writes what the socket accepts unless the reactor is already waiting for
+// it to turn writable. The caller holds the lock.
+static void writeReplicaLocked(Replica *replica) {
+  if (replica->stream->pending > OUTPUT_HARD_LIMIT) {
+    failReplica(replica);
+    return;
+  }
+  if (replica->writable) {
+    return;
   }
+  int status = flushOutputBuffer(replica->stream, replica->fd);
+  if (status == OUTPUT_ERR) {
+    failReplica(replica);
+  } else if (status == OUTPUT_PENDING) {
+    watchReplicaOutput(replica, 1);
+  }
+}
 
-  Replica new_replica = {.fd = fd, .ack_offset = 0};
+void addReplica(RedisServer *server, ClientState *client) {
+  OutputBuffer *reply = createOutputBuffer();
+  if (!reply) {
+    return;
+  }
+
+  Replicas *list = server->repl_info->replicas;
+  pthread_mutex_lock(&list->lock);
+  if (list->replica_count >= list->replica_capacity) {
+    list->replica_capacity *= 2;
+    list->replicas =
+        realloc(list->replicas, sizeof(Replica) * list->replica_capacity);
+  }
 
-  server->repl_info->replicas
-      ->replicas[server->repl_info->replicas->replica_count++] = new_replica;
+  // Everything owed to the replica so far leads its stream, so nothing
+  // propagated from now on can overtake the sync reply
+  Replica *replica = &list->replicas[list->replica_count++];
+  long long offset = server->repl_info->repl_offset;
+  *replica = (Replica){.fd = client->fd,
+                       .ack_offset = offset,
+                       .sync_offset = offset,
+                       .stream = client->reply,
+                       .client = client,
+                       .epfd = client->epfd,
+                       .writable = 0,
+                       .failed = 0};
+  client->reply = reply;
+  client->replica = 1;
+  writeReplicaLocked(replica);
+  pthread_mutex_unlock(&list->lock);
 }
 
 void removeReplica(RedisServer *server, int fd) {
-  for (size_t i = 0; i < server->repl_info->replicas->replica_count; i++) {
-    if (server->repl_info->replicas->replicas[i].fd == fd) {
-      memmove(&server->repl_info->replicas->replicas[i],
-              &server->repl_info->replicas->replicas[i + 1],
-              sizeof(Replica) *
-                  (server->repl_info->replicas->replica_count - i - 1));
-      server->repl_info->replicas->replica_count--;
-      break;
-    }
+  Replicas *list = server->repl_info->replicas;
+  pthread_mutex_lock(&list->lock);
+  Replica *replica = findReplicaLocked(list, fd);
+  if (replica) {
+    freeOutputBuffer(replica->stream);
+    size_t index = (size_t)(replica - list->replicas);
+    memmove(replica, replica + 1,
+            sizeof(Replica) * (list->replica_count - index - 1));
+    list->replica_count--;
   }
+  pthread_mutex_unlock(&list->lock);
 }
 
 void propagateCommand(RedisServer *server, RespValue *command) {
-  char *cmd_str = createRespArrayFromElements(command->data.array.elements,
-                                              command->data.array.len);
+  Replicas *list = server->repl_info->replicas;
+  size_t bytes = 0;
 
-  for (size_t i = 0; i < server->repl_info->replicas->replica_count; i++) {
-    int fd = server->repl_info->replicas->replicas[i].fd;
-    ssize_t written = write(fd, cmd_str, strlen(cmd_str));
+  // One writer at a time, so commands from different reactors reach every
+  // replica whole and in the same order
+  pthread_mutex_lock(&list->lock);
+  for (size_t i = 0; i < list->replica_count; i++) {
+    Replica *replica = &list->replicas[i];
+    if (replica->failed) {
+      continue;
+    }
+    // Shared arguments are referenced, not copied into every stream
+    size_t pending = replica->stream->pending;
+    if (writeRespValue(replica->stream, command) != OUTPUT_OK) {
+      failReplica(replica);
+      continue;
+    }
+    bytes = replica->stream->pending - pending;
+    writeReplicaLocked(replica);
+  }
+  // The offset counts the stream once, as each replica will see it
+  __atomic_add_fetch(&server->repl_info->repl_offset, bytes, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&list->lock);
+}
+
+int flushReplica(RedisServer *server, int fd) {
+  Replicas *list = server->repl_info->replicas;
+  int result = 0;
+
+  pthread_mutex_lock(&list->lock);
+  Replica *replica = findReplicaLocked(list, fd);
+  if (!replica || replica->failed) {
+    result = -1;
+  } else {
+    int status = flushOutputBuffer(replica->stream, fd);
+    if (status == OUTPUT_ERR) {
+      failReplica(replica);
+      result = -1;
+    } else if (status == OUTPUT_OK) {
+      watchReplicaOutput(replica, 0);
+    }
+  }
+  pthread_mutex_unlock(&list->lock);
+  return result;
+}
+
+void sendToReplicas(RedisServer *server, const char *data, size_t len) {
+  Replicas *list = server->repl_info->replicas;
+  if (!list) {
+    return;
+  }
+  size_t bytes = 0;
+  pthread_mutex_lock(&list->lock);
+  for (size_t i = 0; i < list->replica_count; i++) {
+    Replica *replica = &list->replicas[i];
+    if (replica->failed) {
+      continue;
+    }
+    if (outputBufferAppend(replica->stream, data, len) != OUTPUT_OK) {
+      failReplica(replica);
+      continue;
+    }
+    bytes = len;
+    writeReplicaLocked(replica);
+  }
+  __atomic_add_fetch(&server->repl_info->repl_offset, bytes, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&list->lock);
+}
+
+void ackReplica(RedisServer *server, int fd, long long offset) {
+  Replicas *list = server->repl_info->replicas;
+  pthread_mutex_lock(&list->lock);
+  Replica *replica = findReplicaLocked(list, fd);
+  // Replicas count what they applied from the start of their own stream
+  if (replica && replica->sync_offset + offset > replica->ack_offset) {
+    replica->ack_offset = replica->sync_offset + offset;
+  }
+  pthread_mutex_unlock(&list->lock);
+}
 
-    if (written < 0) {
-      removeReplica(server, fd);
-      close(fd);
-      i--;
+size_t replicasAcked(RedisServer *server, long long offset) {
+  Replicas *list = server->repl_info->replicas;
+  if (!list) {
+    return 0;
+  }
+  size_t acked = 0;
+  pthread_mutex_lock(&list->lock);
+  for (size_t i = 0; i < list->replica_count; i++) {
+    if (list->replicas[i].ack_offset >= offset) {
+      acked++;
     }
+  }
+  pthread_mutex_unlock(&list->lock);
+  return acked;
+}
 
-    server->repl_info->repl_offset += written;
+size_t replicaCount(RedisServer *server) {
+  Replicas *list = server->repl_info->replicas;
+  if (!list) {
+    return 0;
   }
+  pthread_mutex_lock(&list->lock);
+  size_t count = list->replica_count;
+  pthread_mutex_unlock(&list->lock);
+  return count;
+}
 
-  free(cmd_str);
+long long replicationOffset(RedisServer *server) {
+  return __atomic_load_n(&server->repl_info->repl_offset, __ATOMIC_RELAXED);
 }
 
 void freeReplicas(RedisServer *server) {
+  // The sockets belong to the replicas' clients
   for (size_t i = 0; i < server->repl_info->replicas->replica_count; i++) {
-    close(server->repl_info->replicas->replicas[i].fd);
+    freeOutputBuffer(server->repl_info->replicas->replicas[i].stream);
   }
 
+  pthread_mutex_destroy(&server->repl_info->replicas->lock);
   free(server->repl_info->replicas->replicas);
   free(server->repl_info->replicas);
   server->repl_info->replicas = NULL;
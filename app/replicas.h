@@ -1,13 +1,88 @@
 #ifndef REPLICAS_H
 #define REPLICAS_H
 
+#include "client_handler.h"
 #include "resp.h"
 #include "server.h"
 
 void initReplicaList(RedisServer *server);
-void addReplica(RedisServer *server, int fd);
+
+/**
+ * Turns a client that sent PSYNC into a replica. Replies still queued for
+ * it, the sync reply included, become the start of its replication stream,
+ * and the master stops answering the connection from then on.
+ * @param server Master server
+ * @param client Connection of the replica, served by the calling reactor
+ */
+void addReplica(RedisServer *server, ClientState *client);
+
+/**
+ * Forgets a replica and drops its unsent stream. The connection itself is
+ * left to its client.
+ * @param server Master server
+ * @param fd Socket of the replica
+ */
 void removeReplica(RedisServer *server, int fd);
+
 void freeReplicas(RedisServer *server);
+
+/**
+ * Appends a write command to every replica's stream and writes as much as
+ * each socket accepts. What is left is finished by flushReplica once the
+ * socket turns writable.
+ * @param server Master server
+ * @param command Command to replicate
+ */
 void propagateCommand(RedisServer *server, RespValue *command);
 
+/**
+ * Continues writing a replica's stream, called by the reactor serving the
+ * connection when it reports EPOLLOUT
+ * @param server Master server
+ * @param fd Socket of the replica
+ * @return 0 on progress, -1 if the connection failed and must be closed
+ */
+int flushReplica(RedisServer *server, int fd);
+
+/**
+ * Sends raw protocol bytes to every replica, e.g. REPLCONF GETACK. Like
+ * propagated commands they advance the replication offset, which replicas
+ * count them in too.
+ * @param server Master server
+ * @param data Bytes to send
+ * @param len Length of data
+ */
+void sendToReplicas(RedisServer *server, const char *data, size_t len);
+
+/**
+ * Records how much of its stream a replica reported applied (REPLCONF ACK)
+ * @param server Master server
+ * @param fd Socket of the replica
+ * @param offset Bytes applied since the replica synced
+ */
+void ackReplica(RedisServer *server, int fd, long long offset);
+
+/**
+ * Counts the replicas that confirmed the stream up to an offset, for WAIT
+ * @param server Master server
+ * @param offset Replication offset to reach
+ * @return Number of replicas at or past offset
+ */
+size_t replicasAcked(RedisServer *server, long long offset);
+
+/**
+ * Counts the connected replicas
+ * @param server Master server
+ * @return Number of replicas
+ */
+size_t replicaCount(RedisServer *server);
+
+/**
+ * Reads the replication offset, which the replication thread or any
+ * reactor may be advancing
+ * @param server Master or replica server
+ * @return Bytes of replication stream produced, or applied on a replica
+ */
+long long replicationOffset(RedisServer *server);
+
 #endif
@@ -1,5 +1,7 @@
 #define _GNU_SOURCE
 #include "resp.h"
+#include "slab.h"
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,30 +13,70 @@
  */
 
 RespBuffer *createRespBuffer() {
-  RespBuffer *respBuffer = malloc(sizeof(RespBuffer));
+  RespBuffer *respBuffer = calloc(1, sizeof(RespBuffer));
   respBuffer->buffer = malloc(RESP_BUFFER_SIZE);
   respBuffer->size = RESP_BUFFER_SIZE;
   respBuffer->used = 0;
+  respBuffer->pos = 0;
+  respBuffer->pendingArgs = -1;
+  respBuffer->bulkLen = -1;
   return respBuffer;
 }
 
 void freeRespBuffer(RespBuffer *buffer) {
+  free(buffer->args);
+  free(buffer->argv);
+  free(buffer->argOffsets);
   free(buffer->buffer);
   free(buffer);
 }
 
-int appendRespBuffer(RespBuffer *buffer, const char *data, size_t len) {
-  if (buffer->used + len > buffer->size) {
-    size_t newSize = buffer->size * 2;
-    while (newSize < buffer->used + len) {
-      newSize *= 2;
-    }
-    char *newBuffer = realloc(buffer->buffer, newSize);
-    if (!newBuffer)
-      return RESP_ERR;
-    buffer->buffer = newBuffer;
-    buffer->size = newSize;
+// Marks bytes as parsed. The cursor moves instead of shifting the remaining
+// data, which only happens in compactRespBuffer when space runs out.
+static void consumeRespBuffer(RespBuffer *buffer, size_t len) {
+  buffer->pos += len;
+  if (buffer->pos == buffer->used) {
+    buffer->pos = 0;
+    buffer->used = 0;
+  }
+}
+
+static void compactRespBuffer(RespBuffer *buffer) {
+  if (buffer->pos == 0) {
+    return;
+  }
+  memmove(buffer->buffer, buffer->buffer + buffer->pos,
+          buffer->used - buffer->pos);
+  buffer->used -= buffer->pos;
+  buffer->pos = 0;
+}
+
+int reserveRespBuffer(RespBuffer *buffer, size_t len) {
+  if (buffer->used + len <= buffer->size) {
+    return RESP_OK;
+  }
+  compactRespBuffer(buffer);
+  if (buffer->used + len <= buffer->size) {
+    return RESP_OK;
   }
+
+  // Grow geometrically, but size a large argument exactly
+  size_t needed = buffer->used + len;
+  size_t newSize = buffer->size * 2;
+  if (newSize < needed) {
+    newSize = needed;
+  }
+  char *newBuffer = realloc(buffer->buffer, newSize);
+  if (!newBuffer)
+    return RESP_ERR;
+  buffer->buffer = newBuffer;
+  buffer->size = newSize;
+  return RESP_OK;
+}
+
+int appendRespBuffer(RespBuffer *buffer, const char *data, size_t len) {
+  if (reserveRespBuffer(buffer, len) != RESP_OK)
+    return RESP_ERR;
   memcpy(buffer->buffer + buffer->used, data, len);
   buffer->used += len;
   return RESP_OK;
@@ -84,146 +126,186 @@ char *createBulkString(const char *str, size_t len) {
 
 char *createNullBulkString(void) { return strdup("$-1\r\n"); }
 
+// Renders a reply built with the streaming encoders as a string
+static char *renderReply(OutputBuffer *out, int status) {
+  char *result = status == OUTPUT_OK ? flattenOutputBuffer(out, NULL) : NULL;
+  freeOutputBuffer(out);
+  return result;
+}
+
 char *createRespArray(const char **elements, size_t count) {
-  RespBuffer *buffer = createRespBuffer();
-  char header[32];
-  snprintf(header, sizeof(header), "*%zu\r\n", count);
-  appendRespBuffer(buffer, header, strlen(header));
+  OutputBuffer *out = createOutputBuffer();
+  if (!out)
+    return NULL;
 
-  for (size_t i = 0; i < count; i++) {
-    char *bulkStr = createBulkString(elements[i], strlen(elements[i]));
-    appendRespBuffer(buffer, bulkStr, strlen(bulkStr));
-    free(bulkStr);
+  int status = writeArrayHeader(out, count);
+  for (size_t i = 0; i < count && status == OUTPUT_OK; i++) {
+    status = writeBulkString(out, elements[i], strlen(elements[i]));
   }
-
-  char *result = strndup(buffer->buffer, buffer->used);
-  freeRespBuffer(buffer);
-  return result;
+  return renderReply(out, status);
 }
 
 char *createRespArrayFromElements(RespValue **elements, size_t count) {
-  RespBuffer *buffer = createRespBuffer();
-  char header[32];
-  snprintf(header, sizeof(header), "*%zu\r\n", count);
-  appendRespBuffer(buffer, header, strlen(header));
-
-  for (size_t i = 0; i < count; i++) {
-    char *elementStr;
-    switch (elements[i]->type) {
-    case RespTypeString:
-      elementStr = createSimpleString(elements[i]->data.string.str);
-      break;
-    case RespTypeInteger:
-      elementStr = createInteger(elements[i]->data.integer);
-      break;
-    case RespTypeArray:
-      elementStr = createRespArrayFromElements(elements[i]->data.array.elements,
-                                               elements[i]->data.array.len);
-      break;
-    case RespTypeBulk:
-      elementStr = createBulkString(elements[i]->data.string.str,
-                                    elements[i]->data.string.len);
-      break;
-    case RespTypeError:
-      elementStr = createError(elements[i]->data.string.str);
-      break;
-    default:
-      elementStr = createNullBulkString();
+  OutputBuffer *out = createOutputBuffer();
+  if (!out)
+    return NULL;
+
+  int status = writeArrayHeader(out, count);
+  for (size_t i = 0; i < count && status == OUTPUT_OK; i++) {
+    status = writeRespValue(out, elements[i]);
+  }
+  return renderReply(out, status);
+}
+
+char *createXrangeResponse(StreamEntry *entries, size_t count) {
+  OutputBuffer *out = createOutputBuffer();
+  if (!out)
+    return NULL;
+  return renderReply(out, writeXrangeResponse(out, entries, count));
+}
+
+char *createXreadResponse(StreamInfo *streams, size_t numStreams) {
+  OutputBuffer *out = createOutputBuffer();
+  if (!out)
+    return NULL;
+  return renderReply(out, writeXreadResponse(out, streams, numStreams));
+}
+
+/*
+ * Streaming Encoders
+ * ------------------
+ */
+
+// Appends "<prefix><number>\r\n"
+static int writeNumberLine(OutputBuffer *out, char prefix, long long num) {
+  char line[32];
+  int len = snprintf(line, sizeof(line), "%c%lld\r\n", prefix, num);
+  return outputBufferAppend(out, line, len);
+}
+
+static int writeLine(OutputBuffer *out, char prefix, const char *str) {
+  size_t len = strlen(str);
+  if (outputBufferAppend(out, &prefix, 1) != OUTPUT_OK ||
+      outputBufferAppend(out, str, len) != OUTPUT_OK)
+    return OUTPUT_ERR;
+  return outputBufferAppend(out, "\r\n", 2);
+}
+
+int writeSimpleString(OutputBuffer *out, const char *str) {
+  return writeLine(out, '+', str);
+}
+
+int writeError(OutputBuffer *out, const char *message) {
+  return writeLine(out, '-', message);
+}
+
+int writeInteger(OutputBuffer *out, long long num) {
+  return writeNumberLine(out, ':', num);
+}
+
+int writeBulkString(OutputBuffer *out, const char *str, size_t len) {
+  if (writeNumberLine(out, '$', (long long)len) != OUTPUT_OK ||
+      outputBufferAppend(out, str, len) != OUTPUT_OK)
+    return OUTPUT_ERR;
+  return outputBufferAppend(out, "\r\n", 2);
+}
+
+int writeSharedBulkString(OutputBuffer *out, SharedValue *value) {
+  if (writeNumberLine(out, '$', (long long)value->len) != OUTPUT_OK ||
+      outputBufferAppendShared(out, value) != OUTPUT_OK)
+    return OUTPUT_ERR;
+  return outputBufferAppend(out, "\r\n", 2);
+}
+
+int writeNullBulkString(OutputBuffer *out) {
+  return outputBufferAppend(out, "$-1\r\n", 5);
+}
+
+int writeArrayHeader(OutputBuffer *out, size_t count) {
+  return writeNumberLine(out, '*', (long long)count);
+}
+
+int writeRespValue(OutputBuffer *out, RespValue *value) {
+  switch (value->type) {
+  case RespTypeString:
+    return writeSimpleString(out, value->data.string.str);
+  case RespTypeError:
+    return writeError(out, value->data.string.str);
+  case RespTypeInteger:
+    return writeInteger(out, value->data.integer);
+  case RespTypeBulk:
+    if (value->data.string.shared)
+      return writeSharedBulkString(out, value->data.string.shared);
+    return writeBulkString(out, value->data.string.str,
+                           value->data.string.len);
+  case RespTypeArray:
+    if (writeArrayHeader(out, value->data.array.len) != OUTPUT_OK)
+      return OUTPUT_ERR;
+    for (size_t i = 0; i < value->data.array.len; i++) {
+      if (writeRespValue(out, value->data.array.elements[i]) != OUTPUT_OK)
+        return OUTPUT_ERR;
     }
-    appendRespBuffer(buffer, elementStr, strlen(elementStr));
-    free(elementStr);
+    return OUTPUT_OK;
   }
+  return writeNullBulkString(out);
+}
 
-  char *result = strndup(buffer->buffer, buffer->used);
-  freeRespBuffer(buffer);
-  return result;
+// Appends one entry as [id, [field, value, ...]]
+static int writeStreamEntry(OutputBuffer *out, StreamEntry *entry) {
+  if (writeArrayHeader(out, 2) != OUTPUT_OK ||
+      writeBulkString(out, entry->id, strlen(entry->id)) != OUTPUT_OK ||
+      writeArrayHeader(out, entry->numFields * 2) != OUTPUT_OK)
+    return OUTPUT_ERR;
+
+  for (size_t i = 0; i < entry->numFields; i++) {
+    if (writeBulkString(out, entry->fields[i], strlen(entry->fields[i])) !=
+            OUTPUT_OK ||
+        writeBulkString(out, entry->values[i], strlen(entry->values[i])) !=
+            OUTPUT_OK)
+      return OUTPUT_ERR;
+  }
+  return OUTPUT_OK;
 }
 
-char *createXrangeResponse(StreamEntry *entries, size_t count) {
+int writeXrangeResponse(OutputBuffer *out, StreamEntry *entries,
+                        size_t count) {
   if (!entries || count == 0) {
-    return createRespArray(NULL, 0);
+    return writeArrayHeader(out, 0);
   }
 
-  RespBuffer *buffer = createRespBuffer();
-  char header[32];
-  snprintf(header, sizeof(header), "*%zu\r\n", count);
-  appendRespBuffer(buffer, header, strlen(header));
-
+  if (writeArrayHeader(out, count) != OUTPUT_OK)
+    return OUTPUT_ERR;
   for (StreamEntry *entry = entries; entry; entry = entry->next) {
-    appendRespBuffer(buffer, "*2\r\n", 4);
-    char *idStr = createBulkString(entry->id, strlen(entry->id));
-    appendRespBuffer(buffer, idStr, strlen(idStr));
-    free(idStr);
-
-    char fieldsHeader[32];
-    snprintf(fieldsHeader, sizeof(fieldsHeader), "*%zu\r\n",
-             entry->numFields * 2);
-    appendRespBuffer(buffer, fieldsHeader, strlen(fieldsHeader));
-
-    for (size_t i = 0; i < entry->numFields; i++) {
-      char *fieldStr =
-          createBulkString(entry->fields[i], strlen(entry->fields[i]));
-      char *valueStr =
-          createBulkString(entry->values[i], strlen(entry->values[i]));
-      appendRespBuffer(buffer, fieldStr, strlen(fieldStr));
-      appendRespBuffer(buffer, valueStr, strlen(valueStr));
-      free(fieldStr);
-      free(valueStr);
-    }
+    if (writeStreamEntry(out, entry) != OUTPUT_OK)
+      return OUTPUT_ERR;
   }
-
-  char *result = strndup(buffer->buffer, buffer->used);
-  freeRespBuffer(buffer);
-  return result;
+  return OUTPUT_OK;
 }
 
-char *createXreadResponse(StreamInfo *streams, size_t numStreams) {
-  RespBuffer *buffer = createRespBuffer();
-  char header[32];
-  snprintf(header, sizeof(header), "*%zu\r\n", numStreams);
-  appendRespBuffer(buffer, header, strlen(header));
+int writeXreadResponse(OutputBuffer *out, StreamInfo *streams,
+                       size_t numStreams) {
+  if (writeArrayHeader(out, numStreams) != OUTPUT_OK)
+    return OUTPUT_ERR;
 
   for (size_t i = 0; i < numStreams; i++) {
     StreamInfo *streamInfo = &streams[i];
-    appendRespBuffer(buffer, "*2\r\n", 4);
-
-    char *keyStr = createBulkString(streamInfo->key, strlen(streamInfo->key));
-    appendRespBuffer(buffer, keyStr, strlen(keyStr));
-    free(keyStr);
+    if (writeArrayHeader(out, 2) != OUTPUT_OK ||
+        writeBulkString(out, streamInfo->key, strlen(streamInfo->key)) !=
+            OUTPUT_OK)
+      return OUTPUT_ERR;
 
     if (!streamInfo->entries || streamInfo->count == 0) {
-      appendRespBuffer(buffer, "*0\r\n", 4);
+      if (writeArrayHeader(out, 0) != OUTPUT_OK)
+        return OUTPUT_ERR;
       continue;
     }
 
-    appendRespBuffer(buffer, "*1\r\n", 4);
-    appendRespBuffer(buffer, "*2\r\n", 4);
-
-    char *idStr = createBulkString(streamInfo->entries->id,
-                                   strlen(streamInfo->entries->id));
-    appendRespBuffer(buffer, idStr, strlen(idStr));
-    free(idStr);
-
-    char fieldsHeader[32];
-    snprintf(fieldsHeader, sizeof(fieldsHeader), "*%zu\r\n",
-             streamInfo->entries->numFields * 2);
-    appendRespBuffer(buffer, fieldsHeader, strlen(fieldsHeader));
-
-    for (size_t j = 0; j < streamInfo->entries->numFields; j++) {
-      char *fieldStr = createBulkString(streamInfo->entries->fields[j],
-                                        strlen(streamInfo->entries->fields[j]));
-      char *valueStr = createBulkString(streamInfo->entries->values[j],
-                                        strlen(streamInfo->entries->values[j]));
-      appendRespBuffer(buffer, fieldStr, strlen(fieldStr));
-      appendRespBuffer(buffer, valueStr, strlen(valueStr));
-      free(fieldStr);
-      free(valueStr);
-    }
+    // Only the first entry of each stream is returned
+    if (writeArrayHeader(out, 1) != OUTPUT_OK ||
+        writeStreamEntry(out, streamInfo->entries) != OUTPUT_OK)
+      return OUTPUT_ERR;
   }
-
-  char *result = strndup(buffer->buffer, buffer->used);
-  freeRespBuffer(buffer);
-  return result;
+  return OUTPUT_OK;
 }
 
 // Format Resp funcs
@@ -267,12 +349,19 @@ int parseLine(const char *data, size_t len, size_t *lineLen, char **line) {
 }
 
 RespValue *createRespString(const char *str, size_t len) {
-  RespValue *value = malloc(sizeof(RespValue));
+  RespValue *value = slabAlloc(sizeof(RespValue));
+  if (!value)
+    return NULL;
   value->type = RespTypeBulk;
-  value->data.string.str = malloc(len + 1);
+  value->data.string.str = slabAlloc(len + 1);
+  if (!value->data.string.str) {
+    slabFree(value);
+    return NULL;
+  }
   memcpy(value->data.string.str, str, len);
   value->data.string.str[len] = '\0';
   value->data.string.len = len;
+  value->data.string.shared = NULL;
   return value;
 }
 
@@ -284,16 +373,18 @@ static int parseBulkString(const char *data, size_t len, RespValue **value,
     return RESP_INCOMPLETE;
   }
 
-  int strLen = atoi(line + 1);
+  long long strLen = strtoll(line + 1, NULL, 10);
   free(line);
   *consumed = lineLen + 2;
 
-  if (strLen < 0)
+  if (strLen < 0 || strLen > RESP_MAX_BULK_LEN)
     return RESP_ERR;
   if (len < *consumed + strLen + 2)
     return RESP_INCOMPLETE;
 
   *value = createRespString(data + *consumed, strLen);
+  if (!*value)
+    return RESP_ERR;
   *consumed += strLen + 2;
   return RESP_OK;
 }
@@ -306,22 +397,38 @@ static int parseArray(const char *data, size_t len, RespValue **value,
     return RESP_INCOMPLETE;
   }
 
-  int arrayLen = atoi(line + 1);
+  long long arrayLen = strtoll(line + 1, NULL, 10);
   free(line);
   *consumed = lineLen + 2;
 
-  if (arrayLen < 0)
+  // The length comes from the peer, so bound it before sizing anything
+  if (arrayLen < 0 || arrayLen > RESP_MAX_ARGS)
     return RESP_ERR;
+  // Every element takes at least "$0\r\n\r\n", wait for that much data
+  // before allocating for it
+  if ((size_t)arrayLen > (len - *consumed) / 6)
+    return RESP_INCOMPLETE;
 
-  RespValue *arrayValue = malloc(sizeof(RespValue));
+  RespValue *arrayValue = slabAlloc(sizeof(RespValue));
+  if (!arrayValue)
+    return RESP_ERR;
   arrayValue->type = RespTypeArray;
+  arrayValue->data.array.len = 0;
+  arrayValue->data.array.handler = NULL;
+  arrayValue->data.array.elements =
+      slabAlloc((size_t)arrayLen * sizeof(RespValue *));
+  if (!arrayValue->data.array.elements) {
+    slabFree(arrayValue);
+    return RESP_ERR;
+  }
   arrayValue->data.array.len = arrayLen;
-  arrayValue->data.array.elements = malloc(sizeof(RespValue *) * arrayLen);
+  memset(arrayValue->data.array.elements, 0,
+         (size_t)arrayLen * sizeof(RespValue *));
 
   data += *consumed;
   len -= *consumed;
 
-  for (int i = 0; i < arrayLen; i++) {
+  for (long long i = 0; i < arrayLen; i++) {
     size_t elementConsumed;
     int result = parseBulkString(data, len, &arrayValue->data.array.elements[i],
                                  &elementConsumed);
@@ -339,33 +446,261 @@ static int parseArray(const char *data, size_t len, RespValue **value,
 }
 
 int parseResp(RespBuffer *buffer, RespValue **value) {
-  if (buffer->used < 3)
+  const char *data = buffer->buffer + buffer->pos;
+  size_t len = buffer->used - buffer->pos;
+  if (len < 3)
     return RESP_INCOMPLETE;
 
   size_t consumed;
   int result;
 
-  switch (buffer->buffer[0]) {
+  switch (data[0]) {
   case '*':
-    result = parseArray(buffer->buffer, buffer->used, value, &consumed);
+    result = parseArray(data, len, value, &consumed);
     break;
   case '$':
-    result = parseBulkString(buffer->buffer, buffer->used, value, &consumed);
+    result = parseBulkString(data, len, value, &consumed);
     break;
   default:
     return RESP_ERR;
   }
 
   if (result == RESP_OK) {
-    memmove(buffer->buffer, buffer->buffer + consumed, buffer->used - consumed);
-    buffer->used -= consumed;
+    consumeRespBuffer(buffer, consumed);
   }
 
   return result;
 }
 
+/*
+ * Zero-copy parsing
+ * -----------------
+ */
+
+// Parses a "<type><number>\r\n" header starting at data. Sets *number and
+// the offset just past the CRLF in *consumed.
+static int parseHeader(const char *data, size_t len, char type,
+                       long long *number, size_t *consumed) {
+  if (len == 0)
+    return RESP_INCOMPLETE;
+  if (data[0] != type)
+    return RESP_ERR;
+  const char *crlf = memchr(data, '\r', len);
+  if (!crlf)
+    return len > RESP_MAX_HEADER ? RESP_ERR : RESP_INCOMPLETE;
+  if ((size_t)(crlf - data) + 1 >= len)
+    return RESP_INCOMPLETE;
+  if (crlf[1] != '\n')
+    return RESP_ERR;
+
+  const char *p = data + 1;
+  int negative = 0;
+  if (p < crlf && *p == '-') {
+    negative = 1;
+    p++;
+  }
+  if (p == crlf)
+    return RESP_ERR;
+
+  long long n = 0;
+  for (; p < crlf; p++) {
+    if (*p < '0' || *p > '9' || n > (LLONG_MAX - 9) / 10)
+      return RESP_ERR;
+    n = n * 10 + (*p - '0');
+  }
+
+  *number = negative ? -n : n;
+  *consumed = crlf - data + 2;
+  return RESP_OK;
+}
+
+static int reserveArgs(RespBuffer *buffer, size_t count) {
+  if (count <= buffer->argsCapacity)
+    return RESP_OK;
+
+  size_t capacity = buffer->argsCapacity ? buffer->argsCapacity : 8;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  RespValue *args = realloc(buffer->args, capacity * sizeof(RespValue));
+  if (!args)
+    return RESP_ERR;
+  buffer->args = args;
+
+  RespValue **argv = realloc(buffer->argv, capacity * sizeof(RespValue *));
+  if (!argv)
+    return RESP_ERR;
+  buffer->argv = argv;
+
+  size_t *offsets = realloc(buffer->argOffsets, capacity * sizeof(size_t));
+  if (!offsets)
+    return RESP_ERR;
+  buffer->argOffsets = offsets;
+
+  // args may have moved, rebuild every element pointer
+  for (size_t i = 0; i < capacity; i++) {
+    buffer->argv[i] = &buffer->args[i];
+  }
+  buffer->argsCapacity = capacity;
+  return RESP_OK;
+}
+
+// Gives back the slots an oversized command grew, once it has been served
+static void releaseArgs(RespBuffer *buffer) {
+  if (buffer->argsCapacity <= RESP_ARGS_RETAIN)
+    return;
+  free(buffer->args);
+  free(buffer->argv);
+  free(buffer->argOffsets);
+  buffer->args = NULL;
+  buffer->argv = NULL;
+  buffer->argOffsets = NULL;
+  buffer->argsCapacity = 0;
+}
+
+// Scans one bulk string at data into slice without touching the buffer
+static int scanBulkString(const char *data, size_t len, RespValue *slice,
+                          size_t *consumed) {
+  long long strLen;
+  size_t headerLen;
+  int result = parseHeader(data, len, '$', &strLen, &headerLen);
+  if (result != RESP_OK)
+    return result;
+  if (strLen < 0 || strLen > RESP_MAX_BULK_LEN)
+    return RESP_ERR;
+  if (len - headerLen < (size_t)strLen + 2)
+    return RESP_INCOMPLETE;
+  if (data[headerLen + strLen] != '\r' || data[headerLen + strLen + 1] != '\n')
+    return RESP_ERR;
+
+  slice->type = RespTypeBulk;
+  slice->data.string.str = (char *)data + headerLen;
+  slice->data.string.len = strLen;
+  slice->data.string.shared = NULL;
+  *consumed = headerLen + strLen + 2;
+  return RESP_OK;
+}
+
+// Scans as many arguments of the pending command as are buffered, resuming
+// where the previous call stopped. Offsets are kept relative to pos since
+// the data may move when the buffer is compacted or grown.
+static int scanArguments(RespBuffer *buffer) {
+  while (buffer->parsedArgs < (size_t)buffer->pendingArgs) {
+    size_t available = buffer->used - buffer->pos - buffer->scanned;
+
+    if (buffer->bulkLen < 0) {
+      long long bulkLen;
+      size_t headerLen;
+      int result =
+          parseHeader(buffer->buffer + buffer->pos + buffer->scanned,
+                      available, '$', &bulkLen, &headerLen);
+      if (result != RESP_OK)
+        return result;
+      if (bulkLen < 0 || bulkLen > RESP_MAX_BULK_LEN)
+        return RESP_ERR;
+      buffer->bulkLen = bulkLen;
+      buffer->scanned += headerLen;
+      available -= headerLen;
+
+      // Size the buffer for a big argument now rather than doubling it
+      // repeatedly while it trickles in
+      if (bulkLen >= RESP_BIG_ARG && (size_t)bulkLen + 2 > available &&
+          reserveRespBuffer(buffer, bulkLen + 2 - available) != RESP_OK)
+        return RESP_ERR;
+    }
+
+    size_t argLen = buffer->bulkLen;
+    if (available < argLen + 2)
+      return RESP_INCOMPLETE;
+
+    // Slots are added as arguments arrive, never for what a header claims
+    if (reserveArgs(buffer, buffer->parsedArgs + 1) != RESP_OK)
+      return RESP_ERR;
+
+    const char *arg = buffer->buffer + buffer->pos + buffer->scanned;
+    if (arg[argLen] != '\r' || arg[argLen + 1] != '\n')
+      return RESP_ERR;
+
+    buffer->argOffsets[buffer->parsedArgs] = buffer->scanned;
+    buffer->args[buffer->parsedArgs].data.string.len = argLen;
+    buffer->parsedArgs++;
+    buffer->scanned += argLen + 2;
+    buffer->bulkLen = -1;
+  }
+  return RESP_OK;
+}
+
+int parseRespInPlace(RespBuffer *buffer, RespValue **value) {
+  char *data = buffer->buffer + buffer->pos;
+  size_t len = buffer->used - buffer->pos;
+  RespValue *command = &buffer->command;
+  int result;
+
+  if (buffer->pendingArgs < 0) {
+    if (len < 3)
+      return RESP_INCOMPLETE;
+
+    if (data[0] == '$') {
+      size_t consumed;
+      result = scanBulkString(data, len, command, &consumed);
+      if (result != RESP_OK)
+        return result;
+      command->data.string.str[command->data.string.len] = '\0';
+      consumeRespBuffer(buffer, consumed);
+      *value = command;
+      return RESP_OK;
+    }
+
+    long long arrayLen;
+    size_t headerLen;
+    result = parseHeader(data, len, '*', &arrayLen, &headerLen);
+    if (result != RESP_OK)
+      return result;
+    if (arrayLen < 0 || arrayLen > RESP_MAX_ARGS)
+      return RESP_ERR;
+
+    // The previous command is done with its slots. Presize only as far as
+    // a header can be trusted, the rest grows as arguments arrive.
+    releaseArgs(buffer);
+    if (reserveArgs(buffer, arrayLen < RESP_ARGS_RETAIN ? arrayLen
+                                                        : RESP_ARGS_RETAIN) !=
+        RESP_OK)
+      return RESP_ERR;
+
+    buffer->pendingArgs = arrayLen;
+    buffer->parsedArgs = 0;
+    buffer->bulkLen = -1;
+    buffer->scanned = headerLen;
+  }
+
+  result = scanArguments(buffer);
+  if (result != RESP_OK)
+    return result;
+
+  // Complete: point the slices at the data and terminate each one by
+  // overwriting the \r that follows it
+  data = buffer->buffer + buffer->pos;
+  for (long long i = 0; i < buffer->pendingArgs; i++) {
+    RespValue *arg = &buffer->args[i];
+    arg->type = RespTypeBulk;
+    arg->data.string.str = data + buffer->argOffsets[i];
+    arg->data.string.str[arg->data.string.len] = '\0';
+    arg->data.string.shared = NULL;
+  }
+
+  command->type = RespTypeArray;
+  command->data.array.elements = buffer->argv;
+  command->data.array.len = buffer->pendingArgs;
+  command->data.array.handler = NULL;
+  consumeRespBuffer(buffer, buffer->scanned);
+  buffer->pendingArgs = -1;
+  *value = command;
+  return RESP_OK;
+}
+
 RespValue *parseResponseToRespValue(const char *response) {
-  RespValue *value = malloc(sizeof(RespValue));
+  RespValue *value = slabAlloc(sizeof(RespValue));
   size_t consumed;
 
   switch (response[0]) {
@@ -374,12 +709,13 @@ RespValue *parseResponseToRespValue(const char *response) {
     char *line;
     size_t lineLen;
     parseLine(response, strlen(response), &lineLen, &line);
-    RespValue *newValue = malloc(sizeof(RespValue));
+    RespValue *newValue = slabAlloc(sizeof(RespValue));
     newValue->type = (response[0] == '+') ? RespTypeString : RespTypeError;
-    newValue->data.string.str = strdup(line + 1);
+    newValue->data.string.str = slabStrdup(line + 1);
     newValue->data.string.len = lineLen - 1;
+    newValue->data.string.shared = NULL;
     free(line);
-    free(value);
+    slabFree(value);
     value = newValue;
     break;
   }
@@ -416,25 +752,28 @@ void freeRespValue(RespValue *value) {
   case RespTypeString:
   case RespTypeBulk:
   case RespTypeError:
-    free(value->data.string.str);
+    if (value->data.string.shared)
+      releaseSharedValue(value->data.string.shared);
+    else
+      slabFree(value->data.string.str);
     break;
   case RespTypeArray:
     for (size_t i = 0; i < value->data.array.len; i++) {
       freeRespValue(value->data.array.elements[i]);
     }
-    free(value->data.array.elements);
+    slabFree(value->data.array.elements);
     break;
   case RespTypeInteger:
     break;
   }
-  free(value);
+  slabFree(value);
 }
 
 RespValue *cloneRespValue(RespValue *original) {
   if (!original)
     return NULL;
 
-  RespValue *clone = malloc(sizeof(RespValue));
+  RespValue *clone = slabAlloc(sizeof(RespValue));
   clone->type = original->type;
 
   switch (original->type) {
@@ -442,7 +781,21 @@ RespValue *cloneRespValue(RespValue *original) {
   case RespTypeBulk:
   case RespTypeError:
     clone->data.string.len = original->data.string.len;
-    clone->data.string.str = malloc(original->data.string.len + 1);
+    clone->data.string.shared = NULL;
+    // Large arguments are shared, so queued transactions, the store and
+    // replication streams all reference the one copy made here
+    if (original->data.string.shared ||
+        (original->type == RespTypeBulk &&
+         original->data.string.len >= SHARED_VALUE_MIN_REF)) {
+      clone->data.string.shared =
+          original->data.string.shared
+              ? retainSharedValue(original->data.string.shared)
+              : createSharedValue(original->data.string.str,
+                                  original->data.string.len);
+      clone->data.string.str = clone->data.string.shared->data;
+      break;
+    }
+    clone->data.string.str = slabAlloc(original->data.string.len + 1);
     memcpy(clone->data.string.str, original->data.string.str,
            original->data.string.len);
     clone->data.string.str[original->data.string.len] = '\0';
@@ -450,8 +803,9 @@ RespValue *cloneRespValue(RespValue *original) {
 
   case RespTypeArray:
     clone->data.array.len = original->data.array.len;
+    clone->data.array.handler = original->data.array.handler;
     clone->data.array.elements =
-        malloc(sizeof(RespValue *) * original->data.array.len);
+        slabAlloc(sizeof(RespValue *) * original->data.array.len);
     for (size_t i = 0; i < original->data.array.len; i++) {
       clone->data.array.elements[i] =
           cloneRespValue(original->data.array.elements[i]);
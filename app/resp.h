@@ -1,6 +1,7 @@
 #ifndef RESP_H
 #define RESP_H
 
+#include "output_buffer.h"
 #include "stream.h"
 #include <stddef.h>
 #include <sys/types.h>
@@ -10,6 +11,11 @@
 #define RESP_ERR -1           /* Operation failed */
 #define RESP_INCOMPLETE 1     /* More data needed to complete parsing */
 #define RESP_BUFFER_SIZE 4096 /* Initial buffer size for RESP parsing */
+#define RESP_MAX_ARGS (1024 * 1024) /* Largest accepted command array */
+#define RESP_ARGS_RETAIN 64 /* Argument slots reserved up front and kept */
+#define RESP_MAX_BULK_LEN (512LL * 1024 * 1024) /* Largest accepted argument */
+#define RESP_BIG_ARG (32 * 1024) /* Arguments presized in the buffer */
+#define RESP_MAX_HEADER 32 /* Longest "*<len>" or "$<len>" header line */
 
 /**
  * RESP protocol value types
@@ -31,11 +37,14 @@ typedef struct RespValue {
     struct {
       char *str;  /* String data */
       size_t len; /* String length */
+      SharedValue *shared; /* Owns str when set, see cloneRespValue */
     } string;
     long long integer; /* Integer value */
     struct {
       struct RespValue **elements; /* Array elements */
       size_t len;                  /* Array length */
+      /* Command table entry, cached by resolveCommand, NULL until then */
+      const struct CommandHandler *handler;
     } array;
   } data;
 } RespValue;
@@ -47,6 +56,22 @@ typedef struct RespBuffer {
   char *buffer; /* Raw data buffer */
   size_t size;  /* Total buffer size */
   size_t used;  /* Amount of buffer currently used */
+  size_t pos;   /* Read cursor, bytes before it have been parsed */
+
+  /* Reusable storage for commands returned by parseRespInPlace */
+  RespValue command;   /* Parsed command */
+  RespValue *args;     /* Argument slices pointing into buffer */
+  RespValue **argv;    /* Pointers to args, used as the array elements */
+  size_t *argOffsets;  /* Offsets of argument data from pos */
+  size_t argsCapacity; /* Number of slots in args, argv and argOffsets,
+                          grown as arguments arrive */
+
+  /* Progress through a partially received command, kept so that each byte
+   * is scanned once however many reads the command spans */
+  long long pendingArgs; /* Array length, -1 until the header is parsed */
+  size_t parsedArgs;     /* Arguments fully received */
+  long long bulkLen;     /* Length of the next argument, -1 until known */
+  size_t scanned;        /* Offset from pos where scanning resumes */
 } RespBuffer;
 
 /**
@@ -70,6 +95,16 @@ void freeRespBuffer(RespBuffer *buffer);
  */
 int appendRespBuffer(RespBuffer *buffer, const char *data, size_t len);
 
+/**
+ * Makes room for at least len more bytes after the buffered data, moving
+ * unparsed data to the front before growing. Lets callers read straight into
+ * buffer + used.
+ * @param buffer Buffer to grow
+ * @param len Number of free bytes required
+ * @return RESP_OK on success, RESP_ERR on allocation failure
+ */
+int reserveRespBuffer(RespBuffer *buffer, size_t len);
+
 /**
  * Parses RESP protocol data from buffer
  * @param buffer Buffer containing RESP data
@@ -79,6 +114,25 @@ int appendRespBuffer(RespBuffer *buffer, const char *data, size_t len);
  */
 int parseResp(RespBuffer *buffer, RespValue **value);
 
+/**
+ * Parses the next command without copying it. The returned value and its
+ * strings point into the buffer's own storage: bulk strings are NUL
+ * terminated in place and no memory is allocated for typical commands. The
+ * value is owned by the buffer, must not be freed, and stays valid only
+ * until the next parse or append on the same buffer (use cloneRespValue to
+ * keep it longer).
+ *
+ * Parsing is incremental: a command that is still incomplete is not scanned
+ * again from its first byte when more data arrives, and the buffer is sized
+ * up front for a large argument once its length header is seen. Do not mix
+ * with parseResp on the same buffer.
+ * @param buffer Buffer containing RESP data
+ * @param value Pointer to store the borrowed value
+ * @return RESP_OK on success, RESP_ERR on failure, RESP_INCOMPLETE if more data
+ * needed
+ */
+int parseRespInPlace(RespBuffer *buffer, RespValue **value);
+
 /**
  * Frees a RESP value and all its contents
  * @param value Value to free
@@ -113,6 +167,87 @@ char *createXreadResponse(StreamInfo *streams, size_t numStreams);
 char *createFormattedBulkString(const char *format, ...);
 char *createFormattedSimpleString(const char *format, ...);
 
+/*
+ * Streaming encoders: append a RESP reply straight to an output buffer with
+ * known lengths, without intermediate allocations. Each returns OUTPUT_OK or
+ * OUTPUT_ERR on allocation failure.
+ */
+
+/**
+ * Appends a simple string (+str)
+ * @param out Buffer to append to
+ * @param str Status text, must not contain CR or LF
+ */
+int writeSimpleString(OutputBuffer *out, const char *str);
+
+/**
+ * Appends an error (-message)
+ * @param out Buffer to append to
+ * @param message Error text, must not contain CR or LF
+ */
+int writeError(OutputBuffer *out, const char *message);
+
+/**
+ * Appends an integer (:num)
+ * @param out Buffer to append to
+ * @param num Value to encode
+ */
+int writeInteger(OutputBuffer *out, long long num);
+
+/**
+ * Appends a binary-safe bulk string ($len)
+ * @param out Buffer to append to
+ * @param str String data, may contain NUL bytes
+ * @param len Length of str
+ */
+int writeBulkString(OutputBuffer *out, const char *str, size_t len);
+
+/**
+ * Appends a shared value as a bulk string, referencing large values
+ * instead of copying them
+ * @param out Buffer to append to
+ * @param value Value to encode, the buffer takes its own reference
+ */
+int writeSharedBulkString(OutputBuffer *out, SharedValue *value);
+
+/**
+ * Appends a null bulk string ($-1)
+ * @param out Buffer to append to
+ */
+int writeNullBulkString(OutputBuffer *out);
+
+/**
+ * Appends an array header (*count). The caller writes the count elements
+ * that follow.
+ * @param out Buffer to append to
+ * @param count Number of elements
+ */
+int writeArrayHeader(OutputBuffer *out, size_t count);
+
+/**
+ * Appends any parsed RESP value, recursing into arrays
+ * @param out Buffer to append to
+ * @param value Value to encode
+ */
+int writeRespValue(OutputBuffer *out, RespValue *value);
+
+/**
+ * Appends an XRANGE reply for a list of entries
+ * @param out Buffer to append to
+ * @param entries Linked list of entries, may be NULL
+ * @param count Number of entries
+ */
+int writeXrangeResponse(OutputBuffer *out, StreamEntry *entries, size_t count);
+
+/**
+ * Appends an XREAD reply
+ * @param out Buffer to append to
+ * @param streams Per-stream read results
+ * @param numStreams Number of streams
+ */
+int writeXreadResponse(OutputBuffer *out, StreamInfo *streams,
+                       size_t numStreams);
+
 RespValue *createRespString(const char *str, size_t len);
 RespValue *cloneRespValue(RespValue *original);
 RespValue *parseResponseToRespValue(const char *response);
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 ;
 
@@ -20,10 +21,12 @@ void *handleReplicationThread(void *args) {
   return NULL;
 }
 
+// The master streams commands as arrays of bulk strings
 static bool isValidCommand(RespValue *command) {
   return command->type == RespTypeArray && command->data.array.len > 0 &&
          command->data.array.elements[0] &&
-         command->data.array.elements[0]->type == RespTypeString;
+         (command->data.array.elements[0]->type == RespTypeBulk ||
+          command->data.array.elements[0]->type == RespTypeString);
 }
 
 static bool isReplconfGetack(RespValue *command) {
@@ -89,12 +92,12 @@ int handleReplicationCommands(RedisServer *server, int fd) {
 
           processCommand(server, command, fd);
 
-          printf("Previous Repl offset: %llu\n",
-                 server->repl_info->repl_offset);
+          printf("Previous Repl offset: %llu\n", replicationOffset(server));
 
-          server->repl_info->repl_offset += cmd_bytes;
+          __atomic_add_fetch(&server->repl_info->repl_offset, cmd_bytes,
+                             __ATOMIC_RELAXED);
 
-          printf(" New Repl offset: %llu\n", server->repl_info->repl_offset);
+          printf(" New Repl offset: %llu\n", replicationOffset(server));
         }
         freeRespValue(command);
       }
@@ -115,6 +118,8 @@ RedisServer *createServer(ServerConfig *config) {
   server->bindaddr = config->bindaddr;
   server->dir = config->dir;
   server->filename = config->dbfilename;
+  // A replica applies the replication stream to db, so it keeps one keyspace
+  server->shared_nothing = config->shared_nothing && !config->is_replica;
 
   // Initialize replication info
   server->repl_info = malloc(sizeof(ReplicationInfo));
@@ -152,7 +157,7 @@ RedisServer *createServer(ServerConfig *config) {
   server->clients_count = 0;
 
   // Initialize storage
-  server->db = createStore();
+  server->db = createShardedStore(config->store_shards);
   if (!server->db) {
     freeServer(server);
     return NULL;
@@ -162,6 +167,9 @@ RedisServer *createServer(ServerConfig *config) {
   server->total_commands_processed = 0;
   server->keyspace_hits = 0;
   server->keyspace_misses = 0;
+  server->expire_budget_us = CRON_EXPIRE_BUDGET_US;
+  server->expire_cycle_us = 0;
+  server->expire_time_cap_count = 0;
 
   return server;
 }
@@ -213,6 +221,12 @@ void freeServer(RedisServer *server) {
     freeStore(server->db);
   }
 
+  for (int i = 0; i < server->partition_count; i++) {
+    freeStore(server->partitions[i]);
+  }
+  free(server->partitions);
+  free(server->partition_budgets_us);
+
   if (server->dir) {
     free(server->dir);
   }
@@ -235,4 +249,100 @@ void freeServer(RedisServer *server) {
   free(server);
 }
 
-void serverCron(RedisServer *server) { clearExpired(server->db); }
+int createServerPartitions(RedisServer *server, int count) {
+  server->partitions = calloc(count, sizeof(RedisStore *));
+  server->partition_budgets_us = calloc(count, sizeof(long long));
+  if (!server->partitions || !server->partition_budgets_us) {
+    return -1;
+  }
+  for (int i = 0; i < count; i++) {
+    // Only the owning reactor ever touches a partition, its cron included,
+    // so the store needs neither shards nor locks
+    server->partitions[i] = createOwnedStore();
+    if (!server->partitions[i]) {
+      return -1;
+    }
+    server->partition_budgets_us[i] = CRON_EXPIRE_BUDGET_US;
+    server->partition_count = i + 1;
+  }
+  return 0;
+}
+
+int keyPartition(RedisServer *server, const char *key, size_t keyLen) {
+  // Map the high half of the hash onto [0, count) without a division; the
+  // partition's own table probes with the low bits
+  uint64_t high = storeKeyHash(key, keyLen) >> 32;
+  return (int)((high * (uint64_t)server->partition_count) >> 32);
+}
+
+static long long monotonicUs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// Expires due keys of a store within its current budget. The wheel only
+// yields keys that are due, so instead of sampling for stale keys the
+// effort adapts to whether the last cycle could keep up.
+static void activeExpireCycle(RedisServer *server, RedisStore *store,
+                              long long *budgetUs) {
+  long long budget = *budgetUs;
+  long long start = monotonicUs();
+  int incomplete = 0;
+  storeActiveExpire(store, budget, &incomplete);
+  __atomic_add_fetch(&server->expire_cycle_us, monotonicUs() - start,
+                     __ATOMIC_RELAXED);
+
+  if (incomplete) {
+    __atomic_add_fetch(&server->expire_time_cap_count, 1, __ATOMIC_RELAXED);
+    budget = budget * 2 < CRON_EXPIRE_BUDGET_MAX_US ? budget * 2
+                                                    : CRON_EXPIRE_BUDGET_MAX_US;
+  } else {
+    budget = budget / 2 > CRON_EXPIRE_BUDGET_US ? budget / 2
+                                                : CRON_EXPIRE_BUDGET_US;
+  }
+  __atomic_store_n(budgetUs, budget, __ATOMIC_RELAXED);
+}
+
+void serverCron(RedisServer *server, int reactor) {
+  RedisStore *store;
+  long long *budgetUs;
+  if (server->partition_count > 0) {
+    // Each reactor maintains its own partition, which no other thread may
+    // touch, and the cycles run in parallel on full budgets
+    if (reactor >= server->partition_count) {
+      return;
+    }
+    store = server->partitions[reactor];
+    budgetUs = &server->partition_budgets_us[reactor];
+  } else {
+    if (reactor != 0) {
+      return;
+    }
+    store = server->db;
+    budgetUs = &server->expire_budget_us;
+  }
+  // A resize also advances on every insert, this finishes it when writes
+  // are rare so the old slot array does not linger
+  storeRehash(store, CRON_REHASH_BUDGET_US);
+  activeExpireCycle(server, store, budgetUs);
+}
+
+long long serverExpireBudget(RedisServer *server) {
+  long long budget =
+      __atomic_load_n(&server->expire_budget_us, __ATOMIC_RELAXED);
+  for (int i = 0; i < server->partition_count; i++) {
+    long long partition =
+        __atomic_load_n(&server->partition_budgets_us[i], __ATOMIC_RELAXED);
+    budget = partition > budget ? partition : budget;
+  }
+  return budget;
+}
+
+size_t serverExpiredKeys(RedisServer *server) {
+  size_t expired = server->db ? storeExpiredKeys(server->db) : 0;
+  for (int i = 0; i < server->partition_count; i++) {
+    expired += storeExpiredKeys(server->partitions[i]);
+  }
+  return expired;
+}
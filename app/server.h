@@ -5,6 +5,13 @@
 #include "handshake.h"
 #include "redis_store.h"
 
+#define SERVER_CRON_INTERVAL_MS 100 /* Time between serverCron runs */
+#define CRON_REHASH_BUDGET_US 1000  /* Keyspace rehash time per cron run */
+#define CRON_EXPIRE_BUDGET_US 2000  /* Active expiry time per cron run */
+#define CRON_EXPIRE_BUDGET_MAX_US 25000 /* Budget cap while expired keys pile up */
+
+struct EventLoop;
+
 typedef struct RedisServer {
   // Networking
   int fd;            // Main server socket file descriptor
@@ -13,9 +20,22 @@ typedef struct RedisServer {
   int tcp_backlog;   // TCP listen() backlog
   int clients_count; // Connected clients counter
 
+  // Blocking commands. Clients wait parked on their reactors, which are
+  // signalled when an XADD or a replica ACK may let them answer.
+  struct EventLoop *reactors;  // Every event loop, linked by nextReactor
+  int blocked_clients;         // Clients with a blocking command pending
+  unsigned long block_signals; // Signals raised so far
+
   // Data Storage
   RedisStore *db; // Main key-value storage
 
+  // Shared-nothing mode: reactor i owns partitions[i] and keys are routed to
+  // their owner instead of being shared through db
+  bool shared_nothing;             // Requested by configuration
+  RedisStore **partitions;         // One store per reactor, NULL when not in use
+  long long *partition_budgets_us; // Active expiry budget of each partition
+  int partition_count;             // Number of partitions, 0 when not in use
+
   // RDB File
   char *dir;
   char *filename;
@@ -28,6 +48,11 @@ typedef struct RedisServer {
   long long total_commands_processed;
   long long keyspace_hits;
   long long keyspace_misses;
+
+  // Active expiry, run by serverCron and read by INFO from any thread
+  long long expire_budget_us;      // Budget of the next cycle on db
+  long long expire_cycle_us;       // Time spent in cycles so far
+  long long expire_time_cap_count; // Cycles that ran out of budget
 } RedisServer;
 
 typedef struct {
@@ -58,15 +83,54 @@ int initServer(RedisServer *server);
 void freeServer(RedisServer *server);
 
 /**
- * Periodic server tasks handler.
+ * Creates one keyspace partition per reactor for shared-nothing mode.
+ *
+ * @param server Pointer to RedisServer instance
+ * @param count Number of reactors
+ * @return 0 on success, -1 on failure
+ */
+int createServerPartitions(RedisServer *server, int count);
+
+/**
+ * Returns the partition owning a key.
+ *
+ * @param server Pointer to RedisServer instance with partitions
+ * @param key Key bytes
+ * @param keyLen Key length
+ * @return Partition index in [0, partition_count)
+ */
+int keyPartition(RedisServer *server, const char *key, size_t keyLen);
+
+/**
+ * Periodic server tasks handler, run by every reactor each
+ * SERVER_CRON_INTERVAL_MS. Reactor 0 maintains db, or in shared-nothing
+ * mode each reactor maintains the partition it owns.
  * Handles tasks like:
- * - Expired keys cleanup
- * - Statistics updates
- * - Health checks
+ * - Incremental keyspace rehashing
+ * - Active expiry, reclaiming keys whose TTL passed without being read.
+ *   Its budget doubles while cycles end with keys still due, up to
+ *   CRON_EXPIRE_BUDGET_MAX_US, and halves back once they keep up.
+ *
+ * @param server Pointer to RedisServer instance
+ * @param reactor Id of the calling reactor
+ */
+void serverCron(RedisServer *server, int reactor);
+
+/**
+ * Reads the active expiry budget, the largest one in shared-nothing mode
+ *
+ * @param server Pointer to RedisServer instance
+ * @return Budget of the next cycle in microseconds
+ */
+long long serverExpireBudget(RedisServer *server);
+
+/**
+ * Counts the keys deleted because their TTL passed, across every keyspace
  *
  * @param server Pointer to RedisServer instance
+ * @return Keys expired since the server started
  */
-void serverCron(RedisServer *server);
+size_t serverExpiredKeys(RedisServer *server);
 
 int handleReplicationCommands(RedisServer *server, int fd);
 
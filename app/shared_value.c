@@ -0,0 +1,31 @@
+#include "shared_value.h"
+#include "slab.h"
+#include <stdlib.h>
+#include <string.h>
+
+SharedValue *createSharedValue(const void *data, size_t len) {
+  SharedValue *value = slabAlloc(sizeof(SharedValue) + len + 1);
+  if (!value) {
+    return NULL;
+  }
+  value->refcount = 1;
+  value->len = len;
+  memcpy(value->data, data, len);
+  value->data[len] = '\0';
+  return value;
+}
+
+SharedValue *retainSharedValue(SharedValue *value) {
+  __atomic_add_fetch(&value->refcount, 1, __ATOMIC_RELAXED);
+  return value;
+}
+
+void releaseSharedValue(SharedValue *value) {
+  if (!value) {
+    return;
+  }
+  // Release orders this holder's reads before the free by the last holder
+  if (__atomic_sub_fetch(&value->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+    slabFree(value);
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef SHARED_VALUE_H
+#define SHARED_VALUE_H
+
+#include <stddef.h>
+
+/* Values at least this long are shared by reference instead of copied into
+ * replies, queued transactions and replication streams */
+#define SHARED_VALUE_MIN_REF 4096
+
+/**
+ * Immutable reference-counted byte string. The bytes never change after
+ * creation: an overwrite installs a new SharedValue and releases the old
+ * one, so every holder keeps seeing the bytes it took a reference to.
+ */
+typedef struct SharedValue {
+  int refcount; /* Updated atomically */
+  size_t len;
+  char data[]; /* len bytes followed by a NUL for convenience */
+} SharedValue;
+
+/**
+ * Creates a shared value holding a copy of the given bytes
+ * @param data Bytes to copy
+ * @param len Length of data
+ * @return New SharedValue with one reference, or NULL on failure
+ */
+SharedValue *createSharedValue(const void *data, size_t len);
+
+/**
+ * Takes another reference to a shared value
+ * @param value Value to retain
+ * @return value, for chaining
+ */
+SharedValue *retainSharedValue(SharedValue *value);
+
+/**
+ * Drops a reference, freeing the value when it was the last one
+ * @param value Value to release, may be NULL
+ */
+void releaseSharedValue(SharedValue *value);
+
+#endif
@@ -0,0 +1,255 @@
+#include "slab.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * Every slab object lives in one reserved address range, split into spans
+ * that each serve a single size class. A pointer belongs to the allocator
+ * iff it falls in the range, and its span index gives its class, so
+ * objects need no header and freeing needs no size.
+ */
+
+static const uint16_t classSizes[SLAB_CLASSES] = {
+    16,  32,  48,  64,  80,  96,  112, 128, 160, 192,
+    224, 256, 320, 384, 448, 512, 640, 768, 896, 1024};
+
+typedef struct SlabClass {
+  pthread_mutex_t lock;
+  void *freeList;
+  char *bump; /* Uncarved part of the newest span */
+  char *bumpEnd;
+  size_t spans;
+  size_t objects;
+  size_t free;
+  size_t acquisitions;
+  size_t contended;
+} __attribute__((aligned(64))) SlabClass;
+
+typedef struct SlabCache {
+  void *lists[SLAB_CLASSES];
+  uint32_t counts[SLAB_CLASSES];
+  int registered; /* Flushed back to the classes on thread exit */
+} SlabCache;
+
+static SlabClass classes[SLAB_CLASSES];
+static __thread SlabCache threadCache;
+
+static pthread_once_t slabOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t cacheKey;
+static char *regionBase;
+static char *regionEnd;
+static size_t regionCursor;    /* Bytes carved into spans */
+static uint8_t *spanClasses;   /* Class of each span, by span index */
+static size_t mallocFallbacks;
+
+// 16-byte steps up to 128, then four classes per doubling
+static inline int classFor(size_t size) {
+  if (size <= 128) {
+    return size ? (int)((size - 1) >> 4) : 0;
+  }
+  int log = 63 - __builtin_clzll(size - 1);
+  return 8 + (log - 7) * 4 + (int)(((size - 1) >> (log - 2)) & 3);
+}
+
+static inline int isSlab(const void *ptr) {
+  const char *p = ptr;
+  return p >= __atomic_load_n(&regionBase, __ATOMIC_RELAXED) &&
+         p < __atomic_load_n(&regionEnd, __ATOMIC_RELAXED);
+}
+
+static inline int classOf(const void *ptr) {
+  return spanClasses[((const char *)ptr - regionBase) / SLAB_SPAN_SIZE];
+}
+
+static void lockClass(SlabClass *class) {
+  if (pthread_mutex_trylock(&class->lock) != 0) {
+    pthread_mutex_lock(&class->lock);
+    class->contended++;
+  }
+  class->acquisitions++;
+}
+
+// Returns up to count cached objects of a class to its central freelist
+static void flushCache(SlabCache *cache, int cls, uint32_t count) {
+  SlabClass *class = &classes[cls];
+  void *list = cache->lists[cls];
+  void *last = list;
+  for (uint32_t i = 1; i < count; i++) {
+    last = *(void **)last;
+  }
+  cache->lists[cls] = *(void **)last;
+  cache->counts[cls] -= count;
+
+  lockClass(class);
+  *(void **)last = class->freeList;
+  class->freeList = list;
+  class->free += count;
+  class->objects -= count;
+  pthread_mutex_unlock(&class->lock);
+}
+
+static void flushThreadCache(void *arg) {
+  SlabCache *cache = arg;
+  for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+    if (cache->counts[cls]) {
+      flushCache(cache, cls, cache->counts[cls]);
+    }
+  }
+}
+
+static void initSlab(void) {
+  for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+    pthread_mutex_init(&classes[cls].lock, NULL);
+  }
+  pthread_key_create(&cacheKey, flushThreadCache);
+
+  // Only the address space is reserved, pages are committed as spans are
+  // first touched. Without a reservation every request goes to malloc.
+  size_t spans = SLAB_REGION_SIZE / SLAB_SPAN_SIZE;
+  spanClasses = calloc(spans, 1);
+  void *region = MAP_FAILED;
+  if (spanClasses) {
+    region = mmap(NULL, SLAB_REGION_SIZE, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+  if (region == MAP_FAILED) {
+    free(spanClasses);
+    spanClasses = NULL;
+    return;
+  }
+  __atomic_store_n(&regionBase, (char *)region, __ATOMIC_RELAXED);
+  __atomic_store_n(&regionEnd, (char *)region + SLAB_REGION_SIZE,
+                   __ATOMIC_RELEASE);
+}
+
+// Gives the class a fresh span to carve, called with its lock held
+static int carveSpan(SlabClass *class, int cls) {
+  size_t offset =
+      __atomic_fetch_add(&regionCursor, SLAB_SPAN_SIZE, __ATOMIC_RELAXED);
+  if (offset + SLAB_SPAN_SIZE > SLAB_REGION_SIZE) {
+    return 0;
+  }
+  spanClasses[offset / SLAB_SPAN_SIZE] = cls;
+  class->bump = regionBase + offset;
+  class->bumpEnd =
+      class->bump + SLAB_SPAN_SIZE / classSizes[cls] * classSizes[cls];
+  class->spans++;
+  return 1;
+}
+
+// Moves a batch of objects from a class into the empty thread cache
+static void refillCache(SlabCache *cache, int cls) {
+  pthread_once(&slabOnce, initSlab);
+  if (!regionEnd) {
+    return;
+  }
+  if (!cache->registered) {
+    pthread_setspecific(cacheKey, cache);
+    cache->registered = 1;
+  }
+
+  SlabClass *class = &classes[cls];
+  size_t size = classSizes[cls];
+  void *list = NULL;
+  uint32_t moved = 0;
+
+  lockClass(class);
+  while (moved < SLAB_BATCH) {
+    void *obj = class->freeList;
+    if (obj) {
+      class->freeList = *(void **)obj;
+      class->free--;
+    } else {
+      if (class->bump == class->bumpEnd && !carveSpan(class, cls)) {
+        break;
+      }
+      obj = class->bump;
+      class->bump += size;
+    }
+    *(void **)obj = list;
+    list = obj;
+    moved++;
+  }
+  class->objects += moved;
+  pthread_mutex_unlock(&class->lock);
+
+  cache->lists[cls] = list;
+  cache->counts[cls] = moved;
+}
+
+void *slabAlloc(size_t size) {
+  if (size <= SLAB_MAX_SIZE) {
+    int cls = classFor(size);
+    SlabCache *cache = &threadCache;
+    if (!cache->lists[cls]) {
+      refillCache(cache, cls);
+    }
+    void *obj = cache->lists[cls];
+    if (obj) {
+      cache->lists[cls] = *(void **)obj;
+      cache->counts[cls]--;
+      return obj;
+    }
+  }
+  __atomic_add_fetch(&mallocFallbacks, 1, __ATOMIC_RELAXED);
+  return malloc(size);
+}
+
+void slabFree(void *ptr) {
+  if (!isSlab(ptr)) {
+    free(ptr);
+    return;
+  }
+  int cls = classOf(ptr);
+  SlabCache *cache = &threadCache;
+  if (!cache->registered) {
+    pthread_setspecific(cacheKey, cache);
+    cache->registered = 1;
+  }
+  *(void **)ptr = cache->lists[cls];
+  cache->lists[cls] = ptr;
+  if (++cache->counts[cls] > SLAB_CACHE_MAX) {
+    flushCache(cache, cls, SLAB_BATCH);
+  }
+}
+
+char *slabStrdup(const char *str) {
+  size_t len = strlen(str) + 1;
+  char *copy = slabAlloc(len);
+  if (copy) {
+    memcpy(copy, str, len);
+  }
+  return copy;
+}
+
+size_t slabUsableSize(void *ptr) {
+  return isSlab(ptr) ? classSizes[classOf(ptr)] : malloc_usable_size(ptr);
+}
+
+void slabGetStats(SlabStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  pthread_once(&slabOnce, initSlab);
+  if (regionEnd) {
+    stats->regionBytes = SLAB_REGION_SIZE;
+  }
+  stats->mallocFallbacks =
+      __atomic_load_n(&mallocFallbacks, __ATOMIC_RELAXED);
+
+  for (int cls = 0; cls < SLAB_CLASSES; cls++) {
+    SlabClass *class = &classes[cls];
+    SlabClassStats *out = &stats->classes[cls];
+    pthread_mutex_lock(&class->lock);
+    out->size = classSizes[cls];
+    out->spans = class->spans;
+    out->objects = class->objects;
+    out->free = class->free;
+    stats->lockAcquisitions += class->acquisitions;
+    stats->lockContended += class->contended;
+    pthread_mutex_unlock(&class->lock);
+    stats->spanBytes += out->spans * SLAB_SPAN_SIZE;
+  }
+}
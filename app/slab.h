@@ -0,0 +1,73 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#define SLAB_MAX_SIZE 1024          /* Larger requests go to malloc */
+#define SLAB_CLASSES 20             /* Size classes from 16 to SLAB_MAX_SIZE */
+#define SLAB_SPAN_SIZE (64 * 1024)  /* Unit carved from the region per class */
+#define SLAB_REGION_SIZE ((size_t)64 << 30) /* Address space reserved */
+#define SLAB_BATCH 32     /* Objects moved between a thread and a class */
+#define SLAB_CACHE_MAX 64 /* Objects a thread caches per class */
+
+/**
+ * Occupancy of one size class
+ */
+typedef struct SlabClassStats {
+  size_t size;    /* Object size */
+  size_t spans;   /* Spans carved for the class */
+  size_t objects; /* Objects held by threads, in use or thread-cached */
+  size_t free;    /* Objects on the central freelist */
+} SlabClassStats;
+
+/**
+ * Allocator counters, gathered from the central state only
+ */
+typedef struct SlabStats {
+  size_t regionBytes;      /* Address space reserved, 0 if slabs are off */
+  size_t spanBytes;        /* Spans carved from the region */
+  size_t lockAcquisitions; /* Central freelist lock acquisitions */
+  size_t lockContended;    /* Acquisitions that had to wait */
+  size_t mallocFallbacks;  /* Allocations served by malloc */
+  SlabClassStats classes[SLAB_CLASSES];
+} SlabStats;
+
+/**
+ * Allocates a block. Requests up to SLAB_MAX_SIZE are rounded up to a size
+ * class and served from the calling thread's cache, which refills from and
+ * spills to per-class central freelists in batches, so the common case
+ * takes no lock. Larger requests, and all requests once the reserved
+ * region is used up, fall back to malloc.
+ * @param size Bytes needed
+ * @return Block aligned to 16 bytes, or NULL on failure
+ */
+void *slabAlloc(size_t size);
+
+/**
+ * Frees a block from slabAlloc. Blocks from plain malloc are accepted too
+ * and handed to free, so ownership can cross the two freely.
+ * @param ptr Block to free, may be NULL
+ */
+void slabFree(void *ptr);
+
+/**
+ * Copies a NUL-terminated string into a slab block
+ * @param str String to copy
+ * @return Copy to release with slabFree, or NULL on failure
+ */
+char *slabStrdup(const char *str);
+
+/**
+ * Returns the bytes usable in a block, which may exceed the request
+ * @param ptr Block from slabAlloc or malloc
+ * @return Usable size in bytes
+ */
+size_t slabUsableSize(void *ptr);
+
+/**
+ * Snapshots the allocator counters
+ * @param stats Filled with the current counters
+ */
+void slabGetStats(SlabStats *stats);
+
+#endif
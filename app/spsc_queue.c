@@ -0,0 +1,55 @@
+#include "spsc_queue.h"
+#include <stdlib.h>
+
+SpscQueue *createSpscQueue(size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) {
+    size *= 2;
+  }
+
+  SpscQueue *queue;
+  if (posix_memalign((void **)&queue, SPSC_CACHE_LINE, sizeof(SpscQueue)) !=
+      0) {
+    return NULL;
+  }
+  queue->items = malloc(size * sizeof(void *));
+  if (!queue->items) {
+    free(queue);
+    return NULL;
+  }
+  queue->mask = size - 1;
+  queue->head = 0;
+  queue->tail = 0;
+  return queue;
+}
+
+void freeSpscQueue(SpscQueue *queue) {
+  if (!queue) {
+    return;
+  }
+  free(queue->items);
+  free(queue);
+}
+
+int spscPush(SpscQueue *queue, void *item) {
+  size_t tail = queue->tail;
+  // Acquire pairs with the consumer's release so the slot is really free
+  size_t head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+  if (tail - head > queue->mask) {
+    return -1;
+  }
+  queue->items[tail & queue->mask] = item;
+  // Publish the item before the consumer can see the new tail
+  __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void *spscPop(SpscQueue *queue) {
+  size_t head = queue->head;
+  if (head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+  void *item = queue->items[head & queue->mask];
+  __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+  return item;
+}
@@ -0,0 +1,49 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+
+#define SPSC_CACHE_LINE 64
+
+/**
+ * Bounded lock-free queue of pointers for exactly one producer thread and
+ * one consumer thread. The producer only writes tail and the consumer only
+ * writes head, each on its own cache line, so the two sides never contend
+ * on a lock and only share a line when the queue runs nearly empty.
+ */
+typedef struct SpscQueue {
+  void **items;
+  size_t mask; /* Capacity - 1, capacity is a power of two */
+  size_t head __attribute__((aligned(SPSC_CACHE_LINE))); /* Next to pop */
+  size_t tail __attribute__((aligned(SPSC_CACHE_LINE))); /* Next to push */
+} SpscQueue;
+
+/**
+ * Creates an empty queue
+ * @param capacity Minimum number of items, rounded up to a power of two
+ * @return Newly allocated SpscQueue or NULL on failure
+ */
+SpscQueue *createSpscQueue(size_t capacity);
+
+/**
+ * Frees the queue. Items still queued are not freed.
+ * @param queue Queue to free
+ */
+void freeSpscQueue(SpscQueue *queue);
+
+/**
+ * Appends an item. Must only be called from the producer thread.
+ * @param queue Queue to push to
+ * @param item Non-NULL item
+ * @return 0 on success, -1 if the queue is full
+ */
+int spscPush(SpscQueue *queue, void *item);
+
+/**
+ * Removes the oldest item. Must only be called from the consumer thread.
+ * @param queue Queue to pop from
+ * @return Oldest item or NULL if the queue is empty
+ */
+void *spscPop(SpscQueue *queue);
+
+#endif
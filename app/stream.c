@@ -1,68 +1,53 @@
 #include "stream.h"
+#include "clock.h"
+#include "slab.h"
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <time.h>
 
-static StreamBlockState stream_block_state = {
-    .mutex = PTHREAD_MUTEX_INITIALIZER,
-    .condition = PTHREAD_COND_INITIALIZER,
-    .has_new_data = false};
+// Scratch copies come from the arena when there is one, otherwise they are
+// owned by the caller and released with freeStreamEntry
+static void *copyAlloc(Arena *arena, size_t size) {
+  return arena ? arenaAlloc(arena, size) : slabAlloc(size);
+}
 
-static uint64_t getCurrentTimeMs() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
+static char *copyString(Arena *arena, const char *str) {
+  return arena ? arenaStrdup(arena, str) : slabStrdup(str);
 }
 
-static StreamEntry *copyStreamEntry(const StreamEntry *source) {
+static StreamEntry *copyStreamEntry(const StreamEntry *source, Arena *arena) {
   if (!source) {
     return NULL;
   }
 
-  StreamEntry *copy = malloc(sizeof(StreamEntry));
+  StreamEntry *copy = copyAlloc(arena, sizeof(StreamEntry));
   if (!copy) {
     return NULL;
   }
 
-  copy->id = strdup(source->id);
-  if (!copy->id) {
-    free(copy);
-    return NULL;
-  }
-
-  copy->numFields = source->numFields;
-  copy->fields = malloc(source->numFields * sizeof(char *));
-  copy->values = malloc(source->numFields * sizeof(char *));
+  copy->id = copyString(arena, source->id);
+  copy->numFields = 0;
+  copy->fields = copyAlloc(arena, source->numFields * sizeof(char *));
+  copy->values = copyAlloc(arena, source->numFields * sizeof(char *));
   copy->next = NULL;
 
-  if (!copy->fields || !copy->values) {
-    free(copy->id);
-    free(copy->fields);
-    free(copy->values);
-    free(copy);
-    return NULL;
+  bool copied = copy->id && copy->fields && copy->values;
+  for (size_t i = 0; copied && i < source->numFields; i++) {
+    copy->fields[i] = copyString(arena, source->fields[i]);
+    copy->values[i] = copyString(arena, source->values[i]);
+    copy->numFields = i + 1;
+    copied = copy->fields[i] && copy->values[i];
   }
 
-  for (size_t i = 0; i < source->numFields; i++) {
-    copy->fields[i] = strdup(source->fields[i]);
-    copy->values[i] = strdup(source->values[i]);
-    
-    if (!copy->fields[i] || !copy->values[i]) {
-      // Cleanup on failure
-      for (size_t j = 0; j <= i; j++) {
-        free(copy->fields[j]);
-        free(copy->values[j]);
-      }
-      free(copy->fields);
-      free(copy->values);
-      free(copy->id);
-      free(copy);
-      return NULL;
+  if (!copied) {
+    // Arena copies are reclaimed by the next reset
+    if (!arena) {
+      freeStreamEntry(copy);
     }
+    return NULL;
   }
-
   return copy;
 }
 
@@ -93,7 +78,7 @@ int compareStreamIDs(const StreamID *id1, const StreamID *id2) {
 }
 
 Stream *createStream(void) {
-  Stream *stream = malloc(sizeof(Stream));
+  Stream *stream = slabAlloc(sizeof(Stream));
   if (!stream) {
     return NULL;
   }
@@ -108,7 +93,7 @@ bool parseStreamID(const char *id, StreamID *parsed) {
   }
 
   if (strcmp(id, "*") == 0) {
-    parsed->ms = getCurrentTimeMs();
+    parsed->ms = (uint64_t)clockNowMs();
     parsed->seq = UINT64_MAX;
     return true;
   }
@@ -209,45 +194,42 @@ char *streamAdd(Stream *stream, const char *id, char **fields, char **values,
                   "target stream top item");
   }
 
-  char *finalId = generateStreamID(parsedId.ms, parsedId.seq);
-  if (!finalId) {
-    return NULL;
-  }
+  char finalId[32];
+  snprintf(finalId, sizeof(finalId), "%lu-%lu", parsedId.ms, parsedId.seq);
 
-  StreamEntry *entry = malloc(sizeof(StreamEntry));
+  StreamEntry *entry = slabAlloc(sizeof(StreamEntry));
   if (!entry) {
-    free(finalId);
     return NULL;
   }
 
-  entry->id = finalId;
+  entry->id = slabStrdup(finalId);
   entry->numFields = numFields;
-  entry->fields = malloc(numFields * sizeof(char *));
-  entry->values = malloc(numFields * sizeof(char *));
+  entry->fields = slabAlloc(numFields * sizeof(char *));
+  entry->values = slabAlloc(numFields * sizeof(char *));
   entry->next = NULL;
 
-  if (!entry->fields || !entry->values) {
-    free(entry->fields);
-    free(entry->values);
-    free(finalId);
-    free(entry);
+  if (!entry->id || !entry->fields || !entry->values) {
+    slabFree(entry->fields);
+    slabFree(entry->values);
+    slabFree(entry->id);
+    slabFree(entry);
     return NULL;
   }
 
   for (size_t i = 0; i < numFields; i++) {
-    entry->fields[i] = strdup(fields[i]);
-    entry->values[i] = strdup(values[i]);
+    entry->fields[i] = slabStrdup(fields[i]);
+    entry->values[i] = slabStrdup(values[i]);
     
     if (!entry->fields[i] || !entry->values[i]) {
       // Cleanup on failure
       for (size_t j = 0; j <= i; j++) {
-        free(entry->fields[j]);
-        free(entry->values[j]);
+        slabFree(entry->fields[j]);
+        slabFree(entry->values[j]);
       }
-      free(entry->fields);
-      free(entry->values);
-      free(finalId);
-      free(entry);
+      slabFree(entry->fields);
+      slabFree(entry->values);
+      slabFree(entry->id);
+      slabFree(entry);
       return NULL;
     }
   }
@@ -259,11 +241,6 @@ char *streamAdd(Stream *stream, const char *id, char **fields, char **values,
   }
   stream->tail = entry;
 
-  pthread_mutex_lock(&stream_block_state.mutex);
-  stream_block_state.has_new_data = true;
-  pthread_cond_broadcast(&stream_block_state.condition);
-  pthread_mutex_unlock(&stream_block_state.mutex);
-
   return strdup(finalId);
 }
 
@@ -278,11 +255,11 @@ void freeStream(Stream *stream) {
     freeStreamEntry(current);
     current = next;
   }
-  free(stream);
+  slabFree(stream);
 }
 
 StreamEntry *streamRange(Stream *stream, const char *start, const char *end,
-                         size_t *count) {
+                         size_t *count, Arena *arena) {
   if (!stream || !start || !end || !count) {
     return NULL;
   }
@@ -315,7 +292,7 @@ StreamEntry *streamRange(Stream *stream, const char *start, const char *end,
     }
 
     if (isIdInRange(&entryId, &startId, &endId)) {
-      StreamEntry *newEntry = copyStreamEntry(entry);
+      StreamEntry *newEntry = copyStreamEntry(entry, arena);
       if (!newEntry) {
         // Cleanup and return what we have so far
         break;
@@ -334,7 +311,8 @@ StreamEntry *streamRange(Stream *stream, const char *start, const char *end,
   return result;
 }
 
-StreamEntry *streamRead(Stream *stream, const char *id, size_t *count) {
+StreamEntry *streamRead(Stream *stream, const char *id, size_t *count,
+                        Arena *arena) {
   if (!stream || !id || !count) {
     return NULL;
   }
@@ -356,7 +334,7 @@ StreamEntry *streamRead(Stream *stream, const char *id, size_t *count) {
 
     // Only include entries with ID greater than the provided ID
     if (compareStreamIDs(&entryId, &startId) > 0) {
-      StreamEntry *newEntry = copyStreamEntry(entry);
+      StreamEntry *newEntry = copyStreamEntry(entry, arena);
       if (!newEntry) {
         // Cleanup and return what we have so far
         break;
@@ -380,108 +358,14 @@ void freeStreamEntry(StreamEntry *entry) {
     return;
   }
 
-  free(entry->id);
+  slabFree(entry->id);
   if (entry->fields && entry->values) {
     for (size_t i = 0; i < entry->numFields; i++) {
-      free(entry->fields[i]);
-      free(entry->values[i]);
-    }
-  }
-  free(entry->fields);
-  free(entry->values);
-  free(entry);
-}
-
-StreamInfo *processStreamReads(Stream **streams, const char **keys,
-                               const char **ids, size_t numStreams,
-                               bool *hasData) {
-  if (!streams || !keys || !ids || !hasData || numStreams == 0) {
-    return NULL;
-  }
-
-  StreamInfo *streamInfos = malloc(numStreams * sizeof(StreamInfo));
-  if (!streamInfos) {
-    return NULL;
-  }
-
-  *hasData = false;
-
-  for (size_t i = 0; i < numStreams; i++) {
-    streamInfos[i].key = strdup(keys[i]);
-    if (!streamInfos[i].key) {
-      // Cleanup on failure
-      for (size_t j = 0; j < i; j++) {
-        free((void*)streamInfos[j].key);
-      }
-      free(streamInfos);
-      return NULL;
-    }
-
-    if (streams[i]) {
-      streamInfos[i].entries =
-          streamRead(streams[i], ids[i], &streamInfos[i].count);
-      if (streamInfos[i].count > 0) {
-        *hasData = true;
-      }
-    } else {
-      streamInfos[i].entries = NULL;
-      streamInfos[i].count = 0;
-    }
-  }
-  return streamInfos;
-}
-
-void freeStreamInfo(StreamInfo *streams, size_t numStreams) {
-  for (size_t i = 0; i < numStreams; i++) {
-    free((void *)streams[i].key);
-    StreamEntry *current = streams[i].entries;
-    while (current) {
-      StreamEntry *next = current->next;
-      freeStreamEntry(current);
-      current = next;
+      slabFree(entry->fields[i]);
+      slabFree(entry->values[i]);
     }
   }
-  free(streams);
+  slabFree(entry->fields);
+  slabFree(entry->values);
+  slabFree(entry);
 }
-
-bool waitForStreamData(StreamBlockState *state, int timeoutMs) {
-  struct timespec timeout;
-  clock_gettime(CLOCK_REALTIME, &timeout);
-  timeout.tv_sec += timeoutMs / 1000;
-  timeout.tv_nsec += (timeoutMs % 1000) * 1000000;
-
-  pthread_mutex_lock(&state->mutex);
-  state->has_new_data = false;
-  int result =
-      pthread_cond_timedwait(&state->condition, &state->mutex, &timeout);
-  pthread_mutex_unlock(&state->mutex);
-
-  return result != ETIMEDOUT;
-}
-
-StreamInfo *recheckStreams(Stream **streams, const char **keys,
-                           const char **ids, size_t numStreams) {
-  StreamInfo *streamInfos = malloc(numStreams * sizeof(StreamInfo));
-
-  for (size_t i = 0; i < numStreams; i++) {
-    streamInfos[i].key = strdup(keys[i]);
-    if (streams[i]) {
-      streamInfos[i].entries =
-          streamRead(streams[i], ids[i], &streamInfos[i].count);
-    } else {
-      streamInfos[i].entries = NULL;
-      streamInfos[i].count = 0;
-    }
-  }
-  return streamInfos;
-}
-
-bool waitForStreamDataInfinite(StreamBlockState *state) {
-  pthread_mutex_lock(&state->mutex);
-  state->has_new_data = false;
-  pthread_cond_wait(&state->condition, &state->mutex);
-  pthread_mutex_unlock(&state->mutex);
-  return true;
-}
-
-StreamBlockState *getStreamBlockState(void) { return &stream_block_state; }
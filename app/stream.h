@@ -1,7 +1,7 @@
 #ifndef STREAM_H
 #define STREAM_H
 
-#include <pthread.h>
+#include "arena.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -30,19 +30,16 @@ typedef struct Stream {
   StreamEntry *tail;
 } Stream;
 
-typedef struct {
-  pthread_mutex_t mutex;
-  pthread_cond_t condition;
-  bool has_new_data;
-} StreamBlockState;
-
 Stream *createStream(void);
 void freeStream(Stream *stream);
 char *streamAdd(Stream *stream, const char *id, char **fields, char **values,
                 size_t numFields);
+// Range and read results are copies. With an arena they live until its next
+// reset, without one the caller frees each entry with freeStreamEntry.
 StreamEntry *streamRange(Stream *stream, const char *start, const char *end,
-                         size_t *count);
-StreamEntry *streamRead(Stream *stream, const char *id, size_t *count);
+                         size_t *count, Arena *arena);
+StreamEntry *streamRead(Stream *stream, const char *id, size_t *count,
+                        Arena *arena);
 
 void freeStreamEntry(StreamEntry *entry);
 
@@ -54,13 +51,4 @@ bool parseStreamID(const char *id, StreamID *parsed);
 uint64_t getNextSequence(Stream *stream, uint64_t ms);
 char *generateStreamID(uint64_t ms, uint64_t seq);
 
-StreamInfo *processStreamReads(Stream **streams, const char **keys,
-                               const char **ids, size_t numStreams,
-                               bool *hasData);
-void freeStreamInfo(StreamInfo *streams, size_t numStreams);
-bool waitForStreamData(StreamBlockState *state, int timeoutMs);
-StreamInfo *recheckStreams(Stream **streams, const char **keys,
-                           const char **ids, size_t numStreams);
-StreamBlockState *getStreamBlockState(void);
-bool waitForStreamDataInfinite(StreamBlockState *state);
 #endif
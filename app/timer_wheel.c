@@ -0,0 +1,151 @@
+#include "timer_wheel.h"
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define WHEEL_SPAN (1LL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+void timerWheelInit(TimerWheel *wheel, long long now) {
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+      wheel->slots[level][slot] = NULL;
+    }
+    wheel->occupied[level] = 0;
+  }
+  wheel->now = now;
+  wheel->count = 0;
+}
+
+// Links a node into the slot covering its deadline, relative to wheel->now
+static void place(TimerWheel *wheel, TimerNode *node) {
+  long long at = node->when < wheel->now ? wheel->now : node->when;
+  long long delta = at - wheel->now;
+  if (delta >= WHEEL_SPAN) {
+    at = wheel->now + WHEEL_SPAN - 1;
+    delta = WHEEL_SPAN - 1;
+  }
+
+  int level = 0;
+  while (delta >= 1LL << (TIMER_WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+  int slot = (int)((at >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+
+  TimerNode **head = &wheel->slots[level][slot];
+  node->next = *head;
+  if (*head) {
+    (*head)->pprev = &node->next;
+  }
+  node->pprev = head;
+  *head = node;
+  wheel->occupied[level] |= 1ULL << slot;
+}
+
+static void unlinkNode(TimerWheel *wheel, TimerNode *node) {
+  *node->pprev = node->next;
+  if (node->next) {
+    node->next->pprev = node->pprev;
+  } else {
+    // A node whose link is a slot head and has no successor was alone
+    TimerNode **first = &wheel->slots[0][0];
+    TimerNode **last = &wheel->slots[TIMER_WHEEL_LEVELS - 1][SLOT_MASK];
+    if (node->pprev >= first && node->pprev <= last) {
+      size_t index = (size_t)(node->pprev - first);
+      wheel->occupied[index / TIMER_WHEEL_SLOTS] &=
+          ~(1ULL << (index % TIMER_WHEEL_SLOTS));
+    }
+  }
+  node->next = NULL;
+  node->pprev = NULL;
+}
+
+void timerWheelAdd(TimerWheel *wheel, TimerNode *node, long long when) {
+  node->when = when;
+  place(wheel, node);
+  wheel->count++;
+}
+
+void timerWheelRemove(TimerWheel *wheel, TimerNode *node) {
+  unlinkNode(wheel, node);
+  wheel->count--;
+}
+
+void timerWheelReplace(TimerNode *old, TimerNode *node) {
+  *node = *old;
+  *node->pprev = node;
+  if (node->next) {
+    node->next->pprev = &node->next;
+  }
+}
+
+// Moves the higher level slots that start at tick down the wheel. A level
+// is only reached when every level below it has wrapped around.
+static void cascade(TimerWheel *wheel, long long tick) {
+  for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+    int slot = (int)((tick >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    TimerNode *node = wheel->slots[level][slot];
+    wheel->slots[level][slot] = NULL;
+    wheel->occupied[level] &= ~(1ULL << slot);
+    while (node) {
+      TimerNode *next = node->next;
+      place(wheel, node);
+      node = next;
+    }
+    if (slot != 0) {
+      return;
+    }
+  }
+}
+
+// First tick after wheel->now at which a timer is due or a cascade moves
+// one. Slots behind the current one at a level belong to its next
+// rotation, which starts at a boundary of the level above.
+static long long nextTick(const TimerWheel *wheel) {
+  for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+    int shift = TIMER_WHEEL_BITS * level;
+    long long index = wheel->now >> shift;
+    int slot = (int)(index & SLOT_MASK);
+    uint64_t ahead =
+        slot == SLOT_MASK ? 0 : wheel->occupied[level] >> (slot + 1);
+    if (ahead) {
+      return (index + 1 + __builtin_ctzll(ahead)) << shift;
+    }
+    if (wheel->occupied[level]) {
+      return ((index | SLOT_MASK) + 1) << shift;
+    }
+  }
+  return wheel->now + 1;
+}
+
+long long timerWheelNextExpiry(const TimerWheel *wheel) {
+  if (wheel->count == 0) {
+    return -1;
+  }
+  if (wheel->slots[0][wheel->now & SLOT_MASK]) {
+    return wheel->now;
+  }
+  return nextTick(wheel);
+}
+
+TimerNode *timerWheelPop(TimerWheel *wheel, long long now) {
+  while (wheel->count > 0 && wheel->now <= now) {
+    TimerNode *node = wheel->slots[0][wheel->now & SLOT_MASK];
+    if (node) {
+      timerWheelRemove(wheel, node);
+      return node;
+    }
+
+    // Jump over ticks where nothing happens, cascading on arrival
+    long long next = nextTick(wheel);
+    if (next > now + 1) {
+      next = now + 1;
+    }
+    wheel->now = next;
+    if ((next & SLOT_MASK) == 0) {
+      cascade(wheel, next);
+    }
+  }
+  if (wheel->count == 0 && wheel->now <= now) {
+    // Nothing is scheduled, so no cascade can be missed
+    wheel->now = now + 1;
+  }
+  return NULL;
+}
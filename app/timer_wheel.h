@@ -0,0 +1,84 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS 6                        /* log2 of slots per level */
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS) /* Slots per level */
+#define TIMER_WHEEL_LEVELS 6 /* Spans 2^36 ticks, later deadlines wait */
+
+/**
+ * Intrusive link for a timer, embedded in the object it schedules
+ */
+typedef struct TimerNode {
+  struct TimerNode *next;
+  struct TimerNode **pprev; /* Link pointing at this node, NULL if idle */
+  long long when;           /* Deadline in ticks */
+} TimerNode;
+
+/**
+ * Hierarchical timing wheel. Level 0 has one slot per tick, each higher
+ * level has slots TIMER_WHEEL_SLOTS times wider. A timer goes in the level
+ * whose span covers its distance from now, and is moved down a level when
+ * the wheel reaches its slot, so adding and removing a timer are O(1) and
+ * each timer is moved at most TIMER_WHEEL_LEVELS - 1 times before it
+ * expires. Deadlines past the top level are parked in its farthest slot and
+ * placed again when it comes round.
+ *
+ * The wheel is not thread safe and does not own its nodes.
+ */
+typedef struct TimerWheel {
+  TimerNode *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+  uint64_t occupied[TIMER_WHEEL_LEVELS]; /* Bit per non-empty slot */
+  long long now;                         /* Next tick to expire */
+  size_t count;                          /* Scheduled timers */
+} TimerWheel;
+
+/**
+ * Prepares an empty wheel
+ * @param wheel Wheel to initialize
+ * @param now Current tick, earlier ticks count as already expired
+ */
+void timerWheelInit(TimerWheel *wheel, long long now);
+
+/**
+ * Schedules a timer. A deadline already passed expires on the next pop.
+ * @param wheel Wheel to add to
+ * @param node Idle timer node
+ * @param when Deadline in ticks
+ */
+void timerWheelAdd(TimerWheel *wheel, TimerNode *node, long long when);
+
+/**
+ * Cancels a scheduled timer, leaving the node idle
+ * @param wheel Wheel holding the node
+ * @param node Scheduled timer node
+ */
+void timerWheelRemove(TimerWheel *wheel, TimerNode *node);
+
+/**
+ * Moves a scheduled timer to another node, e.g. after its object was
+ * reallocated. The contents of old are copied into node first.
+ * @param old Node being replaced, no longer referenced afterwards
+ * @param node Node that takes its place
+ */
+void timerWheelReplace(TimerNode *old, TimerNode *node);
+
+/**
+ * Bounds how long the owner may sleep before popping again
+ * @param wheel Wheel to inspect
+ * @return Earliest tick at which timerWheelPop may have work, or -1 if
+ *         nothing is scheduled
+ */
+long long timerWheelNextExpiry(const TimerWheel *wheel);
+
+/**
+ * Removes one expired timer, advancing the wheel up to now as needed
+ * @param wheel Wheel to expire from
+ * @param now Current tick, timers with deadlines up to it are expired
+ * @return Idle node of an expired timer, or NULL if none is due
+ */
+TimerNode *timerWheelPop(TimerWheel *wheel, long long now);
+
+#endif
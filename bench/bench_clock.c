@@ -0,0 +1,86 @@
+#include "bench_framework.h"
+#include "clock.h"
+#include "redis_store.h"
+
+#define DEFAULT_CLOCK_KEYS 100000
+#define DEFAULT_CLOCK_OPS 10000000
+#define GETS_PER_UPDATE 64 /* GETs served per event loop iteration */
+
+static void countValue(const void *value, size_t valueLen,
+                       SharedValue *shared, void *ctx) {
+  (void)value;
+  (void)shared;
+  *(size_t *)ctx += valueLen;
+}
+
+// Times ops reads of the wall clock, returns ns per read
+static double runClockReads(size_t ops) {
+  long long sum = 0;
+  long long begin = benchNowNs();
+  for (size_t i = 0; i < ops; i++) {
+    sum += clockNowMs();
+  }
+  double elapsed = (double)(benchNowNs() - begin);
+  // Keep the reads from being optimized away
+  if (sum == 42) {
+    printf("  %lld\n", sum);
+  }
+  return elapsed / ops;
+}
+
+// GETs keys round robin, refreshing the cached clock every GETS_PER_UPDATE
+// when cached is set the way an event loop does, returns ns per GET
+static double runGets(RedisStore *store, size_t keys, size_t ops, int cached) {
+  char key[32];
+  size_t bytes = 0;
+  long long begin = benchNowNs();
+  for (size_t i = 0; i < ops; i++) {
+    if (cached && i % GETS_PER_UPDATE == 0) {
+      clockUpdate();
+    }
+    int len = snprintf(key, sizeof(key), "key:%zu", i % keys);
+    storeVisitValue(store, key, len, countValue, &bytes);
+  }
+  double elapsed = (double)(benchNowNs() - begin);
+  clockStopCaching();
+  if (bytes != ops * 5) {
+    printf("  missed keys: %zu of %zu bytes\n", bytes, ops * 5);
+  }
+  return elapsed / ops;
+}
+
+void run_clock_benchmarks(void) {
+  BENCH_HEADER("Clock: clock_gettime per read vs a clock cached per iteration");
+
+  size_t keys = benchEnvSize("BENCH_CLOCK_KEYS", DEFAULT_CLOCK_KEYS);
+  size_t ops = benchEnvSize("BENCH_CLOCK_OPS", DEFAULT_CLOCK_OPS);
+
+  double direct = runClockReads(ops);
+  clockUpdate();
+  double cached = runClockReads(ops);
+  clockStopCaching();
+  printf("  %-20s %10s %10s\n", "ns per op", "direct", "cached");
+  printf("  %-20s %10.1f %10.1f\n", "clock read", direct, cached);
+
+  // Keys with a TTL make every GET check the clock, keys without skip it
+  RedisStore *volatileKeys = createStore();
+  RedisStore *persistentKeys = createStore();
+  char key[32];
+  time_t expiry = getCurrentTimeMs() + 3600 * 1000;
+  for (size_t i = 0; i < keys; i++) {
+    int len = snprintf(key, sizeof(key), "key:%zu", i);
+    storeSet(volatileKeys, key, len, "value", 5);
+    setExpiry(volatileKeys, key, len, expiry);
+    storeSet(persistentKeys, key, len, "value", 5);
+  }
+  printf("  %-20s %10.1f %10.1f\n", "GET, key with TTL",
+         runGets(volatileKeys, keys, ops, 0),
+         runGets(volatileKeys, keys, ops, 1));
+  printf("  %-20s %10.1f %10.1f\n", "GET, key without TTL",
+         runGets(persistentKeys, keys, ops, 0),
+         runGets(persistentKeys, keys, ops, 1));
+  printf("  %zu keys, %zu GETs, clock refreshed every %d GETs when cached\n",
+         keys, ops, GETS_PER_UPDATE);
+  freeStore(volatileKeys);
+  freeStore(persistentKeys);
+}
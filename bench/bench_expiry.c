@@ -0,0 +1,159 @@
+#include "bench_framework.h"
+#include "redis_store.h"
+#include "server.h"
+#include "timer_wheel.h"
+#include <unistd.h>
+
+#define DEFAULT_EXPIRY_KEYS 10000000
+#define EXPIRY_WINDOW_MS 1000 /* TTLs are spread over this many ms */
+
+// Binary heap of deadlines, the O(log n) index the wheel is compared with
+typedef struct HeapTimer {
+  long long when;
+  TimerNode *node;
+} HeapTimer;
+
+static void heapPush(HeapTimer *heap, size_t *count, HeapTimer timer) {
+  size_t index = (*count)++;
+  while (index > 0 && heap[(index - 1) / 2].when > timer.when) {
+    heap[index] = heap[(index - 1) / 2];
+    index = (index - 1) / 2;
+  }
+  heap[index] = timer;
+}
+
+static HeapTimer heapPop(HeapTimer *heap, size_t *count) {
+  HeapTimer top = heap[0];
+  HeapTimer last = heap[--*count];
+  size_t index = 0;
+  for (;;) {
+    size_t child = index * 2 + 1;
+    if (child >= *count) {
+      break;
+    }
+    if (child + 1 < *count && heap[child + 1].when < heap[child].when) {
+      child++;
+    }
+    if (heap[child].when >= last.when) {
+      break;
+    }
+    heap[index] = heap[child];
+    index = child;
+  }
+  heap[index] = last;
+  return top;
+}
+
+// Deadlines up to an hour out, like session TTLs set over time
+static long long deadline(size_t i) {
+  return 1 + (long long)((i * 2654435761ULL) % 3600000);
+}
+
+static void benchIndexes(size_t count) {
+  TimerNode *nodes = malloc(count * sizeof(TimerNode));
+  HeapTimer *heap = malloc(count * sizeof(HeapTimer));
+
+  TimerWheel *wheel = malloc(sizeof(TimerWheel));
+  timerWheelInit(wheel, 0);
+  long long start = benchNowNs();
+  for (size_t i = 0; i < count; i++) {
+    timerWheelAdd(wheel, &nodes[i], deadline(i));
+  }
+  double wheelAdd = (double)(benchNowNs() - start) / count;
+
+  // Expire the hour in 100 ms steps, as serverCron would
+  size_t expired = 0;
+  start = benchNowNs();
+  for (long long now = 0; now <= 3600000; now += SERVER_CRON_INTERVAL_MS) {
+    while (timerWheelPop(wheel, now)) {
+      expired++;
+    }
+  }
+  double wheelExpire = (double)(benchNowNs() - start) / expired;
+
+  size_t heapCount = 0;
+  start = benchNowNs();
+  for (size_t i = 0; i < count; i++) {
+    heapPush(heap, &heapCount, (HeapTimer){deadline(i), &nodes[i]});
+  }
+  double heapAdd = (double)(benchNowNs() - start) / count;
+
+  start = benchNowNs();
+  for (long long now = 0; now <= 3600000; now += SERVER_CRON_INTERVAL_MS) {
+    while (heapCount > 0 && heap[0].when <= now) {
+      // Touch the node as the wheel does, expiring it means freeing it
+      heapPop(heap, &heapCount).node->pprev = NULL;
+    }
+  }
+  double heapExpire = (double)(benchNowNs() - start) / count;
+
+  printf("  %-12s %14s %14s\n", "index", "add ns/timer", "expire ns/timer");
+  printf("  %-12s %14.1f %14.1f\n", "timer wheel", wheelAdd, wheelExpire);
+  printf("  %-12s %14.1f %14.1f\n", "binary heap", heapAdd, heapExpire);
+
+  free(wheel);
+  free(heap);
+  free(nodes);
+}
+
+// Sets count keys with TTLs due within EXPIRY_WINDOW_MS, then reclaims them
+// the way serverCron does
+static void benchStore(size_t count) {
+  RedisStore *store = createStore();
+  char key[32];
+  time_t now = getCurrentTimeMs();
+
+  long long start = benchNowNs();
+  for (size_t i = 0; i < count; i++) {
+    int len = snprintf(key, sizeof(key), "session:%zu", i);
+    storeSet(store, key, len, "token", 5);
+    setExpiry(store, key, len, now + 1 + (time_t)(i % EXPIRY_WINDOW_MS));
+  }
+  double setNs = (double)(benchNowNs() - start) / count;
+
+  // Reschedule every tenth key, then overwrite every tenth, cancelling it
+  start = benchNowNs();
+  for (size_t i = 0; i < count; i += 10) {
+    int len = snprintf(key, sizeof(key), "session:%zu", i);
+    setExpiry(store, key, len, now + EXPIRY_WINDOW_MS);
+  }
+  double moveNs = (double)(benchNowNs() - start) / (count / 10);
+  for (size_t i = 5; i < count; i += 10) {
+    int len = snprintf(key, sizeof(key), "session:%zu", i);
+    storeSet(store, key, len, "token", 5);
+  }
+
+  usleep((EXPIRY_WINDOW_MS + 10) * 1000);
+
+  size_t expired = 0;
+  size_t ticks = 0;
+  start = benchNowNs();
+  size_t batch;
+  do {
+    batch = storeActiveExpire(store, CRON_EXPIRE_BUDGET_US, NULL);
+    expired += batch;
+    ticks++;
+  } while (batch > 0);
+  double elapsed = (double)(benchNowNs() - start);
+
+  printf("  SET + PX:          %8.1f ns/key\n", setNs);
+  printf("  PX reschedule:     %8.1f ns/key\n", moveNs);
+  printf("  active expiry:     %8.1f ns/key, %.2fM keys/s\n",
+         elapsed / expired, expired * 1e3 / elapsed);
+  printf("  %zu keys reclaimed in %zu cron runs of %d us, %zu overwritten "
+         "keys kept\n",
+         expired, ticks - 1, CRON_EXPIRE_BUDGET_US, storeSize(store));
+  freeStore(store);
+}
+
+void run_expiry_benchmarks(void) {
+  BENCH_HEADER("Expiry: timer wheel vs binary heap, and store active expiry");
+
+  size_t count = benchEnvSize("BENCH_EXPIRY_KEYS", DEFAULT_EXPIRY_KEYS);
+  printf("  %zu timers due over an hour, expired in %d ms steps\n", count,
+         SERVER_CRON_INTERVAL_MS);
+  benchIndexes(count);
+
+  printf("  %zu keys with TTLs due over %d ms\n", count, EXPIRY_WINDOW_MS);
+  benchStore(count);
+}
@@ -0,0 +1,32 @@
+#ifndef BENCH_FRAMEWORK_H
+#define BENCH_FRAMEWORK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Returns a monotonic timestamp in nanoseconds
+ */
+static inline long long benchNowNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * Reads a size override from the environment, e.g. BENCH_KEYS=10000000
+ */
+static inline size_t benchEnvSize(const char *name, size_t fallback) {
+  const char *value = getenv(name);
+  if (!value || !*value) {
+    return fallback;
+  }
+  return strtoull(value, NULL, 10);
+}
+
+#define BENCH_HEADER(title) \
+  printf("\n=== %s ===\n", title)
+
+#endif
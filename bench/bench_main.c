@@ -0,0 +1,43 @@
+#include "bench_framework.h"
+
+// Benchmark suite declarations
+void run_pipeline_benchmarks(void);
+void run_hash_table_benchmarks(void);
+void run_store_benchmarks(void);
+void run_memory_benchmarks(void);
+void run_slab_benchmarks(void);
+void run_expiry_benchmarks(void);
+void run_clock_benchmarks(void);
+
+typedef struct {
+  const char *name;
+  void (*run)(void);
+} BenchSuite;
+
+static const BenchSuite suites[] = {
+  {"pipeline", run_pipeline_benchmarks},
+  {"hash_table", run_hash_table_benchmarks},
+  {"store", run_store_benchmarks},
+  {"memory", run_memory_benchmarks},
+  {"slab", run_slab_benchmarks},
+  {"expiry", run_expiry_benchmarks},
+  {"clock", run_clock_benchmarks},
+};
+
+static const size_t suiteCount = sizeof(suites) / sizeof(suites[0]);
+
+int main(int argc, char **argv) {
+  // Without arguments every suite runs, otherwise only the named ones
+  for (size_t i = 0; i < suiteCount; i++) {
+    int selected = argc < 2;
+    for (int j = 1; j < argc; j++) {
+      if (strcmp(argv[j], suites[i].name) == 0) {
+        selected = 1;
+      }
+    }
+    if (selected) {
+      suites[i].run();
+    }
+  }
+  return 0;
+}
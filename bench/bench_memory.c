@@ -0,0 +1,116 @@
+#include "bench_framework.h"
+#include "redis_store.h"
+#include "slab.h"
+#include <malloc.h>
+
+#define DEFAULT_MEMORY_KEYS 10000000
+
+/*
+ * The entry layout the keyspace used before values were embedded: the
+ * entry, its key and its value were three separate allocations.
+ */
+typedef struct LegacyEntry {
+  char *key;
+  size_t keyLen;
+  uint64_t hash;
+  ValueType type;
+  SharedValue *value; /* Allocated with malloc, as it was then */
+  time_t expiry;
+} LegacyEntry;
+
+// Bytes held through malloc plus slab objects handed out
+static size_t heapInUse(void) {
+  struct mallinfo2 info = mallinfo2();
+  SlabStats stats;
+  slabGetStats(&stats);
+  size_t bytes = info.uordblks + info.hblkhd;
+  for (int i = 0; i < SLAB_CLASSES; i++) {
+    bytes += stats.classes[i].objects * stats.classes[i].size;
+  }
+  return bytes;
+}
+
+// Bytes held by the shard indexes rather than by the entries
+static size_t indexBytes(RedisStore *store) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < store->shardCount; i++) {
+    HashTable *table = store->shards[i].table;
+    for (int j = 0; j < 2; j++) {
+      size_t capacity = table->ht[j].capacity;
+      if (capacity) {
+        bytes += capacity * sizeof(StoreEntry *) + capacity + HT_GROUP_WIDTH;
+      }
+    }
+  }
+  return bytes;
+}
+
+static int formatValue(char *buf, size_t size, size_t i, int integer) {
+  return integer ? snprintf(buf, size, "%zu", i)
+                 : snprintf(buf, size, "value:%zu", i);
+}
+
+// Heap bytes per key of the three-allocation layout, index excluded
+static double legacyBytesPerKey(size_t count, int integer) {
+  LegacyEntry **entries = malloc(count * sizeof(LegacyEntry *));
+  size_t before = heapInUse();
+  for (size_t i = 0; i < count; i++) {
+    char key[32], value[32];
+    int keyLen = snprintf(key, sizeof(key), "key:%zu", i);
+    int valueLen = formatValue(value, sizeof(value), i, integer);
+    LegacyEntry *entry = malloc(sizeof(LegacyEntry));
+    entry->key = strdup(key);
+    entry->keyLen = keyLen;
+    entry->type = TYPE_STRING;
+    entry->value = malloc(sizeof(SharedValue) + valueLen + 1);
+    entry->value->refcount = 1;
+    entry->value->len = valueLen;
+    memcpy(entry->value->data, value, valueLen + 1);
+    entry->expiry = 0;
+    entries[i] = entry;
+  }
+  size_t used = heapInUse() - before;
+
+  for (size_t i = 0; i < count; i++) {
+    free(entries[i]->key);
+    free(entries[i]->value);
+    free(entries[i]);
+  }
+  free(entries);
+  return (double)used / count;
+}
+
+// Heap bytes per key of the store, split into entries and index
+static void storeBytesPerKey(size_t count, int integer, double *entryBytes,
+                             double *totalBytes) {
+  size_t before = heapInUse();
+  RedisStore *store = createStore();
+  for (size_t i = 0; i < count; i++) {
+    char key[32], value[32];
+    int keyLen = snprintf(key, sizeof(key), "key:%zu", i);
+    int valueLen = formatValue(value, sizeof(value), i, integer);
+    storeSet(store, key, keyLen, value, valueLen);
+  }
+  size_t used = heapInUse() - before;
+  *totalBytes = (double)used / count;
+  *entryBytes = (double)(used - indexBytes(store)) / count;
+  freeStore(store);
+}
+
+void run_memory_benchmarks(void) {
+  BENCH_HEADER("Memory: heap bytes per small key, three allocations vs embedded");
+
+  size_t count = benchEnvSize("BENCH_MEMORY_KEYS", DEFAULT_MEMORY_KEYS);
+  printf("  %zu keys \"key:N\"\n", count);
+  printf("  %-18s %10s %10s %10s %12s\n", "value", "legacy", "embedded",
+         "saved", "with index");
+
+  const char *labels[] = {"\"value:N\" string", "\"N\" integer"};
+  for (int integer = 0; integer <= 1; integer++) {
+    double legacy = legacyBytesPerKey(count, integer);
+    double entry, total;
+    storeBytesPerKey(count, integer, &entry, &total);
+    printf("  %-18s %10.1f %10.1f %10.1f %12.1f\n", labels[integer], legacy,
+           entry, legacy - entry, total);
+  }
+}
@@ -0,0 +1,115 @@
+#include "bench_framework.h"
+#include "config.h"
+#include "event_loop.h"
+#include "server.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define BENCH_PORT 17379
+
+static void *reactorThread(void *arg) {
+  runReactorGroup((ReactorGroup *)arg);
+  return NULL;
+}
+
+static int connectBenchClient(void) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(BENCH_PORT);
+  addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+  if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    close(sock);
+    return -1;
+  }
+  int nodelay = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+  return sock;
+}
+
+// Sends `ops` copies of `command` in batches of `depth` and waits for each
+// batch of fixed-size replies before sending the next one
+static double runPipeline(int sock, const char *command, size_t replyLen,
+                          size_t depth, size_t ops) {
+  size_t cmdLen = strlen(command);
+  char *batch = malloc(cmdLen * depth);
+  for (size_t i = 0; i < depth; i++) {
+    memcpy(batch + i * cmdLen, command, cmdLen);
+  }
+  char *replies = malloc(replyLen * depth);
+
+  long long start = benchNowNs();
+  for (size_t done = 0; done < ops; done += depth) {
+    send(sock, batch, cmdLen * depth, 0);
+    size_t expected = replyLen * depth;
+    size_t received = 0;
+    while (received < expected) {
+      ssize_t n = recv(sock, replies + received, expected - received, 0);
+      if (n <= 0) {
+        free(batch);
+        free(replies);
+        return 0;
+      }
+      received += n;
+    }
+  }
+  long long elapsed = benchNowNs() - start;
+
+  free(batch);
+  free(replies);
+  return (double)ops * 1e9 / elapsed;
+}
+
+void run_pipeline_benchmarks(void) {
+  BENCH_HEADER("Pipelining: ops/sec vs pipeline depth");
+
+  ServerConfig *config = calloc(1, sizeof(ServerConfig));
+  config->port = BENCH_PORT;
+  config->dir = strdup("/tmp");
+  config->dbfilename = strdup("bench.rdb");
+  config->bindaddr = strdup("127.0.0.1");
+  config->store_shards = STORE_DEFAULT_SHARDS;
+  config->shared_nothing = false;
+
+  RedisServer *server = createServer(config);
+  if (!server || initServer(server) != 0) {
+    printf("Failed to start benchmark server\n");
+    return;
+  }
+
+  ReactorGroup *group = createReactorGroup(server, 1);
+  pthread_t thread;
+  pthread_create(&thread, NULL, reactorThread, group);
+
+  int sock = connectBenchClient();
+  if (sock < 0) {
+    printf("Failed to connect to benchmark server\n");
+    return;
+  }
+
+  size_t ops = benchEnvSize("BENCH_OPS", 200000);
+  const size_t depths[] = {1, 2, 4, 8, 16, 32, 64, 128};
+  const char *set = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n";
+  const char *ping = "*1\r\n$4\r\nPING\r\n";
+
+  printf("%-8s %14s %14s\n", "depth", "PING ops/sec", "SET ops/sec");
+  for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+    size_t depth = depths[i];
+    size_t rounded = (ops / depth) * depth;
+    double pingRate = runPipeline(sock, ping, 7, depth, rounded);
+    double setRate = runPipeline(sock, set, 5, depth, rounded);
+    printf("%-8zu %14.0f %14.0f\n", depth, pingRate, setRate);
+  }
+
+  close(sock);
+  stopReactorGroup(group);
+  pthread_join(thread, NULL);
+  freeReactorGroup(group);
+  freeServer(server);
+  free(config);
+}
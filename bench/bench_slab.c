@@ -0,0 +1,66 @@
+#include "bench_framework.h"
+#include "slab.h"
+#include <pthread.h>
+
+#define DEFAULT_SLAB_OPS 10000000
+#define SLAB_BENCH_BURST 64
+
+typedef struct AllocBenchArgs {
+  void *(*alloc)(size_t);
+  void (*release)(void *);
+  size_t ops;
+} AllocBenchArgs;
+
+// Allocates bursts of entry-sized blocks and frees them, like a pipeline
+// of SETs followed by their replies being released
+static void *allocWorker(void *arg) {
+  AllocBenchArgs *args = (AllocBenchArgs *)arg;
+  void *blocks[SLAB_BENCH_BURST];
+  for (size_t done = 0; done < args->ops; done += SLAB_BENCH_BURST) {
+    for (int i = 0; i < SLAB_BENCH_BURST; i++) {
+      blocks[i] = args->alloc(24 + (size_t)(i * 13 % 100));
+      *(char *)blocks[i] = (char)i;
+    }
+    for (int i = 0; i < SLAB_BENCH_BURST; i++) {
+      args->release(blocks[i]);
+    }
+  }
+  return NULL;
+}
+
+static double runAllocBench(void *(*alloc)(size_t), void (*release)(void *),
+                            int threads, size_t ops) {
+  pthread_t workers[16];
+  AllocBenchArgs args = {alloc, release, ops / threads};
+  long long start = benchNowNs();
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&workers[i], NULL, allocWorker, &args);
+  }
+  for (int i = 0; i < threads; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  // Each op is one allocation and one free
+  return (double)(benchNowNs() - start) / (ops / threads);
+}
+
+void run_slab_benchmarks(void) {
+  BENCH_HEADER("Slab: small allocation + free, malloc vs size-class slabs");
+
+  size_t ops = benchEnvSize("BENCH_SLAB_OPS", DEFAULT_SLAB_OPS);
+  printf("  %zu alloc/free pairs of 24-123 bytes, split across threads\n",
+         ops);
+  printf("  %-8s %14s %14s\n", "threads", "malloc ns/op", "slab ns/op");
+
+  int threadCounts[] = {1, 2, 4, 8};
+  for (size_t i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+    int threads = threadCounts[i];
+    double system = runAllocBench(malloc, free, threads, ops);
+    double slab = runAllocBench(slabAlloc, slabFree, threads, ops);
+    printf("  %-8d %14.1f %14.1f\n", threads, system, slab);
+  }
+
+  SlabStats stats;
+  slabGetStats(&stats);
+  printf("  central lock: %zu acquisitions, %zu contended\n",
+         stats.lockAcquisitions, stats.lockContended);
+}
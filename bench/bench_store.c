@@ -0,0 +1,130 @@
+#include "bench_framework.h"
+#include "output_buffer.h"
+#include "redis_store.h"
+#include "resp.h"
+#include <pthread.h>
+
+#define DEFAULT_THREAD_COUNTS "1,2,4,8"
+#define DEFAULT_STORE_OPS 400000
+#define KEY_SPACE 100000 /* Distinct keys each thread cycles through */
+#define DEFAULT_VALUE_SIZE (1024 * 1024)
+#define DEFAULT_GET_OPS 2000
+
+typedef struct {
+  RedisStore *store;
+  int id;
+  size_t ops;
+  pthread_barrier_t *start;
+} WriterArgs;
+
+static void *writer(void *arg) {
+  WriterArgs *args = (WriterArgs *)arg;
+  char key[32];
+  pthread_barrier_wait(args->start);
+  for (size_t i = 0; i < args->ops; i++) {
+    int len = snprintf(key, sizeof(key), "w%d:%zu", args->id, i % KEY_SPACE);
+    storeSet(args->store, key, len, key, len);
+  }
+  return NULL;
+}
+
+// Runs threads SET loops against one store, returns total ops/sec
+static double runWriters(size_t shards, int threads, size_t opsPerThread) {
+  RedisStore *store = createShardedStore(shards);
+  pthread_t *tids = malloc(threads * sizeof(pthread_t));
+  WriterArgs *args = malloc(threads * sizeof(WriterArgs));
+  pthread_barrier_t start;
+  pthread_barrier_init(&start, NULL, threads + 1);
+
+  for (int i = 0; i < threads; i++) {
+    args[i] = (WriterArgs){store, i, opsPerThread, &start};
+    pthread_create(&tids[i], NULL, writer, &args[i]);
+  }
+
+  pthread_barrier_wait(&start);
+  long long begin = benchNowNs();
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  long long elapsed = benchNowNs() - begin;
+
+  pthread_barrier_destroy(&start);
+  free(tids);
+  free(args);
+  freeStore(store);
+  return threads * opsPerThread * 1e9 / elapsed;
+}
+
+static void writeValue(const void *value, size_t valueLen,
+                       SharedValue *shared, void *ctx) {
+  (void)shared;
+  writeBulkString((OutputBuffer *)ctx, value, valueLen);
+}
+
+typedef enum { GET_COPY, GET_IN_PLACE, GET_SHARED } GetMode;
+
+// Serializes a large value into a reply buffer, returns GB/s of value bytes
+static double runLargeGets(RedisStore *store, size_t valueSize, size_t ops,
+                           GetMode mode) {
+  OutputBuffer *out = createOutputBuffer();
+  long long begin = benchNowNs();
+  for (size_t i = 0; i < ops; i++) {
+    if (mode == GET_SHARED) {
+      SharedValue *value = storeGetShared(store, "big", 3);
+      writeSharedBulkString(out, value);
+      releaseSharedValue(value);
+    } else if (mode == GET_IN_PLACE) {
+      storeVisitValue(store, "big", 3, writeValue, out);
+    } else {
+      size_t len;
+      void *value = storeGet(store, "big", 3, &len);
+      writeBulkString(out, value, len);
+      free(value);
+    }
+    resetOutputBuffer(out);
+  }
+  long long elapsed = benchNowNs() - begin;
+  freeOutputBuffer(out);
+  return (double)valueSize * ops / elapsed;
+}
+
+void run_store_benchmarks(void) {
+  BENCH_HEADER("Store: multi-threaded SET ops/sec, one lock vs shards");
+
+  const char *counts = getenv("BENCH_THREADS");
+  if (!counts || !*counts) {
+    counts = DEFAULT_THREAD_COUNTS;
+  }
+  size_t ops = benchEnvSize("BENCH_OPS", DEFAULT_STORE_OPS);
+
+  printf("  %-8s %14s %8d shards\n", "threads", "1 shard",
+         STORE_DEFAULT_SHARDS);
+  char *list = strdup(counts);
+  for (char *item = strtok(list, ","); item; item = strtok(NULL, ",")) {
+    int threads = atoi(item);
+    if (threads < 1) {
+      continue;
+    }
+    // Fixed total work, split across the threads
+    size_t perThread = ops / threads;
+    printf("  %-8d %14.0f %14.0f\n", threads, runWriters(1, threads, perThread),
+           runWriters(STORE_DEFAULT_SHARDS, threads, perThread));
+  }
+  free(list);
+
+  BENCH_HEADER("Store: large value GET into a reply buffer, GB/s");
+  size_t valueSize = benchEnvSize("BENCH_VALUE_SIZE", DEFAULT_VALUE_SIZE);
+  size_t getOps = benchEnvSize("BENCH_GET_OPS", DEFAULT_GET_OPS);
+  RedisStore *store = createStore();
+  char *value = malloc(valueSize);
+  memset(value, 'v', valueSize);
+  storeSet(store, "big", 3, value, valueSize);
+  free(value);
+
+  printf("  %-10s %10s %10s %10s\n", "value", "copy", "in place", "shared");
+  printf("  %-10zu %10.2f %10.2f %10.2f\n", valueSize,
+         runLargeGets(store, valueSize, getOps, GET_COPY),
+         runLargeGets(store, valueSize, getOps, GET_IN_PLACE),
+         runLargeGets(store, valueSize, getOps, GET_SHARED));
+  freeStore(store);
+}
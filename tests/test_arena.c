@@ -0,0 +1,69 @@
+#include "test_framework.h"
+#include "arena.h"
+#include <stdint.h>
+#include <string.h>
+
+void test_arena_alloc(void) {
+    Arena arena = {0};
+    TEST_ASSERT_NULL(arena.current, "A zeroed arena should hold no memory");
+
+    int aligned = 1;
+    char *previous = NULL;
+    for (size_t size = 1; size <= 100; size++) {
+        char *ptr = arenaAlloc(&arena, size);
+        aligned &= ptr && ((uintptr_t)ptr % ARENA_ALIGN) == 0 && ptr != previous;
+        memset(ptr, 0x5a, size);
+        previous = ptr;
+    }
+    TEST_ASSERT(aligned, "Allocations should be distinct and aligned");
+
+    char *copy = arenaStrdup(&arena, "scratch");
+    TEST_ASSERT_STRING_EQUAL("scratch", copy, "Strdup should copy the string");
+
+    arenaRelease(&arena);
+    TEST_ASSERT_NULL(arena.current, "Release should free every block");
+}
+
+void test_arena_growth(void) {
+    Arena arena = {0};
+    char *small = arenaAlloc(&arena, 16);
+    strcpy(small, "first");
+
+    // Overflow the first block, then ask for more than a doubled block
+    for (int i = 0; i < 10; i++) {
+        arenaAlloc(&arena, ARENA_BLOCK_SIZE / 4);
+    }
+    char *large = arenaAlloc(&arena, ARENA_BLOCK_SIZE * 8);
+    memset(large, 1, ARENA_BLOCK_SIZE * 8);
+
+    TEST_ASSERT(arena.current->size >= ARENA_BLOCK_SIZE * 8 && arena.current->prev,
+                "The arena should chain bigger blocks as it fills");
+    TEST_ASSERT_STRING_EQUAL("first", small, "Earlier allocations should stay valid");
+
+    arenaRelease(&arena);
+}
+
+void test_arena_reset(void) {
+    Arena arena = {0};
+    char *first = arenaAlloc(&arena, 64);
+    arenaAlloc(&arena, ARENA_BLOCK_SIZE);
+    ArenaBlock *kept = arena.current;
+
+    arenaReset(&arena);
+    TEST_ASSERT(arena.current == kept && !kept->prev && kept->used == 0,
+                "Reset should keep only the newest block, emptied");
+    char *again = arenaAlloc(&arena, 64);
+    TEST_ASSERT(again == kept->data && again != first,
+                "Allocation after a reset should reuse the kept block");
+
+    arenaAlloc(&arena, ARENA_RETAIN_MAX * 2);
+    arenaReset(&arena);
+    TEST_ASSERT_NULL(arena.current, "Reset should drop a block past the retain limit");
+}
+
+void run_arena_tests(void) {
+    printf("\n=== Arena Tests ===\n");
+    RUN_TEST(test_arena_alloc);
+    RUN_TEST(test_arena_growth);
+    RUN_TEST(test_arena_reset);
+}
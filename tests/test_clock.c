@@ -0,0 +1,61 @@
+#include "test_framework.h"
+#include "clock.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+static long long wall_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void test_clock_uncached_reads(void) {
+    long long before = wall_ms();
+    long long now = clockNowMs();
+    long long after = wall_ms();
+    TEST_ASSERT(now >= before && now <= after,
+                "Without a cache the wall clock should be read directly");
+
+    long long start = clockMonotonicMs();
+    usleep(20000);
+    TEST_ASSERT(clockMonotonicMs() - start >= 20,
+                "Uncached monotonic reads should advance");
+}
+
+static void *read_clock(void *arg) {
+    *(long long *)arg = clockNowMs();
+    return NULL;
+}
+
+void test_clock_cached_reads(void) {
+    clockUpdate();
+    long long now = clockNowMs();
+    long long monotonic = clockMonotonicMs();
+    usleep(20000);
+    TEST_ASSERT(clockNowMs() == now && clockMonotonicMs() == monotonic,
+                "Cached reads should hold until the next update");
+
+    // The cache belongs to the thread that set it up
+    long long other = 0;
+    pthread_t thread;
+    pthread_create(&thread, NULL, read_clock, &other);
+    pthread_join(thread, NULL);
+    TEST_ASSERT(other >= now + 20, "Other threads should read the clock");
+
+    clockUpdate();
+    TEST_ASSERT(clockNowMs() >= now + 20 && clockMonotonicMs() >= monotonic + 20,
+                "An update should refresh the cache");
+
+    clockStopCaching();
+    now = clockNowMs();
+    usleep(20000);
+    TEST_ASSERT(clockNowMs() >= now + 20,
+                "Reads should be live again once caching stops");
+}
+
+void run_clock_tests(void) {
+    printf("\n=== Clock Tests ===\n");
+    RUN_TEST(test_clock_uncached_reads);
+    RUN_TEST(test_clock_cached_reads);
+}
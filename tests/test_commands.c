@@ -5,8 +5,11 @@
 #include "resp.h"
 #include "server.h"
 #include "config.h"
+#include "replicas.h"
 #include <string.h>
 #include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 RedisServer *create_test_server(void) {
     ServerConfig *config = malloc(sizeof(ServerConfig));
@@ -17,6 +20,8 @@ RedisServer *create_test_server(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     return server;
@@ -26,6 +31,7 @@ RespValue *create_test_command(const char **args, size_t argc) {
     RespValue *command = malloc(sizeof(RespValue));
     command->type = RespTypeArray;
     command->data.array.len = argc;
+    command->data.array.handler = NULL;
     command->data.array.elements = malloc(argc * sizeof(RespValue*));
     
     for (size_t i = 0; i < argc; i++) {
@@ -84,7 +90,7 @@ void test_command_set(void) {
     TEST_ASSERT_STRING_EQUAL("+OK\r\n", response, "SET should return OK");
     
     size_t valueLen;
-    void *value = storeGet(store, "key1", &valueLen);
+    void *value = storeGet(store, "key1", strlen("key1"), &valueLen);
     TEST_ASSERT_NOT_NULL(value, "Value should be stored");
     TEST_ASSERT_STRING_EQUAL("value1", (char*)value, "Stored value should match");
     
@@ -100,7 +106,7 @@ void test_command_get(void) {
     RedisStore *store = createStore();
     ClientState client_state = {0};
     
-    storeSet(store, "key1", "value1", 6);
+    storeSet(store, "key1", strlen("key1"), "value1", 6);
     
     const char *args[] = {"GET", "key1"};
     RespValue *command = create_test_command(args, 2);
@@ -138,7 +144,7 @@ void test_command_type(void) {
     RedisStore *store = createStore();
     ClientState client_state = {0};
     
-    storeSet(store, "key1", "value1", 7);
+    storeSet(store, "key1", strlen("key1"), "value1", 7);
     
     const char *args[] = {"TYPE", "key1"};
     RespValue *command = create_test_command(args, 2);
@@ -184,7 +190,7 @@ void test_command_set_with_px(void) {
     TEST_ASSERT_STRING_EQUAL("+OK\r\n", response, "SET with PX should return OK");
     
     size_t valueLen;
-    void *value = storeGet(store, "key1", &valueLen);
+    void *value = storeGet(store, "key1", strlen("key1"), &valueLen);
     TEST_ASSERT_NOT_NULL(value, "Value should be stored");
     TEST_ASSERT_STRING_EQUAL("value1", (char*)value, "Stored value should match");
     
@@ -212,6 +218,301 @@ void test_command_invalid(void) {
     freeServer(server);
 }
 
+void test_command_partition(void) {
+    RedisServer *server = create_test_server();
+    createServerPartitions(server, 4);
+    ClientState client_state = {0};
+
+    const char *get_args[] = {"GET", "user:1"};
+    RespValue *get = create_test_command(get_args, 2);
+    int owner = keyPartition(server, "user:1", strlen("user:1"));
+    TEST_ASSERT_EQUAL(owner, commandPartition(server, get, &client_state),
+                      "Keyed command should route to the owner of its key");
+
+    const char *ping_args[] = {"PING"};
+    RespValue *ping = create_test_command(ping_args, 1);
+    TEST_ASSERT_EQUAL(PARTITION_ANY, commandPartition(server, ping, &client_state),
+                      "Keyless command should run on any partition");
+
+    // Find a key owned by another partition
+    char other[32];
+    int i = 0;
+    do {
+        snprintf(other, sizeof(other), "key%d", i++);
+    } while (keyPartition(server, other, strlen(other)) == owner);
+
+    const char *xread_args[] = {"XREAD", "STREAMS", "user:1", other, "0", "0"};
+    RespValue *xread = create_test_command(xread_args, 6);
+    TEST_ASSERT_EQUAL(PARTITION_CROSS, commandPartition(server, xread, &client_state),
+                      "Keys on different partitions should be reported as cross");
+
+    freeRespValue(get);
+    freeRespValue(ping);
+    freeRespValue(xread);
+    freeServer(server);
+}
+
+void test_command_increment_family(void) {
+    RedisServer *server = create_test_server();
+    RedisStore *store = createStore();
+    ClientState client_state = {0};
+
+    const char *commands[][3] = {
+        {"INCR", "n", NULL},        {"INCRBY", "n", "10"},     {"DECR", "n", NULL},
+        {"DECRBY", "n", "20"},      {"INCRBYFLOAT", "n", "1.5"}, {"INCRBY", "n", "1x"},
+        {"INCR", "n", NULL},
+    };
+    const char *expected[] = {
+        ":1\r\n", ":11\r\n", ":10\r\n", ":-10\r\n", "$4\r\n-8.5\r\n",
+        "-ERR value is not an integer or out of range\r\n",
+        "-ERR value is not an integer or out of range\r\n",
+    };
+
+    int matched = 0;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        RespValue *command = create_test_command(commands[i], commands[i][2] ? 3 : 2);
+        char *response = (char *)executeCommand(server, store, command, &client_state);
+        matched += response && strcmp(expected[i], response) == 0;
+        free(response);
+        freeRespValue(command);
+    }
+    TEST_ASSERT_EQUAL(7, matched, "Counter commands should update one value in sequence");
+
+    freeStore(store);
+    freeServer(server);
+}
+
+void test_command_xadd_wrong_type(void) {
+    RedisServer *server = create_test_server();
+    RedisStore *store = createStore();
+    ClientState client_state = {0};
+
+    // Integer, embedded and shared strings all refuse to become streams
+    char large[STORE_EMBED_MAX + 2];
+    memset(large, 'x', sizeof(large) - 1);
+    large[sizeof(large) - 1] = '\0';
+    const char *values[] = {"1", "short", large};
+    int refused = 0;
+    for (int i = 0; i < 3; i++) {
+        const char *set_args[] = {"SET", "k", values[i]};
+        const char *xadd_args[] = {"XADD", "k", "*", "f", "v"};
+        RespValue *set = create_test_command(set_args, 3);
+        RespValue *xadd = create_test_command(xadd_args, 5);
+        free((void *)executeCommand(server, store, set, &client_state));
+        char *response = (char *)executeCommand(server, store, xadd, &client_state);
+        refused += response && strncmp(response, "-WRONGTYPE ", 11) == 0;
+        free(response);
+        freeRespValue(set);
+        freeRespValue(xadd);
+    }
+    TEST_ASSERT_EQUAL(3, refused, "XADD on a string key should fail with WRONGTYPE");
+    TEST_ASSERT_EQUAL(TYPE_STRING, getValueType(store, "k", 1),
+                      "The string should be left in place");
+
+    freeStore(store);
+    freeServer(server);
+}
+
+void test_command_incrbyfloat_propagates_set(void) {
+    RedisServer *server = create_test_server();
+    ClientState client_state = {0};
+
+    int fds[2];
+    TEST_ASSERT_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds), "socketpair should succeed");
+    ClientState replica = {0};
+    replica.fd = fds[0];
+    replica.epfd = -1;
+    replica.reply = createOutputBuffer();
+    addReplica(server, &replica);
+
+    time_t expiry = 4102444800000LL;
+    storeSet(server->db, "n", 1, "10", 2);
+    setExpiry(server->db, "n", 1, expiry);
+    const char *incr_args[] = {"INCRBYFLOAT", "n", "0.1"};
+    RespValue *incr = create_test_command(incr_args, 3);
+    char *response = (char *)executeCommand(server, server->db, incr, &client_state);
+    TEST_ASSERT_STRING_EQUAL("$4\r\n10.1\r\n", response, "INCRBYFLOAT should reply with the sum");
+    free(response);
+
+    // Replicas are sent the result, not the increment
+    const char *expected = "*4\r\n$3\r\nSET\r\n$1\r\nn\r\n$4\r\n10.1\r\n$7\r\nKEEPTTL\r\n";
+    char stream[128] = {0};
+    ssize_t n = recv(fds[1], stream, sizeof(stream) - 1, MSG_DONTWAIT);
+    TEST_ASSERT_EQUAL((ssize_t)strlen(expected), n, "One command should be propagated");
+    TEST_ASSERT_STRING_EQUAL(expected, stream, "INCRBYFLOAT should propagate as SET KEEPTTL");
+
+    // Applying it keeps the TTL and the exact bytes
+    RedisStore *store = createStore();
+    storeSet(store, "n", 1, "10", 2);
+    setExpiry(store, "n", 1, expiry);
+    const char *set_args[] = {"SET", "n", "10.1", "KEEPTTL"};
+    RespValue *set = create_test_command(set_args, 4);
+    response = (char *)executeCommand(server, store, set, &client_state);
+    TEST_ASSERT_STRING_EQUAL("+OK\r\n", response, "SET KEEPTTL should return OK");
+    free(response);
+    size_t valueLen;
+    char *value = storeGet(store, "n", 1, &valueLen);
+    TEST_ASSERT(value && valueLen == 4 && memcmp(value, "10.1", 4) == 0,
+                "SET KEEPTTL should store the value as given");
+    free(value);
+    time_t kept = 0;
+    getExpiry(store, "n", 1, &kept);
+    TEST_ASSERT_EQUAL(expiry, kept, "SET KEEPTTL should keep the TTL");
+
+    removeReplica(server, fds[0]);
+    freeOutputBuffer(replica.reply);
+    close(fds[0]);
+    close(fds[1]);
+    freeRespValue(incr);
+    freeRespValue(set);
+    freeStore(store);
+    freeServer(server);
+}
+
+void test_command_info_sections(void) {
+    RedisServer *server = create_test_server();
+    RedisStore *store = createStore();
+    ClientState client_state = {0};
+
+    const char *all_args[] = {"INFO"};
+    const char *memory_args[] = {"INFO", "memory"};
+    const char *replication_args[] = {"INFO", "replication"};
+    const char *stats_args[] = {"INFO", "stats"};
+    RespValue *all = create_test_command(all_args, 1);
+    RespValue *memory = create_test_command(memory_args, 2);
+    RespValue *replication = create_test_command(replication_args, 2);
+    RespValue *stats = create_test_command(stats_args, 2);
+
+    char *response = (char *)executeCommand(server, store, all, &client_state);
+    TEST_ASSERT(response && strstr(response, "role:master") && strstr(response, "slab_span_bytes:") &&
+                strstr(response, "expired_keys:"),
+                "INFO should report every section by default");
+    free(response);
+    response = (char *)executeCommand(server, store, memory, &client_state);
+    TEST_ASSERT(response && !strstr(response, "role:") && strstr(response, "slab_lock_contended:"),
+                "INFO memory should report the allocator only");
+    free(response);
+    response = (char *)executeCommand(server, store, replication, &client_state);
+    TEST_ASSERT(response && strstr(response, "role:master") && !strstr(response, "slab_"),
+                "INFO replication should report replication only");
+    free(response);
+    response = (char *)executeCommand(server, store, stats, &client_state);
+    TEST_ASSERT(response && !strstr(response, "role:") && strstr(response, "expired_keys:0") &&
+                strstr(response, "expire_cycle_cpu_milliseconds:"),
+                "INFO stats should report the expiry counters");
+    free(response);
+
+    freeRespValue(all);
+    freeRespValue(memory);
+    freeRespValue(replication);
+    freeRespValue(stats);
+    freeStore(store);
+    freeServer(server);
+}
+
+void test_command_stream_scratch_in_arena(void) {
+    RedisServer *server = create_test_server();
+    RedisStore *store = createStore();
+    ClientState client_state = {0};
+
+    const char *xadd_args[] = {"XADD", "s", "1-1", "field", "value"};
+    const char *xrange_args[] = {"XRANGE", "s", "-", "+"};
+    const char *xread_args[] = {"XREAD", "STREAMS", "s", "0-0"};
+    RespValue *xadd = create_test_command(xadd_args, 5);
+    RespValue *xrange = create_test_command(xrange_args, 4);
+    RespValue *xread = create_test_command(xread_args, 4);
+
+    OutputBuffer *reply = createOutputBuffer();
+    executeCommandTo(server, store, xadd, &client_state, reply);
+    executeCommandTo(server, store, xrange, &client_state, reply);
+    TEST_ASSERT_NOT_NULL(client_state.arena.current,
+                         "Stream commands should copy entries into the client arena");
+    arenaReset(&client_state.arena);
+    executeCommandTo(server, store, xread, &client_state, reply);
+
+    char *response = flattenOutputBuffer(reply, NULL);
+    TEST_ASSERT_STRING_EQUAL("$3\r\n1-1\r\n"
+                             "*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$5\r\nfield\r\n$5\r\nvalue\r\n"
+                             "*1\r\n*2\r\n$1\r\ns\r\n*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n"
+                             "$5\r\nfield\r\n$5\r\nvalue\r\n",
+                             response, "Replies built from arena copies should be intact");
+    free(response);
+
+    arenaRelease(&client_state.arena);
+    freeOutputBuffer(reply);
+    freeRespValue(xadd);
+    freeRespValue(xrange);
+    freeRespValue(xread);
+    freeStore(store);
+    freeServer(server);
+}
+
+void test_command_lookup(void) {
+    const char *names[] = {"SET", "get", "Ping", "incrbyfloat", "XREAD", "discard", "WAIT"};
+    int found = 0;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        const CommandHandler *entry = lookupCommand(names[i], strlen(names[i]));
+        found += entry && strcasecmp(entry->name, names[i]) == 0;
+    }
+    TEST_ASSERT_EQUAL(7, found, "Every command should be found regardless of case");
+
+    TEST_ASSERT_NULL(lookupCommand("GETX", 4), "Unknown names should not match");
+    TEST_ASSERT_NULL(lookupCommand("GE", 2), "Prefixes of a name should not match");
+    TEST_ASSERT_NULL(lookupCommand("GETRANGE", 8), "Longer names sharing a prefix should not match");
+    TEST_ASSERT_NULL(lookupCommand("", 0), "Empty names should not match");
+    TEST_ASSERT_NULL(lookupCommand("INCRBYFLOATINCRBYFLOAT", 22), "Overlong names should not match");
+    TEST_ASSERT_NOT_NULL(lookupCommand("GET key", 3), "Names need not be NUL-terminated");
+
+    TEST_ASSERT(lookupCommand("SET", 3)->flags == (CMD_WRITE | CMD_FAST) &&
+                lookupCommand("GET", 3)->flags == (CMD_READONLY | CMD_FAST) &&
+                (lookupCommand("EXEC", 4)->flags & CMD_TRANSACTION) &&
+                (lookupCommand("PSYNC", 5)->flags & CMD_ADMIN),
+                "Table entries should carry their command flags");
+}
+
+void test_command_resolve_cached(void) {
+    const char *args[] = {"incr", "n"};
+    RespValue *command = create_test_command(args, 2);
+    const CommandHandler *entry = resolveCommand(command);
+    TEST_ASSERT(entry && entry == command->data.array.handler,
+                "Resolving should cache the entry in the command");
+
+    RespValue *clone = cloneRespValue(command);
+    TEST_ASSERT(clone->data.array.handler == entry,
+                "Queued copies should keep the resolved entry");
+
+    freeRespValue(clone);
+    freeRespValue(command);
+}
+
+void test_command_key_specs(void) {
+    const char *get_args[] = {"GET", "k"};
+    const char *xread_args[] = {"XREAD", "BLOCK", "0", "streams", "a", "b", "0-0", "$"};
+    const char *xread_bad_args[] = {"XREAD", "a", "0-0", "x"};
+    const char *ping_args[] = {"PING"};
+    RespValue *get = create_test_command(get_args, 2);
+    RespValue *xread = create_test_command(xread_args, 8);
+    RespValue *xread_bad = create_test_command(xread_bad_args, 4);
+    RespValue *ping = create_test_command(ping_args, 1);
+
+    KeyRange keys;
+    TEST_ASSERT(commandKeys(get, &keys) == 1 && keys.first == 1 && keys.last == 1,
+                "GET should have its first argument as key");
+    TEST_ASSERT(commandKeys(xread, &keys) == 2 && keys.first == 4 && keys.last == 5,
+                "XREAD keys should follow STREAMS and precede the ids");
+    TEST_ASSERT_EQUAL(0, commandKeys(xread_bad, &keys), "XREAD without STREAMS has no keys");
+    TEST_ASSERT_EQUAL(0, commandKeys(ping, &keys), "PING has no keys");
+
+    ClientState client_state = {0};
+    TEST_ASSERT(commandMayBlock(xread, &client_state) && !commandMayBlock(get, &client_state),
+                "Only XREAD with BLOCK should be reported as blocking");
+
+    freeRespValue(get);
+    freeRespValue(xread);
+    freeRespValue(xread_bad);
+    freeRespValue(ping);
+}
+
 void run_command_tests(void) {
     printf("\n=== Command Tests ===\n");
     RUN_TEST(test_command_ping);
@@ -223,4 +524,13 @@ void run_command_tests(void) {
     RUN_TEST(test_command_type_nonexistent);
     RUN_TEST(test_command_set_with_px);
     RUN_TEST(test_command_invalid);
+    RUN_TEST(test_command_partition);
+    RUN_TEST(test_command_increment_family);
+    RUN_TEST(test_command_xadd_wrong_type);
+    RUN_TEST(test_command_incrbyfloat_propagates_set);
+    RUN_TEST(test_command_info_sections);
+    RUN_TEST(test_command_stream_scratch_in_arena);
+    RUN_TEST(test_command_lookup);
+    RUN_TEST(test_command_resolve_cached);
+    RUN_TEST(test_command_key_specs);
 }
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "test_framework.h"
+#include "hash_table.h"
+#include "redis_store.h"
+#include <string.h>
+
+// FNV-1a with a final mix, any well distributed 64-bit hash will do here
+static uint64_t test_hash(const char *key, size_t len) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 1099511628211ULL;
+    }
+    hash ^= hash >> 29;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static StoreEntry **make_entries(size_t count, uint64_t (*hashFn)(const char *, size_t)) {
+    StoreEntry **entries = malloc(count * sizeof(StoreEntry *));
+    for (size_t i = 0; i < count; i++) {
+        char key[32];
+        int len = snprintf(key, sizeof(key), "key:%zu", i);
+        entries[i] = calloc(1, sizeof(StoreEntry) + len + 1);
+        memcpy(entries[i]->key, key, len + 1);
+        entries[i]->keyLen = len;
+        entries[i]->hash = hashFn(key, len);
+    }
+    return entries;
+}
+
+static void free_entries(StoreEntry **entries, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i]);
+    }
+    free(entries);
+}
+
+static uint64_t constant_hash(const char *key, size_t len) {
+    (void)key;
+    (void)len;
+    return 0x2A;
+}
+
+void test_hash_table_create(void) {
+    HashTable *table = createHashTable(100);
+    TEST_ASSERT_NOT_NULL(table, "HashTable creation should succeed");
+    TEST_ASSERT_EQUAL(128, table->ht[0].capacity, "Capacity should round up to a power of two");
+    TEST_ASSERT_EQUAL(0, hashTableSize(table), "New table should be empty");
+    freeHashTable(table);
+}
+
+void test_hash_table_insert_find(void) {
+    size_t count = 100000;
+    StoreEntry **entries = make_entries(count, test_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+
+    int inserted = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (hashTableInsert(table, entries[i]) != 0) {
+            inserted = 0;
+        }
+    }
+    TEST_ASSERT(inserted, "Every insert should succeed");
+    TEST_ASSERT_EQUAL(count, hashTableSize(table), "Table should count every entry");
+    TEST_ASSERT((table->ht[0].capacity & (table->ht[0].capacity - 1)) == 0,
+                "Capacity should stay a power of two while growing");
+
+    int found = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (hashTableFind(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash) != entries[i]) {
+            found = 0;
+        }
+    }
+    TEST_ASSERT(found, "Every inserted key should be found");
+    TEST_ASSERT_NULL(hashTableFind(table, "missing", 7, test_hash("missing", 7)),
+                     "Missing key should not be found");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void test_hash_table_remove(void) {
+    size_t count = 10000;
+    StoreEntry **entries = make_entries(count, test_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+    for (size_t i = 0; i < count; i++) {
+        hashTableInsert(table, entries[i]);
+    }
+
+    int removed = 1;
+    for (size_t i = 0; i < count; i += 2) {
+        if (hashTableRemove(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash) != entries[i]) {
+            removed = 0;
+        }
+    }
+    TEST_ASSERT(removed, "Removing present keys should return their entries");
+    TEST_ASSERT_EQUAL(count / 2, hashTableSize(table), "Half of the entries should remain");
+
+    int correct = 1;
+    for (size_t i = 0; i < count; i++) {
+        StoreEntry *entry = hashTableFind(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash);
+        if ((i % 2 == 0 && entry) || (i % 2 == 1 && entry != entries[i])) {
+            correct = 0;
+        }
+    }
+    TEST_ASSERT(correct, "Only the remaining keys should be found");
+    TEST_ASSERT_NULL(hashTableRemove(table, entries[0]->key, entries[0]->keyLen, entries[0]->hash),
+                     "Removing a missing key should return NULL");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void test_hash_table_churn(void) {
+    // Repeated insert/remove cycles must reuse tombstones instead of growing
+    size_t count = 64;
+    StoreEntry **entries = make_entries(count, test_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+
+    for (int round = 0; round < 1000; round++) {
+        for (size_t i = 0; i < count; i++) {
+            hashTableInsert(table, entries[i]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            hashTableRemove(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, hashTableSize(table), "Table should be empty after churn");
+    TEST_ASSERT(table->ht[0].capacity <= 256, "Churn should not keep growing the table");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void test_hash_table_full_collisions(void) {
+    // Identical hashes force every lookup through the full probe sequence
+    size_t count = 200;
+    StoreEntry **entries = make_entries(count, constant_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+    for (size_t i = 0; i < count; i++) {
+        hashTableInsert(table, entries[i]);
+    }
+
+    int found = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (hashTableFind(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash) != entries[i]) {
+            found = 0;
+        }
+    }
+    TEST_ASSERT(found, "Colliding keys should be told apart by their bytes");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void test_hash_table_iterate(void) {
+    size_t count = 1000;
+    StoreEntry **entries = make_entries(count, test_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+    for (size_t i = 0; i < count; i++) {
+        hashTableInsert(table, entries[i]);
+    }
+
+    // Remove while iterating, as the expiry sweep does
+    size_t seen = 0;
+    size_t pos = 0;
+    StoreEntry *entry;
+    while ((entry = hashTableNext(table, &pos))) {
+        seen++;
+        hashTableRemove(table, entry->key, entry->keyLen, entry->hash);
+    }
+    TEST_ASSERT_EQUAL(count, seen, "Iteration should visit every entry once");
+    TEST_ASSERT_EQUAL(0, hashTableSize(table), "Every entry should have been removed");
+
+    for (size_t i = 0; i < count; i++) {
+        hashTableInsert(table, entries[i]);
+    }
+    hashTableClear(table);
+    pos = 0;
+    TEST_ASSERT_NULL(hashTableNext(table, &pos), "Cleared table should have no entries");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void test_hash_table_incremental_rehash(void) {
+    size_t count = 10000;
+    StoreEntry **entries = make_entries(count, test_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+
+    // Stop right after a resize of a non-trivial table starts
+    size_t inserted = 0;
+    while (inserted < count &&
+           !(hashTableIsRehashing(table) && table->ht[0].capacity >= 1024)) {
+        hashTableInsert(table, entries[inserted++]);
+    }
+    TEST_ASSERT(hashTableIsRehashing(table), "Growing past a full table should start a resize");
+    TEST_ASSERT(table->ht[1].capacity > table->ht[0].capacity, "The new slot array should be larger");
+    TEST_ASSERT(table->ht[0].used > 0, "Entries should still be waiting to migrate");
+    TEST_ASSERT_EQUAL(inserted, hashTableSize(table), "Size should count both slot arrays");
+
+    int found = 1;
+    for (size_t i = 0; i < inserted; i++) {
+        if (hashTableFind(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash) != entries[i]) {
+            found = 0;
+        }
+    }
+    TEST_ASSERT(found, "Every key should be found mid-resize");
+
+    // Remove keys from both arrays before the resize finishes
+    int removed = 1;
+    for (size_t i = 0; i < inserted; i += 3) {
+        if (hashTableRemove(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash) != entries[i]) {
+            removed = 0;
+        }
+    }
+    TEST_ASSERT(removed, "Removing mid-resize should find keys in either array");
+
+    size_t oldCapacity = table->ht[0].capacity;
+    size_t before = table->ht[0].used;
+    hashTableRehash(table, 1);
+    TEST_ASSERT(table->ht[0].used >= before - 1, "A step should migrate at most the slots it visits");
+
+    TEST_ASSERT_EQUAL(0, hashTableRehash(table, SIZE_MAX), "Rehashing without a limit should finish");
+    TEST_ASSERT(!hashTableIsRehashing(table), "Table should no longer be rehashing");
+    TEST_ASSERT(table->ht[0].capacity > oldCapacity, "The larger array should take over");
+
+    int correct = 1;
+    for (size_t i = 0; i < inserted; i++) {
+        StoreEntry *entry = hashTableFind(table, entries[i]->key, entries[i]->keyLen, entries[i]->hash);
+        if ((i % 3 == 0 && entry) || (i % 3 != 0 && entry != entries[i])) {
+            correct = 0;
+        }
+    }
+    TEST_ASSERT(correct, "Only the remaining keys should be found after the resize");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void test_hash_table_rehash_bounded(void) {
+    // No single insert may migrate more than HT_REHASH_STEP slots
+    size_t count = 50000;
+    StoreEntry **entries = make_entries(count, test_hash);
+    HashTable *table = createHashTable(HT_MIN_CAPACITY);
+
+    int bounded = 1;
+    for (size_t i = 0; i < count; i++) {
+        long before = table->rehashIdx;
+        size_t capacity = table->ht[0].capacity;
+        hashTableInsert(table, entries[i]);
+        if (before >= 0 && table->rehashIdx >= 0 && table->ht[0].capacity == capacity &&
+            table->rehashIdx - before > HT_REHASH_STEP) {
+            bounded = 0;
+        }
+    }
+    TEST_ASSERT(bounded, "Each insert should migrate a bounded number of slots");
+    TEST_ASSERT_EQUAL(count, hashTableSize(table), "Every entry should be indexed");
+
+    freeHashTable(table);
+    free_entries(entries, count);
+}
+
+void run_hash_table_tests(void) {
+    printf("\n=== Hash Table Tests ===\n");
+    RUN_TEST(test_hash_table_create);
+    RUN_TEST(test_hash_table_insert_find);
+    RUN_TEST(test_hash_table_remove);
+    RUN_TEST(test_hash_table_churn);
+    RUN_TEST(test_hash_table_full_collisions);
+    RUN_TEST(test_hash_table_iterate);
+    RUN_TEST(test_hash_table_incremental_rehash);
+    RUN_TEST(test_hash_table_rehash_bounded);
+}
@@ -5,12 +5,15 @@
 #include "redis_store.h"
 #include "resp.h"
 #include "networking.h"
+#include "event_loop.h"
+#include "replicas.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 
 #define TEST_PORT 16379
 #define TEST_TIMEOUT 5
@@ -63,6 +66,8 @@ void test_server_create_and_init(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     TEST_ASSERT_NOT_NULL(server, "Server creation should succeed");
@@ -85,6 +90,8 @@ void test_server_accept_connection(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     TEST_ASSERT_NOT_NULL(server, "Server creation should succeed");
@@ -123,16 +130,18 @@ void test_server_database_operations(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     TEST_ASSERT_NOT_NULL(server, "Server creation should succeed");
     TEST_ASSERT_NOT_NULL(server->db, "Server database should be initialized");
     
-    int result = storeSet(server->db, "test_key", "test_value", 11);
+    int result = storeSet(server->db, "test_key", strlen("test_key"), "test_value", 11);
     TEST_ASSERT_EQUAL(STORE_OK, result, "Database set operation should succeed");
     
     size_t valueLen;
-    void *value = storeGet(server->db, "test_key", &valueLen);
+    void *value = storeGet(server->db, "test_key", strlen("test_key"), &valueLen);
     TEST_ASSERT_NOT_NULL(value, "Database get operation should succeed");
     TEST_ASSERT_STRING_EQUAL("test_value", (char*)value, "Retrieved value should match");
     
@@ -149,6 +158,8 @@ void test_server_statistics(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     TEST_ASSERT_NOT_NULL(server, "Server creation should succeed");
@@ -176,18 +187,20 @@ void test_server_concurrent_operations(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     TEST_ASSERT_NOT_NULL(server, "Server creation should succeed");
     
-    storeSet(server->db, "key1", "value1", 7);
-    storeSet(server->db, "key2", "value2", 7);
-    storeSet(server->db, "key3", "value3", 7);
+    storeSet(server->db, "key1", strlen("key1"), "value1", 7);
+    storeSet(server->db, "key2", strlen("key2"), "value2", 7);
+    storeSet(server->db, "key3", strlen("key3"), "value3", 7);
     
     size_t valueLen;
-    void *value1 = storeGet(server->db, "key1", &valueLen);
-    void *value2 = storeGet(server->db, "key2", &valueLen);
-    void *value3 = storeGet(server->db, "key3", &valueLen);
+    void *value1 = storeGet(server->db, "key1", strlen("key1"), &valueLen);
+    void *value2 = storeGet(server->db, "key2", strlen("key2"), &valueLen);
+    void *value3 = storeGet(server->db, "key3", strlen("key3"), &valueLen);
     
     TEST_ASSERT_NOT_NULL(value1, "First concurrent get should succeed");
     TEST_ASSERT_NOT_NULL(value2, "Second concurrent get should succeed");
@@ -212,6 +225,8 @@ void test_server_memory_management(void) {
     config->master_host = NULL;
     config->master_port = 0;
     config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
     
     RedisServer *server = createServer(config);
     TEST_ASSERT_NOT_NULL(server, "Server creation should succeed");
@@ -220,7 +235,7 @@ void test_server_memory_management(void) {
         char key[32], value[32];
         sprintf(key, "key%d", i);
         sprintf(value, "value%d", i);
-        storeSet(server->db, key, value, strlen(value) + 1);
+        storeSet(server->db, key, strlen(key), value, strlen(value) + 1);
     }
     
     size_t store_size = storeSize(server->db);
@@ -230,7 +245,7 @@ void test_server_memory_management(void) {
         char key[32];
         sprintf(key, "key%d", i);
         size_t valueLen;
-        void *value = storeGet(server->db, key, &valueLen);
+        void *value = storeGet(server->db, key, strlen(key), &valueLen);
         TEST_ASSERT_NOT_NULL(value, "Each stored value should be retrievable");
         free(value);
     }
@@ -238,6 +253,862 @@ void test_server_memory_management(void) {
     freeServer(server);
 }
 
+void *event_loop_thread(void *arg) {
+    runEventLoop((EventLoop *)arg);
+    return NULL;
+}
+
+int connect_test_client(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    if (connect(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    struct timeval timeout = {TEST_TIMEOUT, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+void test_server_event_loop(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 2;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    EventLoop *loop = createEventLoop(server);
+    TEST_ASSERT_NOT_NULL(loop, "Event loop creation should succeed");
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, event_loop_thread, loop);
+
+    // Idle connections must not starve later clients
+    int idle[16];
+    for (int i = 0; i < 16; i++) {
+        idle[i] = connect_test_client(TEST_PORT + 2);
+    }
+
+    int client = connect_test_client(TEST_PORT + 2);
+    TEST_ASSERT(client >= 0, "Client should connect while others are idle");
+
+    // Command split across two writes is reassembled by the loop
+    const char *part1 = "*1\r\n$4\r\nPI";
+    const char *part2 = "NG\r\n";
+    send(client, part1, strlen(part1), 0);
+    usleep(50000);
+    send(client, part2, strlen(part2), 0);
+
+    char reply[64] = {0};
+    ssize_t n = recv(client, reply, sizeof(reply) - 1, 0);
+    TEST_ASSERT(n > 0, "Event loop should reply to a split command");
+    TEST_ASSERT_STRING_EQUAL("+PONG\r\n", reply, "Split PING should return PONG");
+
+    const char *ping = "*1\r\n$4\r\nPING\r\n";
+    send(idle[15], ping, strlen(ping), 0);
+    memset(reply, 0, sizeof(reply));
+    recv(idle[15], reply, sizeof(reply) - 1, 0);
+    TEST_ASSERT_STRING_EQUAL("+PONG\r\n", reply, "Every multiplexed client should be served");
+
+    for (int i = 0; i < 16; i++) {
+        close(idle[i]);
+    }
+    close(client);
+
+    stopEventLoop(loop);
+    pthread_join(thread, NULL);
+    freeEventLoop(loop);
+    freeServer(server);
+}
+
+void *reactor_group_thread(void *arg) {
+    runReactorGroup((ReactorGroup *)arg);
+    return NULL;
+}
+
+void test_server_reactor_group(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 3;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    ReactorGroup *group = createReactorGroup(server, 4);
+    TEST_ASSERT_NOT_NULL(group, "Reactor group creation should succeed");
+    TEST_ASSERT_EQUAL(4, group->count, "Reactor group should have 4 reactors");
+    TEST_ASSERT(group->loops[1]->listen_fd != server->fd,
+                "Each extra reactor should own a listening socket");
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    // Connections land on different reactors but share one keyspace
+    int clients[8];
+    const char *set = "*3\r\n$3\r\nSET\r\n$6\r\nshared\r\n$1\r\nv\r\n";
+    const char *get = "*2\r\n$3\r\nGET\r\n$6\r\nshared\r\n";
+    int served = 0;
+    for (int i = 0; i < 8; i++) {
+        clients[i] = connect_test_client(TEST_PORT + 3);
+        const char *cmd = i == 0 ? set : get;
+        send(clients[i], cmd, strlen(cmd), 0);
+
+        char reply[64] = {0};
+        recv(clients[i], reply, sizeof(reply) - 1, 0);
+        const char *expected = i == 0 ? "+OK\r\n" : "$1\r\nv\r\n";
+        if (strcmp(expected, reply) == 0) {
+            served++;
+        }
+    }
+    TEST_ASSERT_EQUAL(8, served, "Every reactor should serve its clients from the shared store");
+
+    for (int i = 0; i < 8; i++) {
+        close(clients[i]);
+    }
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+void test_server_shared_nothing(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 4;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = true;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    ReactorGroup *group = createReactorGroup(server, 4);
+    TEST_ASSERT_NOT_NULL(group, "Reactor group creation should succeed");
+    TEST_ASSERT_EQUAL(4, server->partition_count, "Each reactor should own a partition");
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    // Pipelined commands hop between partitions but reply in order
+    int client = connect_test_client(TEST_PORT + 4);
+    char request[4096];
+    char expected[4096];
+    size_t requestLen = 0, expectedLen = 0;
+    for (int i = 0; i < 32; i++) {
+        char key[16];
+        int keyLen = snprintf(key, sizeof(key), "k%02d", i);
+        requestLen += snprintf(request + requestLen, sizeof(request) - requestLen,
+                               "*3\r\n$3\r\nSET\r\n$%d\r\n%s\r\n$%d\r\n%s\r\n"
+                               "*2\r\n$3\r\nGET\r\n$%d\r\n%s\r\n",
+                               keyLen, key, keyLen, key, keyLen, key);
+        expectedLen += snprintf(expected + expectedLen, sizeof(expected) - expectedLen,
+                                "+OK\r\n$%d\r\n%s\r\n", keyLen, key);
+    }
+    send(client, request, requestLen, 0);
+
+    char reply[4096] = {0};
+    size_t received = 0;
+    while (received < expectedLen) {
+        ssize_t n = recv(client, reply + received, sizeof(reply) - 1 - received, 0);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+    }
+    TEST_ASSERT_STRING_EQUAL(expected, reply, "Pipelined replies should keep request order");
+
+    // A transaction touching two partitions is refused
+    char other[16];
+    int i = 0;
+    do {
+        snprintf(other, sizeof(other), "o%d", i++);
+    } while (keyPartition(server, other, strlen(other)) ==
+             keyPartition(server, "k00", 3));
+    int len = snprintf(request, sizeof(request),
+                       "*1\r\n$5\r\nMULTI\r\n"
+                       "*2\r\n$3\r\nGET\r\n$3\r\nk00\r\n"
+                       "*2\r\n$3\r\nGET\r\n$%zu\r\n%s\r\n"
+                       "*1\r\n$4\r\nEXEC\r\n",
+                       strlen(other), other);
+    send(client, request, len, 0);
+
+    const char *crossReply = "+OK\r\n+QUEUED\r\n+QUEUED\r\n"
+                             "-CROSSSLOT Keys in request don't hash to the same partition\r\n";
+    memset(reply, 0, sizeof(reply));
+    received = 0;
+    while (received < strlen(crossReply)) {
+        ssize_t n = recv(client, reply + received, sizeof(reply) - 1 - received, 0);
+        if (n <= 0) {
+            break;
+        }
+        received += n;
+    }
+    TEST_ASSERT_STRING_EQUAL(crossReply, reply, "Cross-partition EXEC should be refused");
+
+    close(client);
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+// Reads from sock until buf holds len bytes
+static int recv_exact(int sock, char *buf, size_t len) {
+    size_t received = 0;
+    while (received < len) {
+        ssize_t n = recv(sock, buf + received, len - received, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        received += n;
+    }
+    return 0;
+}
+
+#define REPL_TEST_WRITERS 4
+#define REPL_TEST_SETS 16
+#define REPL_TEST_VALUE (64 * 1024)
+
+void test_server_replica_stream(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 5;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    ReactorGroup *group = createReactorGroup(server, 2);
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    // A replica with a tiny receive window that does not read while the
+    // writes go out, so the master's socket writes come up short
+    int replica = socket(AF_INET, SOCK_STREAM, 0);
+    int window = 4096;
+    setsockopt(replica, SOL_SOCKET, SO_RCVBUF, &window, sizeof(window));
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(TEST_PORT + 5);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    connect(replica, (struct sockaddr *)&addr, sizeof(addr));
+    struct timeval timeout = {TEST_TIMEOUT, 0};
+    setsockopt(replica, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    const char *psync = "*3\r\n$5\r\nPSYNC\r\n$1\r\n?\r\n$2\r\n-1\r\n";
+    send(replica, psync, strlen(psync), 0);
+    char sync[128] = {0};
+    size_t syncLen = strlen("+FULLRESYNC 8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb 0\r\n$17\r\n") + 17;
+    TEST_ASSERT(recv_exact(replica, sync, syncLen) == 0 &&
+                strncmp(sync, "+FULLRESYNC ", 12) == 0,
+                "PSYNC should be answered with a full resync");
+
+    // Writers on both reactors replicate large SETs at the same time
+    char *value = malloc(REPL_TEST_VALUE);
+    int writers[REPL_TEST_WRITERS];
+    for (int w = 0; w < REPL_TEST_WRITERS; w++) {
+        writers[w] = connect_test_client(TEST_PORT + 5);
+    }
+    for (int i = 0; i < REPL_TEST_SETS; i++) {
+        for (int w = 0; w < REPL_TEST_WRITERS; w++) {
+            char header[64];
+            int len = snprintf(header, sizeof(header),
+                               "*3\r\n$3\r\nSET\r\n$5\r\nw%d:%02d\r\n$%d\r\n",
+                               w, i, REPL_TEST_VALUE);
+            memset(value, 'a' + w, REPL_TEST_VALUE);
+            send(writers[w], header, len, 0);
+            send(writers[w], value, REPL_TEST_VALUE, 0);
+            send(writers[w], "\r\n", 2, 0);
+        }
+    }
+    int acked = 1;
+    for (int w = 0; w < REPL_TEST_WRITERS; w++) {
+        char replies[5 * REPL_TEST_SETS];
+        acked &= recv_exact(writers[w], replies, sizeof(replies)) == 0 &&
+                 memcmp(replies, "+OK\r\n", 5) == 0;
+        close(writers[w]);
+    }
+    TEST_ASSERT(acked, "Every write should be acknowledged");
+
+    // Now drain the stream: every command must arrive whole, each writer's
+    // in order, and the offset must count exactly the stream
+    RespBuffer *buffer = createRespBuffer();
+    int next[REPL_TEST_WRITERS] = {0};
+    int parsed = 0;
+    int intact = 1;
+    size_t streamBytes = 0;
+    char chunk[16384];
+    while (parsed < REPL_TEST_WRITERS * REPL_TEST_SETS && intact) {
+        ssize_t n = recv(replica, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            intact = 0;
+            break;
+        }
+        streamBytes += n;
+        appendRespBuffer(buffer, chunk, n);
+        RespValue *command;
+        int result;
+        while ((result = parseResp(buffer, &command)) == RESP_OK) {
+            RespValue **args = command->data.array.elements;
+            int w = args[1]->data.string.str[1] - '0';
+            char key[16];
+            snprintf(key, sizeof(key), "w%d:%02d", w, next[w]++);
+            intact &= command->data.array.len == 3 &&
+                      strcmp(args[0]->data.string.str, "SET") == 0 &&
+                      strcmp(args[1]->data.string.str, key) == 0 &&
+                      args[2]->data.string.len == REPL_TEST_VALUE &&
+                      args[2]->data.string.str[REPL_TEST_VALUE - 1] == 'a' + w;
+            freeRespValue(command);
+            parsed++;
+        }
+        intact &= result != RESP_ERR;
+    }
+    TEST_ASSERT(intact && parsed == REPL_TEST_WRITERS * REPL_TEST_SETS,
+                "A slow replica should receive every command whole and in order");
+    TEST_ASSERT_EQUAL(streamBytes, (size_t)replicationOffset(server),
+                      "The offset should count the stream once");
+
+    freeRespBuffer(buffer);
+    free(value);
+    close(replica);
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+#define RACE_TEST_WRITERS 4
+#define RACE_TEST_KEYS 1000
+
+void test_server_replica_write_order(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 8;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    ReactorGroup *group = createReactorGroup(server, 2);
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    int replica = connect_test_client(TEST_PORT + 8);
+    const char *psync = "*3\r\n$5\r\nPSYNC\r\n$1\r\n?\r\n$2\r\n-1\r\n";
+    send(replica, psync, strlen(psync), 0);
+    char sync[128] = {0};
+    size_t syncLen = strlen("+FULLRESYNC 8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb 0\r\n$17\r\n") + 17;
+    TEST_ASSERT(recv_exact(replica, sync, syncLen) == 0,
+                "PSYNC should be answered with a full resync");
+
+    // Writers spread over both reactors race to set the same keys
+    static char batch[RACE_TEST_WRITERS][64 * RACE_TEST_KEYS];
+    size_t batchLen[RACE_TEST_WRITERS] = {0};
+    int writers[RACE_TEST_WRITERS];
+    for (int w = 0; w < RACE_TEST_WRITERS; w++) {
+        writers[w] = connect_test_client(TEST_PORT + 8);
+        for (int i = 0; i < RACE_TEST_KEYS; i++) {
+            batchLen[w] += snprintf(batch[w] + batchLen[w], 64,
+                                    "*3\r\n$3\r\nSET\r\n$9\r\nrace:%04d\r\n$2\r\nw%d\r\n",
+                                    i, w);
+        }
+    }
+    for (int w = 0; w < RACE_TEST_WRITERS; w++) {
+        send(writers[w], batch[w], batchLen[w], 0);
+    }
+    int acked = 1;
+    static char replies[5 * RACE_TEST_KEYS];
+    for (int w = 0; w < RACE_TEST_WRITERS; w++) {
+        acked &= recv_exact(writers[w], replies, sizeof(replies)) == 0;
+        close(writers[w]);
+    }
+    TEST_ASSERT(acked, "Every write should be acknowledged");
+
+    // Replay the stream: the last SET of each key must be the value the
+    // master kept
+    int last[RACE_TEST_KEYS];
+    RespBuffer *buffer = createRespBuffer();
+    int parsed = 0;
+    char chunk[16384];
+    while (parsed < RACE_TEST_WRITERS * RACE_TEST_KEYS) {
+        ssize_t n = recv(replica, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            break;
+        }
+        appendRespBuffer(buffer, chunk, n);
+        RespValue *command;
+        while (parseResp(buffer, &command) == RESP_OK) {
+            RespValue **args = command->data.array.elements;
+            last[atoi(args[1]->data.string.str + 5)] = args[2]->data.string.str[1] - '0';
+            freeRespValue(command);
+            parsed++;
+        }
+    }
+    TEST_ASSERT_EQUAL(RACE_TEST_WRITERS * RACE_TEST_KEYS, parsed,
+                      "Every write should be replicated");
+
+    int ordered = 0;
+    size_t valueLen;
+    for (int i = 0; i < RACE_TEST_KEYS; i++) {
+        char key[16];
+        int len = snprintf(key, sizeof(key), "race:%04d", i);
+        char *value = storeGet(server->db, key, len, &valueLen);
+        if (value && valueLen == 2 && value[1] - '0' == last[i]) {
+            ordered++;
+        }
+        free(value);
+    }
+    TEST_ASSERT_EQUAL(RACE_TEST_KEYS, ordered,
+                      "Replicas should see each key's writes in the master's order");
+
+    freeRespBuffer(buffer);
+    close(replica);
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+// Polls until the server counts the given number of blocked clients
+static int wait_for_blocked(RedisServer *server, int expected) {
+    for (int i = 0; i < 200; i++) {
+        if (__atomic_load_n(&server->blocked_clients, __ATOMIC_SEQ_CST) == expected) {
+            return 1;
+        }
+        usleep(10000);
+    }
+    return 0;
+}
+
+static long long elapsed_ms(struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000LL +
+           (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+#define BLOCKED_TEST_CLIENTS 20
+
+void test_server_blocked_clients(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 6;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = true;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    // Two partitions, so some clients block on a stream another reactor owns
+    ReactorGroup *group = createReactorGroup(server, 2);
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    // Far more blocked clients than there used to be workers for them
+    const char *xread = "*6\r\n$5\r\nXREAD\r\n$5\r\nBLOCK\r\n$1\r\n0\r\n"
+                        "$7\r\nSTREAMS\r\n$6\r\nevents\r\n$1\r\n$\r\n";
+    int blocked[BLOCKED_TEST_CLIENTS];
+    for (int i = 0; i < BLOCKED_TEST_CLIENTS; i++) {
+        blocked[i] = connect_test_client(TEST_PORT + 6);
+        send(blocked[i], xread, strlen(xread), 0);
+    }
+    int quitter = connect_test_client(TEST_PORT + 6);
+    send(quitter, xread, strlen(xread), 0);
+    TEST_ASSERT(wait_for_blocked(server, BLOCKED_TEST_CLIENTS + 1),
+                "Every XREAD BLOCK client should be parked");
+
+    // Leaving while blocked frees the client at once
+    close(quitter);
+    TEST_ASSERT(wait_for_blocked(server, BLOCKED_TEST_CLIENTS),
+                "A blocked client that disconnects should be dropped");
+
+    // Other clients are still served while the blocked ones wait
+    int writer = connect_test_client(TEST_PORT + 6);
+    const char *ping = "*1\r\n$4\r\nPING\r\n";
+    send(writer, ping, strlen(ping), 0);
+    char reply[256] = {0};
+    recv(writer, reply, sizeof(reply) - 1, 0);
+    TEST_ASSERT_STRING_EQUAL("+PONG\r\n", reply, "The server should not be held up");
+
+    const char *xadd = "*5\r\n$4\r\nXADD\r\n$6\r\nevents\r\n$3\r\n1-1\r\n"
+                       "$1\r\nf\r\n$1\r\nv\r\n";
+    send(writer, xadd, strlen(xadd), 0);
+    memset(reply, 0, sizeof(reply));
+    recv(writer, reply, sizeof(reply) - 1, 0);
+    TEST_ASSERT_STRING_EQUAL("$3\r\n1-1\r\n", reply, "XADD should add the entry");
+
+    int woken = 0;
+    for (int i = 0; i < BLOCKED_TEST_CLIENTS; i++) {
+        memset(reply, 0, sizeof(reply));
+        if (recv(blocked[i], reply, sizeof(reply) - 1, 0) > 0 &&
+            strstr(reply, "$6\r\nevents\r\n") && strstr(reply, "$3\r\n1-1\r\n")) {
+            woken++;
+        }
+        // Served again normally once unblocked
+        send(blocked[i], ping, strlen(ping), 0);
+        memset(reply, 0, sizeof(reply));
+        recv(blocked[i], reply, sizeof(reply) - 1, 0);
+        woken -= strcmp(reply, "+PONG\r\n") != 0;
+        close(blocked[i]);
+    }
+    TEST_ASSERT_EQUAL(BLOCKED_TEST_CLIENTS, woken,
+                      "XADD should wake every blocked reader with the entry");
+    TEST_ASSERT(wait_for_blocked(server, 0), "No client should be left blocked");
+
+    // A timeout answers with a null reply once it passes, give or take the
+    // millisecond the clock is read in
+    const char *timed = "*6\r\n$5\r\nXREAD\r\n$5\r\nBLOCK\r\n$3\r\n150\r\n"
+                        "$7\r\nSTREAMS\r\n$7\r\nmissing\r\n$1\r\n$\r\n";
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    send(writer, timed, strlen(timed), 0);
+    memset(reply, 0, sizeof(reply));
+    recv(writer, reply, sizeof(reply) - 1, 0);
+    long long waited = elapsed_ms(&start);
+    TEST_ASSERT_STRING_EQUAL("$-1\r\n", reply, "A timed out XREAD should reply null");
+    TEST_ASSERT(waited >= 140 && waited < 1000,
+                "XREAD BLOCK should time out close to its deadline");
+    close(writer);
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+#define PARKED_TEST_VALUE (4 * 1024 * 1024)
+
+void test_server_blocked_client_output(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 9;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+    char *value = malloc(PARKED_TEST_VALUE);
+    memset(value, 'v', PARKED_TEST_VALUE);
+    storeSet(server->db, "big", 3, value, PARKED_TEST_VALUE);
+
+    ReactorGroup *group = createReactorGroup(server, 2);
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    // The GET reply is far more than the socket takes at once, so most of
+    // it is still queued when the XREAD behind it parks the client
+    int client = connect_test_client(TEST_PORT + 9);
+    const char *pipeline = "*2\r\n$3\r\nGET\r\n$3\r\nbig\r\n"
+                           "*6\r\n$5\r\nXREAD\r\n$5\r\nBLOCK\r\n$1\r\n0\r\n"
+                           "$7\r\nSTREAMS\r\n$6\r\nevents\r\n$1\r\n$\r\n";
+    send(client, pipeline, strlen(pipeline), 0);
+    TEST_ASSERT(wait_for_blocked(server, 1), "XREAD should block");
+
+    char header[32];
+    int headerLen = snprintf(header, sizeof(header), "$%d\r\n", PARKED_TEST_VALUE);
+    char *reply = malloc(headerLen + PARKED_TEST_VALUE + 2);
+    TEST_ASSERT(recv_exact(client, reply, headerLen + PARKED_TEST_VALUE + 2) == 0 &&
+                memcmp(reply, header, headerLen) == 0 &&
+                memcmp(reply + headerLen, value, PARKED_TEST_VALUE) == 0,
+                "Replies queued before a blocking command should keep flowing");
+    TEST_ASSERT_EQUAL(1, __atomic_load_n(&server->blocked_clients, __ATOMIC_SEQ_CST),
+                      "The client should stay blocked while its output drains");
+
+    free(reply);
+    free(value);
+    close(client);
+    TEST_ASSERT(wait_for_blocked(server, 0), "Closing should release the blocked client");
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+void test_server_wait_acks(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT + 7;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, initServer(server), "Server initialization should succeed");
+
+    ReactorGroup *group = createReactorGroup(server, 2);
+    pthread_t thread;
+    pthread_create(&thread, NULL, reactor_group_thread, group);
+
+    int replica = connect_test_client(TEST_PORT + 7);
+    const char *psync = "*3\r\n$5\r\nPSYNC\r\n$1\r\n?\r\n$2\r\n-1\r\n";
+    send(replica, psync, strlen(psync), 0);
+    char sync[128] = {0};
+    size_t syncLen = strlen("+FULLRESYNC 8371b4fb1155b71f4a04d3e1bc3e18c4a990aeeb 0\r\n$17\r\n") + 17;
+    TEST_ASSERT(recv_exact(replica, sync, syncLen) == 0,
+                "PSYNC should be answered with a full resync");
+
+    int client = connect_test_client(TEST_PORT + 7);
+    const char *set = "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$1\r\nv\r\n";
+    send(client, set, strlen(set), 0);
+    char reply[64] = {0};
+    recv(client, reply, sizeof(reply) - 1, 0);
+    TEST_ASSERT_STRING_EQUAL("+OK\r\n", reply, "SET should succeed");
+
+    // WAIT answers as soon as the replica acknowledges the SET
+    const char *getack = "*3\r\n$8\r\nREPLCONF\r\n$6\r\nGETACK\r\n$1\r\n*\r\n";
+    const char *wait = "*3\r\n$4\r\nWAIT\r\n$1\r\n1\r\n$4\r\n5000\r\n";
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    send(client, wait, strlen(wait), 0);
+    char stream[128] = {0};
+    size_t streamLen = strlen(set) + strlen(getack);
+    TEST_ASSERT(recv_exact(replica, stream, streamLen) == 0 &&
+                memcmp(stream, set, strlen(set)) == 0 &&
+                memcmp(stream + strlen(set), getack, strlen(getack)) == 0,
+                "The replica should get the SET, then GETACK");
+    char ack[128];
+    int ackLen = snprintf(ack, sizeof(ack),
+                          "*3\r\n$8\r\nREPLCONF\r\n$3\r\nACK\r\n$2\r\n%zu\r\n",
+                          strlen(set));
+    send(replica, ack, ackLen, 0);
+    memset(reply, 0, sizeof(reply));
+    recv(client, reply, sizeof(reply) - 1, 0);
+    TEST_ASSERT_STRING_EQUAL(":1\r\n", reply, "WAIT should count the acknowledgement");
+    TEST_ASSERT(elapsed_ms(&start) < 1000, "WAIT should not sit out its timeout");
+
+    // Asking for more replicas than exist waits for the timeout
+    const char *waitTwo = "*3\r\n$4\r\nWAIT\r\n$1\r\n2\r\n$3\r\n200\r\n";
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    send(client, waitTwo, strlen(waitTwo), 0);
+    memset(stream, 0, sizeof(stream));
+    recv_exact(replica, stream, strlen(getack));
+    ackLen = snprintf(ack, sizeof(ack),
+                      "*3\r\n$8\r\nREPLCONF\r\n$3\r\nACK\r\n$2\r\n%zu\r\n",
+                      strlen(set) + strlen(getack));
+    send(replica, ack, ackLen, 0);
+    memset(reply, 0, sizeof(reply));
+    recv(client, reply, sizeof(reply) - 1, 0);
+    long long waited = elapsed_ms(&start);
+    TEST_ASSERT_STRING_EQUAL(":1\r\n", reply, "WAIT should report the replicas that acked");
+    TEST_ASSERT(waited >= 190 && waited < 1000, "WAIT should answer at its timeout");
+
+    close(client);
+    close(replica);
+
+    stopReactorGroup(group);
+    pthread_join(thread, NULL);
+    freeReactorGroup(group);
+    freeServer(server);
+}
+
+void test_server_cron_active_expire(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = false;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(CRON_EXPIRE_BUDGET_US, server->expire_budget_us,
+                      "Active expiry should start at the base budget");
+
+    // More due keys than one base budget can delete
+    time_t now = getCurrentTimeMs();
+    char key[32];
+    for (int i = 0; i < 300000; i++) {
+        int len = snprintf(key, sizeof(key), "session:%d", i);
+        storeSet(server->db, key, len, "token", 5);
+        setExpiry(server->db, key, len, now - 1);
+    }
+
+    serverCron(server, 0);
+    TEST_ASSERT(server->expire_time_cap_count == 1 &&
+                server->expire_budget_us == 2 * CRON_EXPIRE_BUDGET_US,
+                "A cycle that runs out of time should double the budget");
+
+    int runs = 1;
+    long long peak = server->expire_budget_us;
+    while (storeSize(server->db) > 0 && runs < 1000) {
+        serverCron(server, 0);
+        peak = server->expire_budget_us > peak ? server->expire_budget_us : peak;
+        runs++;
+    }
+    TEST_ASSERT(peak <= CRON_EXPIRE_BUDGET_MAX_US && storeSize(server->db) == 0,
+                "Growing budgets should drain the backlog within the cap");
+    TEST_ASSERT_EQUAL(300000, serverExpiredKeys(server),
+                      "Every expired key should be counted");
+
+    for (int i = 0; i < 5; i++) {
+        serverCron(server, 0);
+    }
+    TEST_ASSERT_EQUAL(CRON_EXPIRE_BUDGET_US, server->expire_budget_us,
+                      "The budget should shrink back once cycles keep up");
+    TEST_ASSERT(server->expire_cycle_us > 0, "Cycle time should be accounted");
+
+    freeServer(server);
+}
+
+void test_server_cron_partitions(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = true;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, createServerPartitions(server, 2),
+                      "Partition creation should succeed");
+    TEST_ASSERT(!server->partitions[0]->shards[0].locked,
+                "Partitions should be unlocked stores");
+
+    time_t now = getCurrentTimeMs();
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        int len = snprintf(key, sizeof(key), "session:%d", i);
+        for (int p = 0; p < 2; p++) {
+            storeSet(server->partitions[p], key, len, "token", 5);
+            setExpiry(server->partitions[p], key, len, now - 1);
+        }
+    }
+
+    // Each reactor's cron only reaches the partition it owns
+    serverCron(server, 1);
+    TEST_ASSERT(storeSize(server->partitions[0]) == 100 &&
+                storeSize(server->partitions[1]) == 0,
+                "Reactor 1 should expire only its own partition");
+    serverCron(server, 2);
+    TEST_ASSERT_EQUAL(100, storeSize(server->partitions[0]),
+                      "A reactor without a partition should do nothing");
+    serverCron(server, 0);
+    TEST_ASSERT_EQUAL(0, storeSize(server->partitions[0]),
+                      "Reactor 0 should expire its own partition");
+    TEST_ASSERT_EQUAL(200, serverExpiredKeys(server),
+                      "Expired keys should add up across partitions");
+    TEST_ASSERT_EQUAL(CRON_EXPIRE_BUDGET_US, serverExpireBudget(server),
+                      "Cycles that keep up should stay at the base budget");
+
+    freeServer(server);
+}
+
+void test_server_cron_expire_time_cap(void) {
+    ServerConfig *config = malloc(sizeof(ServerConfig));
+    config->port = TEST_PORT;
+    config->dir = strdup("/tmp");
+    config->dbfilename = strdup("test.rdb");
+    config->bindaddr = strdup("127.0.0.1");
+    config->master_host = NULL;
+    config->master_port = 0;
+    config->is_replica = false;
+    config->store_shards = STORE_DEFAULT_SHARDS;
+    config->shared_nothing = true;
+
+    RedisServer *server = createServer(config);
+    TEST_ASSERT_EQUAL(0, createServerPartitions(server, 1),
+                      "Partition creation should succeed");
+
+    time_t now = getCurrentTimeMs();
+    char key[32];
+    for (int i = 0; i < 20000; i++) {
+        int len = snprintf(key, sizeof(key), "session:%d", i);
+        storeSet(server->partitions[0], key, len, "token", 5);
+        setExpiry(server->partitions[0], key, len, now - 1);
+    }
+
+    // No batch of deletes fits in a microsecond, so every cycle hits the cap
+    server->partition_budgets_us[0] = 1;
+    serverCron(server, 0);
+    TEST_ASSERT(storeSize(server->partitions[0]) > 0,
+                "A cycle out of time should leave due keys behind");
+    TEST_ASSERT_EQUAL(1, server->expire_time_cap_count,
+                      "A cycle out of time should be counted");
+    TEST_ASSERT_EQUAL(2, server->partition_budgets_us[0],
+                      "A cycle out of time should double the budget");
+    serverCron(server, 0);
+    TEST_ASSERT(server->expire_time_cap_count == 2 &&
+                server->partition_budgets_us[0] == 4,
+                "Each cycle out of time should count and double again");
+
+    int runs = 0;
+    while (storeSize(server->partitions[0]) > 0 && runs++ < 1000) {
+        serverCron(server, 0);
+    }
+    long long cap = server->expire_time_cap_count;
+    for (int i = 0; i < 5; i++) {
+        serverCron(server, 0);
+    }
+    TEST_ASSERT(server->expire_time_cap_count == cap &&
+                server->partition_budgets_us[0] == CRON_EXPIRE_BUDGET_US,
+                "Cycles that keep up should not count and shrink to the base budget");
+
+    freeServer(server);
+}
+
 void run_integration_tests(void) {
     printf("\n=== Integration Tests ===\n");
     RUN_TEST(test_server_create_and_init);
@@ -246,4 +1117,15 @@ void run_integration_tests(void) {
     RUN_TEST(test_server_statistics);
     RUN_TEST(test_server_concurrent_operations);
     RUN_TEST(test_server_memory_management);
+    RUN_TEST(test_server_event_loop);
+    RUN_TEST(test_server_reactor_group);
+    RUN_TEST(test_server_shared_nothing);
+    RUN_TEST(test_server_replica_stream);
+    RUN_TEST(test_server_replica_write_order);
+    RUN_TEST(test_server_blocked_clients);
+    RUN_TEST(test_server_blocked_client_output);
+    RUN_TEST(test_server_wait_acks);
+    RUN_TEST(test_server_cron_active_expire);
+    RUN_TEST(test_server_cron_partitions);
+    RUN_TEST(test_server_cron_expire_time_cap);
 }
\ No newline at end of file
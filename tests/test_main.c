@@ -6,15 +6,29 @@ void run_resp_tests(void);
 void run_command_tests(void);
 void run_stream_tests(void);
 void run_integration_tests(void);
+void run_output_buffer_tests(void);
+void run_hash_table_tests(void);
+void run_spsc_queue_tests(void);
+void run_slab_tests(void);
+void run_arena_tests(void);
+void run_timer_wheel_tests(void);
+void run_clock_tests(void);
 
 int main(void) {
     test_init();
     
     // Run all test suites
     run_redis_store_tests();
+    run_hash_table_tests();
     run_resp_tests();
     run_command_tests();
     run_stream_tests();
+    run_output_buffer_tests();
+    run_spsc_queue_tests();
+    run_slab_tests();
+    run_arena_tests();
+    run_timer_wheel_tests();
+    run_clock_tests();
     run_integration_tests();
     
     // Print summary
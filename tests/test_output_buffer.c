@@ -0,0 +1,152 @@
+#include "test_framework.h"
+#include "output_buffer.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void test_create_output_buffer(void) {
+    OutputBuffer *out = createOutputBuffer();
+    TEST_ASSERT_NOT_NULL(out, "OutputBuffer creation should succeed");
+    TEST_ASSERT_EQUAL(0, out->pending, "New buffer should have nothing pending");
+    TEST_ASSERT_NULL(out->head, "New buffer should have no chunks");
+    freeOutputBuffer(out);
+}
+
+void test_output_buffer_append(void) {
+    OutputBuffer *out = createOutputBuffer();
+
+    outputBufferAppend(out, "+OK\r\n", 5);
+    outputBufferAppend(out, ":1\r\n", 4);
+    TEST_ASSERT_EQUAL(9, out->pending, "Pending should count every appended byte");
+    TEST_ASSERT_PTR_EQUAL(out->head, out->tail, "Small replies should share a chunk");
+    TEST_ASSERT(memcmp(out->head->data, "+OK\r\n:1\r\n", 9) == 0,
+                "Chunk should hold replies in order");
+
+    freeOutputBuffer(out);
+}
+
+void test_output_buffer_append_large(void) {
+    OutputBuffer *out = createOutputBuffer();
+    size_t len = OUTPUT_CHUNK_SIZE * 3 + 7;
+    char *data = malloc(len);
+    memset(data, 'x', len);
+
+    outputBufferAppend(out, "+OK\r\n", 5);
+    int result = outputBufferAppend(out, data, len);
+    TEST_ASSERT_EQUAL(OUTPUT_OK, result, "Large append should succeed");
+    TEST_ASSERT_EQUAL(len + 5, out->pending, "Pending should include large reply");
+    TEST_ASSERT(out->head != out->tail, "Large reply should spill into a new chunk");
+
+    free(data);
+    freeOutputBuffer(out);
+}
+
+void test_output_buffer_flush(void) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    OutputBuffer *out = createOutputBuffer();
+    outputBufferAppend(out, "$5\r\n", 4);
+    outputBufferAppend(out, "hello\r\n", 7);
+
+    int result = flushOutputBuffer(out, fds[0]);
+    TEST_ASSERT_EQUAL(OUTPUT_OK, result, "Flush to a ready socket should drain the buffer");
+    TEST_ASSERT_EQUAL(0, out->pending, "Nothing should be pending after flush");
+
+    char received[32] = {0};
+    recv(fds[1], received, sizeof(received) - 1, 0);
+    TEST_ASSERT_STRING_EQUAL("$5\r\nhello\r\n", received, "Peer should receive the queued bytes");
+
+    freeOutputBuffer(out);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_output_buffer_partial_flush(void) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL, 0) | O_NONBLOCK);
+
+    size_t len = 4 * 1024 * 1024;
+    char *data = malloc(len);
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (char)(i % 251);
+    }
+
+    OutputBuffer *out = createOutputBuffer();
+    outputBufferAppend(out, data, len);
+
+    int result = flushOutputBuffer(out, fds[0]);
+    TEST_ASSERT_EQUAL(OUTPUT_PENDING, result, "Flush to a full socket should leave data pending");
+    TEST_ASSERT(out->pending > 0 && out->pending < len, "Partial write should keep the unsent tail");
+
+    // Drain the peer while flushing the rest, then verify nothing was lost
+    char *received = malloc(len);
+    size_t total = 0;
+    while (total < len) {
+        ssize_t n = recv(fds[1], received + total, len - total, MSG_DONTWAIT);
+        if (n > 0) {
+            total += n;
+        }
+        flushOutputBuffer(out, fds[0]);
+    }
+    TEST_ASSERT_EQUAL(0, out->pending, "Buffer should drain once the peer reads");
+    TEST_ASSERT(memcmp(data, received, len) == 0, "Partial writes should not corrupt the stream");
+
+    free(received);
+    free(data);
+    freeOutputBuffer(out);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void test_output_buffer_append_shared(void) {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+
+    size_t len = SHARED_VALUE_MIN_REF * 2;
+    char *data = malloc(len);
+    memset(data, 's', len);
+    SharedValue *value = createSharedValue(data, len);
+
+    OutputBuffer *out = createOutputBuffer();
+    outputBufferAppend(out, "$", 1);
+    outputBufferAppendShared(out, value);
+    outputBufferAppend(out, "\r\n", 2);
+    TEST_ASSERT(out->head->next->shared == value && value->refcount == 2,
+                "Large value should be referenced instead of copied");
+    TEST_ASSERT_EQUAL(len + 3, out->pending, "Pending should count the referenced bytes");
+
+    char *received = malloc(len + 3);
+    flushOutputBuffer(out, fds[0]);
+    size_t total = 0;
+    while (total < len + 3) {
+        ssize_t n = recv(fds[1], received + total, len + 3 - total, 0);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    TEST_ASSERT(total == len + 3 && received[0] == '$' &&
+                memcmp(received + 1, data, len) == 0,
+                "Referenced bytes should be written in order");
+    TEST_ASSERT_EQUAL(1, value->refcount, "Flushed chunk should release its reference");
+
+    releaseSharedValue(value);
+    free(received);
+    free(data);
+    freeOutputBuffer(out);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+void run_output_buffer_tests(void) {
+    printf("\n=== Output Buffer Tests ===\n");
+    RUN_TEST(test_create_output_buffer);
+    RUN_TEST(test_output_buffer_append);
+    RUN_TEST(test_output_buffer_append_large);
+    RUN_TEST(test_output_buffer_flush);
+    RUN_TEST(test_output_buffer_partial_flush);
+    RUN_TEST(test_output_buffer_append_shared);
+}
@@ -8,8 +8,9 @@
 void test_create_store(void) {
     RedisStore *store = createStore();
     TEST_ASSERT_NOT_NULL(store, "Store creation should succeed");
-    TEST_ASSERT_EQUAL(INITIAL_STORE_SIZE, store->size, "Initial store size should be correct");
-    TEST_ASSERT_EQUAL(0, store->used, "Initial store usage should be 0");
+    TEST_ASSERT_EQUAL(STORE_DEFAULT_SHARDS, store->shardCount, "Store should use the default shard count");
+    TEST_ASSERT_EQUAL(INITIAL_STORE_SIZE, store->shards[0].table->ht[0].capacity, "Initial store size should be correct");
+    TEST_ASSERT_EQUAL(0, storeSize(store), "Initial store usage should be 0");
     freeStore(store);
 }
 
@@ -19,11 +20,11 @@ void test_store_set_and_get(void) {
     const char *value = "testvalue";
     size_t valueLen = strlen(value) + 1;
     
-    int result = storeSet(store, key, (void*)value, valueLen);
+    int result = storeSet(store, key, strlen(key), (void*)value, valueLen);
     TEST_ASSERT_EQUAL(STORE_OK, result, "Store set should succeed");
     
     size_t retrievedLen;
-    void *retrieved = storeGet(store, key, &retrievedLen);
+    void *retrieved = storeGet(store, key, strlen(key), &retrievedLen);
     TEST_ASSERT_NOT_NULL(retrieved, "Retrieved value should not be NULL");
     TEST_ASSERT_EQUAL(valueLen, retrievedLen, "Retrieved value length should match");
     TEST_ASSERT_STRING_EQUAL(value, (char*)retrieved, "Retrieved value should match original");
@@ -35,7 +36,7 @@ void test_store_set_and_get(void) {
 void test_store_get_nonexistent(void) {
     RedisStore *store = createStore();
     size_t retrievedLen;
-    void *retrieved = storeGet(store, "nonexistent", &retrievedLen);
+    void *retrieved = storeGet(store, "nonexistent", strlen("nonexistent"), &retrievedLen);
     TEST_ASSERT_NULL(retrieved, "Non-existent key should return NULL");
     freeStore(store);
 }
@@ -48,11 +49,11 @@ void test_store_overwrite(void) {
     size_t valueLen1 = strlen(value1) + 1;
     size_t valueLen2 = strlen(value2) + 1;
     
-    storeSet(store, key, (void*)value1, valueLen1);
-    storeSet(store, key, (void*)value2, valueLen2);
+    storeSet(store, key, strlen(key), (void*)value1, valueLen1);
+    storeSet(store, key, strlen(key), (void*)value2, valueLen2);
     
     size_t retrievedLen;
-    void *retrieved = storeGet(store, key, &retrievedLen);
+    void *retrieved = storeGet(store, key, strlen(key), &retrievedLen);
     TEST_ASSERT_NOT_NULL(retrieved, "Retrieved value should not be NULL");
     TEST_ASSERT_EQUAL(valueLen2, retrievedLen, "Retrieved value length should match new value");
     TEST_ASSERT_STRING_EQUAL(value2, (char*)retrieved, "Retrieved value should match new value");
@@ -69,13 +70,13 @@ void test_store_multiple_keys(void) {
     
     for (size_t i = 0; i < numKeys; i++) {
         size_t valueLen = strlen(values[i]) + 1;
-        int result = storeSet(store, keys[i], (void*)values[i], valueLen);
+        int result = storeSet(store, keys[i], strlen(keys[i]), (void*)values[i], valueLen);
         TEST_ASSERT_EQUAL(STORE_OK, result, "Store set should succeed for multiple keys");
     }
     
     for (size_t i = 0; i < numKeys; i++) {
         size_t retrievedLen;
-        void *retrieved = storeGet(store, keys[i], &retrievedLen);
+        void *retrieved = storeGet(store, keys[i], strlen(keys[i]), &retrievedLen);
         TEST_ASSERT_NOT_NULL(retrieved, "Retrieved value should not be NULL for multiple keys");
         TEST_ASSERT_STRING_EQUAL(values[i], (char*)retrieved, "Retrieved value should match for multiple keys");
         free(retrieved);
@@ -90,20 +91,20 @@ void test_store_expiry(void) {
     const char *value = "expiring_value";
     size_t valueLen = strlen(value) + 1;
     
-    storeSet(store, key, (void*)value, valueLen);
+    storeSet(store, key, strlen(key), (void*)value, valueLen);
     
     time_t expiry = getCurrentTimeMs() + 1000; // 1 second from now in milliseconds
-    int result = setExpiry(store, key, expiry);
+    int result = setExpiry(store, key, strlen(key), expiry);
     TEST_ASSERT_EQUAL(STORE_OK, result, "Setting expiry should succeed");
     
     size_t retrievedLen;
-    void *retrieved = storeGet(store, key, &retrievedLen);
+    void *retrieved = storeGet(store, key, strlen(key), &retrievedLen);
     TEST_ASSERT_NOT_NULL(retrieved, "Value should still be retrievable before expiry");
     free(retrieved);
     
     sleep(2);
     
-    retrieved = storeGet(store, key, &retrievedLen);
+    retrieved = storeGet(store, key, strlen(key), &retrievedLen);
     TEST_ASSERT_NULL(retrieved, "Value should be NULL after expiry");
     
     freeStore(store);
@@ -115,12 +116,12 @@ void test_store_value_type(void) {
     const char *value = "test_value";
     size_t valueLen = strlen(value) + 1;
     
-    storeSet(store, key, (void*)value, valueLen);
+    storeSet(store, key, strlen(key), (void*)value, valueLen);
     
-    ValueType type = getValueType(store, key);
+    ValueType type = getValueType(store, key, strlen(key));
     TEST_ASSERT_EQUAL(TYPE_STRING, type, "Value type should be TYPE_STRING");
     
-    type = getValueType(store, "nonexistent");
+    type = getValueType(store, "nonexistent", strlen("nonexistent"));
     TEST_ASSERT_EQUAL(TYPE_NONE, type, "Non-existent key should return TYPE_NONE");
     
     freeStore(store);
@@ -133,22 +134,22 @@ void test_store_null_parameters(void) {
     size_t valueLen = strlen(value) + 1;
     size_t retrievedLen;
     
-    int result = storeSet(NULL, key, (void*)value, valueLen);
+    int result = storeSet(NULL, key, strlen(key), (void*)value, valueLen);
     TEST_ASSERT_EQUAL(STORE_ERR, result, "Store set with NULL store should fail");
     
-    result = storeSet(store, NULL, (void*)value, valueLen);
+    result = storeSet(store, NULL, 0, (void*)value, valueLen);
     TEST_ASSERT_EQUAL(STORE_ERR, result, "Store set with NULL key should fail");
     
-    result = storeSet(store, key, NULL, valueLen);
+    result = storeSet(store, key, strlen(key), NULL, valueLen);
     TEST_ASSERT_EQUAL(STORE_ERR, result, "Store set with NULL value should fail");
     
-    void *retrieved = storeGet(NULL, key, &retrievedLen);
+    void *retrieved = storeGet(NULL, key, strlen(key), &retrievedLen);
     TEST_ASSERT_NULL(retrieved, "Store get with NULL store should return NULL");
     
-    retrieved = storeGet(store, NULL, &retrievedLen);
+    retrieved = storeGet(store, NULL, 0, &retrievedLen);
     TEST_ASSERT_NULL(retrieved, "Store get with NULL key should return NULL");
     
-    retrieved = storeGet(store, key, NULL);
+    retrieved = storeGet(store, key, strlen(key), NULL);
     TEST_ASSERT_NULL(retrieved, "Store get with NULL valueLen should return NULL");
     
     freeStore(store);
@@ -166,12 +167,12 @@ void test_store_hash_collision(void) {
     size_t valueLen1 = strlen(value1) + 1;
     size_t valueLen2 = strlen(value2) + 1;
     
-    storeSet(store, key1, (void*)value1, valueLen1);
-    storeSet(store, key2, (void*)value2, valueLen2);
+    storeSet(store, key1, strlen(key1), (void*)value1, valueLen1);
+    storeSet(store, key2, strlen(key2), (void*)value2, valueLen2);
     
     size_t retrievedLen;
-    void *retrieved1 = storeGet(store, key1, &retrievedLen);
-    void *retrieved2 = storeGet(store, key2, &retrievedLen);
+    void *retrieved1 = storeGet(store, key1, strlen(key1), &retrievedLen);
+    void *retrieved2 = storeGet(store, key2, strlen(key2), &retrievedLen);
     
     TEST_ASSERT_NOT_NULL(retrieved1, "First value should be retrievable");
     TEST_ASSERT_NOT_NULL(retrieved2, "Second value should be retrievable");
@@ -183,6 +184,701 @@ void test_store_hash_collision(void) {
     freeStore(store);
 }
 
+void test_store_binary_keys(void) {
+    RedisStore *store = createStore();
+
+    // Keys that only differ after an embedded NUL must not collide
+    const char key1[] = {'k', '\0', 'a'};
+    const char key2[] = {'k', '\0', 'b'};
+    storeSet(store, key1, sizeof(key1), "one", 3);
+    storeSet(store, key2, sizeof(key2), "two", 3);
+    TEST_ASSERT_EQUAL(2, storeSize(store), "Keys with embedded NUL should be distinct");
+
+    size_t retrievedLen;
+    void *retrieved = storeGet(store, key2, sizeof(key2), &retrievedLen);
+    TEST_ASSERT_NOT_NULL(retrieved, "Binary key should be retrievable");
+    TEST_ASSERT(retrievedLen == 3 && memcmp(retrieved, "two", 3) == 0,
+                "Binary key should map to its own value");
+    free(retrieved);
+
+    retrieved = storeGet(store, "k", 1, &retrievedLen);
+    TEST_ASSERT_NULL(retrieved, "Key prefix up to the NUL should not match");
+
+    freeStore(store);
+}
+
+void test_store_delete(void) {
+    RedisStore *store = createStore();
+
+    storeSet(store, "key", 3, "value", 5);
+    TEST_ASSERT_EQUAL(STORE_OK, storeDelete(store, "key", 3), "Delete should succeed");
+    TEST_ASSERT_EQUAL(0, storeSize(store), "Store should be empty after delete");
+
+    size_t retrievedLen;
+    TEST_ASSERT_NULL(storeGet(store, "key", 3, &retrievedLen), "Deleted key should be gone");
+    TEST_ASSERT_EQUAL(STORE_ERR, storeDelete(store, "key", 3),
+                      "Deleting a missing key should fail");
+
+    freeStore(store);
+}
+
+void test_store_get_expiry(void) {
+    RedisStore *store = createStore();
+
+    time_t expiry = 0;
+    TEST_ASSERT_EQUAL(STORE_ERR, getExpiry(store, "key", 3, &expiry),
+                      "Missing key should have no expiry");
+
+    storeSet(store, "key", 3, "value", 5);
+    time_t future = getCurrentTimeMs() + 60000;
+    setExpiry(store, "key", 3, future);
+    TEST_ASSERT_EQUAL(STORE_OK, getExpiry(store, "key", 3, &expiry), "Get expiry should succeed");
+    TEST_ASSERT_EQUAL(future, expiry, "Expiry should match the value set");
+
+    setExpiry(store, "key", 3, 12345);
+    TEST_ASSERT_EQUAL(STORE_ERR, getExpiry(store, "key", 3, &expiry),
+                      "A key past its expiry should have no expiry to read");
+
+    freeStore(store);
+}
+
+void test_store_clear(void) {
+    RedisStore *store = createStore();
+
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        storeSet(store, key, len, "v", 1);
+    }
+    storeClear(store);
+    TEST_ASSERT_EQUAL(0, storeSize(store), "Store should be empty after clear");
+
+    size_t retrievedLen;
+    TEST_ASSERT_NULL(storeGet(store, "key1", 4, &retrievedLen), "Cleared key should be gone");
+    storeSet(store, "key1", 4, "v", 1);
+    TEST_ASSERT_EQUAL(1, storeSize(store), "Store should be usable after clear");
+
+    freeStore(store);
+}
+
+void test_store_rehash(void) {
+    RedisStore *store = createShardedStore(1);
+    HashTable *table = store->shards[0].table;
+
+    // Stop while a resize is still in progress
+    char key[32];
+    size_t count = 0;
+    while (count < 100000 &&
+           !(hashTableIsRehashing(table) && table->ht[0].capacity >= 4096)) {
+        int len = snprintf(key, sizeof(key), "key%zu", count++);
+        storeSet(store, key, len, key, len);
+    }
+    TEST_ASSERT(hashTableIsRehashing(table), "Store should be mid-resize");
+
+    storeRehash(store, 1000000);
+    TEST_ASSERT(!hashTableIsRehashing(table), "A generous budget should finish the resize");
+    TEST_ASSERT_EQUAL(count, storeSize(store), "Every key should survive the resize");
+
+    int intact = 1;
+    for (size_t i = 0; i < count; i++) {
+        int len = snprintf(key, sizeof(key), "key%zu", i);
+        size_t valueLen;
+        char *value = storeGet(store, key, len, &valueLen);
+        if (!value || valueLen != (size_t)len || memcmp(value, key, len) != 0) {
+            intact = 0;
+        }
+        free(value);
+    }
+    TEST_ASSERT(intact, "Values should be readable after the resize");
+
+    freeStore(store);
+}
+
+void test_store_shards(void) {
+    RedisStore *store = createShardedStore(5);
+    TEST_ASSERT_EQUAL(8, store->shardCount, "Shard count should round up to a power of two");
+
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        storeSet(store, key, len, "v", 1);
+    }
+
+    int spread = 1;
+    for (size_t i = 0; i < store->shardCount; i++) {
+        if (hashTableSize(store->shards[i].table) == 0) {
+            spread = 0;
+        }
+    }
+    TEST_ASSERT(spread, "Keys should be spread over every shard");
+    TEST_ASSERT_EQUAL(1000, storeSize(store), "Size should add up every shard");
+
+    storeDelete(store, "key7", 4);
+    size_t valueLen;
+    TEST_ASSERT_NULL(storeGet(store, "key7", 4, &valueLen), "Deleted key should be gone");
+    storeClear(store);
+    TEST_ASSERT_EQUAL(0, storeSize(store), "Clear should empty every shard");
+    freeStore(store);
+
+    store = createShardedStore(100000);
+    TEST_ASSERT_EQUAL(STORE_MAX_SHARDS, store->shardCount, "Shard count should be capped");
+    freeStore(store);
+}
+
+void test_store_owned(void) {
+    RedisStore *store = createOwnedStore();
+    TEST_ASSERT_EQUAL(1, store->shardCount, "An owned store should have one shard");
+    TEST_ASSERT(!store->shards[0].locked, "An owned store should not lock");
+
+    char key[32];
+    time_t now = getCurrentTimeMs();
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        storeSet(store, key, len, "v", 1);
+        if (i % 2) {
+            setExpiry(store, key, len, now - 1);
+        }
+    }
+    size_t valueLen;
+    TEST_ASSERT_NULL(storeGet(store, "key1", 4, &valueLen), "Expired key should be gone");
+    long long counter = 0;
+    TEST_ASSERT(storeIncrBy(store, "counter", 7, 1, &counter) == STORE_OK && counter == 1,
+                "Increments should work without locks");
+    storeRehash(store, 1000000);
+    storeActiveExpire(store, 1000000, NULL);
+    TEST_ASSERT_EQUAL(501, storeSize(store), "Active expiry should reclaim the rest");
+    freeStore(store);
+}
+
+typedef struct {
+    RedisStore *store;
+    int id;
+} StoreWriterArgs;
+
+static void *store_writer(void *arg) {
+    StoreWriterArgs *args = arg;
+    char key[32];
+    for (int i = 0; i < 5000; i++) {
+        int len = snprintf(key, sizeof(key), "t%d:%d", args->id, i);
+        storeSet(args->store, key, len, key, len);
+        size_t valueLen;
+        free(storeGet(args->store, key, len, &valueLen));
+    }
+    return NULL;
+}
+
+void test_store_concurrent_writers(void) {
+    RedisStore *store = createStore();
+    pthread_t threads[4];
+    StoreWriterArgs args[4];
+    for (int i = 0; i < 4; i++) {
+        args[i].store = store;
+        args[i].id = i;
+        pthread_create(&threads[i], NULL, store_writer, &args[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT_EQUAL(20000, storeSize(store), "Concurrent writers should not lose keys");
+
+    size_t valueLen;
+    char *value = storeGet(store, "t3:4999", 7, &valueLen);
+    TEST_ASSERT(value && valueLen == 7 && memcmp(value, "t3:4999", 7) == 0,
+                "Values written concurrently should be intact");
+    free(value);
+    freeStore(store);
+}
+
+typedef struct VisitedValue {
+    const void *data;
+    size_t len;
+    int calls;
+} VisitedValue;
+
+static void record_value(const void *value, size_t valueLen, SharedValue *shared, void *ctx) {
+    (void)shared;
+    VisitedValue *visited = (VisitedValue *)ctx;
+    visited->data = value;
+    visited->len = valueLen;
+    visited->calls++;
+}
+
+void test_store_visit_value(void) {
+    RedisStore *store = createStore();
+    storeSet(store, "key", 3, "value", 5);
+
+    VisitedValue visited = {0};
+    TEST_ASSERT_EQUAL(STORE_OK, storeVisitValue(store, "key", 3, record_value, &visited),
+                      "Visiting a stored string should succeed");
+    TEST_ASSERT(visited.calls == 1 && visited.len == 5 &&
+                memcmp(visited.data, "value", 5) == 0,
+                "Visitor should see the value once");
+
+    visited.calls = 0;
+    TEST_ASSERT_EQUAL(STORE_ERR, storeVisitValue(store, "missing", 7, record_value, &visited),
+                      "Visiting a missing key should fail");
+    char *id;
+    storeStreamAdd(store, "stream", 6, "1-1", NULL, NULL, 0, &id);
+    free(id);
+    TEST_ASSERT_EQUAL(STORE_WRONGTYPE, storeStreamAdd(store, "key", 3, "1-1", NULL, NULL, 0, &id),
+                      "Adding to a string key should fail with a type error");
+    TEST_ASSERT_EQUAL(STORE_ERR, storeVisitValue(store, "stream", 6, record_value, &visited),
+                      "Visiting a non-string key should fail");
+    TEST_ASSERT_EQUAL(0, visited.calls, "Visitor should not run without a value");
+
+    freeStore(store);
+}
+
+void test_store_shared_value(void) {
+    RedisStore *store = createStore();
+    char old[STORE_EMBED_MAX + 1], updated[STORE_EMBED_MAX + 1];
+    memset(old, 'o', sizeof(old));
+    memset(updated, 'n', sizeof(updated));
+    storeSet(store, "key", 3, old, sizeof(old));
+
+    SharedValue *held = storeGetShared(store, "key", 3);
+    TEST_ASSERT_NOT_NULL(held, "Shared get should return the value");
+    TEST_ASSERT_EQUAL(2, held->refcount, "Reader and store should share one copy");
+
+    // Overwriting installs a new value, the reader keeps the old bytes
+    SharedValue *fresh = createSharedValue(updated, sizeof(updated));
+    storeSetShared(store, "key", 3, fresh);
+    TEST_ASSERT(held->refcount == 1 && memcmp(held->data, old, sizeof(old)) == 0,
+                "Overwrite should leave the held value intact");
+
+    SharedValue *current = storeGetShared(store, "key", 3);
+    TEST_ASSERT_PTR_EQUAL(fresh, current, "Store should reference the value it was given");
+
+    storeDelete(store, "key", 3);
+    TEST_ASSERT_EQUAL(2, fresh->refcount, "Delete should drop only the store's reference");
+    TEST_ASSERT_NULL(storeGetShared(store, "key", 3), "Deleted key should have no value");
+
+    releaseSharedValue(held);
+    releaseSharedValue(current);
+    releaseSharedValue(fresh);
+    freeStore(store);
+}
+
+static StoreEntry *find_entry(RedisStore *store, const char *key) {
+    size_t keyLen = strlen(key);
+    uint64_t hash = storeKeyHash(key, keyLen);
+    StoreShard *shard = &store->shards[(hash >> 54) & (store->shardCount - 1)];
+    return hashTableFind(shard->table, key, keyLen, hash);
+}
+
+void test_store_value_encodings(void) {
+    RedisStore *store = createStore();
+    char large[STORE_EMBED_MAX + 1];
+    memset(large, 'x', sizeof(large));
+
+    storeSet(store, "int", 3, "-12345", 6);
+    storeSet(store, "padded", 6, "007", 3);
+    storeSet(store, "small", 5, "hello", 5);
+    storeSet(store, "large", 5, large, sizeof(large));
+    TEST_ASSERT(find_entry(store, "int")->encoding == ENCODING_INT &&
+                find_entry(store, "int")->value.integer == -12345,
+                "Canonical integers should be stored natively");
+    TEST_ASSERT_EQUAL(ENCODING_EMBED, find_entry(store, "padded")->encoding,
+                      "Non-canonical integers should keep their bytes");
+    TEST_ASSERT_EQUAL(ENCODING_EMBED, find_entry(store, "small")->encoding,
+                      "Short values should be embedded");
+    TEST_ASSERT_EQUAL(ENCODING_SHARED, find_entry(store, "large")->encoding,
+                      "Long values should use a shared buffer");
+
+    size_t len;
+    char *value = storeGet(store, "int", 3, &len);
+    TEST_ASSERT(len == 6 && strcmp(value, "-12345") == 0,
+                "Integer values should read back as their original bytes");
+    free(value);
+    value = storeGet(store, "padded", 6, &len);
+    TEST_ASSERT(len == 3 && strcmp(value, "007") == 0, "Padded integer should read back unchanged");
+    free(value);
+
+    // Growing an embedded value past its entry's room moves the entry
+    storeSet(store, "small", 5, "a somewhat longer value that still embeds", 41);
+    value = storeGet(store, "small", 5, &len);
+    TEST_ASSERT(len == 41 && strcmp(value, "a somewhat longer value that still embeds") == 0,
+                "Grown embedded value should read back");
+    free(value);
+    storeSet(store, "small", 5, large, sizeof(large));
+    storeSet(store, "large", 5, "tiny", 4);
+    TEST_ASSERT(find_entry(store, "small")->encoding == ENCODING_SHARED &&
+                find_entry(store, "large")->encoding == ENCODING_EMBED,
+                "Overwrites should switch encodings both ways");
+    TEST_ASSERT_EQUAL(4, storeSize(store), "Re-encoding should not add keys");
+
+    freeStore(store);
+}
+
+void test_store_incr_by(void) {
+    RedisStore *store = createStore();
+    long long value = 0;
+
+    TEST_ASSERT_EQUAL(STORE_OK, storeIncrBy(store, "counter", 7, 5, &value),
+                      "Incrementing a missing key should succeed");
+    TEST_ASSERT_EQUAL(5, value, "Missing key should count as 0");
+    storeIncrBy(store, "counter", 7, -8, &value);
+    TEST_ASSERT_EQUAL(-3, value, "Negative delta should decrement");
+    TEST_ASSERT_EQUAL(ENCODING_INT, find_entry(store, "counter")->encoding,
+                      "Counter should stay natively encoded");
+
+    storeSet(store, "max", 3, "9223372036854775807", 19);
+    TEST_ASSERT_EQUAL(STORE_OVERFLOW, storeIncrBy(store, "max", 3, 1, &value),
+                      "Overflow should be refused");
+    storeSet(store, "text", 4, "abc", 3);
+    TEST_ASSERT_EQUAL(STORE_NOT_NUMBER, storeIncrBy(store, "text", 4, 1, &value),
+                      "Non-integer value should be refused");
+    char *id;
+    storeStreamAdd(store, "stream", 6, "1-1", NULL, NULL, 0, &id);
+    free(id);
+    TEST_ASSERT_EQUAL(STORE_WRONGTYPE, storeIncrBy(store, "stream", 6, 1, &value),
+                      "Stream key should be refused");
+
+    // An expired counter starts over without its old TTL
+    storeSet(store, "old", 3, "41", 2);
+    setExpiry(store, "old", 3, getCurrentTimeMs() - 1);
+    storeIncrBy(store, "old", 3, 1, &value);
+    time_t expiry = -1;
+    getExpiry(store, "old", 3, &expiry);
+    TEST_ASSERT(value == 1 && expiry == 0, "Expired key should count as missing");
+
+    freeStore(store);
+}
+
+void test_store_incr_by_float(void) {
+    RedisStore *store = createStore();
+    char result[STORE_FLOAT_BUF];
+    size_t len;
+
+    storeSet(store, "f", 1, "10.50", 5);
+    TEST_ASSERT_EQUAL(STORE_OK, storeIncrByFloat(store, "f", 1, 0.1L, result, sizeof(result), &len),
+                      "Float increment should succeed");
+    TEST_ASSERT_STRING_EQUAL("10.6", result, "Result should drop trailing zeros");
+    storeIncrByFloat(store, "f", 1, -0.6L, result, sizeof(result), &len);
+    TEST_ASSERT(strcmp(result, "10") == 0 && find_entry(store, "f")->encoding == ENCODING_INT,
+                "Integral result should be stored as an integer");
+
+    storeSet(store, "text", 4, "1.5x", 4);
+    TEST_ASSERT_EQUAL(STORE_NOT_NUMBER,
+                      storeIncrByFloat(store, "text", 4, 1, result, sizeof(result), &len),
+                      "Non-numeric value should be refused");
+
+    freeStore(store);
+}
+
+typedef struct CounterArgs {
+    RedisStore *store;
+    int increments;
+} CounterArgs;
+
+static void *store_counter(void *arg) {
+    CounterArgs *args = (CounterArgs *)arg;
+    long long value;
+    for (int i = 0; i < args->increments; i++) {
+        storeIncrBy(args->store, "hits", 4, 1, &value);
+    }
+    return NULL;
+}
+
+void test_store_concurrent_increments(void) {
+    RedisStore *store = createStore();
+    pthread_t threads[4];
+    CounterArgs args = {store, 25000};
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, store_counter, &args);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    long long value = 0;
+    storeIncrBy(store, "hits", 4, 0, &value);
+    TEST_ASSERT_EQUAL(100000, value, "Concurrent increments should never be lost");
+    freeStore(store);
+}
+
+// Checks every shard's timer wheel holds exactly its keys with a TTL
+static int expiry_wheels_valid(RedisStore *store) {
+    for (size_t s = 0; s < store->shardCount; s++) {
+        StoreShard *shard = &store->shards[s];
+        size_t expiring = 0;
+        size_t pos = 0;
+        StoreEntry *entry;
+        while ((entry = hashTableNext(shard->table, &pos))) {
+            if ((entry->timer.when != 0) != (entry->timer.pprev != NULL) ||
+                (entry->timer.pprev && *entry->timer.pprev != &entry->timer)) {
+                return 0;
+            }
+            expiring += entry->timer.when != 0;
+        }
+        if (expiring != shard->expiring.count) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void test_store_active_expire(void) {
+    RedisStore *store = createStore();
+    time_t now = getCurrentTimeMs();
+    char key[32];
+    char result[STORE_FLOAT_BUF];
+    size_t resultLen;
+
+    // Due keys and deleted keys, among keys with a future TTL, a removed
+    // TTL or one dropped by overwriting the value
+    for (int i = 0; i < 2000; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        storeSet(store, key, len, "1", 1);
+        if (i % 8 == 0) {
+            setExpiry(store, key, len, now + 60000);
+            storeDelete(store, key, len);
+        } else if (i % 4 == 0) {
+            setExpiry(store, key, len, now - 1 - i);
+        } else if (i % 4 == 1) {
+            setExpiry(store, key, len, now + 60000 + i);
+        } else if (i % 4 == 2) {
+            setExpiry(store, key, len, now + 1000);
+            setExpiry(store, key, len, 0);
+        } else {
+            setExpiry(store, key, len, now + 60000);
+            storeSet(store, key, len, "2", 1);
+        }
+        if (i % 8 == 5) {
+            // Outgrows the entry, the TTL moves with the key
+            storeIncrByFloat(store, key, len, 0.123456789012345L, result,
+                             sizeof(result), &resultLen);
+        }
+    }
+    TEST_ASSERT(expiry_wheels_valid(store), "Timers should track exactly the keys with a TTL");
+    TEST_ASSERT_EQUAL(1750, storeSize(store), "Due keys should wait for a cycle");
+
+    int incomplete = -1;
+    TEST_ASSERT_EQUAL(250, storeActiveExpire(store, 1000000, &incomplete),
+                      "A generous budget should delete every due key");
+    TEST_ASSERT(incomplete == 0 && storeExpiredKeys(store) == 250,
+                "A cycle that keeps up should count its keys and report completion");
+    TEST_ASSERT_EQUAL(1500, storeSize(store), "Only due keys should be deleted");
+    TEST_ASSERT(expiry_wheels_valid(store), "Timers should track exactly the keys with a TTL");
+
+    int kept = 1;
+    for (int i = 0; i < 2000; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        time_t expiry = 0;
+        int found = getExpiry(store, key, len, &expiry) == STORE_OK;
+        kept &= i % 4 == 0 ? !found : found && (expiry != 0) == (i % 4 == 1);
+    }
+    TEST_ASSERT(kept, "Keys without a passed TTL should keep their expiry");
+    TEST_ASSERT_EQUAL(0, storeActiveExpire(store, 1000000, NULL),
+                      "Nothing should be left to expire");
+
+    freeStore(store);
+}
+
+void test_store_active_expire_budget(void) {
+    RedisStore *store = createShardedStore(4);
+    time_t now = getCurrentTimeMs();
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        storeSet(store, key, len, "v", 1);
+        setExpiry(store, key, len, now - 1000 + i % 500);
+    }
+
+    // A spent budget still expires one batch per call, and the cursor
+    // moves on so no shard is left behind
+    size_t total = 0;
+    int calls = 0;
+    int progress = 1;
+    int incomplete = 0;
+    while (storeSize(store) > 0 && calls < 1000) {
+        size_t expired = storeActiveExpire(store, 0, &incomplete);
+        progress &= expired > 0 && expired <= STORE_EXPIRE_BATCH;
+        if (calls == 0) {
+            TEST_ASSERT(incomplete, "A spent budget with keys left should be reported");
+        }
+        total += expired;
+        calls++;
+    }
+    TEST_ASSERT(progress, "Each call should expire at most one batch");
+    TEST_ASSERT_EQUAL(1000, total, "Repeated calls should reach every shard");
+    TEST_ASSERT_EQUAL(1000, storeExpiredKeys(store), "Every expired key should be counted");
+    TEST_ASSERT(expiry_wheels_valid(store), "No timers should be left");
+
+    freeStore(store);
+}
+
+static void ignore_value(const void *value, size_t valueLen, SharedValue *shared, void *ctx) {
+    (void)value;
+    (void)valueLen;
+    (void)shared;
+    (void)ctx;
+}
+
+static void ignore_stream(Stream *stream, void *ctx) {
+    (void)stream;
+    (void)ctx;
+}
+
+void test_store_lazy_expire(void) {
+    RedisStore *store = createStore();
+    time_t past = getCurrentTimeMs() - 1;
+    char key[32];
+    for (int i = 0; i < 10; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        if (i == 5) {
+            char *id;
+            storeStreamAdd(store, key, len, "1-1", NULL, NULL, 0, &id);
+            free(id);
+        } else {
+            storeSet(store, key, len, "value", 5);
+        }
+        setExpiry(store, key, len, past);
+    }
+
+    // Every access path deletes the expired key it finds
+    size_t len;
+    time_t expiry;
+    int missing = 1;
+    missing &= storeGet(store, "key0", 4, &len) == NULL;
+    missing &= storeGetShared(store, "key1", 4) == NULL;
+    missing &= storeVisitValue(store, "key2", 4, ignore_value, NULL) == STORE_ERR;
+    missing &= getValueType(store, "key3", 4) == TYPE_NONE;
+    missing &= getExpiry(store, "key4", 4, &expiry) == STORE_ERR;
+    missing &= storeVisitStream(store, "key5", 4, ignore_stream, NULL) == STORE_ERR;
+    missing &= storeDelete(store, "key6", 4) == STORE_ERR;
+    missing &= setExpiry(store, "key7", 4, 0) == STORE_ERR;
+    TEST_ASSERT(missing, "Expired keys should read as missing");
+    TEST_ASSERT(storeSize(store) == 2 && storeExpiredKeys(store) == 8,
+                "Reading an expired key should delete it");
+    TEST_ASSERT(expiry_wheels_valid(store), "Deleted keys should leave the timer wheel");
+
+    // Writers start over on a fresh key without the old TTL
+    storeSet(store, "key8", 4, "fresh", 5);
+    char *fields[] = {"field"};
+    char *values[] = {"value"};
+    char *id = NULL;
+    storeStreamAdd(store, "key9", 4, "1-1", fields, values, 1, &id);
+    TEST_ASSERT(id && getValueType(store, "key9", 4) == TYPE_STREAM,
+                "A stream should be recreated over an expired key");
+    free(id);
+    TEST_ASSERT(getExpiry(store, "key8", 4, &expiry) == STORE_OK && expiry == 0 &&
+                storeExpiredKeys(store) == 10,
+                "Overwriting an expired key should count it as expired");
+
+    freeStore(store);
+}
+
+typedef struct LazyExpireArgs {
+    RedisStore *store;
+    int missing;
+} LazyExpireArgs;
+
+static void *lazy_expire_reader(void *arg) {
+    LazyExpireArgs *args = (LazyExpireArgs *)arg;
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(key, sizeof(key), "hot%d", i);
+        size_t valueLen;
+        args->missing &= storeGet(args->store, key, len, &valueLen) == NULL;
+    }
+    return NULL;
+}
+
+void test_store_concurrent_lazy_expire(void) {
+    RedisStore *store = createShardedStore(4);
+    time_t past = getCurrentTimeMs() - 1;
+    char key[32];
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(key, sizeof(key), "hot%d", i);
+        storeSet(store, key, len, "value", 5);
+        setExpiry(store, key, len, past);
+    }
+
+    pthread_t threads[4];
+    LazyExpireArgs args[4];
+    for (int i = 0; i < 4; i++) {
+        args[i] = (LazyExpireArgs){store, 1};
+        pthread_create(&threads[i], NULL, lazy_expire_reader, &args[i]);
+    }
+    int missing = 1;
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        missing &= args[i].missing;
+    }
+    TEST_ASSERT(missing, "Concurrent readers should all miss");
+    TEST_ASSERT(storeSize(store) == 0 && storeExpiredKeys(store) == 1000,
+                "Racing readers should delete each key exactly once");
+
+    freeStore(store);
+}
+
+typedef struct StreamReaderArgs {
+    RedisStore *store;
+    int intact;
+    int visits;
+} StreamReaderArgs;
+
+static void range_whole_stream(Stream *stream, void *ctx) {
+    StreamReaderArgs *args = (StreamReaderArgs *)ctx;
+    size_t count;
+    StreamEntry *entry = streamRange(stream, "-", "+", &count, NULL);
+    size_t walked = 0;
+    while (entry) {
+        StreamEntry *next = entry->next;
+        args->intact &= entry->numFields == 1 && strcmp(entry->values[0], "v") == 0;
+        freeStreamEntry(entry);
+        entry = next;
+        walked++;
+    }
+    args->intact &= walked == count;
+    args->visits++;
+}
+
+static void *stream_reader(void *arg) {
+    StreamReaderArgs *args = (StreamReaderArgs *)arg;
+    for (int i = 0; i < 2000; i++) {
+        storeVisitStream(args->store, "events", 6, range_whole_stream, args);
+    }
+    return NULL;
+}
+
+void test_store_concurrent_stream_reads(void) {
+    RedisStore *store = createShardedStore(4);
+    pthread_t threads[3];
+    StreamReaderArgs args[3];
+    for (int i = 0; i < 3; i++) {
+        args[i] = (StreamReaderArgs){store, 1, 0};
+        pthread_create(&threads[i], NULL, stream_reader, &args[i]);
+    }
+
+    // Appending to the stream and replacing it race with the readers' walks
+    char *fields[] = {"f"};
+    char *values[] = {"v"};
+    char id[32];
+    for (int i = 1; i <= 2000; i++) {
+        snprintf(id, sizeof(id), "%d-1", i);
+        char *added;
+        storeStreamAdd(store, "events", 6, id, fields, values, 1, &added);
+        free(added);
+        if (i % 100 == 0) {
+            storeDelete(store, "events", 6);
+        } else if (i % 50 == 0) {
+            storeSet(store, "events", 6, "plain", 5);
+            storeDelete(store, "events", 6);
+        }
+    }
+
+    int intact = 1;
+    for (int i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+        intact &= args[i].intact;
+    }
+    TEST_ASSERT(intact, "Readers should only see whole entries of a live stream");
+
+    freeStore(store);
+}
+
 void run_redis_store_tests(void) {
     printf("\n=== Redis Store Tests ===\n");
     RUN_TEST(test_create_store);
@@ -194,4 +890,23 @@ void run_redis_store_tests(void) {
     RUN_TEST(test_store_value_type);
     RUN_TEST(test_store_null_parameters);
     RUN_TEST(test_store_hash_collision);
+    RUN_TEST(test_store_binary_keys);
+    RUN_TEST(test_store_delete);
+    RUN_TEST(test_store_get_expiry);
+    RUN_TEST(test_store_clear);
+    RUN_TEST(test_store_rehash);
+    RUN_TEST(test_store_shards);
+    RUN_TEST(test_store_owned);
+    RUN_TEST(test_store_concurrent_writers);
+    RUN_TEST(test_store_visit_value);
+    RUN_TEST(test_store_shared_value);
+    RUN_TEST(test_store_value_encodings);
+    RUN_TEST(test_store_incr_by);
+    RUN_TEST(test_store_incr_by_float);
+    RUN_TEST(test_store_concurrent_increments);
+    RUN_TEST(test_store_active_expire);
+    RUN_TEST(test_store_active_expire_budget);
+    RUN_TEST(test_store_lazy_expire);
+    RUN_TEST(test_store_concurrent_lazy_expire);
+    RUN_TEST(test_store_concurrent_stream_reads);
 }
\ No newline at end of file
@@ -152,6 +152,343 @@ void test_parse_line_incomplete(void) {
     TEST_ASSERT_EQUAL(RESP_INCOMPLETE, result, "Parse incomplete line should return RESP_INCOMPLETE");
 }
 
+void test_parse_resp_in_place(void) {
+    RespBuffer *buffer = createRespBuffer();
+    const char *data = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n";
+    appendRespBuffer(buffer, data, strlen(data));
+
+    RespValue *command = NULL;
+    int result = parseRespInPlace(buffer, &command);
+    TEST_ASSERT_EQUAL(RESP_OK, result, "In-place parse should succeed");
+    TEST_ASSERT_EQUAL(RespTypeArray, command->type, "Parsed value should be an array");
+    TEST_ASSERT_EQUAL(3, command->data.array.len, "Array should have 3 elements");
+
+    RespValue *key = command->data.array.elements[1];
+    TEST_ASSERT_STRING_EQUAL("key", key->data.string.str, "Key should be NUL terminated in place");
+    TEST_ASSERT_EQUAL(3, key->data.string.len, "Key length should be correct");
+    TEST_ASSERT(key->data.string.str >= buffer->buffer &&
+                key->data.string.str < buffer->buffer + buffer->size,
+                "Key should point into the receive buffer");
+    TEST_ASSERT_STRING_EQUAL("value", command->data.array.elements[2]->data.string.str,
+                             "Value should be NUL terminated in place");
+    TEST_ASSERT_EQUAL(0, buffer->used, "Fully parsed buffer should be reset");
+
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_in_place_pipelined(void) {
+    RespBuffer *buffer = createRespBuffer();
+    const char *data = "*1\r\n$4\r\nPING\r\n*2\r\n$4\r\nECHO\r\n$2\r\nhi\r\n*1\r\n$4";
+    appendRespBuffer(buffer, data, strlen(data));
+    char *start = buffer->buffer;
+
+    RespValue *command = NULL;
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command), "First command should parse");
+    TEST_ASSERT_STRING_EQUAL("PING", command->data.array.elements[0]->data.string.str,
+                             "First command should be PING");
+    TEST_ASSERT_EQUAL(14, buffer->pos, "Cursor should advance past the first command");
+
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command), "Second command should parse");
+    TEST_ASSERT_STRING_EQUAL("hi", command->data.array.elements[1]->data.string.str,
+                             "Second command argument should be correct");
+
+    TEST_ASSERT_EQUAL(RESP_INCOMPLETE, parseRespInPlace(buffer, &command),
+                      "Partial command should be incomplete");
+    TEST_ASSERT(buffer->buffer == start && buffer->pos > 0,
+                "Parsing should not move the remaining data");
+
+    const char *rest = "\r\nPING\r\n";
+    appendRespBuffer(buffer, rest, strlen(rest));
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command),
+                      "Completed command should parse");
+    TEST_ASSERT_STRING_EQUAL("PING", command->data.array.elements[0]->data.string.str,
+                             "Completed command should be PING");
+
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_in_place_compacts(void) {
+    RespBuffer *buffer = createRespBuffer();
+    const char *ping = "*1\r\n$4\r\nPING\r\n";
+    size_t pingLen = strlen(ping);
+
+    // Fill the buffer with whole commands followed by a partial one
+    while (buffer->used + pingLen <= buffer->size) {
+        appendRespBuffer(buffer, ping, pingLen);
+    }
+    size_t partial = buffer->size - buffer->used;
+    appendRespBuffer(buffer, ping, partial);
+
+    RespValue *command = NULL;
+    while (parseRespInPlace(buffer, &command) == RESP_OK) {
+    }
+    size_t size = buffer->size;
+    TEST_ASSERT_EQUAL(buffer->size, buffer->used, "Buffer should be full");
+
+    appendRespBuffer(buffer, ping + partial, pingLen - partial);
+    TEST_ASSERT_EQUAL(0, buffer->pos, "Append into a full buffer should compact");
+    TEST_ASSERT_EQUAL(size, buffer->size, "Compaction should avoid growing the buffer");
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command),
+                      "Command split across compaction should parse");
+
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_in_place_errors(void) {
+    RespBuffer *buffer = createRespBuffer();
+    RespValue *command = NULL;
+
+    const char *badLength = "*1\r\n$x\r\nPING\r\n";
+    appendRespBuffer(buffer, badLength, strlen(badLength));
+    TEST_ASSERT_EQUAL(RESP_ERR, parseRespInPlace(buffer, &command),
+                      "Non-numeric length should be a protocol error");
+    freeRespBuffer(buffer);
+
+    buffer = createRespBuffer();
+    const char *badTerminator = "*1\r\n$4\r\nPINGxx";
+    appendRespBuffer(buffer, badTerminator, strlen(badTerminator));
+    TEST_ASSERT_EQUAL(RESP_ERR, parseRespInPlace(buffer, &command),
+                      "Missing CRLF after bulk data should be a protocol error");
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_oversized_array(void) {
+    RespBuffer *buffer = createRespBuffer();
+    RespValue *value = NULL;
+
+    const char *huge = "*100000000000\r\n$4\r\nPING\r\n";
+    appendRespBuffer(buffer, huge, strlen(huge));
+    TEST_ASSERT_EQUAL(RESP_ERR, parseResp(buffer, &value),
+                      "Array longer than RESP_MAX_ARGS should be rejected");
+    freeRespBuffer(buffer);
+
+    buffer = createRespBuffer();
+    const char *ping = "*1\r\n$4\r\nPING\r\n";
+    appendRespBuffer(buffer, ping, strlen(ping));
+    TEST_ASSERT_EQUAL(RESP_OK, parseResp(buffer, &value),
+                      "Arrays within the limit should still parse");
+    freeRespValue(value);
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_in_place_arg_slots(void) {
+    RespBuffer *buffer = createRespBuffer();
+    RespValue *command = NULL;
+
+    // A header alone must not size the argument slots
+    const char *claim = "*1048576\r\n";
+    appendRespBuffer(buffer, claim, strlen(claim));
+    TEST_ASSERT_EQUAL(RESP_INCOMPLETE, parseRespInPlace(buffer, &command),
+                      "A header without arguments should be incomplete");
+    TEST_ASSERT(buffer->argsCapacity <= RESP_ARGS_RETAIN,
+                "Slots should not be reserved for arguments not yet received");
+    freeRespBuffer(buffer);
+
+    // Slots grow with a long command and are given back after it
+    buffer = createRespBuffer();
+    char arg[16];
+    appendRespBuffer(buffer, "*1000\r\n", 7);
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(arg, sizeof(arg), "$3\r\n%03d\r\n", i);
+        appendRespBuffer(buffer, arg, len);
+    }
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command),
+                      "A long command should parse");
+    TEST_ASSERT(command->data.array.len == 1000 &&
+                strcmp(command->data.array.elements[999]->data.string.str, "999") == 0,
+                "Every argument should survive the slots growing");
+    TEST_ASSERT(buffer->argsCapacity >= 1000, "Slots should grow to the command");
+
+    const char *ping = "*1\r\n$4\r\nPING\r\n";
+    appendRespBuffer(buffer, ping, strlen(ping));
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command),
+                      "A short command should parse after a long one");
+    TEST_ASSERT(buffer->argsCapacity <= RESP_ARGS_RETAIN,
+                "Slots grown for an oversized command should be released");
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_in_place_incremental(void) {
+    RespBuffer *buffer = createRespBuffer();
+    RespValue *command = NULL;
+    size_t valueLen = 1024 * 1024;
+
+    char header[64];
+    int headerLen = snprintf(header, sizeof(header),
+                             "*3\r\n$3\r\nSET\r\n$3\r\nbig\r\n$%zu\r\n", valueLen);
+    appendRespBuffer(buffer, header, headerLen);
+    TEST_ASSERT_EQUAL(RESP_INCOMPLETE, parseRespInPlace(buffer, &command),
+                      "Command without its value should be incomplete");
+    TEST_ASSERT_EQUAL(2, buffer->parsedArgs, "Received arguments should be remembered");
+    TEST_ASSERT_EQUAL(valueLen, (size_t)buffer->bulkLen, "Pending argument length should be remembered");
+    TEST_ASSERT(buffer->size - buffer->used >= valueLen + 2,
+                "Buffer should be presized for the large argument");
+
+    char chunk[1024];
+    memset(chunk, 'x', sizeof(chunk));
+    size_t size = buffer->size;
+    int resumed = 1;
+    for (size_t sent = 0; sent < valueLen; sent += sizeof(chunk)) {
+        appendRespBuffer(buffer, chunk, sizeof(chunk));
+        if (parseRespInPlace(buffer, &command) != RESP_INCOMPLETE || buffer->parsedArgs != 2) {
+            resumed = 0;
+        }
+    }
+    TEST_ASSERT(resumed, "Each chunk should resume the scan at the pending argument");
+    TEST_ASSERT_EQUAL(size, buffer->size, "Presized buffer should not grow again");
+
+    appendRespBuffer(buffer, "\r\n", 2);
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command), "Completed command should parse");
+    TEST_ASSERT_EQUAL(3, command->data.array.len, "Array should have 3 elements");
+    TEST_ASSERT_STRING_EQUAL("big", command->data.array.elements[1]->data.string.str,
+                             "Key should survive the resumed scan");
+    TEST_ASSERT_EQUAL(valueLen, command->data.array.elements[2]->data.string.len,
+                      "Value length should be correct");
+    TEST_ASSERT_EQUAL(-1, buffer->pendingArgs, "Parse state should be reset");
+
+    freeRespBuffer(buffer);
+}
+
+void test_parse_resp_in_place_byte_at_a_time(void) {
+    RespBuffer *buffer = createRespBuffer();
+    RespValue *command = NULL;
+    const char *data = "*2\r\n$4\r\nECHO\r\n$11\r\nhello world\r\n";
+    size_t len = strlen(data);
+
+    int incomplete = 1;
+    for (size_t i = 0; i < len - 1; i++) {
+        appendRespBuffer(buffer, data + i, 1);
+        if (parseRespInPlace(buffer, &command) != RESP_INCOMPLETE) {
+            incomplete = 0;
+        }
+    }
+    TEST_ASSERT(incomplete, "Every prefix of the command should be incomplete");
+    appendRespBuffer(buffer, data + len - 1, 1);
+    TEST_ASSERT_EQUAL(RESP_OK, parseRespInPlace(buffer, &command), "Completed command should parse");
+    TEST_ASSERT_STRING_EQUAL("hello world", command->data.array.elements[1]->data.string.str,
+                             "Argument should be correct");
+
+    freeRespBuffer(buffer);
+}
+
+void test_reserve_resp_buffer(void) {
+    RespBuffer *buffer = createRespBuffer();
+    TEST_ASSERT_EQUAL(RESP_OK, reserveRespBuffer(buffer, 100000), "Reserve should succeed");
+    TEST_ASSERT(buffer->size - buffer->used >= 100000, "Reserved space should be available");
+    freeRespBuffer(buffer);
+}
+
+static char *render(OutputBuffer *out) {
+    char *result = flattenOutputBuffer(out, NULL);
+    resetOutputBuffer(out);
+    return result;
+}
+
+void test_write_simple_replies(void) {
+    OutputBuffer *out = createOutputBuffer();
+
+    writeSimpleString(out, "OK");
+    char *result = render(out);
+    TEST_ASSERT_STRING_EQUAL("+OK\r\n", result, "Simple string should be encoded");
+    free(result);
+
+    writeError(out, "ERR boom");
+    result = render(out);
+    TEST_ASSERT_STRING_EQUAL("-ERR boom\r\n", result, "Error should be encoded");
+    free(result);
+
+    writeInteger(out, -42);
+    result = render(out);
+    TEST_ASSERT_STRING_EQUAL(":-42\r\n", result, "Integer should be encoded");
+    free(result);
+
+    writeNullBulkString(out);
+    result = render(out);
+    TEST_ASSERT_STRING_EQUAL("$-1\r\n", result, "Null bulk string should be encoded");
+    free(result);
+
+    freeOutputBuffer(out);
+}
+
+void test_write_bulk_string_binary_safe(void) {
+    OutputBuffer *out = createOutputBuffer();
+    const char value[] = {'a', '\0', 'b', '\r', '\n'};
+
+    TEST_ASSERT_EQUAL(OUTPUT_OK, writeBulkString(out, value, sizeof(value)),
+                      "Bulk string write should succeed");
+    size_t len;
+    char *result = flattenOutputBuffer(out, &len);
+    TEST_ASSERT_EQUAL(11, len, "Encoded length should include embedded NUL bytes");
+    TEST_ASSERT(memcmp("$5\r\na\0b\r\n\r\n", result, len) == 0,
+                "Bulk string should be copied byte for byte");
+    free(result);
+
+    freeOutputBuffer(out);
+}
+
+void test_write_array(void) {
+    OutputBuffer *out = createOutputBuffer();
+
+    writeArrayHeader(out, 2);
+    writeBulkString(out, "foo", 3);
+    writeInteger(out, 7);
+    char *result = render(out);
+    TEST_ASSERT_STRING_EQUAL("*2\r\n$3\r\nfoo\r\n:7\r\n", result,
+                             "Array should be encoded element by element");
+    free(result);
+
+    freeOutputBuffer(out);
+}
+
+void test_write_resp_value(void) {
+    OutputBuffer *out = createOutputBuffer();
+    RespValue *elements[2];
+    elements[0] = createRespString("GET", 3);
+    elements[1] = createRespString("key", 3);
+    RespValue array = {.type = RespTypeArray};
+    array.data.array.elements = elements;
+    array.data.array.len = 2;
+
+    writeRespValue(out, &array);
+    char *result = render(out);
+    TEST_ASSERT_STRING_EQUAL("*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n", result,
+                             "Parsed command should be re-encoded");
+    free(result);
+
+    freeRespValue(elements[0]);
+    freeRespValue(elements[1]);
+    freeOutputBuffer(out);
+}
+
+void test_clone_shares_large_strings(void) {
+    size_t len = SHARED_VALUE_MIN_REF;
+    char *data = malloc(len);
+    memset(data, 'x', len);
+    RespValue *large = createRespString(data, len);
+    RespValue *small = createRespString("v", 1);
+
+    RespValue *first = cloneRespValue(large);
+    RespValue *second = cloneRespValue(first);
+    RespValue *copy = cloneRespValue(small);
+    TEST_ASSERT_NULL(copy->data.string.shared, "Small strings should be copied");
+    TEST_ASSERT(first->data.string.shared != NULL &&
+                second->data.string.shared == first->data.string.shared &&
+                first->data.string.shared->refcount == 2,
+                "Cloning a large string should share one copy");
+    TEST_ASSERT(memcmp(second->data.string.str, data, len) == 0,
+                "Shared clone should hold the original bytes");
+
+    freeRespValue(first);
+    TEST_ASSERT_EQUAL(1, second->data.string.shared->refcount,
+                      "Freeing a clone should drop its reference");
+
+    freeRespValue(second);
+    freeRespValue(copy);
+    freeRespValue(small);
+    freeRespValue(large);
+    free(data);
+}
+
 void run_resp_tests(void) {
     printf("\n=== RESP Protocol Tests ===\n");
     RUN_TEST(test_create_resp_buffer);
@@ -169,4 +506,18 @@ void run_resp_tests(void) {
     RUN_TEST(test_create_resp_string);
     RUN_TEST(test_parse_line);
     RUN_TEST(test_parse_line_incomplete);
+    RUN_TEST(test_parse_resp_in_place);
+    RUN_TEST(test_parse_resp_in_place_pipelined);
+    RUN_TEST(test_parse_resp_in_place_compacts);
+    RUN_TEST(test_parse_resp_in_place_errors);
+    RUN_TEST(test_parse_resp_oversized_array);
+    RUN_TEST(test_parse_resp_in_place_arg_slots);
+    RUN_TEST(test_parse_resp_in_place_incremental);
+    RUN_TEST(test_parse_resp_in_place_byte_at_a_time);
+    RUN_TEST(test_reserve_resp_buffer);
+    RUN_TEST(test_write_simple_replies);
+    RUN_TEST(test_write_bulk_string_binary_safe);
+    RUN_TEST(test_write_array);
+    RUN_TEST(test_write_resp_value);
+    RUN_TEST(test_clone_shares_large_strings);
 }
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "test_framework.h"
+#include "slab.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_TEST_OBJECTS 100000
+
+void test_slab_size_classes(void) {
+    size_t requests[] = {1, 16, 17, 128, 129, 160, 161, 257, 1000, SLAB_MAX_SIZE};
+    size_t expected[] = {16, 16, 32, 128, 160, 160, 192, 320, 1024, 1024};
+
+    int matched = 0;
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+        void *ptr = slabAlloc(requests[i]);
+        matched += slabUsableSize(ptr) == expected[i] && ((uintptr_t)ptr & 15) == 0;
+        slabFree(ptr);
+    }
+    TEST_ASSERT_EQUAL(10, matched, "Requests should round up to aligned size classes");
+}
+
+void test_slab_reuse(void) {
+    void *first = slabAlloc(40);
+    memset(first, 0xab, 40);
+    slabFree(first);
+    void *second = slabAlloc(48);
+    TEST_ASSERT(first == second, "A freed block should be reused by the same class");
+    slabFree(second);
+
+    char *copy = slabStrdup("hello");
+    TEST_ASSERT_STRING_EQUAL("hello", copy, "Strdup should copy the string");
+    slabFree(copy);
+}
+
+void test_slab_malloc_interop(void) {
+    SlabStats before, after;
+    slabGetStats(&before);
+    char *large = slabAlloc(SLAB_MAX_SIZE + 1);
+    memset(large, 1, SLAB_MAX_SIZE + 1);
+    TEST_ASSERT(slabUsableSize(large) >= SLAB_MAX_SIZE + 1,
+                "Large blocks should report malloc's usable size");
+    slabFree(large);
+    slabGetStats(&after);
+    TEST_ASSERT_EQUAL(before.mallocFallbacks + 1, after.mallocFallbacks,
+                      "Large requests should fall back to malloc");
+
+    // Blocks from malloc may be released through the slab
+    slabFree(malloc(24));
+    slabFree(NULL);
+}
+
+void test_slab_stats(void) {
+    void **objects = malloc(SLAB_TEST_OBJECTS * sizeof(void *));
+    SlabStats before, during, after;
+    slabGetStats(&before);
+    for (size_t i = 0; i < SLAB_TEST_OBJECTS; i++) {
+        objects[i] = slabAlloc(100);
+    }
+    slabGetStats(&during);
+    for (size_t i = 0; i < SLAB_TEST_OBJECTS; i++) {
+        slabFree(objects[i]);
+    }
+    slabGetStats(&after);
+    free(objects);
+
+    // 100 bytes is served by the 112 byte class
+    SlabClassStats *class = &during.classes[6];
+    TEST_ASSERT_EQUAL(112, class->size, "Class table should list its object size");
+    TEST_ASSERT(class->objects >= SLAB_TEST_OBJECTS &&
+                class->spans * (SLAB_SPAN_SIZE / 112) >= SLAB_TEST_OBJECTS,
+                "Allocated objects should be backed by carved spans");
+    TEST_ASSERT(after.classes[6].objects <= before.classes[6].objects + SLAB_CACHE_MAX &&
+                after.classes[6].free >= SLAB_TEST_OBJECTS - SLAB_CACHE_MAX,
+                "Freed objects should return to the central freelist");
+    TEST_ASSERT(after.lockAcquisitions > before.lockAcquisitions &&
+                after.lockAcquisitions - before.lockAcquisitions < SLAB_TEST_OBJECTS / 8,
+                "The central lock should only be taken once per batch");
+}
+
+typedef struct SlabHandoff {
+    void **objects;
+    size_t count;
+} SlabHandoff;
+
+// Frees on one thread what another allocated
+static void *slab_free_all(void *arg) {
+    SlabHandoff *handoff = (SlabHandoff *)arg;
+    for (size_t i = 0; i < handoff->count; i++) {
+        slabFree(handoff->objects[i]);
+    }
+    return NULL;
+}
+
+static void *slab_churn(void *arg) {
+    intptr_t seed = (intptr_t)arg;
+    int intact = 1;
+    for (int round = 0; round < 100; round++) {
+        char *blocks[64];
+        for (int i = 0; i < 64; i++) {
+            size_t size = 16 + (size_t)((seed + i * 37 + round) % 400);
+            blocks[i] = slabAlloc(size);
+            memset(blocks[i], (int)(seed + i), size);
+        }
+        for (int i = 0; i < 64; i++) {
+            intact &= blocks[i][0] == (char)(seed + i);
+            slabFree(blocks[i]);
+        }
+    }
+    return intact ? (void *)1 : NULL;
+}
+
+void test_slab_threads(void) {
+    SlabHandoff handoff = {malloc(SLAB_TEST_OBJECTS * sizeof(void *)), SLAB_TEST_OBJECTS};
+    for (size_t i = 0; i < handoff.count; i++) {
+        handoff.objects[i] = slabAlloc(64);
+    }
+    pthread_t freer;
+    pthread_create(&freer, NULL, slab_free_all, &handoff);
+    pthread_join(freer, NULL);
+    free(handoff.objects);
+
+    SlabStats stats;
+    slabGetStats(&stats);
+    TEST_ASSERT(stats.classes[3].free >= SLAB_TEST_OBJECTS - SLAB_CACHE_MAX,
+                "An exiting thread should flush its cache to the central freelist");
+
+    pthread_t threads[4];
+    for (intptr_t i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, slab_churn, (void *)i);
+    }
+    int intact = 1;
+    for (int i = 0; i < 4; i++) {
+        void *result;
+        pthread_join(threads[i], &result);
+        intact &= result != NULL;
+    }
+    TEST_ASSERT(intact, "Concurrent threads should never share a live block");
+}
+
+void run_slab_tests(void) {
+    printf("\n=== Slab Allocator Tests ===\n");
+    RUN_TEST(test_slab_size_classes);
+    RUN_TEST(test_slab_reuse);
+    RUN_TEST(test_slab_malloc_interop);
+    RUN_TEST(test_slab_stats);
+    RUN_TEST(test_slab_threads);
+}
@@ -0,0 +1,102 @@
+#include "test_framework.h"
+#include "spsc_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+
+#define SPSC_TEST_ITEMS 1000000
+
+void test_spsc_push_pop(void) {
+    SpscQueue *queue = createSpscQueue(8);
+    TEST_ASSERT_NOT_NULL(queue, "Queue creation should succeed");
+    TEST_ASSERT_NULL(spscPop(queue), "New queue should be empty");
+
+    int values[3] = {1, 2, 3};
+    for (int i = 0; i < 3; i++) {
+        spscPush(queue, &values[i]);
+    }
+    int ordered = 1;
+    for (int i = 0; i < 3; i++) {
+        ordered &= spscPop(queue) == &values[i];
+    }
+    TEST_ASSERT(ordered, "Items should pop in push order");
+    TEST_ASSERT_NULL(spscPop(queue), "Queue should be empty after draining");
+
+    freeSpscQueue(queue);
+}
+
+void test_spsc_full(void) {
+    SpscQueue *queue = createSpscQueue(5);
+    TEST_ASSERT_EQUAL(7, queue->mask, "Capacity should round up to a power of two");
+
+    int value = 0;
+    int pushed = 0;
+    while (spscPush(queue, &value) == 0) {
+        pushed++;
+    }
+    TEST_ASSERT_EQUAL(8, pushed, "Push should fail once the queue is full");
+
+    spscPop(queue);
+    TEST_ASSERT_EQUAL(0, spscPush(queue, &value), "Pop should free a slot");
+
+    freeSpscQueue(queue);
+}
+
+void test_spsc_wraparound(void) {
+    SpscQueue *queue = createSpscQueue(4);
+
+    // Cycle the indices several times around the ring
+    int ordered = 1;
+    for (uintptr_t i = 1; i <= 100; i++) {
+        spscPush(queue, (void *)i);
+        spscPush(queue, (void *)(i + 1000));
+        ordered &= spscPop(queue) == (void *)i;
+        ordered &= spscPop(queue) == (void *)(i + 1000);
+    }
+    TEST_ASSERT(ordered, "Order should hold across wraparound");
+    TEST_ASSERT_NULL(spscPop(queue), "Queue should end empty");
+
+    freeSpscQueue(queue);
+}
+
+static void *spsc_producer(void *arg) {
+    SpscQueue *queue = (SpscQueue *)arg;
+    for (uintptr_t i = 1; i <= SPSC_TEST_ITEMS; i++) {
+        while (spscPush(queue, (void *)i) != 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void test_spsc_two_threads(void) {
+    SpscQueue *queue = createSpscQueue(64);
+    pthread_t producer;
+    pthread_create(&producer, NULL, spsc_producer, queue);
+
+    uintptr_t expected = 1;
+    int ordered = 1;
+    while (expected <= SPSC_TEST_ITEMS) {
+        void *item = spscPop(queue);
+        if (!item) {
+            sched_yield();
+            continue;
+        }
+        ordered &= (uintptr_t)item == expected;
+        expected++;
+    }
+    pthread_join(producer, NULL);
+
+    TEST_ASSERT(ordered, "Consumer should see every item once, in order");
+    TEST_ASSERT_NULL(spscPop(queue), "Queue should be empty after the producer finishes");
+
+    freeSpscQueue(queue);
+}
+
+void run_spsc_queue_tests(void) {
+    printf("\n=== SPSC Queue Tests ===\n");
+    RUN_TEST(test_spsc_push_pop);
+    RUN_TEST(test_spsc_full);
+    RUN_TEST(test_spsc_wraparound);
+    RUN_TEST(test_spsc_two_threads);
+}
@@ -74,7 +74,7 @@ void test_stream_range(void) {
     streamAdd(stream, "1234567890125-0", fields, values, 1);
     
     size_t count;
-    StreamEntry *entries = streamRange(stream, "-", "+", &count);
+    StreamEntry *entries = streamRange(stream, "-", "+", &count, NULL);
     TEST_ASSERT_NOT_NULL(entries, "Stream range should return entries");
     TEST_ASSERT_EQUAL(3, count, "Stream range should return all entries");
     
@@ -92,7 +92,7 @@ void test_stream_range_with_bounds(void) {
     streamAdd(stream, "1234567890125-0", fields, values, 1);
     
     size_t count;
-    StreamEntry *entries = streamRange(stream, "1234567890124-0", "1234567890125-0", &count);
+    StreamEntry *entries = streamRange(stream, "1234567890124-0", "1234567890125-0", &count, NULL);
     TEST_ASSERT_NOT_NULL(entries, "Stream range with bounds should return entries");
     TEST_ASSERT_EQUAL(2, count, "Stream range should return bounded entries");
     
@@ -109,7 +109,7 @@ void test_stream_read(void) {
     streamAdd(stream, "1234567890124-0", fields, values, 1);
     
     size_t count;
-    StreamEntry *entries = streamRead(stream, "1234567890123-0", &count);
+    StreamEntry *entries = streamRead(stream, "1234567890123-0", &count, NULL);
     TEST_ASSERT_NOT_NULL(entries, "Stream read should return entries");
     TEST_ASSERT_EQUAL(1, count, "Stream read should return entries after specified ID");
     
@@ -0,0 +1,169 @@
+#include "test_framework.h"
+#include "timer_wheel.h"
+#include <stdlib.h>
+
+#define WHEEL_TEST_TIMERS 20000
+
+// Counts the scheduled nodes and checks their links and occupancy bits
+static size_t wheel_scheduled(TimerWheel *wheel, int *valid) {
+    size_t count = 0;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            TimerNode **link = &wheel->slots[level][slot];
+            *valid &= (*link != NULL) == ((wheel->occupied[level] >> slot) & 1);
+            for (TimerNode *node = *link; node; node = node->next) {
+                *valid &= node->pprev == link;
+                link = &node->next;
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+static unsigned long long next_random(unsigned long long *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 17;
+}
+
+void test_timer_wheel_expiry_order(void) {
+    TimerWheel wheel;
+    timerWheelInit(&wheel, 1000);
+    TimerNode *nodes = calloc(WHEEL_TEST_TIMERS, sizeof(TimerNode));
+
+    // Deadlines from every level, including some already passed
+    unsigned long long seed = 42;
+    for (int i = 0; i < WHEEL_TEST_TIMERS; i++) {
+        long long range = 1LL << (4 * (i % 9) + 2);
+        timerWheelAdd(&wheel, &nodes[i], 900 + (long long)(next_random(&seed) % range));
+    }
+    int valid = 1;
+    TEST_ASSERT(wheel_scheduled(&wheel, &valid) == WHEEL_TEST_TIMERS && valid,
+                "Every timer should be linked into an occupied slot");
+
+    // Advance in uneven steps; each pop must be due, and nothing due may
+    // be left behind once pop runs dry
+    long long now = 1000;
+    size_t popped = 0;
+    int due = 1;
+    int complete = 1;
+    while (wheel.count > 0) {
+        now += (long long)(next_random(&seed) % 5000) + 1;
+        if (popped > WHEEL_TEST_TIMERS / 2) {
+            now += 1LL << 28;
+        }
+        TimerNode *node;
+        while ((node = timerWheelPop(&wheel, now))) {
+            due &= node->when <= now && !node->pprev;
+            popped++;
+        }
+        for (int i = 0; i < WHEEL_TEST_TIMERS; i++) {
+            complete &= nodes[i].when > now || !nodes[i].pprev;
+        }
+    }
+    TEST_ASSERT(due, "Popped timers should be due and idle");
+    TEST_ASSERT(complete, "Every due timer should be popped");
+    TEST_ASSERT_EQUAL(WHEEL_TEST_TIMERS, popped, "Each timer should pop once");
+
+    free(nodes);
+}
+
+void test_timer_wheel_exact_tick(void) {
+    TimerWheel wheel;
+    timerWheelInit(&wheel, 5);
+    long long deadlines[] = {5, 63, 64, 65, 4095, 4096, 300000, 1LL << 40};
+    size_t count = sizeof(deadlines) / sizeof(deadlines[0]);
+    TimerNode nodes[8];
+    for (size_t i = 0; i < count; i++) {
+        timerWheelAdd(&wheel, &nodes[i], deadlines[i]);
+    }
+
+    // Nothing pops a tick early, and each pops on its own tick
+    int exact = 1;
+    for (size_t i = 0; i < count; i++) {
+        exact &= timerWheelPop(&wheel, deadlines[i] - 1) == NULL;
+        exact &= timerWheelPop(&wheel, deadlines[i]) == &nodes[i];
+    }
+    TEST_ASSERT(exact, "Timers should expire on their deadline tick");
+    TEST_ASSERT_EQUAL(0, wheel.count, "The wheel should be empty");
+
+    // A deadline behind the wheel expires on the next pop
+    timerWheelAdd(&wheel, &nodes[0], 1);
+    TEST_ASSERT(timerWheelPop(&wheel, wheel.now) == &nodes[0],
+                "A passed deadline should pop at once");
+}
+
+void test_timer_wheel_remove(void) {
+    TimerWheel wheel;
+    timerWheelInit(&wheel, 0);
+    TimerNode nodes[300];
+    for (int i = 0; i < 300; i++) {
+        // Several timers per slot so removal hits heads, middles and tails
+        timerWheelAdd(&wheel, &nodes[i], (i % 100) * 50);
+    }
+    for (int i = 0; i < 300; i += 2) {
+        timerWheelRemove(&wheel, &nodes[i]);
+    }
+    int valid = 1;
+    TEST_ASSERT(wheel_scheduled(&wheel, &valid) == 150 && valid,
+                "Removal should unlink nodes and keep occupancy exact");
+
+    // Moving a node keeps its place in the list
+    TimerNode moved;
+    timerWheelReplace(&nodes[1], &moved);
+    int odd = 1;
+    size_t popped = 0;
+    TimerNode *node;
+    while ((node = timerWheelPop(&wheel, 10000))) {
+        odd &= node == &moved || ((node - nodes) % 2 == 1 && node != &nodes[1]);
+        popped++;
+    }
+    TEST_ASSERT(odd && popped == 150, "Only the timers left should pop");
+
+    valid = 1;
+    TEST_ASSERT(wheel_scheduled(&wheel, &valid) == 0 && valid,
+                "An empty wheel should have no occupied slots");
+}
+
+void test_timer_wheel_next_expiry(void) {
+    TimerWheel wheel;
+    timerWheelInit(&wheel, 5);
+    TEST_ASSERT_EQUAL(-1, timerWheelNextExpiry(&wheel),
+                      "An empty wheel should have nothing to wait for");
+
+    long long deadlines[] = {5, 70, 4100, 300000};
+    TimerNode nodes[4];
+    for (int i = 0; i < 4; i++) {
+        timerWheelAdd(&wheel, &nodes[i], deadlines[i]);
+    }
+
+    // Sleeping until the reported tick never oversleeps a deadline, and
+    // takes far fewer wakeups than ticking
+    long long now = 5;
+    int onTime = 1;
+    int wakeups = 0;
+    while (wheel.count > 0 && wakeups < 100) {
+        long long next = timerWheelNextExpiry(&wheel);
+        if (next > now) {
+            now = next;
+        }
+        TimerNode *node;
+        while ((node = timerWheelPop(&wheel, now))) {
+            onTime &= node->when == now;
+        }
+        wakeups++;
+    }
+    TEST_ASSERT(onTime && wheel.count == 0,
+                "Every timer should pop on the tick it was waited for");
+    TEST_ASSERT(wakeups < 20, "Waits should skip idle ticks");
+    TEST_ASSERT_EQUAL(-1, timerWheelNextExpiry(&wheel),
+                      "A drained wheel should have nothing to wait for");
+}
+
+void run_timer_wheel_tests(void) {
+    printf("\n=== Timer Wheel Tests ===\n");
+    RUN_TEST(test_timer_wheel_expiry_order);
+    RUN_TEST(test_timer_wheel_exact_tick);
+    RUN_TEST(test_timer_wheel_remove);
+    RUN_TEST(test_timer_wheel_next_expiry);
+}